@@ -29,6 +29,7 @@
 #include "AstcTextures.h"
 #include "Timer.h"
 #include "SolidSphere.h"
+#include "TextureStreamer.h"
 
 using namespace AstcTextures;
 using namespace std;
@@ -46,6 +47,9 @@ Text* text_displayer = NULL;
 /* Instance of SolidSphere which provides mesh data for the globe. */
 SolidSphere* solid_sphere = NULL;
 
+/* Loads the textures in the background. NULL once every texture has been loaded, or if streaming is disabled. */
+MaliSDK::TextureStreamer* texture_streamer = NULL;
+
 /* Place where all asset files are located. */
 const string resource_directory("/data/data/com.arm.malideveloper.openglessdk.astctextures/files/");
 
@@ -273,6 +277,23 @@ GLuint create_program(const char* vertex_source, const char* fragment_source)
     return program;
 }
 
+/**
+ * \brief Check whether all textures of a texture set have been loaded.
+ *
+ * \param[in] texture_set_id Index of the texture set.
+ */
+bool is_texture_set_loaded(unsigned int texture_set_id)
+{
+    if (texture_streamer == NULL)
+    {
+        return true;
+    }
+
+    return texture_streamer->isTextureComplete(texture_ids[texture_set_id].cloud_and_gloss_texture_id) &&
+           texture_streamer->isTextureComplete(texture_ids[texture_set_id].earth_color_texture_id)     &&
+           texture_streamer->isTextureComplete(texture_ids[texture_set_id].earth_night_texture_id);
+}
+
 /**
  * \brief Update texture bindings and text presented by text renderer.
  *
@@ -281,7 +302,10 @@ GLuint create_program(const char* vertex_source, const char* fragment_source)
  */
 void update_texture_bindings(bool force_switch_texture)
 {
-    if (timer.getTime() >= ASTC_TEXTURE_SWITCH_INTERVAL || force_switch_texture)
+    unsigned int next_texture_set_id = (current_texture_set_id < n_texture_ids - 1) ? current_texture_set_id + 1 : 0;
+
+    /* While textures are still streaming, stay on the current texture set until the next one has been loaded. */
+    if ((timer.getTime() >= ASTC_TEXTURE_SWITCH_INTERVAL && is_texture_set_loaded(next_texture_set_id)) || force_switch_texture)
     {
         /* If the current texture set is to be changed, reset timer to start counting time again. */
         timer.reset();
@@ -291,14 +315,7 @@ void update_texture_bindings(bool force_switch_texture)
 
         if (!force_switch_texture)
         {
-            if (current_texture_set_id < n_texture_ids - 1)
-            {
-                current_texture_set_id++;
-            }
-            else
-            {
-                current_texture_set_id = 0;
-            }
+            current_texture_set_id = next_texture_set_id;
         }
 
         /* Change displayed text. */
@@ -311,7 +328,10 @@ void update_texture_bindings(bool force_switch_texture)
                                    255); /* Alpha channel. */
     }
 
-    /* Update texture units with new bindings. */
+    /*
+     * Update texture units with new bindings. Rebinding every frame also picks up newly streamed textures.
+     * Textures with no resident levels yet are incomplete, so they sample as black rather than as uninitialized memory.
+     */
     GL_CHECK(glActiveTexture(GL_TEXTURE0));
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture_ids[current_texture_set_id].cloud_and_gloss_texture_id));
     GL_CHECK(glActiveTexture(GL_TEXTURE1));
@@ -320,6 +340,21 @@ void update_texture_bindings(bool force_switch_texture)
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture_ids[current_texture_set_id].earth_night_texture_id));
 }
 
+/**
+ * \brief Set filtering and wrapping of a globe texture.
+ *
+ * \param[in] to_id Texture object ID.
+ */
+void set_texture_parameters(GLuint to_id)
+{
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, to_id));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,     GL_REPEAT));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_REPEAT));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
 /**
  * \brief Define and retrieve compressed texture image.
  *
@@ -403,14 +438,11 @@ GLuint load_texture(const char* file_name, GLenum compressed_data_internal_forma
                                     n_bytes_to_read,
                                     (const GLvoid*)&astc_data_ptr[1]));
 
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,     GL_REPEAT));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_REPEAT));
-
     /* Unbind texture from target. */
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
 
+    set_texture_parameters(to_id);
+
     /* Terminate file operations. */
     fclose(compressed_data_file);
     FREE_CHECK(input_data);
@@ -418,6 +450,22 @@ GLuint load_texture(const char* file_name, GLenum compressed_data_internal_forma
     return to_id;
 }
 
+/**
+ * \brief Start streaming a compressed texture image in the background.
+ *
+ * \param[in] file_name                       Texture file name.
+ * \param[in] compressed_data_internal_format ASTC compression internal format.
+ * \param[in] priority                        Textures with a higher priority are loaded first.
+ */
+GLuint stream_texture(const char* file_name, GLenum compressed_data_internal_format, int priority)
+{
+    GLuint to_id = texture_streamer->streamTexture(file_name, compressed_data_internal_format, priority);
+
+    set_texture_parameters(to_id);
+
+    return to_id;
+}
+
 /**
  * \brief Define 32 texture sets that the demo will switch between every 5 seconds.
  */
@@ -428,16 +476,40 @@ void load_textures(void)
     string earth_color_texture_file_path;
     string earth_night_texture_file_path;
 
+#if STREAM_TEXTURES
+    texture_streamer = new MaliSDK::TextureStreamer();
+
+    if (!texture_streamer->start())
+    {
+        LOGI("Texture streaming is not available, loading all textures now.\n");
+
+        delete texture_streamer;
+        texture_streamer = NULL;
+    }
+#endif
+
     for (int i = 0; i < n_texture_ids; i++)
     {
         cloud_and_gloss_texture_file_path = resource_directory + texture_sets_info[i].cloud_and_gloss_texture_file_path;
         earth_color_texture_file_path     = resource_directory + texture_sets_info[i].earth_color_texture_file_path;
         earth_night_texture_file_path     = resource_directory + texture_sets_info[i].earth_night_texture_file_path;
 
-        texture_ids[i].cloud_and_gloss_texture_id = load_texture(cloud_and_gloss_texture_file_path.c_str(), texture_sets_info[i].compressed_data_internal_format);
-        texture_ids[i].earth_color_texture_id     = load_texture(earth_color_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format);
-        texture_ids[i].earth_night_texture_id     = load_texture(earth_night_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format);
-        texture_ids[i].name                       = texture_sets_info[i].compressed_texture_format_name;
+        if (texture_streamer != NULL)
+        {
+            /* Texture sets are shown in order, so the earlier ones are needed first. */
+            int priority = n_texture_ids - i;
+
+            texture_ids[i].cloud_and_gloss_texture_id = stream_texture(cloud_and_gloss_texture_file_path.c_str(), texture_sets_info[i].compressed_data_internal_format, priority);
+            texture_ids[i].earth_color_texture_id     = stream_texture(earth_color_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format, priority);
+            texture_ids[i].earth_night_texture_id     = stream_texture(earth_night_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format, priority);
+        }
+        else
+        {
+            texture_ids[i].cloud_and_gloss_texture_id = load_texture(cloud_and_gloss_texture_file_path.c_str(), texture_sets_info[i].compressed_data_internal_format);
+            texture_ids[i].earth_color_texture_id     = load_texture(earth_color_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format);
+            texture_ids[i].earth_night_texture_id     = load_texture(earth_night_texture_file_path.c_str(),     texture_sets_info[i].compressed_data_internal_format);
+        }
+        texture_ids[i].name = texture_sets_info[i].compressed_texture_format_name;
     }
 
     /* Configure texture set. */
@@ -622,6 +694,20 @@ void render_frame(void)
     /* Get the current time. */
     current_time = fps_timer.getTime();
 
+    /* Pick up textures which finished loading since the last frame. */
+    if (texture_streamer != NULL)
+    {
+        texture_streamer->update();
+
+        if (texture_streamer->isIdle())
+        {
+            texture_streamer->logStatistics();
+
+            delete texture_streamer;
+            texture_streamer = NULL;
+        }
+    }
+
     /* Obtain angular rates around X, Y, Z axes. */
     angle_x = (float) (current_time * X_ROTATION_SPEED);
     angle_y = (float) (current_time * Y_ROTATION_SPEED);
@@ -645,6 +731,10 @@ void render_frame(void)
  */
 void cleanup_graphics(void)
 {
+    /* Stop streaming before deleting the textures it writes to. */
+    delete texture_streamer;
+    texture_streamer = NULL;
+
     /* Delete all used textures. */
     for (int i = 0; i < n_texture_ids; i++)
     {
@@ -97,6 +97,10 @@
 #define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR  (0x93DC)
 #define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR  (0x93DD)
 
+/* Load the textures on background threads while the globe is already rendering.
+   If 0, every texture is loaded before the first frame. */
+#define STREAM_TEXTURES                            (1)
+
 /* Time period for each texture set to be displayed. */
 #define ASTC_TEXTURE_SWITCH_INTERVAL               (5) /* sec */
 
@@ -129,6 +129,7 @@ uniform int bitOffset;
 uniform vec3 axis;
 uniform float zMin;
 uniform float zMax;
+uniform uint numKeys;
 
 /*
  * The particles are sorted by increasing distance along the sorting axis.
@@ -137,15 +138,20 @@ uniform float zMax;
  * the range [zMin, zMax] -> [0, 65535].
  * Finally we extract the current working digits (2-bit in this case) from the key.
  *
+ * The last work group may run past the end of the particles when numKeys is not a multiple
+ * of BLOCK_SIZE. Those keys get the largest possible value, so the stable sort keeps them
+ * behind every real particle in every pass, and scan_reorder.cs can simply drop them.
+ *
  * Read four particles at once to improve vectorization a bit.
  */
 uvec4 decodeKeys(uint index)
 {
+    uvec4 keyIndex = 4u * index + uvec4(0u, 1u, 2u, 3u);
     vec4 z = vec4(
-            dot(in_points[4u * index + 0u].xyz, axis),
-            dot(in_points[4u * index + 1u].xyz, axis),
-            dot(in_points[4u * index + 2u].xyz, axis),
-            dot(in_points[4u * index + 3u].xyz, axis));
+            keyIndex.x < numKeys ? dot(in_points[keyIndex.x].xyz, axis) : zMax,
+            keyIndex.y < numKeys ? dot(in_points[keyIndex.y].xyz, axis) : zMax,
+            keyIndex.z < numKeys ? dot(in_points[keyIndex.z].xyz, axis) : zMax,
+            keyIndex.w < numKeys ? dot(in_points[keyIndex.w].xyz, axis) : zMax);
     z = 65535.0 * clamp((z - zMin) / (zMax - zMin), vec4(0.0), vec4(1.0));
     return bitfieldExtract(uvec4(z), bitOffset, 2);
 }
@@ -79,6 +79,7 @@ layout(binding = 4, std430) readonly buffer FlagsData
 };
 
 layout(location = 0) uniform int uShift;
+uniform uint numKeys;
 
 void main()
 {
@@ -119,8 +120,10 @@ void main()
 
     // Reorder data since we now know the output indices.
     // Not the most cache friendly operation.
-    out_sort_buf[carry.x] = sort_buf[4u * ident + 0u];
-    out_sort_buf[carry.y] = sort_buf[4u * ident + 1u];
-    out_sort_buf[carry.z] = sort_buf[4u * ident + 2u];
-    out_sort_buf[carry.w] = sort_buf[4u * ident + 3u];
+    // Keys past numKeys are padding, see scan_first.cs. They always sort behind the real particles, so there is nothing to move.
+    uvec4 keyIndex = 4u * ident + uvec4(0u, 1u, 2u, 3u);
+    if (keyIndex.x < numKeys) out_sort_buf[carry.x] = sort_buf[keyIndex.x];
+    if (keyIndex.y < numKeys) out_sort_buf[carry.y] = sort_buf[keyIndex.y];
+    if (keyIndex.z < numKeys) out_sort_buf[carry.z] = sort_buf[keyIndex.z];
+    if (keyIndex.w < numKeys) out_sort_buf[carry.w] = sort_buf[keyIndex.w];
 }
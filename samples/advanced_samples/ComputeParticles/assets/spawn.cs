@@ -20,23 +20,23 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-float noise1f(int x)
+/*
+ * Integer hash from "Hash Functions for GPU Rendering" by Jarzynski and Olano (PCG).
+ * Hashing the particle index directly works for any number of particles, unlike
+ * value noise over float(index) * time, which runs out of float precision and
+ * overflows int(floor(x)) once there are around a million particles.
+ */
+uint pcgHash(uint v)
 {
-    x = (x<<13) ^ x;
-    return ( 1.0 - float((x * (x * x * 15731 + 789221) + 1376312589) & 0x7fffffff) / 1073741824.0);
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
 }
 
-float snoise(float x)
+// Returns a random value in [-1, 1] for the given particle, stream and frame key.
+float srand(uint index, uint stream, uint key)
 {
-    int xi = int(floor(x));
-    float xf = x - float(xi);
-
-    float h0 = noise1f(xi);
-    float h1 = noise1f(xi + 1);
-
-    // Smoothly nterpolate between noise values
-    float t = smoothstep(0.0, 1.0, xf);
-    return h0 + (h1 - h0) * t;
+    return float(pcgHash(index ^ pcgHash(key + stream))) / 2147483647.5 - 1.0;
 }
 
 layout (local_size_x = 64) in;
@@ -49,26 +49,33 @@ uniform vec3 emitterPos;
 uniform float particleLifetime;
 uniform float time;
 
+// Large particle counts are split over several dispatches, baseIndex is the first particle of this one.
+// The last work group may run past the end of the particles.
+uniform uint baseIndex;
+uniform uint numParticles;
+
 void main()
 {
-    uint index = gl_GlobalInvocationID.x;
+    uint index = baseIndex + gl_GlobalInvocationID.x;
+    if (index >= numParticles)
+        return;
 
     vec3 p;
 
-    // Random offset
-    float seed = float(index) * 100.0 * time;
-    p.x = snoise(seed);
-    p.z = snoise(seed + 13.0);
-    p.y = snoise(seed + 127.0);
+    // Random offset, with a new set of numbers every frame
+    uint key = pcgHash(floatBitsToUint(time));
+    p.x = srand(index, 0u, key);
+    p.z = srand(index, 1u, key);
+    p.y = srand(index, 2u, key);
 
     // Normalize to get sphere distribution
-    p = (0.06 + 0.04 * snoise(seed + 491.0)) * normalize(p);
+    p = (0.06 + 0.04 * srand(index, 3u, key)) * normalize(p);
 
     // Particle respawns at emitter
     p += emitterPos;
 
     // New lifetime with slight variation
-    float newLifetime = (1.0 + 0.25 * snoise(seed)) * particleLifetime;
+    float newLifetime = (1.0 + 0.25 * srand(index, 0u, key)) * particleLifetime;
 
     SpawnInfo[index] = vec4(p, newLifetime);
 }
@@ -34,6 +34,11 @@ uniform vec3 seed;
 uniform vec3 emitterPos;
 uniform vec3 spherePos;
 uniform float particleLifetime;
+
+// Large particle counts are split over several dispatches, baseIndex is the first particle of this one.
+// The last work group may run past the end of the particles.
+uniform uint baseIndex;
+uniform uint numParticles;
 const vec2 eps = vec2(0.002, 0.0);
 const vec3 dx = eps.xyy;
 const vec3 dy = eps.yxy;
@@ -72,7 +77,9 @@ vec3 gradphi(vec3 p)
 
 void main()
 {
-    uint index = gl_GlobalInvocationID.x;
+    uint index = baseIndex + gl_GlobalInvocationID.x;
+    if (index >= numParticles)
+        return;
     vec4 status = Position[index];
     float lifetime = status.w;
     if (lifetime < 0.0)
@@ -24,9 +24,30 @@
 #include "primitives.h"
 #include "noise.h"
 #include "sort.h"
+#include "CounterRandom.h"
+#include "ThreadPool.h"
 #include <math.h>
 const float TIMESTEP = 0.005f;
-const uint32 NUM_PARTICLES = NUM_KEYS;
+
+// Number of particles at startup. Any count can be set at runtime with set_particle_count().
+const uint32 INITIAL_PARTICLE_COUNT = 1 << 14;
+
+// Larger particle counts are spawned and updated with several dispatches of at most this many particles.
+const uint32 PARTICLES_PER_DISPATCH = 1 << 18;
+const uint32 WORK_GROUP_SIZE = 64;
+
+// When enabled, the particle count steps through the budgets below, and the average frame time of each is logged.
+// The largest budgets need well over a hundred megabytes of buffers.
+const bool STRESS_TEST = false;
+const uint32 STRESS_TEST_BUDGETS[] = { 1 << 14, 1 << 16, 1 << 18, 1 << 20, 1 << 21 };
+const uint32 NUM_STRESS_TEST_BUDGETS = sizeof(STRESS_TEST_BUDGETS) / sizeof(STRESS_TEST_BUDGETS[0]);
+const float STRESS_TEST_INTERVAL = 10.0f;
+
+// The CPU sort is a fallback for devices where compute shaders are slow, and a reference for the GPU sort.
+const SortBackend SORT_BACKEND = SORT_BACKEND_GPU;
+
+// How often the sort throughput is logged, in seconds.
+const float SORT_STATISTICS_INTERVAL = 5.0f;
 
 Shader
     shader_plane,
@@ -64,7 +85,10 @@ vec3
     sort_axis;
 
 float
-    particle_lifetime;
+    particle_lifetime,
+    sort_statistics_time,
+    stress_test_time,
+    stress_test_frame_time;
 
 bool
     front_to_back,
@@ -76,6 +100,16 @@ GLuint
     shadow_map_tex,
     shadow_map_fbo;
 
+uint32
+    num_particles,
+    particle_capacity,
+    max_dispatch_groups,
+    stress_test_budget,
+    stress_test_frames;
+
+MaliSDK::ThreadPool
+    *thread_pool;
+
 int
     window_width,
     window_height,
@@ -104,7 +138,8 @@ bool load_app()
         !shader_draw_particle.link())
         return false;
 
-    if (!sort_init())
+    thread_pool = new MaliSDK::ThreadPool;
+    if (!sort_init(INITIAL_PARTICLE_COUNT, thread_pool))
         return false;
 
     return true;
@@ -130,6 +165,11 @@ void free_app()
     glDeleteFramebuffers(1, &shadow_map_fbo);
 
     sort_free();
+
+    delete thread_pool;
+    thread_pool = NULL;
+    num_particles = 0;
+    particle_capacity = 0;
 }
 
 void init_shadowmap(int width, int height)
@@ -152,25 +192,81 @@ void init_shadowmap(int width, int height)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void init_particles()
+/*
+ * Writes the initial position and lifetime of particles [first, first + count) to data.
+ * Every particle gets the four random numbers of its own index from a counter-based generator,
+ * so the result does not depend on the order the particles are seeded in, or on the number of threads.
+ * The numbers are generated in batches on the stack, as the mapped buffer should only be written to.
+*/
+void seed_particles(vec4 *data, uint32 first, uint32 count)
+{
+    const uint32 BATCH_SIZE = 256;
+    thread_pool->parallelFor(count, [=](unsigned int begin, unsigned int end)
+    {
+        const MaliSDK::CounterRandom random;
+        vec4 batch[BATCH_SIZE];
+        for (uint32 batch_first = begin; batch_first < end; batch_first += BATCH_SIZE)
+        {
+            uint32 batch_count = end - batch_first < BATCH_SIZE ? end - batch_first : BATCH_SIZE;
+            random.generateFloatBatch(first + batch_first, 0, batch_count, &batch[0].x);
+
+            for (uint32 i = 0; i < batch_count; ++i)
+            {
+                // Distribute initial position inside a sphere of radius 0.3
+                vec3 p = vec3(0.0f, 0.0f, 0.0f);
+                p.x = 0.3f * (-1.0f + 2.0f * batch[i].x);
+                p.y = 0.3f * (-1.0f + 2.0f * batch[i].y);
+                p.z = 0.3f * (-1.0f + 2.0f * batch[i].z);
+
+                // Each particle has a slightly randomized lifetime, around a constant value
+                float lifetime = (1.0 + 0.25 * batch[i].w) * particle_lifetime;
+                data[batch_first + i] = vec4(p, lifetime);
+            }
+        }
+    }, 4096);
+}
+
+/*
+ * Changes the number of simulated particles. New particles are seeded straight into the mapped buffer.
+ * The buffers grow by at least half their size, so that stepping the count up does not
+ * reallocate and copy the particles every time.
+*/
+void set_particle_count(unsigned int count)
 {
-    // Store particle position (x, y, z) and lifetime (w)
-    vec4 *data = new vec4[NUM_PARTICLES];
-    for (int i = 0; i < NUM_PARTICLES; ++i)
+    if (count > particle_capacity)
     {
-        // Distribute initial position inside a sphere of radius 0.3
-        vec3 p = vec3(0.0f, 0.0f, 0.0f);
-        p.x = 0.3f * (-1.0f + 2.0f * frand());
-        p.y = 0.3f * (-1.0f + 2.0f * frand());
-        p.z = 0.3f * (-1.0f + 2.0f * frand());
-
-        // Each particle has a slightly randomized lifetime, around a constant value
-        float lifetime = (1.0 + 0.25 * frand()) * particle_lifetime;
-        data[i] = vec4(p, lifetime);
+        uint32 capacity = count > particle_capacity + particle_capacity / 2 ? count : particle_capacity + particle_capacity / 2;
+        GLuint position = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, capacity * sizeof(vec4), NULL);
+        if (particle_capacity > 0)
+        {
+            // Keep the particles that are alive
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer_position);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, position);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, num_particles * sizeof(vec4));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            del_buffer(buffer_position);
+            del_buffer(buffer_spawn);
+        }
+        buffer_position = position;
+        buffer_spawn = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, capacity * sizeof(vec4), NULL);
+        particle_capacity = capacity;
+    }
+
+    if (count > num_particles)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_position);
+        vec4 *data = (vec4*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, num_particles * sizeof(vec4), (count - num_particles) * sizeof(vec4),
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        ASSERT(data != NULL, "Failed to map the particle buffer\n");
+        seed_particles(data, num_particles, count - num_particles);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
     }
-    buffer_position = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, NUM_PARTICLES * sizeof(vec4), data);
-    buffer_spawn = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, NUM_PARTICLES * sizeof(vec4), NULL);
-    delete[] data;
+
+    num_particles = count;
+    sort_resize(count);
 }
 
 void init_app(int width, int height)
@@ -202,8 +298,19 @@ void init_app(int width, int height)
 
     shadow_map_width = 512;
     shadow_map_height = 512;
-
-    init_particles();
+    sort_statistics_time = 0.0f;
+    stress_test_time = 0.0f;
+    stress_test_frame_time = 0.0f;
+    stress_test_frames = 0;
+    stress_test_budget = 0;
+
+    GLint max_groups = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_groups);
+    max_dispatch_groups = PARTICLES_PER_DISPATCH / WORK_GROUP_SIZE < uint32(max_groups) ? PARTICLES_PER_DISPATCH / WORK_GROUP_SIZE : uint32(max_groups);
+
+    num_particles = 0;
+    particle_capacity = 0;
+    set_particle_count(STRESS_TEST ? STRESS_TEST_BUDGETS[0] : INITIAL_PARTICLE_COUNT);
     init_shadowmap(shadow_map_width, shadow_map_height);
 }
 
@@ -220,7 +327,63 @@ void sort_particles()
     vec4 v = vec4(0.0, 0.0, 0.0, 1.0);
     v = inverse(mat_view) * v;
     vec3 view_axis = normalize(v.xyz());
-    radix_sort(buffer_position, view_axis, -2.0f, 2.0f);
+    if (SORT_BACKEND == SORT_BACKEND_CPU)
+        radix_sort_cpu(buffer_position, view_axis, -2.0f, 2.0f);
+    else
+        radix_sort(buffer_position, view_axis, -2.0f, 2.0f);
+}
+
+void log_sort_statistics()
+{
+    float now = get_elapsed_time();
+    if (now - sort_statistics_time < SORT_STATISTICS_INTERVAL)
+        return;
+    sort_statistics_time = now;
+
+    SortStatistics stats = sort_get_statistics();
+    if (stats.sorts > 0 && stats.seconds > 0.0)
+    {
+        LOGI("Sorted %u keys on the %s: %.3f ms per sort, %.2f million keys per second\n",
+             sort_get_num_keys(), SORT_BACKEND == SORT_BACKEND_CPU ? "CPU" : "GPU",
+             1000.0 * stats.seconds / stats.sorts, stats.keys / stats.seconds * 1e-6);
+    }
+    sort_reset_statistics();
+}
+
+/*
+ * Runs the current compute shader once per particle. Counts beyond a single dispatch
+ * are split up, and <baseIndex> tells each dispatch where its particles start.
+*/
+void dispatch_particles()
+{
+    uint32 num_groups = (num_particles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+    uniform("numParticles", num_particles);
+    for (uint32 first_group = 0; first_group < num_groups; first_group += max_dispatch_groups)
+    {
+        uint32 groups = num_groups - first_group < max_dispatch_groups ? num_groups - first_group : max_dispatch_groups;
+        uniform("baseIndex", first_group * WORK_GROUP_SIZE);
+        glDispatchCompute(groups, 1, 1);
+    }
+}
+
+void update_stress_test(float dt)
+{
+    stress_test_frame_time += dt;
+    stress_test_frames++;
+
+    float now = get_elapsed_time();
+    if (now - stress_test_time < STRESS_TEST_INTERVAL)
+        return;
+
+    LOGI("%u particles: %.2f ms per frame\n", num_particles, 1000.0f * stress_test_frame_time / stress_test_frames);
+
+    stress_test_budget = (stress_test_budget + 1) % NUM_STRESS_TEST_BUDGETS;
+    set_particle_count(STRESS_TEST_BUDGETS[stress_test_budget]);
+    sort_reset_statistics();
+
+    stress_test_time = now;
+    stress_test_frame_time = 0.0f;
+    stress_test_frames = 0;
 }
 
 /*
@@ -231,15 +394,13 @@ void sort_particles()
 */
 void update_particles()
 {
-    const uint32 WORK_GROUP_SIZE = 64;
-
     // Generate respawn info
     use_shader(shader_spawn);
     uniform("time", get_elapsed_time());
     uniform("emitterPos", emitter_pos);
     uniform("particleLifetime", particle_lifetime);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer_spawn);
-    glDispatchCompute(NUM_PARTICLES / WORK_GROUP_SIZE, 1, 1);
+    dispatch_particles();
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
     // Advect through velocity field
@@ -250,7 +411,7 @@ void update_particles()
     uniform("spherePos", sphere_pos);
     uniform("particleLifetime", particle_lifetime);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffer_position);
-    glDispatchCompute(NUM_PARTICLES / WORK_GROUP_SIZE, 1, 1);
+    dispatch_particles();
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
@@ -273,7 +434,7 @@ void update_shadow_map()
     uniform("view", mat_view_light);
     glBindBuffer(GL_ARRAY_BUFFER, buffer_position);
     attribfv("position", 4, 0, 0);
-    glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
+    glDrawArrays(GL_POINTS, 0, num_particles);
 
     blend_mode(false);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -300,6 +461,10 @@ void update_app(float dt)
 
     update_particles();
     sort_particles();
+    log_sort_statistics();
+
+    if (STRESS_TEST)
+        update_stress_test(dt);
 
     update_shadow_map();
 }
@@ -350,7 +515,7 @@ void render_particles()
     glBindTexture(GL_TEXTURE_2D, shadow_map_tex);
     glBindBuffer(GL_ARRAY_BUFFER, buffer_position);
     attribfv("position", 4, 0, 0);
-    glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
+    glDrawArrays(GL_POINTS, 0, num_particles);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -26,6 +26,7 @@ void init_app(int width, int height);
 void update_app(float dt);
 void render_app(float dt);
 void free_app();
+void set_particle_count(unsigned int count);
 void on_pointer_down(float x, float y);
 void on_pointer_up(float x, float y);
 
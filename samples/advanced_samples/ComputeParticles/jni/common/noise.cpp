@@ -35,22 +35,3 @@ float min(float x, float y)
 {
 	return x < y ? x : y;
 }
-
-// See http://en.wikipedia.org/wiki/Xorshift
-unsigned int xor128()
-{
-	static unsigned int x = 123456789;
-	static unsigned int y = 362436069;
-	static unsigned int z = 521288629;
-	static unsigned int w = 88675123;
-	unsigned int t;
-
-	t = x ^ (x << 11);
-	x = y; y = z; z = w;
-	return w = w ^ (w >> 19) ^ (t ^ (t >>8));
-}
-
-float frand()
-{
-	return xor128() / float(4294967295.0f);
-}
\ No newline at end of file
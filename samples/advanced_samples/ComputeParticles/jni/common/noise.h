@@ -25,10 +25,4 @@ float clamp(float x, float min, float max);
 float max(float x, float y);
 float min(float x, float y);
 
-// Returns a random integer with a period of 2^128 - 1
-unsigned int xor128();
-
-// Returns a single precision floating-point value uniformly over the interval [0.0, 1.0]
-float frand();
-
 #endif
\ No newline at end of file
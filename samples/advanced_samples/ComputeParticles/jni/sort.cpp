@@ -23,10 +23,32 @@
 #include "common/glutil.h"
 #include "common/shader.h"
 #include "common/common.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
 #include <string.h>
 
 #define MAX_SCAN_LEVELS 4
 
+// Set to 1 to check every GPU sort against the CPU sort. Reads both results back, so it is slow.
+#define SORT_VALIDATE 0
+
+// From GL_EXT_disjoint_timer_query.
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#define NUM_TIMER_QUERIES 4
+
+// The CPU sort uses two passes of 8-bit digits, and splits the keys into at most one chunk per thread.
+const uint32 CPU_RADIX_BITS = 8;
+const uint32 CPU_RADIX = 1 << CPU_RADIX_BITS;
+const uint32 CPU_PASSES = 16 / CPU_RADIX_BITS;
+const uint32 CPU_MIN_KEYS_PER_CHUNK = 4096;
+
 Shader
     shader_scan,
     shader_scan_first,
@@ -39,10 +61,81 @@ GLuint
     buf_flags,
     buf_sorted;
 
-unsigned scan_levels;
+unsigned
+    scan_levels,
+    allocated_scan_levels;
+
+uint32
+    num_keys,
+    num_blocks,
+    key_capacity;
+
+GLuint timer_queries[NUM_TIMER_QUERIES];
+uint32 timer_query_keys[NUM_TIMER_QUERIES];
+unsigned timer_query_next;
+bool timer_queries_supported;
+
+SortStatistics statistics;
 
-bool sort_init()
+MaliSDK::ThreadPool *cpu_pool;
+GLint max_dispatch_groups;
+vector<uint16> cpu_keys[2];
+vector<vec4> cpu_scratch;
+vector<uint32> cpu_histograms;
+
+// The scan is recursive. We have to scan until the entire dispatch can be computed by a single work group.
+static unsigned get_scan_levels(uint32 keys)
 {
+    unsigned levels = 0;
+    uint32 elems = std::max(keys, 2u);
+    while (elems > 1)
+    {
+        levels++;
+        elems = (elems + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+    return levels;
+}
+
+static void allocate_buffers(uint32 capacity)
+{
+    uint32 blocks = (capacity + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    allocated_scan_levels = get_scan_levels(capacity);
+    ASSERT(allocated_scan_levels <= MAX_SCAN_LEVELS, "Too many keys to sort\n");
+
+    buf_sorted = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, capacity * sizeof(vec4), NULL);
+    buf_flags  = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, blocks * BLOCK_SIZE * sizeof(GLuint), NULL);
+
+    // Allocate memory for scan levels. Make sure to properly pad them to a workgroups worth of work.
+    uint32 elems = blocks;
+    for (unsigned i = 0; i < allocated_scan_levels; i++)
+    {
+        buf_scan[i] = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, elems * BLOCK_SIZE * 4 * sizeof(GLuint), NULL);
+        elems = (elems + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        buf_sums[i] = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, elems * BLOCK_SIZE * 4 * sizeof(GLuint), NULL);
+    }
+
+    key_capacity = capacity;
+}
+
+static void free_buffers()
+{
+    del_buffer(buf_sorted);
+    del_buffer(buf_flags);
+
+    for (unsigned i = 0; i < allocated_scan_levels; i++)
+    {
+        del_buffer(buf_scan[i]);
+        del_buffer(buf_sums[i]);
+    }
+
+    allocated_scan_levels = 0;
+    key_capacity = 0;
+}
+
+bool sort_init(uint32_t keys, MaliSDK::ThreadPool *thread_pool)
+{
+    cpu_pool = thread_pool;
+
     string res = "/data/data/com.arm.malideveloper.openglessdk.computeparticles/files/";
     if (!shader_scan.load_compute_from_file(res + "scan.cs") ||
             !shader_scan_first.load_compute_from_file(res + "scan_first.cs") ||
@@ -60,53 +153,305 @@ bool sort_init()
         return false;
     }
 
-    // We do the scan recursively. We have to do scan until one the entire dispatch can be computed by a single work group.
-    unsigned elems = NUM_KEYS;
-    scan_levels = 0;
-    while (elems > 1)
+    const char *extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    timer_queries_supported = extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+    if (timer_queries_supported)
     {
-       scan_levels++;
-       elems = (elems + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        glGenQueries(NUM_TIMER_QUERIES, timer_queries);
     }
+    memset(timer_query_keys, 0, sizeof(timer_query_keys));
+    timer_query_next = 0;
 
-    buf_sorted = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, NUM_KEYS * sizeof(vec4), NULL);
-    buf_flags  = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, NUM_KEYS * sizeof(GLuint), NULL);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_dispatch_groups);
 
-    // Allocate memory for scan levels. Make sure to properly pad them to a workgroups worth of work.
-    elems = NUM_BLOCKS;
-    for (unsigned i = 0; i < scan_levels; i++)
-    {
-        buf_scan[i] = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, elems * BLOCK_SIZE * 4 * sizeof(GLuint), NULL);
-        elems = (elems + BLOCK_SIZE - 1) / BLOCK_SIZE;
-        buf_sums[i] = gen_buffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_COPY, elems * BLOCK_SIZE * 4 * sizeof(GLuint), NULL);
-    }
+    num_keys = 0;
+    key_capacity = 0;
+    allocated_scan_levels = 0;
+    sort_resize(keys);
+    sort_reset_statistics();
 
     return true;
 }
 
 void sort_free()
 {
-    del_buffer(buf_sorted);
-    del_buffer(buf_flags);
+    free_buffers();
 
-    for (unsigned i = 0; i < scan_levels; i++)
+    if (timer_queries_supported)
     {
-        del_buffer(buf_scan[i]);
-        del_buffer(buf_sums[i]);
+        glDeleteQueries(NUM_TIMER_QUERIES, timer_queries);
     }
 
     shader_scan.dispose();
     shader_scan_first.dispose();
     shader_resolve.dispose();
     shader_reorder.dispose();
+
+    cpu_pool = NULL;
+    for (unsigned i = 0; i < 2; i++)
+    {
+        vector<uint16>().swap(cpu_keys[i]);
+    }
+    vector<vec4>().swap(cpu_scratch);
+    vector<uint32>().swap(cpu_histograms);
+}
+
+void sort_resize(uint32_t keys)
+{
+    num_blocks = (keys + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    ASSERT(num_blocks <= uint32(max_dispatch_groups), "Too many keys to sort in a single dispatch\n");
+
+    // Grow by at least half the capacity, so that a slowly increasing particle count does not reallocate every frame.
+    if (keys > key_capacity)
+    {
+        uint32 capacity = std::max(keys, key_capacity + key_capacity / 2);
+        capacity = uint32(std::min<unsigned long long>(capacity, (unsigned long long)max_dispatch_groups * BLOCK_SIZE));
+        if (key_capacity > 0)
+        {
+            free_buffers();
+        }
+        allocate_buffers(capacity);
+    }
+
+    num_keys = keys;
+    scan_levels = get_scan_levels(keys);
+}
+
+uint32_t sort_get_num_keys()
+{
+    return num_keys;
+}
+
+SortStatistics sort_get_statistics()
+{
+    return statistics;
+}
+
+void sort_reset_statistics()
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+/*
+ * Collects the timings of finished sorts without waiting for the GPU.
+ * Queries are issued and completed in order, so we can stop at the first one that is still busy.
+ */
+static void poll_timer_queries()
+{
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    for (unsigned i = 0; i < NUM_TIMER_QUERIES; i++)
+    {
+        unsigned index = (timer_query_next + i) % NUM_TIMER_QUERIES;
+        if (timer_query_keys[index] == 0)
+        {
+            continue;
+        }
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(timer_queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            break;
+        }
+
+        // The 32-bit result is in nanoseconds, which is plenty for a single sort.
+        GLuint nanoseconds = 0;
+        glGetQueryObjectuiv(timer_queries[index], GL_QUERY_RESULT, &nanoseconds);
+
+        // The timer is unreliable across a disjoint event, such as a frequency change. Drop the result.
+        if (!disjoint)
+        {
+            statistics.keys += timer_query_keys[index];
+            statistics.seconds += nanoseconds * 1e-9;
+            statistics.sorts++;
+        }
+        timer_query_keys[index] = 0;
+    }
 }
 
-void sort_bits(GLuint buf_input, int bit_offset, vec3 axis, float z_min, float z_max)
+/*
+ * The 16-bit sort key of a particle. Must match decodeKeys() in scan_first.cs.
+ *
+ * GLSL ES 3.1 lets the GPU fuse the multiplies and adds of dot(), and there is no way to forbid it
+ * without the precise qualifier, so the key of a particle right at the edge of a key may be one off
+ * between the two sides. Particles then move past their neighbours at that edge, which is invisible
+ * since their depth is practically the same.
+ */
+static inline uint16 get_key(const vec4 &particle, const vec3 &axis, float z_min, float z_max)
+{
+    float z = particle.x * axis.x + particle.y * axis.y + particle.z * axis.z;
+    z = 65535.0f * std::min(std::max((z - z_min) / (z_max - z_min), 0.0f), 1.0f);
+    return uint16(z);
+}
+
+/*
+ * Least significant digit radix sort of the particles by their keys.
+ *
+ * The keys are split into one contiguous chunk per thread. Every pass, each chunk counts its digits,
+ * and an exclusive scan of the counts, ordered by digit and then by chunk, gives every chunk the output
+ * offset for each digit. Chunks then scatter their keys in parallel without any synchronization, and
+ * since chunks and the elements within a chunk keep their order, every pass is stable just like the
+ * scan on the GPU. The counts for the first pass are taken while computing the keys.
+ */
+static void sort_on_cpu(vec4 *particles, uint32 count, vec3 axis, float z_min, float z_max)
+{
+    if (count < 2)
+    {
+        return;
+    }
+
+    const uint32 num_chunks = std::max(1u, std::min(cpu_pool->getNumberOfThreads(), count / CPU_MIN_KEYS_PER_CHUNK));
+    const uint32 chunk_size = (count + num_chunks - 1) / num_chunks;
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        cpu_keys[i].resize(count);
+    }
+    cpu_scratch.resize(count);
+    cpu_histograms.resize(num_chunks * CPU_RADIX);
+
+    uint16 *keys_in = &cpu_keys[0][0];
+    uint16 *keys_out = &cpu_keys[1][0];
+    vec4 *values_in = particles;
+    vec4 *values_out = &cpu_scratch[0];
+
+    cpu_pool->parallelFor(num_chunks, [&](unsigned int begin_chunk, unsigned int end_chunk)
+    {
+        for (uint32 chunk = begin_chunk; chunk < end_chunk; chunk++)
+        {
+            uint32 *histogram = &cpu_histograms[chunk * CPU_RADIX];
+            memset(histogram, 0, CPU_RADIX * sizeof(uint32));
+            uint32 end = std::min(count, (chunk + 1) * chunk_size);
+            for (uint32 i = chunk * chunk_size; i < end; i++)
+            {
+                uint16 key = get_key(values_in[i], axis, z_min, z_max);
+                keys_in[i] = key;
+                histogram[key & (CPU_RADIX - 1)]++;
+            }
+        }
+    });
+
+    for (uint32 pass = 0; pass < CPU_PASSES; pass++)
+    {
+        const uint32 shift = pass * CPU_RADIX_BITS;
+
+        // The previous pass moved the keys between chunks, so count them again.
+        if (pass > 0)
+        {
+            cpu_pool->parallelFor(num_chunks, [&](unsigned int begin_chunk, unsigned int end_chunk)
+            {
+                for (uint32 chunk = begin_chunk; chunk < end_chunk; chunk++)
+                {
+                    uint32 *histogram = &cpu_histograms[chunk * CPU_RADIX];
+                    memset(histogram, 0, CPU_RADIX * sizeof(uint32));
+                    uint32 end = std::min(count, (chunk + 1) * chunk_size);
+                    for (uint32 i = chunk * chunk_size; i < end; i++)
+                    {
+                        histogram[(keys_in[i] >> shift) & (CPU_RADIX - 1)]++;
+                    }
+                }
+            });
+        }
+
+        // Turn the counts into output offsets. If every key has the same digit, the pass would not move anything.
+        uint32 offset = 0;
+        bool single_digit = false;
+        for (uint32 digit = 0; digit < CPU_RADIX; digit++)
+        {
+            uint32 digit_start = offset;
+            for (uint32 chunk = 0; chunk < num_chunks; chunk++)
+            {
+                uint32 &entry = cpu_histograms[chunk * CPU_RADIX + digit];
+                uint32 chunk_count = entry;
+                entry = offset;
+                offset += chunk_count;
+            }
+            single_digit = single_digit || offset - digit_start == count;
+        }
+
+        if (single_digit)
+        {
+            continue;
+        }
+
+        cpu_pool->parallelFor(num_chunks, [&](unsigned int begin_chunk, unsigned int end_chunk)
+        {
+            for (uint32 chunk = begin_chunk; chunk < end_chunk; chunk++)
+            {
+                uint32 *offsets = &cpu_histograms[chunk * CPU_RADIX];
+                uint32 end = std::min(count, (chunk + 1) * chunk_size);
+                for (uint32 i = chunk * chunk_size; i < end; i++)
+                {
+                    uint16 key = keys_in[i];
+                    uint32 index = offsets[(key >> shift) & (CPU_RADIX - 1)]++;
+                    keys_out[index] = key;
+                    values_out[index] = values_in[i];
+                }
+            }
+        });
+
+        std::swap(keys_in, keys_out);
+        std::swap(values_in, values_out);
+    }
+
+    // An odd number of passes ran, so the result is in the scratch buffer.
+    if (values_in != particles)
+    {
+        memcpy(particles, values_in, count * sizeof(vec4));
+    }
+}
+
+void radix_sort_cpu(vec4 *particles, uint32_t count, vec3 axis, float z_min, float z_max)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    sort_on_cpu(particles, count, axis, z_min, z_max);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    statistics.keys += count;
+    statistics.seconds += elapsed.count();
+    statistics.sorts++;
+}
+
+void radix_sort_cpu(GLuint particles, vec3 axis, float z_min, float z_max)
+{
+    if (num_keys == 0)
+    {
+        return;
+    }
+
+    // Make the compute shader writes visible to the mapping. Mapping waits for the GPU to finish with the buffer.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particles);
+    vec4 *data = (vec4*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, num_keys * sizeof(vec4), GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+    ASSERT(data != NULL, "Failed to map the particle buffer\n");
+
+    radix_sort_cpu(data, num_keys, axis, z_min, z_max);
+
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+#if SORT_VALIDATE
+static void read_particles(GLuint buffer, vector<vec4> &particles)
+{
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    const vec4 *data = (const vec4*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, num_keys * sizeof(vec4), GL_MAP_READ_BIT);
+    ASSERT(data != NULL, "Failed to map the particle buffer\n");
+    particles.assign(data, data + num_keys);
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+#endif
+
+static void sort_bits(GLuint buf_input, int bit_offset, vec3 axis, float z_min, float z_max)
 {
     // Keep track of which dispatch sizes we used to make the resolve steps simpler.
     unsigned dispatch_sizes[MAX_SCAN_LEVELS] = {0};
 
-    unsigned blocks = NUM_BLOCKS;
+    unsigned blocks = num_blocks;
 
     // First pass. Compute 16-bit unsigned depth and apply first pass of scan algorithm.
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buf_input);
@@ -118,6 +463,7 @@ void sort_bits(GLuint buf_input, int bit_offset, vec3 axis, float z_min, float z
     uniform("axis", axis);
     uniform("zMin", z_min);
     uniform("zMax", z_max);
+    uniform("numKeys", num_keys);
     dispatch_sizes[0] = blocks;
     glDispatchCompute(blocks, 1, 1);
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -172,7 +518,8 @@ void sort_bits(GLuint buf_input, int bit_offset, vec3 axis, float z_min, float z
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, buf_sums[0]);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buf_sorted);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, buf_flags);
-    glDispatchCompute(NUM_BLOCKS, 1, 1);
+    uniform("numKeys", num_keys);
+    glDispatchCompute(num_blocks, 1, 1);
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
     // Now we're done :)
@@ -180,6 +527,29 @@ void sort_bits(GLuint buf_input, int bit_offset, vec3 axis, float z_min, float z
 
 void radix_sort(GLuint buf_input, vec3 axis, float z_min, float z_max)
 {
+    if (num_keys < 2)
+    {
+        return;
+    }
+
+#if SORT_VALIDATE
+    vector<vec4> reference;
+    read_particles(buf_input, reference);
+    sort_on_cpu(&reference[0], num_keys, axis, z_min, z_max);
+#endif
+
+    if (timer_queries_supported)
+    {
+        poll_timer_queries();
+    }
+
+    // Skip timing this sort if the oldest query is still in flight.
+    bool timed = timer_queries_supported && timer_query_keys[timer_query_next] == 0;
+    if (timed)
+    {
+        glBeginQuery(GL_TIME_ELAPSED_EXT, timer_queries[timer_query_next]);
+    }
+
     for (uint32_t i = 0; i < 8; i++)
     {
         sort_bits(buf_input, i * 2, axis, z_min, z_max);
@@ -189,7 +559,37 @@ void radix_sort(GLuint buf_input, vec3 axis, float z_min, float z_max)
         std::swap(buf_input, buf_sorted);
     }
 
+    if (timed)
+    {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        timer_query_keys[timer_query_next] = num_keys;
+        timer_query_next = (timer_query_next + 1) % NUM_TIMER_QUERIES;
+    }
+
     // We use the position data to draw the particles afterwards
     // Thus we need to ensure that the data is up to date
     glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+#if SORT_VALIDATE
+    vector<vec4> result;
+    read_particles(buf_input, result);
+    // Keys computed on the GPU may be one off at key edges, see get_key(), which only reorders nearby particles.
+    uint32 mismatches = 0;
+    for (uint32 i = 0; i < num_keys; i++)
+    {
+        if (memcmp(&result[i], &reference[i], sizeof(vec4)) != 0)
+        {
+            int result_key = get_key(result[i], axis, z_min, z_max);
+            int reference_key = get_key(reference[i], axis, z_min, z_max);
+            if (abs(result_key - reference_key) > 1)
+            {
+                mismatches++;
+            }
+        }
+    }
+    if (mismatches > 0)
+    {
+        LOGE("GPU sort differs from the CPU sort at %u of %u particles\n", mismatches, num_keys);
+    }
+#endif
 }
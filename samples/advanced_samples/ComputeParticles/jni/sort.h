@@ -22,12 +22,52 @@
 #define SORT_H
 
 #include "common/common.h"
+
+namespace MaliSDK
+{
+    class ThreadPool;
+}
+
 const uint32_t BLOCK_SIZE = 128;
-const uint32_t NUM_KEYS = 1 << 14;
-const uint32_t NUM_BLOCKS = NUM_KEYS / BLOCK_SIZE;
 
-bool sort_init();
+/*
+ * The sort keys are the particle distances along the sort axis, quantized to 16 bits.
+ * Both backends sort stably on the same keys and therefore produce the same particle order.
+ */
+enum SortBackend
+{
+    SORT_BACKEND_GPU,
+    SORT_BACKEND_CPU
+};
+
+/*
+ * Accumulated sort throughput since the last reset.
+ * GPU timings are only available with GL_EXT_disjoint_timer_query, and arrive a few frames late.
+ */
+struct SortStatistics
+{
+    double keys;
+    double seconds;
+    uint32 sorts;
+};
+
+// The CPU sort runs on thread_pool.
+bool sort_init(uint32_t num_keys, MaliSDK::ThreadPool *thread_pool);
 void sort_free();
+
+// Changes the number of keys sorted by radix_sort(). Any count up to a dispatch worth of blocks is allowed.
+// Scratch buffers only ever grow, by at least half their size at a time.
+void sort_resize(uint32_t num_keys);
+uint32_t sort_get_num_keys();
+
+// Sorts the first sort_get_num_keys() particles in the shader storage buffer with compute shaders.
 void radix_sort(GLuint particles, vec3 axis, float z_min, float z_max);
 
+// Sorts the particles on the CPU using every core. The buffer version maps the buffer, which waits for the GPU.
+void radix_sort_cpu(vec4 *particles, uint32_t count, vec3 axis, float z_min, float z_max);
+void radix_sort_cpu(GLuint particles, vec3 axis, float z_min, float z_max);
+
+SortStatistics sort_get_statistics();
+void sort_reset_statistics();
+
 #endif
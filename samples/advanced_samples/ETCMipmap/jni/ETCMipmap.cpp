@@ -118,14 +118,15 @@ bool setupGraphics(int w, int h)
     GL_CHECK(glGenTextures(1, &textureID));
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, textureID));
     string mainTexturePath = texturePath + "0" + imageExtension;
-    unsigned char *textureData;
-    Texture::loadData(mainTexturePath.c_str(), &textureData);
-    ETCHeader loadedETCHeader = ETCHeader(textureData);
+    MappedFile textureFile;
+    const unsigned char *textureData = NULL;
+    ETCHeader loadedETCHeader;
+    Texture::loadPKMData(mainTexturePath.c_str(), &loadedETCHeader, textureFile, &textureData);
     GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_ETC1_RGB8_OES,
              loadedETCHeader.getWidth(), loadedETCHeader.getHeight(), 0,
              loadedETCHeader.getPaddedWidth() * loadedETCHeader.getPaddedHeight() >> 1,
-             textureData + 16));
-    free(textureData);
+             textureData));
+    textureFile.close();
 
 #    ifdef DISABLE_MIPMAPS
     /* Disable Mipmaps. */
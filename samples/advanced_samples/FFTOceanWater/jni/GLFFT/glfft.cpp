@@ -195,9 +195,8 @@ struct CostPropagate
     vector<unsigned> radices;
 };
 
-static vector<Radix> split_radices(unsigned Nx, unsigned Ny, Mode mode, Target input_target, Target output_target,
-        const FFTOptions &options,
-        bool pow2_stride, const FFTWisdom &wisdom, double &accumulate_cost)
+vector<unsigned> GLFFT::find_radix_splits(unsigned Nx, unsigned Ny, Mode mode,
+        const FFTOptions &options, const FFTWisdom &wisdom, double &accumulate_cost)
 {
     unsigned N;
     switch (mode)
@@ -291,6 +290,16 @@ static vector<Radix> split_radices(unsigned Nx, unsigned Ny, Mode mode, Target i
         throw logic_error("Radix splits are invalid.");
     }
 
+    accumulate_cost += cost.cost;
+    return radices;
+}
+
+static vector<Radix> split_radices(unsigned Nx, unsigned Ny, Mode mode, Target input_target, Target output_target,
+        const FFTOptions &options,
+        bool pow2_stride, const FFTWisdom &wisdom, double &accumulate_cost)
+{
+    auto radices = find_radix_splits(Nx, Ny, mode, options, wisdom, accumulate_cost);
+
     vector<Radix> radices_out;
     radices_out.reserve(radices.size());
 
@@ -315,7 +324,6 @@ static vector<Radix> split_radices(unsigned Nx, unsigned Ny, Mode mode, Target i
                     pow2_stride));
     }
 
-    accumulate_cost += cost.cost;
     return radices_out;
 }
 
@@ -337,6 +345,103 @@ void ProgramCache::insert_program(const Parameters &parameters, GLuint program)
     programs[parameters] = Program(program);
 }
 
+// 64-bit FNV-1a. Program binary keys outlive the process, so std::hash is not an option.
+static inline uint64_t fnv1a(uint64_t h, const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= uint8_t(data[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t ProgramCache::get_binary_key(const string &source)
+{
+    // Binaries are only valid for the exact driver they were produced by.
+    if (driver_identity.empty())
+    {
+        static const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (auto name : names)
+        {
+            GL_CHECK(const GLubyte *str = glGetString(name));
+            if (str)
+            {
+                driver_identity += reinterpret_cast<const char*>(str);
+            }
+            driver_identity += '\n';
+        }
+    }
+
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = fnv1a(h, driver_identity.data(), driver_identity.size());
+    h = fnv1a(h, GLFFT_GLSL_LANG_STRING, strlen(GLFFT_GLSL_LANG_STRING));
+    h = fnv1a(h, source.data(), source.size());
+    return h;
+}
+
+GLuint ProgramCache::load_program_binary(const string &source)
+{
+    if (!binary_store)
+    {
+        return 0;
+    }
+
+    GLenum format = 0;
+    vector<uint8_t> binary;
+    if (!binary_store->load(get_binary_key(source), format, binary))
+    {
+        return 0;
+    }
+
+    GL_CHECK(GLuint program = glCreateProgram());
+    if (!program)
+    {
+        return 0;
+    }
+
+    GL_CHECK(glProgramBinary(program, format, binary.data(), GLsizei(binary.size())));
+
+    GLint status = GL_FALSE;
+    GL_CHECK(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (status == GL_FALSE)
+    {
+        glfft_log("GLFFT: Stored program binary was rejected, recompiling.\n");
+        GL_CHECK(glDeleteProgram(program));
+        return 0;
+    }
+
+    return program;
+}
+
+void ProgramCache::store_program_binary(const string &source, GLuint program)
+{
+    if (!binary_store)
+    {
+        return;
+    }
+
+    GLint length = 0;
+    GL_CHECK(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0)
+    {
+        // Driver does not support retrieving binaries.
+        return;
+    }
+
+    vector<uint8_t> binary(length);
+    GLsizei out_length = 0;
+    GLenum format = 0;
+    GL_CHECK(glGetProgramBinary(program, length, &out_length, &format, binary.data()));
+    if (out_length <= 0)
+    {
+        return;
+    }
+
+    binary.resize(out_length);
+    binary_store->store(get_binary_key(source), format, binary);
+}
+
 GLuint FFT::get_program(const Parameters &params)
 {
     GLuint prog = cache->find_program(params);
@@ -925,11 +1030,22 @@ GLuint FFT::build_program(const Parameters &params)
     str += Blob::fft_main_source;
 #endif
 
-    GLuint prog = compile_compute_shader(str.c_str());
+    // Skip compilation entirely if an earlier run already built this exact source.
+    GLuint prog = cache->load_program_binary(str);
+    if (prog)
+    {
+        return prog;
+    }
+
+    prog = compile_compute_shader(str.c_str());
     if (!prog)
     {
         puts(str.c_str());
     }
+    else
+    {
+        cache->store_program_binary(str, prog);
+    }
 
 #if 0
     char shader_path[1024];
@@ -973,6 +1089,10 @@ GLuint FFT::compile_compute_shader(const char *src)
     }
 
     GL_CHECK(glAttachShader(program, shader));
+    if (cache->has_binary_store())
+    {
+        GL_CHECK(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
     GL_CHECK(glLinkProgram(program));
     GL_CHECK(glDeleteShader(shader));
 
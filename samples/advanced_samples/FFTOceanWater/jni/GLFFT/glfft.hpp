@@ -33,6 +33,22 @@
 namespace GLFFT
 {
 
+/// @brief Finds the cheapest way to split a 1D transform into radix 4, 8, 16 and 64 passes.
+///
+/// Costs are looked up in wisdom, with rough estimates for passes which have no wisdom.
+/// Used by FFT to plan its passes, and by CPUFFT so both backends agree on the plan.
+///
+/// @param Nx              Number of complex samples in horizontal dimension.
+/// @param Ny              Number of complex samples in vertical dimension.
+/// @param mode            Horizontal(Dual) or Vertical(Dual). Other modes return an empty split.
+/// @param options         FFT options, used as fallback when wisdom is missing.
+/// @param wisdom          GLFFT wisdom.
+/// @param accumulate_cost The cost of the chosen split is added to this value.
+///
+/// @returns Radices sorted from largest to smallest. Empty if the transform has length 1.
+std::vector<unsigned> find_radix_splits(unsigned Nx, unsigned Ny, Mode mode,
+        const FFTOptions &options, const FFTWisdom &wisdom, double &accumulate_cost);
+
 class FFT
 {
     public:
@@ -17,6 +17,8 @@
  */
 
 #include "glfft_common.hpp"
+#include <cstdio>
+#include <cinttypes>
 
 using namespace std;
 using namespace GLFFT;
@@ -156,3 +158,90 @@ Program::Program(Program &&prog)
 }
 
 
+
+FileProgramBinaryStore::FileProgramBinaryStore(string prefix)
+    : prefix(move(prefix))
+{}
+
+string FileProgramBinaryStore::get_path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".bin", key);
+    return prefix + name;
+}
+
+// File header: magic, binary format, binary size. Binaries are device specific, so native endian is fine.
+static const uint32_t program_binary_magic = 0x50464c47; // "GLFP"
+// FFT program binaries are a few hundred kB at most, anything larger than this is not one of ours.
+static const uint32_t program_binary_max_size = 16 * 1024 * 1024;
+
+bool FileProgramBinaryStore::load(uint64_t key, GLenum &format, vector<uint8_t> &binary)
+{
+    string path = get_path(key);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    uint32_t header[3];
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == program_binary_magic &&
+              header[2] > 0 && header[2] <= program_binary_max_size;
+
+    // The size in the header must account for exactly the rest of the file before we allocate for it.
+    if (ok)
+    {
+        long offset = ftell(file);
+        ok = offset >= 0 && fseek(file, 0, SEEK_END) == 0;
+        if (ok)
+        {
+            long end = ftell(file);
+            ok = end >= offset && uint64_t(end - offset) == header[2] && fseek(file, offset, SEEK_SET) == 0;
+        }
+    }
+
+    if (ok)
+    {
+        format = header[1];
+        binary.resize(header[2]);
+        ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+
+    fclose(file);
+
+    if (!ok)
+    {
+        glfft_log("GLFFT: Ignoring corrupt program binary %s.\n", path.c_str());
+    }
+    return ok;
+}
+
+void FileProgramBinaryStore::store(uint64_t key, GLenum format, const vector<uint8_t> &binary)
+{
+    if (binary.empty() || binary.size() > program_binary_max_size)
+    {
+        return;
+    }
+
+    string path = get_path(key);
+
+    // Write to a temporary file first so an interrupted write never leaves a truncated binary behind.
+    string tmp_path = path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        glfft_log("GLFFT: Failed to open %s for writing.\n", tmp_path.c_str());
+        return;
+    }
+
+    uint32_t header[3] = { program_binary_magic, uint32_t(format), uint32_t(binary.size()) };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        glfft_log("GLFFT: Failed to write program binary %s.\n", path.c_str());
+        remove(tmp_path.c_str());
+    }
+}
@@ -29,6 +29,8 @@
 #include <cstring>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 
 namespace GLFFT
 {
@@ -100,7 +102,23 @@ struct Parameters
 
     bool operator==(const Parameters &other) const
     {
-        return std::memcmp(this, &other, sizeof(Parameters)) == 0;
+        // Compare member-wise, the struct has tail padding which is not guaranteed to be zero.
+        return workgroup_size_x == other.workgroup_size_x &&
+               workgroup_size_y == other.workgroup_size_y &&
+               workgroup_size_z == other.workgroup_size_z &&
+               radix == other.radix &&
+               vector_size == other.vector_size &&
+               direction == other.direction &&
+               mode == other.mode &&
+               input_target == other.input_target &&
+               output_target == other.output_target &&
+               p1 == other.p1 &&
+               pow2_stride == other.pow2_stride &&
+               shared_banked == other.shared_banked &&
+               fft_fp16 == other.fft_fp16 &&
+               input_fp16 == other.input_fp16 &&
+               output_fp16 == other.output_fp16 &&
+               fft_normalize == other.fft_normalize;
     }
 };
 
@@ -138,6 +156,14 @@ struct FFTOptions
     } type;
 };
 
+/// Mixes value into an existing hash (boost::hash_combine).
+/// Hashing field by field keeps every bit of every member significant,
+/// unlike XOR-ing bytes together which collapses to at most 256 distinct hashes.
+inline std::size_t hash_combine(std::size_t seed, std::size_t value)
+{
+    return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
 }
 
 namespace std
@@ -147,13 +173,25 @@ namespace std
     {
         std::size_t operator()(const GLFFT::Parameters &params) const
         {
+            using GLFFT::hash_combine;
             std::size_t h = 0;
-            hash<uint8_t> hasher;
-            for (std::size_t i = 0; i < sizeof(GLFFT::Parameters); i++)
-            {
-                h ^= hasher(reinterpret_cast<const uint8_t*>(&params)[i]);
-            }
-
+            h = hash_combine(h, params.workgroup_size_x);
+            h = hash_combine(h, params.workgroup_size_y);
+            h = hash_combine(h, params.workgroup_size_z);
+            h = hash_combine(h, params.radix);
+            h = hash_combine(h, params.vector_size);
+            h = hash_combine(h, std::size_t(params.direction + 1));
+            h = hash_combine(h, params.mode);
+            h = hash_combine(h, params.input_target);
+            h = hash_combine(h, params.output_target);
+            h = hash_combine(h,
+                    (params.p1 << 0) |
+                    (params.pow2_stride << 1) |
+                    (params.shared_banked << 2) |
+                    (params.fft_fp16 << 3) |
+                    (params.input_fp16 << 4) |
+                    (params.output_fp16 << 5) |
+                    (params.fft_normalize << 6));
             return h;
         }
     };
@@ -218,6 +256,33 @@ class Program
         GLuint name = 0;
 };
 
+/// Persistent storage for linked program binaries, so programs survive between runs.
+/// Keys are hashes of the complete shader source and the driver identity.
+/// Implement this to keep binaries somewhere other than plain files, e.g. in memory for tests.
+class ProgramBinaryStore
+{
+    public:
+        virtual ~ProgramBinaryStore() = default;
+
+        /// Returns false if no binary is stored for key.
+        virtual bool load(uint64_t key, GLenum &format, std::vector<uint8_t> &binary) = 0;
+        virtual void store(uint64_t key, GLenum format, const std::vector<uint8_t> &binary) = 0;
+};
+
+/// Stores every program binary in its own file named "<prefix><key in hex>.bin".
+class FileProgramBinaryStore : public ProgramBinaryStore
+{
+    public:
+        explicit FileProgramBinaryStore(std::string prefix);
+
+        bool load(uint64_t key, GLenum &format, std::vector<uint8_t> &binary) override;
+        void store(uint64_t key, GLenum format, const std::vector<uint8_t> &binary) override;
+
+    private:
+        std::string prefix;
+        std::string get_path(uint64_t key) const;
+};
+
 class ProgramCache
 {
     public:
@@ -226,8 +291,23 @@ class ProgramCache
 
         size_t cache_size() const { return programs.size(); }
 
+        /// Enables persistent caching of compiled programs through store.
+        void set_binary_store(std::shared_ptr<ProgramBinaryStore> store) { binary_store = std::move(store); }
+        bool has_binary_store() const { return bool(binary_store); }
+
+        /// Creates a program from a stored binary built from source.
+        /// Returns 0 if nothing is stored or if the driver rejects the binary, e.g. after a driver update.
+        GLuint load_program_binary(const std::string &source);
+
+        /// Reads back the binary of a linked program built from source and hands it to the store.
+        void store_program_binary(const std::string &source, GLuint program);
+
     private:
         std::unordered_map<Parameters, Program> programs;
+        std::shared_ptr<ProgramBinaryStore> binary_store;
+        std::string driver_identity;
+
+        uint64_t get_binary_key(const std::string &source);
 };
 
 }
@@ -0,0 +1,817 @@
+/* Copyright (C) 2015 Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "glfft_cpu.hpp"
+#include "glfft_simd.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <complex>
+#include <random>
+
+using namespace std;
+using namespace GLFFT;
+
+// Number of columns each worker transforms at a time in vertical passes.
+static const unsigned column_strip_width = 32;
+
+template<typename T>
+struct CVector
+{
+    T re, im;
+};
+
+template<typename T>
+static inline CVector<T> operator+(const CVector<T> &a, const CVector<T> &b)
+{
+    return { a.re + b.re, a.im + b.im };
+}
+
+template<typename T>
+static inline CVector<T> operator-(const CVector<T> &a, const CVector<T> &b)
+{
+    return { a.re - b.re, a.im - b.im };
+}
+
+template<typename T>
+static inline CVector<T> cmul(const CVector<T> &a, const CVector<T> &b)
+{
+    return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+}
+
+// Multiplies by +j for inverse transforms and -j for forward transforms.
+template<typename T>
+static inline CVector<T> mul_dir_j(const CVector<T> &a, float dir)
+{
+    return { a.im * -dir, a.re * dir };
+}
+
+// Multiplies by exp(dir * j * pi / 4) and exp(dir * j * 3 * pi / 4).
+template<typename T>
+static inline CVector<T> mul_dir_1_8(const CVector<T> &a, float dir)
+{
+    const float s = 0.70710678118f;
+    return { (a.re - a.im * dir) * s, (a.im + a.re * dir) * s };
+}
+
+template<typename T>
+static inline CVector<T> mul_dir_3_8(const CVector<T> &a, float dir)
+{
+    const float s = 0.70710678118f;
+    return { (a.re * -1.0f - a.im * dir) * s, (a.re * dir - a.im) * s };
+}
+
+template<typename T>
+static inline void butterfly2(CVector<T> *x, float)
+{
+    CVector<T> a = x[0] + x[1];
+    CVector<T> b = x[0] - x[1];
+    x[0] = a;
+    x[1] = b;
+}
+
+// Reads x[0], x[stride], x[2 * stride], x[3 * stride], writes results in natural order to the same slots.
+template<typename T>
+static inline void butterfly4(CVector<T> *x, float dir, unsigned stride = 1)
+{
+    CVector<T> a0 = x[0] + x[2 * stride];
+    CVector<T> a1 = x[0] - x[2 * stride];
+    CVector<T> a2 = x[stride] + x[3 * stride];
+    CVector<T> a3 = mul_dir_j(x[stride] - x[3 * stride], dir);
+
+    x[0] = a0 + a2;
+    x[stride] = a1 + a3;
+    x[2 * stride] = a0 - a2;
+    x[3 * stride] = a1 - a3;
+}
+
+template<typename T>
+static inline void butterfly8(CVector<T> *x, float dir)
+{
+    // Radix-2 decimation in time on top of two radix-4 butterflies (evens and odds).
+    butterfly4(x + 0, dir, 2);
+    butterfly4(x + 1, dir, 2);
+
+    CVector<T> o1 = mul_dir_1_8(x[3], dir);
+    CVector<T> o2 = mul_dir_j(x[5], dir);
+    CVector<T> o3 = mul_dir_3_8(x[7], dir);
+
+    CVector<T> y[8] = {
+        x[0] + x[1], x[2] + o1, x[4] + o2, x[6] + o3,
+        x[0] - x[1], x[2] - o1, x[4] - o2, x[6] - o3,
+    };
+
+    for (unsigned i = 0; i < 8; i++)
+    {
+        x[i] = y[i];
+    }
+}
+
+template<unsigned R, typename T>
+static inline void butterfly(CVector<T> *x, float dir)
+{
+    switch (R)
+    {
+        case 2:
+            butterfly2(x, dir);
+            break;
+        case 4:
+            butterfly4(x, dir);
+            break;
+        case 8:
+            butterfly8(x, dir);
+            break;
+    }
+}
+
+enum TwiddleMode
+{
+    // First pass (p == 1), all twiddles are 1.
+    TwiddleNone,
+    // Each lane has its own twiddle (horizontal passes).
+    TwiddlePerLane,
+    // All lanes share one twiddle (vertical passes).
+    TwiddleBroadcast
+};
+
+struct LaneArgs
+{
+    const float *src_re, *src_im;
+    size_t in_stride;
+    float *dst_re, *dst_im;
+    size_t out_stride;
+    const float *tw_re, *tw_im;
+    size_t tw_stride;
+    float dir;
+};
+
+template<unsigned R, TwiddleMode mode, typename T>
+static inline void butterfly_lane(const LaneArgs &args, unsigned l)
+{
+    typedef SimdTraits<T> V;
+    CVector<T> x[R];
+
+    for (unsigned r = 0; r < R; r++)
+    {
+        x[r].re = V::load(args.src_re + r * args.in_stride + l);
+        x[r].im = V::load(args.src_im + r * args.in_stride + l);
+    }
+
+    if (mode != TwiddleNone)
+    {
+        for (unsigned r = 1; r < R; r++)
+        {
+            CVector<T> w;
+            if (mode == TwiddlePerLane)
+            {
+                w.re = V::load(args.tw_re + (r - 1) * args.tw_stride + l);
+                w.im = V::load(args.tw_im + (r - 1) * args.tw_stride + l);
+            }
+            else
+            {
+                w.re = V::splat(args.tw_re[(r - 1) * args.tw_stride]);
+                w.im = V::splat(args.tw_im[(r - 1) * args.tw_stride]);
+            }
+            x[r] = cmul(x[r], w);
+        }
+    }
+
+    butterfly<R>(x, args.dir);
+
+    for (unsigned r = 0; r < R; r++)
+    {
+        V::store(args.dst_re + r * args.out_stride + l, x[r].re);
+        V::store(args.dst_im + r * args.out_stride + l, x[r].im);
+    }
+}
+
+// Runs count independent radix-R butterflies on consecutive lanes, four lanes at a time.
+template<unsigned R, TwiddleMode mode>
+static void butterfly_lanes(const LaneArgs &args, unsigned count)
+{
+    unsigned l = 0;
+    for (; l + 4 <= count; l += 4)
+    {
+        butterfly_lane<R, mode, SimdFloat4>(args, l);
+    }
+
+    for (; l < count; l++)
+    {
+        butterfly_lane<R, mode, float>(args, l);
+    }
+}
+
+template<TwiddleMode mode>
+static void butterfly_lanes(unsigned radix, const LaneArgs &args, unsigned count)
+{
+    switch (radix)
+    {
+        case 2:
+            butterfly_lanes<2, mode>(args, count);
+            break;
+        case 4:
+            butterfly_lanes<4, mode>(args, count);
+            break;
+        case 8:
+            butterfly_lanes<8, mode>(args, count);
+            break;
+        default:
+            throw logic_error("Unsupported CPU radix.");
+    }
+}
+
+CPUFFT::CPUFFT(unsigned Nx, unsigned Ny, Type type, Direction direction,
+        const FFTOptions &options, const FFTWisdom &wisdom, shared_ptr<ThreadPool> thread_pool)
+    : type(type), direction(direction), size_x(Nx), size_y(Ny), pool(move(thread_pool))
+{
+    bool expand = type == ComplexToReal || type == RealToComplex;
+    unsigned complex_x = expand ? Nx / 2 : Nx;
+
+    // Sanity checks, same rules as the GPU implementation.
+    if (!complex_x || !Ny || (complex_x & (complex_x - 1)) || (Ny & (Ny - 1)))
+    {
+        throw logic_error("FFT size is not POT.");
+    }
+
+    if (type == ComplexToReal && direction == Forward)
+    {
+        throw logic_error("ComplexToReal transforms requires inverse transform.");
+    }
+
+    if (type == RealToComplex && direction != Forward)
+    {
+        throw logic_error("RealToComplex transforms requires forward transform.");
+    }
+
+    if (options.type.input_fp16 || options.type.output_fp16)
+    {
+        throw logic_error("CPU FFT only supports FP32 input and output.");
+    }
+
+    if (!pool)
+    {
+        pool = make_shared<ThreadPool>();
+    }
+
+    channels = type == ComplexToComplexDual ? 2 : 1;
+    spatial_width = complex_x;
+    frequency_width = expand ? complex_x + 1 : complex_x;
+    plane_size = size_t(max(spatial_width, frequency_width)) * Ny;
+    planes[0].resize(2 * channels * plane_size);
+    planes[1].resize(2 * channels * plane_size);
+
+    // The GPU normalizes by 1 / radix in every pass, i.e. by the size of the complex transform.
+    if (options.type.normalize)
+    {
+        scale = 1.0f / (float(complex_x) * float(Ny));
+    }
+
+    Mode horizontal_mode = type == ComplexToComplexDual ? HorizontalDual : Horizontal;
+    Mode vertical_mode = type == ComplexToComplexDual ? VerticalDual : Vertical;
+
+    // Plan the same radix splits as the GPU would for this wisdom.
+    vector<unsigned> horizontal_radices;
+    vector<unsigned> vertical_radices;
+    if (direction == Forward)
+    {
+        horizontal_radices = find_radix_splits(complex_x, Ny, horizontal_mode, options, wisdom, cost);
+        vertical_radices = find_radix_splits(complex_x, Ny, vertical_mode, options, wisdom, cost);
+    }
+    else
+    {
+        vertical_radices = find_radix_splits(complex_x, Ny, vertical_mode, options, wisdom, cost);
+        horizontal_radices = find_radix_splits(complex_x, Ny, horizontal_mode, options, wisdom, cost);
+    }
+
+    horizontal_passes = build_passes(horizontal_radices, complex_x);
+    vertical_passes = build_passes(vertical_radices, Ny);
+
+    if (expand)
+    {
+        float dir = direction == Forward ? -1.0f : 1.0f;
+        resolve_twiddle_real.resize(complex_x);
+        resolve_twiddle_imag.resize(complex_x);
+        for (unsigned k = 0; k < complex_x; k++)
+        {
+            double angle = dir * M_PI * double(k) / double(complex_x);
+            resolve_twiddle_real[k] = float(cos(angle));
+            resolve_twiddle_imag[k] = float(sin(angle));
+        }
+    }
+}
+
+vector<CPUFFT::Pass> CPUFFT::build_passes(const vector<unsigned> &radices, unsigned N) const
+{
+    // Composite radices are executed as two smaller passes, just like the shaders do in shared memory.
+    vector<unsigned> expanded;
+    for (auto radix : radices)
+    {
+        switch (radix)
+        {
+            case 16:
+                expanded.push_back(4);
+                expanded.push_back(4);
+                break;
+
+            case 64:
+                expanded.push_back(8);
+                expanded.push_back(8);
+                break;
+
+            default:
+                expanded.push_back(radix);
+                break;
+        }
+    }
+
+    double dir = direction == Forward ? -1.0 : 1.0;
+    vector<Pass> passes;
+    unsigned p = 1;
+
+    for (auto radix : expanded)
+    {
+        Pass pass;
+        pass.radix = radix;
+        pass.p = p;
+        pass.twiddle_real.resize((radix - 1) * p);
+        pass.twiddle_imag.resize((radix - 1) * p);
+
+        for (unsigned r = 1; r < radix; r++)
+        {
+            for (unsigned j = 0; j < p; j++)
+            {
+                double angle = dir * 2.0 * M_PI * double(j * r) / double(p * radix);
+                pass.twiddle_real[(r - 1) * p + j] = float(cos(angle));
+                pass.twiddle_imag[(r - 1) * p + j] = float(sin(angle));
+            }
+        }
+
+        passes.push_back(move(pass));
+        p *= radix;
+    }
+
+    if (p != N)
+    {
+        throw logic_error("Radix splits are invalid.");
+    }
+
+    return passes;
+}
+
+void CPUFFT::load(unsigned plane, const float *input, const float *input_aux)
+{
+    unsigned width = direction == Forward ? spatial_width : frequency_width;
+    // Complex half-spectrum rows use a stride of Nx complex samples.
+    unsigned input_stride = type == RealToComplex ? spatial_width : size_x;
+    unsigned components = 2 * channels;
+
+    pool->parallel_for(size_y, [&](unsigned begin, unsigned end) {
+        for (unsigned y = begin; y < end; y++)
+        {
+            for (unsigned c = 0; c < channels; c++)
+            {
+                float *re = plane_real(plane, c) + size_t(y) * width;
+                float *im = plane_imag(plane, c) + size_t(y) * width;
+                const float *in = input + size_t(y) * input_stride * components + 2 * c;
+
+                if (input_aux)
+                {
+                    const float *aux = input_aux + size_t(y) * input_stride * components + 2 * c;
+                    for (unsigned x = 0; x < width; x++)
+                    {
+                        CVector<float> a = { in[x * components], in[x * components + 1] };
+                        CVector<float> b = { aux[x * components], aux[x * components + 1] };
+                        CVector<float> v = cmul(a, b);
+                        re[x] = v.re;
+                        im[x] = v.im;
+                    }
+                }
+                else
+                {
+                    for (unsigned x = 0; x < width; x++)
+                    {
+                        re[x] = in[x * components];
+                        im[x] = in[x * components + 1];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void CPUFFT::store(float *output, unsigned plane)
+{
+    unsigned width = direction == Forward ? frequency_width : spatial_width;
+    unsigned output_stride = type == ComplexToReal ? spatial_width : size_x;
+    unsigned components = 2 * channels;
+
+    pool->parallel_for(size_y, [&](unsigned begin, unsigned end) {
+        for (unsigned y = begin; y < end; y++)
+        {
+            for (unsigned c = 0; c < channels; c++)
+            {
+                const float *re = plane_real(plane, c) + size_t(y) * width;
+                const float *im = plane_imag(plane, c) + size_t(y) * width;
+                float *out = output + size_t(y) * output_stride * components + 2 * c;
+
+                for (unsigned x = 0; x < width; x++)
+                {
+                    out[x * components] = re[x] * scale;
+                    out[x * components + 1] = im[x] * scale;
+                }
+            }
+        }
+    });
+}
+
+void CPUFFT::transform_row(const vector<Pass> &passes, unsigned N, float dir,
+        float *in_re, float *in_im, float *out_re, float *out_im, float *scratch)
+{
+    if (passes.empty())
+    {
+        copy(in_re, in_re + N, out_re);
+        copy(in_im, in_im + N, out_im);
+        return;
+    }
+
+    float *ping_re = scratch;
+    float *ping_im = scratch + N;
+    float *interleave_re = scratch + 2 * N;
+    float *interleave_im = scratch + 3 * N;
+
+    float *src_re = in_re;
+    float *src_im = in_im;
+
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        auto &pass = passes[i];
+        bool last = i + 1 == passes.size();
+        float *dst_re = last ? out_re : (src_re == in_re ? ping_re : in_re);
+        float *dst_im = last ? out_im : (src_im == in_im ? ping_im : in_im);
+
+        unsigned R = pass.radix;
+        unsigned stride = N / R;
+
+        if (pass.p == 1)
+        {
+            // Stockham autosort writes element r of butterfly k to k * R + r.
+            // Butterflies are computed on contiguous lanes, then interleaved.
+            LaneArgs args = {
+                src_re, src_im, stride,
+                interleave_re, interleave_im, stride,
+                nullptr, nullptr, 0,
+                dir,
+            };
+            butterfly_lanes<TwiddleNone>(R, args, stride);
+
+            for (unsigned k = 0; k < stride; k++)
+            {
+                for (unsigned r = 0; r < R; r++)
+                {
+                    dst_re[k * R + r] = interleave_re[r * stride + k];
+                    dst_im[k * R + r] = interleave_im[r * stride + k];
+                }
+            }
+        }
+        else
+        {
+            // Butterfly k = g * p + j reads k + r * N / R and writes g * p * R + j + r * p.
+            unsigned p = pass.p;
+            for (unsigned g = 0; g < N / (R * p); g++)
+            {
+                LaneArgs args = {
+                    src_re + g * p, src_im + g * p, stride,
+                    dst_re + g * p * R, dst_im + g * p * R, p,
+                    pass.twiddle_real.data(), pass.twiddle_imag.data(), p,
+                    dir,
+                };
+                butterfly_lanes<TwiddlePerLane>(R, args, p);
+            }
+        }
+
+        src_re = dst_re;
+        src_im = dst_im;
+    }
+}
+
+// See FFT_real_to_complex in fft_common.comp.
+static void resolve_real_to_complex(const float *in_re, const float *in_im, float *out_re, float *out_im,
+        const float *tw_re, const float *tw_im, unsigned N)
+{
+    out_re[0] = in_re[0] + in_im[0];
+    out_im[0] = 0.0f;
+    out_re[N] = in_re[0] - in_im[0];
+    out_im[N] = 0.0f;
+
+    for (unsigned k = 1; k < N; k++)
+    {
+        CVector<float> a = { in_re[k], in_im[k] };
+        CVector<float> b = { in_re[N - k], -in_im[N - k] };
+        // -j * twiddle
+        CVector<float> w = { tw_im[k], -tw_re[k] };
+
+        CVector<float> fe = a + b;
+        CVector<float> fo = cmul(a - b, w);
+        out_re[k] = 0.5f * (fe.re + fo.re);
+        out_im[k] = 0.5f * (fe.im + fo.im);
+    }
+}
+
+// See FFT_complex_to_real in fft_common.comp.
+static void resolve_complex_to_real(const float *in_re, const float *in_im, float *out_re, float *out_im,
+        const float *tw_re, const float *tw_im, unsigned N)
+{
+    for (unsigned k = 0; k < N; k++)
+    {
+        CVector<float> a = { in_re[k], in_im[k] };
+        CVector<float> b = { in_re[N - k], -in_im[N - k] };
+        // +j * twiddle
+        CVector<float> w = { -tw_im[k], tw_re[k] };
+
+        CVector<float> even = a + b;
+        CVector<float> odd = cmul(a - b, w);
+        out_re[k] = even.re + odd.re;
+        out_im[k] = even.im + odd.im;
+    }
+}
+
+void CPUFFT::run_rows(unsigned src_plane, unsigned dst_plane)
+{
+    unsigned in_width = direction == Forward ? spatial_width : frequency_width;
+    unsigned out_width = direction == Forward ? frequency_width : spatial_width;
+    unsigned N = spatial_width;
+    float dir = direction == Forward ? -1.0f : 1.0f;
+
+    pool->parallel_for(size_y * channels, [&](unsigned begin, unsigned end) {
+        // [resolve in/out 2N + 2][row transform scratch 4N][row transform output 2N]
+        vector<float> scratch(8 * N + 2);
+        float *row_re = scratch.data();
+        float *row_im = row_re + N + 1;
+        float *transform_scratch = row_im + N + 1;
+        float *result_re = transform_scratch + 4 * N;
+        float *result_im = result_re + N;
+
+        for (unsigned i = begin; i < end; i++)
+        {
+            unsigned c = i / size_y;
+            unsigned y = i % size_y;
+            float *src_re = plane_real(src_plane, c) + size_t(y) * in_width;
+            float *src_im = plane_imag(src_plane, c) + size_t(y) * in_width;
+            float *dst_re = plane_real(dst_plane, c) + size_t(y) * out_width;
+            float *dst_im = plane_imag(dst_plane, c) + size_t(y) * out_width;
+
+            switch (type)
+            {
+                case RealToComplex:
+                    transform_row(horizontal_passes, N, dir, src_re, src_im, result_re, result_im, transform_scratch);
+                    resolve_real_to_complex(result_re, result_im, dst_re, dst_im,
+                            resolve_twiddle_real.data(), resolve_twiddle_imag.data(), N);
+                    break;
+
+                case ComplexToReal:
+                    resolve_complex_to_real(src_re, src_im, row_re, row_im,
+                            resolve_twiddle_real.data(), resolve_twiddle_imag.data(), N);
+                    transform_row(horizontal_passes, N, dir, row_re, row_im, dst_re, dst_im, transform_scratch);
+                    break;
+
+                default:
+                    transform_row(horizontal_passes, N, dir, src_re, src_im, dst_re, dst_im, transform_scratch);
+                    break;
+            }
+        }
+    });
+}
+
+unsigned CPUFFT::run_columns(unsigned plane)
+{
+    if (vertical_passes.empty())
+    {
+        return plane;
+    }
+
+    unsigned width = frequency_width;
+    unsigned strips = (width + column_strip_width - 1) / column_strip_width;
+    float dir = direction == Forward ? -1.0f : 1.0f;
+
+    // Each worker runs all passes on its own strip of columns, so no synchronization is needed between passes.
+    pool->parallel_for(strips * channels, [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; i++)
+        {
+            unsigned c = i / strips;
+            unsigned x0 = (i % strips) * column_strip_width;
+            unsigned count = min(column_strip_width, width - x0);
+            unsigned src = plane;
+
+            for (auto &pass : vertical_passes)
+            {
+                unsigned R = pass.radix;
+                unsigned p = pass.p;
+                unsigned stride = size_y / R;
+                const float *src_re = plane_real(src, c) + x0;
+                const float *src_im = plane_imag(src, c) + x0;
+                float *dst_re = plane_real(src ^ 1, c) + x0;
+                float *dst_im = plane_imag(src ^ 1, c) + x0;
+
+                for (unsigned k = 0; k < stride; k++)
+                {
+                    unsigned j = k & (p - 1);
+                    unsigned out_row = (k - j) * R + j;
+
+                    LaneArgs args = {
+                        src_re + size_t(k) * width, src_im + size_t(k) * width, size_t(stride) * width,
+                        dst_re + size_t(out_row) * width, dst_im + size_t(out_row) * width, size_t(p) * width,
+                        pass.twiddle_real.data() + j, pass.twiddle_imag.data() + j, p,
+                        dir,
+                    };
+
+                    if (p == 1)
+                    {
+                        butterfly_lanes<TwiddleNone>(R, args, count);
+                    }
+                    else
+                    {
+                        butterfly_lanes<TwiddleBroadcast>(R, args, count);
+                    }
+                }
+
+                src ^= 1;
+            }
+        }
+    });
+
+    return plane ^ (vertical_passes.size() & 1);
+}
+
+void CPUFFT::process(float *output, const float *input, const float *input_aux)
+{
+    load(0, input, direction == InverseConvolve ? input_aux : nullptr);
+
+    unsigned plane;
+    if (direction == Forward)
+    {
+        run_rows(0, 1);
+        plane = run_columns(1);
+    }
+    else
+    {
+        plane = run_columns(0);
+        run_rows(plane, plane ^ 1);
+        plane ^= 1;
+    }
+
+    store(output, plane);
+}
+
+// Naive DFT of every row or every column of a Ny x Nx grid, O(N^2) per row or column.
+static void naive_dft(vector<complex<double>> &data, unsigned Nx, unsigned Ny, bool columns, double dir)
+{
+    unsigned N = columns ? Ny : Nx;
+    unsigned lines = columns ? Nx : Ny;
+    size_t stride = columns ? Nx : 1;
+
+    vector<complex<double>> twiddles(N);
+    for (unsigned k = 0; k < N; k++)
+    {
+        twiddles[k] = polar(1.0, dir * 2.0 * M_PI * double(k) / double(N));
+    }
+
+    vector<complex<double>> line(N);
+    for (unsigned l = 0; l < lines; l++)
+    {
+        complex<double> *base = data.data() + (columns ? l : size_t(l) * Nx);
+        for (unsigned k = 0; k < N; k++)
+        {
+            complex<double> sum = 0.0;
+            for (unsigned n = 0; n < N; n++)
+            {
+                sum += base[n * stride] * twiddles[(size_t(n) * k) % N];
+            }
+            line[k] = sum;
+        }
+
+        for (unsigned k = 0; k < N; k++)
+        {
+            base[k * stride] = line[k];
+        }
+    }
+}
+
+double CPUFFT::validate(unsigned Nx, unsigned Ny, Type type, Direction direction, shared_ptr<ThreadPool> pool)
+{
+    if ((type != ComplexToComplex && type != ComplexToReal) || direction == InverseConvolve)
+    {
+        throw logic_error("Only ComplexToComplex and ComplexToReal transforms can be validated.");
+    }
+
+    FFTOptions options;
+    CPUFFT fft(Nx, Ny, type, direction, options, FFTWisdom(), move(pool));
+
+    // Fixed seed, so a failure can be reproduced.
+    mt19937 engine(1337);
+    uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+    vector<float> input;
+    vector<double> expected;
+    vector<complex<double>> data(size_t(Nx) * Ny);
+
+    if (type == ComplexToComplex)
+    {
+        input.resize(2 * data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            input[2 * i + 0] = distribution(engine);
+            input[2 * i + 1] = distribution(engine);
+            data[i] = complex<double>(input[2 * i + 0], input[2 * i + 1]);
+        }
+
+        double dir = direction == Forward ? -1.0 : 1.0;
+        naive_dft(data, Nx, Ny, false, dir);
+        naive_dft(data, Nx, Ny, true, dir);
+
+        expected.resize(2 * data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            expected[2 * i + 0] = data[i].real();
+            expected[2 * i + 1] = data[i].imag();
+        }
+    }
+    else
+    {
+        // A half-spectrum only describes a real signal if it is Hermitian, so take the spectrum of real samples.
+        vector<float> samples(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            samples[i] = distribution(engine);
+            data[i] = samples[i];
+        }
+        naive_dft(data, Nx, Ny, false, -1.0);
+        naive_dft(data, Nx, Ny, true, -1.0);
+
+        // N / 2 + 1 complex samples per row with a stride of Nx complex samples.
+        input.assign(2 * data.size(), 0.0f);
+        for (unsigned y = 0; y < Ny; y++)
+        {
+            for (unsigned x = 0; x <= Nx / 2; x++)
+            {
+                size_t i = size_t(y) * Nx + x;
+                input[2 * i + 0] = float(data[i].real());
+                input[2 * i + 1] = float(data[i].imag());
+            }
+        }
+
+        // The unnormalized inverse of the forward transform scales the samples by the number of samples.
+        expected.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            expected[i] = double(samples[i]) * Nx * Ny;
+        }
+    }
+
+    vector<float> output(expected.size());
+    fft.process(output.data(), input.data());
+
+    double max_error = 0.0;
+    double max_magnitude = 0.0;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        max_error = max(max_error, fabs(double(output[i]) - expected[i]));
+        max_magnitude = max(max_magnitude, fabs(expected[i]));
+    }
+
+    return max_magnitude > 0.0 ? max_error / max_magnitude : max_error;
+}
+
+double CPUFFT::bench(float *output, const float *input,
+        unsigned warmup_iterations, unsigned iterations, double max_time)
+{
+    for (unsigned i = 0; i < warmup_iterations; i++)
+    {
+        process(output, input);
+    }
+
+    unsigned runs = 0;
+    double start_time = glfft_time();
+
+    for (unsigned i = 0; i < iterations && (((glfft_time() - start_time) < max_time) || i == 0); i++)
+    {
+        process(output, input);
+        runs++;
+    }
+
+    return (glfft_time() - start_time) / runs;
+}
@@ -0,0 +1,155 @@
+/* Copyright (C) 2015 Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GLFFT_CPU_HPP__
+#define GLFFT_CPU_HPP__
+
+#include "glfft.hpp"
+#include "glfft_thread_pool.hpp"
+#include <vector>
+#include <memory>
+#include <limits>
+
+namespace GLFFT
+{
+
+/// @brief CPU reference implementation of FFT.
+///
+/// Mirrors the construction and process() semantics of FFT, but works on client memory
+/// instead of GL objects, so the same transforms can be validated and benchmarked without a GPU.
+/// Radix splits are planned with find_radix_splits(), i.e. the same plan FFT would pick for the same wisdom.
+/// Composite radix 16 and 64 passes are run as 4x4 and 8x8, like the GPU shaders do internally.
+///
+/// Memory layouts match the SSBO layouts used by FFT with FP32 input and output:
+/// - ComplexToComplex:     Nx * Ny interleaved (real, imag) pairs.
+/// - ComplexToComplexDual: Nx * Ny interleaved (real0, imag0, real1, imag1) quads.
+/// - RealToComplex:        Input is Nx * Ny reals.
+///                         Output is N / 2 + 1 complex values per row with a stride of Nx complex samples.
+/// - ComplexToReal:        Input is N / 2 + 1 complex values per row with a stride of Nx complex samples.
+///                         Output is Nx * Ny reals.
+/// Padding at the end of complex half-spectrum rows is neither read nor written.
+class CPUFFT
+{
+    public:
+        /// @brief Creates a full FFT.
+        ///
+        /// All memory allocation is done in constructor.
+        /// Will throw if invalid parameters are passed.
+        ///
+        /// @param Nx        Number of samples in horizontal dimension.
+        /// @param Ny        Number of samples in vertical dimension.
+        /// @param type      The transform type.
+        /// @param direction Forward, inverse or inverse with convolution.
+        /// @param options   FFT options. FP16 input and output are not supported, options.type.fp16 is ignored.
+        /// @param wisdom    GLFFT wisdom used to plan radix splits.
+        /// @param pool      Worker pool to run on. If null, a pool with one thread per core is created.
+        CPUFFT(unsigned Nx, unsigned Ny, Type type, Direction direction,
+                const FFTOptions &options, const FFTWisdom &wisdom = FFTWisdom(),
+                std::shared_ptr<ThreadPool> pool = nullptr);
+
+        /// @brief Process the FFT.
+        ///
+        /// @param output    Output samples. Must not alias input.
+        /// @param input     Input samples.
+        /// @param input_aux If using convolution transform type,
+        ///                  the content of input and input_aux will be multiplied together.
+        void process(float *output, const float *input, const float *input_aux = nullptr);
+
+        /// @brief Run process() multiple times, timing the results.
+        ///
+        /// @returns Average time per process() call in seconds.
+        double bench(float *output, const float *input,
+                unsigned warmup_iterations, unsigned iterations,
+                double max_time = std::numeric_limits<double>::max());
+
+        /// @brief Checks process() against a naive DFT in double precision, on random input.
+        ///
+        /// Needs no GL context, so the CPU transforms can be verified on a headless machine.
+        /// Only ComplexToComplex and ComplexToReal transforms without convolution are supported.
+        /// Will throw for other transforms.
+        ///
+        /// @param Nx        Number of samples in horizontal dimension.
+        /// @param Ny        Number of samples in vertical dimension.
+        /// @param type      The transform type.
+        /// @param direction Forward or inverse.
+        /// @param pool      Worker pool to run on. If null, a pool with one thread per core is created.
+        /// @returns Largest absolute error, relative to the largest magnitude of the expected output.
+        static double validate(unsigned Nx, unsigned Ny, Type type, Direction direction,
+                std::shared_ptr<ThreadPool> pool = nullptr);
+
+        /// @brief Returns the cost of the radix splits, as estimated from wisdom. Only used for debugging.
+        double get_cost() const { return cost; }
+
+        /// @brief Returns number of butterfly passes in a process() call.
+        unsigned get_num_passes() const { return unsigned(horizontal_passes.size() + vertical_passes.size()); }
+
+        /// @brief Returns Nx.
+        unsigned get_dimension_x() const { return size_x; }
+        /// @brief Returns Ny.
+        unsigned get_dimension_y() const { return size_y; }
+
+    private:
+        struct Pass
+        {
+            unsigned radix;
+            unsigned p;
+            // Twiddle factors w^r for r = 1 .. radix - 1, laid out as [(r - 1) * p + j].
+            std::vector<float> twiddle_real;
+            std::vector<float> twiddle_imag;
+        };
+
+        Type type;
+        Direction direction;
+        unsigned size_x, size_y;
+        unsigned channels;
+        // Width in complex samples of the spatial and frequency domain rows.
+        unsigned spatial_width;
+        unsigned frequency_width;
+        float scale = 1.0f;
+        double cost = 0.0;
+
+        std::vector<Pass> horizontal_passes;
+        std::vector<Pass> vertical_passes;
+        std::vector<float> resolve_twiddle_real;
+        std::vector<float> resolve_twiddle_imag;
+
+        // Split (SoA) real and imaginary planes, ping-ponged between passes.
+        std::vector<float> planes[2];
+        size_t plane_size = 0;
+
+        std::shared_ptr<ThreadPool> pool;
+
+        std::vector<Pass> build_passes(const std::vector<unsigned> &radices, unsigned N) const;
+
+        // Runs all passes of a 1D Stockham transform over one row of N samples.
+        // The input row may be clobbered. scratch must hold 4 * N floats.
+        static void transform_row(const std::vector<Pass> &passes, unsigned N, float dir,
+                float *in_re, float *in_im, float *out_re, float *out_im, float *scratch);
+
+        float *plane_real(unsigned index, unsigned channel) { return planes[index].data() + 2 * channel * plane_size; }
+        float *plane_imag(unsigned index, unsigned channel) { return plane_real(index, channel) + plane_size; }
+
+        void load(unsigned plane, const float *input, const float *input_aux);
+        void store(float *output, unsigned plane);
+        void run_rows(unsigned src_plane, unsigned dst_plane);
+        unsigned run_columns(unsigned plane);
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/* Copyright (C) 2015 Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Thin 4-wide float vector wrapper used by the CPU code paths.
+// Maps to NEON or SSE where available, plain arrays otherwise.
+
+#ifndef GLFFT_SIMD_HPP__
+#define GLFFT_SIMD_HPP__
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GLFFT_SIMD_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GLFFT_SIMD_SSE
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace GLFFT
+{
+
+struct SimdFloat4
+{
+#if defined(GLFFT_SIMD_NEON)
+    float32x4_t v;
+
+    static inline SimdFloat4 load(const float *ptr) { return { vld1q_f32(ptr) }; }
+    static inline SimdFloat4 splat(float value) { return { vdupq_n_f32(value) }; }
+    inline void store(float *ptr) const { vst1q_f32(ptr, v); }
+
+    friend inline SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return { vaddq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return { vsubq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return { vmulq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, float b) { return { vmulq_n_f32(a.v, b) }; }
+    friend inline SimdFloat4 min(SimdFloat4 a, SimdFloat4 b) { return { vminq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 max(SimdFloat4 a, SimdFloat4 b) { return { vmaxq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 abs(SimdFloat4 a) { return { vabsq_f32(a.v) }; }
+    friend inline SimdFloat4 truncate(SimdFloat4 a) { return { vcvtq_f32_s32(vcvtq_s32_f32(a.v)) }; }
+    /// 2^(n - 127) for integral n in [1, 254].
+    friend inline SimdFloat4 exp2_biased(SimdFloat4 n) { return { vreinterpretq_f32_s32(vshlq_n_s32(vcvtq_s32_f32(n.v), 23)) }; }
+#if defined(__aarch64__)
+    friend inline SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return { vdivq_f32(a.v, b.v) }; }
+    friend inline SimdFloat4 sqrt(SimdFloat4 a) { return { vsqrtq_f32(a.v) }; }
+#else
+    // ARMv7 NEON has no divide or square root, refine the estimates with two Newton-Raphson steps.
+    friend inline SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b)
+    {
+        float32x4_t r = vrecpeq_f32(b.v);
+        r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+        r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+        return { vmulq_f32(a.v, r) };
+    }
+
+    friend inline SimdFloat4 sqrt(SimdFloat4 a)
+    {
+        float32x4_t r = vrsqrteq_f32(a.v);
+        r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+        r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+        // rsqrt(0) is infinite, mask so that sqrt(0) = 0 rather than NaN.
+        uint32x4_t nonzero = vcgtq_f32(a.v, vdupq_n_f32(0.0f));
+        return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(a.v, r)), nonzero)) };
+    }
+#endif
+#elif defined(GLFFT_SIMD_SSE)
+    __m128 v;
+
+    static inline SimdFloat4 load(const float *ptr) { return { _mm_loadu_ps(ptr) }; }
+    static inline SimdFloat4 splat(float value) { return { _mm_set1_ps(value) }; }
+    inline void store(float *ptr) const { _mm_storeu_ps(ptr, v); }
+
+    friend inline SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return { _mm_add_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, float b) { return { _mm_mul_ps(a.v, _mm_set1_ps(b)) }; }
+    friend inline SimdFloat4 min(SimdFloat4 a, SimdFloat4 b) { return { _mm_min_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 max(SimdFloat4 a, SimdFloat4 b) { return { _mm_max_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return { _mm_div_ps(a.v, b.v) }; }
+    friend inline SimdFloat4 sqrt(SimdFloat4 a) { return { _mm_sqrt_ps(a.v) }; }
+    friend inline SimdFloat4 abs(SimdFloat4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    friend inline SimdFloat4 truncate(SimdFloat4 a) { return { _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v)) }; }
+    /// 2^(n - 127) for integral n in [1, 254].
+    friend inline SimdFloat4 exp2_biased(SimdFloat4 n) { return { _mm_castsi128_ps(_mm_slli_epi32(_mm_cvttps_epi32(n.v), 23)) }; }
+#else
+    float v[4];
+
+    static inline SimdFloat4 load(const float *ptr) { return { { ptr[0], ptr[1], ptr[2], ptr[3] } }; }
+    static inline SimdFloat4 splat(float value) { return { { value, value, value, value } }; }
+    inline void store(float *ptr) const { for (unsigned i = 0; i < 4; i++) ptr[i] = v[i]; }
+
+#define GLFFT_SIMD_SCALAR_OP(expr) SimdFloat4 r; for (unsigned i = 0; i < 4; i++) r.v[i] = expr; return r
+    friend inline SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] + b.v[i]); }
+    friend inline SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] - b.v[i]); }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] * b.v[i]); }
+    friend inline SimdFloat4 operator*(SimdFloat4 a, float b) { GLFFT_SIMD_SCALAR_OP(a.v[i] * b); }
+    friend inline SimdFloat4 min(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+    friend inline SimdFloat4 max(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+    friend inline SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { GLFFT_SIMD_SCALAR_OP(a.v[i] / b.v[i]); }
+    friend inline SimdFloat4 sqrt(SimdFloat4 a) { GLFFT_SIMD_SCALAR_OP(std::sqrt(a.v[i])); }
+    friend inline SimdFloat4 abs(SimdFloat4 a) { GLFFT_SIMD_SCALAR_OP(std::fabs(a.v[i])); }
+    friend inline SimdFloat4 truncate(SimdFloat4 a) { GLFFT_SIMD_SCALAR_OP(float(int32_t(a.v[i]))); }
+    friend inline SimdFloat4 exp2_biased(SimdFloat4 n)
+    {
+        SimdFloat4 r;
+        for (unsigned i = 0; i < 4; i++)
+        {
+            int32_t bits = int32_t(n.v[i]) << 23;
+            std::memcpy(&r.v[i], &bits, sizeof(bits));
+        }
+        return r;
+    }
+#undef GLFFT_SIMD_SCALAR_OP
+#endif
+};
+
+// The operations above are friends, which are only found through ADL.
+// Forward to them from here, declaring them at namespace scope would hide std::min and friends in GLFFT code.
+namespace SimdDetail
+{
+inline SimdFloat4 simd_min(SimdFloat4 a, SimdFloat4 b) { return min(a, b); }
+inline SimdFloat4 simd_max(SimdFloat4 a, SimdFloat4 b) { return max(a, b); }
+inline SimdFloat4 simd_sqrt(SimdFloat4 a) { return sqrt(a); }
+inline SimdFloat4 simd_abs(SimdFloat4 a) { return abs(a); }
+inline SimdFloat4 simd_truncate(SimdFloat4 a) { return truncate(a); }
+inline SimdFloat4 simd_exp2_biased(SimdFloat4 n) { return exp2_biased(n); }
+}
+
+/// Lets kernels be written once for both SimdFloat4 and plain float (for loop tails).
+template<typename T>
+struct SimdTraits;
+
+template<>
+struct SimdTraits<float>
+{
+    enum { width = 1 };
+    static inline float load(const float *ptr) { return *ptr; }
+    static inline float splat(float value) { return value; }
+    static inline void store(float *ptr, float value) { *ptr = value; }
+    static inline float min(float a, float b) { return std::min(a, b); }
+    static inline float max(float a, float b) { return std::max(a, b); }
+    static inline float sqrt(float a) { return std::sqrt(a); }
+    static inline float abs(float a) { return std::fabs(a); }
+    static inline float truncate(float a) { return float(int32_t(a)); }
+    static inline float exp2_biased(float n)
+    {
+        float r;
+        int32_t bits = int32_t(n) << 23;
+        std::memcpy(&r, &bits, sizeof(bits));
+        return r;
+    }
+};
+
+template<>
+struct SimdTraits<SimdFloat4>
+{
+    enum { width = 4 };
+    static inline SimdFloat4 load(const float *ptr) { return SimdFloat4::load(ptr); }
+    static inline SimdFloat4 splat(float value) { return SimdFloat4::splat(value); }
+    static inline void store(float *ptr, SimdFloat4 value) { value.store(ptr); }
+    static inline SimdFloat4 min(SimdFloat4 a, SimdFloat4 b) { return SimdDetail::simd_min(a, b); }
+    static inline SimdFloat4 max(SimdFloat4 a, SimdFloat4 b) { return SimdDetail::simd_max(a, b); }
+    static inline SimdFloat4 sqrt(SimdFloat4 a) { return SimdDetail::simd_sqrt(a); }
+    static inline SimdFloat4 abs(SimdFloat4 a) { return SimdDetail::simd_abs(a); }
+    static inline SimdFloat4 truncate(SimdFloat4 a) { return SimdDetail::simd_truncate(a); }
+    static inline SimdFloat4 exp2_biased(SimdFloat4 n) { return SimdDetail::simd_exp2_biased(n); }
+};
+
+/// exp(x) for float or SimdFloat4 with a relative error of a few ulp.
+/// Splits x into n * ln(2) + r, evaluates exp(r) with a polynomial (Cephes expf)
+/// and scales by 2^n through the exponent bits. Inputs are clamped to the normal float range.
+template<typename T>
+inline T exp_approx(T x)
+{
+    typedef SimdTraits<T> S;
+    x = S::max(S::min(x, S::splat(88.0f)), S::splat(-87.33654f));
+
+    // Bias by 127 (plus 0.5 for rounding) so truncation acts as round-to-nearest on a positive number.
+    T n = S::truncate(x * 1.44269504f + S::splat(127.5f));
+    T e = n - S::splat(127.0f);
+    T r = x - e * 0.693359375f + e * 2.12194440e-4f;
+
+    T p = S::splat(1.9875691500e-4f);
+    p = p * r + S::splat(1.3981999507e-3f);
+    p = p * r + S::splat(8.3334519073e-3f);
+    p = p * r + S::splat(4.1665795894e-2f);
+    p = p * r + S::splat(1.6666665459e-1f);
+    p = p * r + S::splat(5.0000001201e-1f);
+    p = p * (r * r) + r + S::splat(1.0f);
+
+    return p * S::exp2_biased(n);
+}
+
+}
+
+#endif
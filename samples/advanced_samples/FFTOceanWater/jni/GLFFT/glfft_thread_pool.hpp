@@ -0,0 +1,72 @@
+/* Copyright (C) 2015 Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GLFFT_THREAD_POOL_HPP__
+#define GLFFT_THREAD_POOL_HPP__
+
+#include "ThreadPool.h"
+#include <functional>
+
+namespace GLFFT
+{
+
+/// @brief A minimal fork-join worker pool used by the CPU code paths.
+///
+/// Thin wrapper around MaliSDK::ThreadPool, so GLFFT and the rest of the sample share one implementation.
+/// Workers are created once and sleep until parallel_for() hands them work,
+/// so the pool can be reused every frame without thread creation overhead.
+class ThreadPool
+{
+    public:
+        /// @brief Creates a pool.
+        ///
+        /// @param num_threads Total number of threads taking part in parallel_for(), including the caller.
+        ///                    0 picks std::thread::hardware_concurrency().
+        explicit ThreadPool(unsigned num_threads = 0)
+            : pool(num_threads)
+        {}
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// @brief Runs func(begin, end) over [0, count) split into chunks, and blocks until all chunks are done.
+        ///
+        /// The calling thread processes chunks as well.
+        /// func must not throw, and must not call parallel_for() on the same pool.
+        ///
+        /// @param count     Number of work items.
+        /// @param func      Called with half-open ranges of work items.
+        /// @param min_chunk Lower bound on work items per call to func.
+        void parallel_for(unsigned count, const std::function<void (unsigned, unsigned)> &func, unsigned min_chunk = 1)
+        {
+            pool.parallelFor(count, func, min_chunk);
+        }
+
+        /// @brief Returns the number of threads taking part in parallel_for(), including the caller.
+        unsigned get_num_threads() const { return pool.getNumberOfThreads(); }
+
+        /// @brief Returns the underlying pool, for code outside GLFFT which works on the same threads.
+        MaliSDK::ThreadPool &get_pool() { return pool; }
+
+    private:
+        MaliSDK::ThreadPool pool;
+};
+
+}
+
+#endif
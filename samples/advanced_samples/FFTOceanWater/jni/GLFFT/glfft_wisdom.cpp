@@ -19,6 +19,7 @@
 #include "glfft_wisdom.hpp"
 #include "glfft.hpp"
 #include <utility>
+#include <cstdio>
 
 using namespace std;
 using namespace GLFFT;
@@ -462,3 +463,242 @@ const FFTOptions::Performance& FFTWisdom::find_optimal_options_or_default(unsign
     return itr != end(library) ? itr->second : base_options.performance;
 }
 
+
+// On-disk wisdom format. All fields are little-endian 32-bit words except the cost, which is a 64-bit IEEE double.
+//   magic, version, renderer length, renderer bytes, pass count,
+//   then per pass: Nx, Ny, radix, mode, input target, output target, type flags, cost,
+//                  workgroup_size_x, workgroup_size_y, vector_size, shared_banked.
+// Bump the version whenever the layout or the meaning of a field changes.
+static const uint32_t wisdom_magic = 0x57464c47; // "GLFW"
+static const uint32_t wisdom_version = 1;
+
+static void write_u32(vector<uint8_t> &out, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; i++)
+    {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+static void write_u64(vector<uint8_t> &out, uint64_t value)
+{
+    write_u32(out, uint32_t(value));
+    write_u32(out, uint32_t(value >> 32));
+}
+
+namespace
+{
+    struct WisdomReader
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t offset;
+
+        bool read_u32(uint32_t &value)
+        {
+            if (size - offset < 4)
+            {
+                return false;
+            }
+
+            value = 0;
+            for (unsigned i = 0; i < 4; i++)
+            {
+                value |= uint32_t(data[offset++]) << (8 * i);
+            }
+            return true;
+        }
+
+        bool read_u64(uint64_t &value)
+        {
+            uint32_t lo, hi;
+            if (!read_u32(lo) || !read_u32(hi))
+            {
+                return false;
+            }
+            value = uint64_t(lo) | (uint64_t(hi) << 32);
+            return true;
+        }
+    };
+}
+
+static inline uint32_t type_to_flags(const FFTOptions::Type &type)
+{
+    return (type.fp16 << 0) | (type.input_fp16 << 1) | (type.output_fp16 << 2) | (type.normalize << 3);
+}
+
+vector<uint8_t> FFTWisdom::serialize(const char *renderer) const
+{
+    vector<uint8_t> out;
+    size_t renderer_len = strlen(renderer);
+    out.reserve(20 + renderer_len + library.size() * 52);
+
+    write_u32(out, wisdom_magic);
+    write_u32(out, wisdom_version);
+    write_u32(out, uint32_t(renderer_len));
+    out.insert(end(out), renderer, renderer + renderer_len);
+    write_u32(out, uint32_t(library.size()));
+
+    for (auto &entry : library)
+    {
+        auto &pass = entry.first.pass;
+        auto &perf = entry.second;
+
+        uint64_t cost_bits;
+        static_assert(sizeof(cost_bits) == sizeof(entry.first.cost), "Cost must be a 64-bit double.");
+        memcpy(&cost_bits, &entry.first.cost, sizeof(cost_bits));
+
+        write_u32(out, pass.Nx);
+        write_u32(out, pass.Ny);
+        write_u32(out, pass.radix);
+        write_u32(out, pass.mode);
+        write_u32(out, pass.input_target);
+        write_u32(out, pass.output_target);
+        write_u32(out, type_to_flags(pass.type));
+        write_u64(out, cost_bits);
+        write_u32(out, perf.workgroup_size_x);
+        write_u32(out, perf.workgroup_size_y);
+        write_u32(out, perf.vector_size);
+        write_u32(out, perf.shared_banked);
+    }
+
+    return out;
+}
+
+bool FFTWisdom::deserialize(const void *data, size_t size, const char *renderer)
+{
+    WisdomReader reader = { static_cast<const uint8_t*>(data), size, 0 };
+
+    uint32_t magic, version, renderer_len;
+    if (!reader.read_u32(magic) || !reader.read_u32(version) || !reader.read_u32(renderer_len))
+    {
+        return false;
+    }
+
+    if (magic != wisdom_magic)
+    {
+        glfft_log("Wisdom blob has invalid magic.\n");
+        return false;
+    }
+
+    if (version != wisdom_version)
+    {
+        glfft_log("Wisdom blob has version %u, expected %u. Discarding.\n", version, wisdom_version);
+        return false;
+    }
+
+    if (size - reader.offset < renderer_len ||
+        renderer_len != strlen(renderer) ||
+        memcmp(reader.data + reader.offset, renderer, renderer_len) != 0)
+    {
+        glfft_log("Wisdom blob was created for a different renderer. Discarding.\n");
+        return false;
+    }
+    reader.offset += renderer_len;
+
+    uint32_t count;
+    if (!reader.read_u32(count))
+    {
+        return false;
+    }
+
+    // Parse everything before touching the library so a truncated blob is rejected as a whole.
+    vector<pair<WisdomPass, FFTOptions::Performance>> passes;
+    passes.reserve(min<size_t>(count, (size - reader.offset) / 52));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t Nx, Ny, radix, mode, input_target, output_target, flags;
+        uint32_t workgroup_size_x, workgroup_size_y, vector_size, shared_banked;
+        uint64_t cost_bits;
+
+        bool ok = reader.read_u32(Nx) && reader.read_u32(Ny) && reader.read_u32(radix) &&
+                  reader.read_u32(mode) && reader.read_u32(input_target) && reader.read_u32(output_target) &&
+                  reader.read_u32(flags) && reader.read_u64(cost_bits) &&
+                  reader.read_u32(workgroup_size_x) && reader.read_u32(workgroup_size_y) &&
+                  reader.read_u32(vector_size) && reader.read_u32(shared_banked);
+
+        if (!ok || mode > ResolveComplexToReal || input_target > ImageReal || output_target > ImageReal)
+        {
+            glfft_log("Wisdom blob is corrupt. Discarding.\n");
+            return false;
+        }
+
+        FFTOptions::Type type;
+        type.fp16 = (flags & (1 << 0)) != 0;
+        type.input_fp16 = (flags & (1 << 1)) != 0;
+        type.output_fp16 = (flags & (1 << 2)) != 0;
+        type.normalize = (flags & (1 << 3)) != 0;
+
+        WisdomPass pass = {
+            {
+                Nx, Ny, radix, static_cast<Mode>(mode),
+                static_cast<Target>(input_target), static_cast<Target>(output_target),
+                type,
+            },
+            0.0,
+        };
+        memcpy(&pass.cost, &cost_bits, sizeof(pass.cost));
+
+        FFTOptions::Performance perf;
+        perf.workgroup_size_x = workgroup_size_x;
+        perf.workgroup_size_y = workgroup_size_y;
+        perf.vector_size = vector_size;
+        perf.shared_banked = shared_banked != 0;
+
+        passes.push_back(make_pair(pass, perf));
+    }
+
+    // Passes learned in this session take precedence over stored ones.
+    for (auto &pass : passes)
+    {
+        library.insert(pass);
+    }
+
+    return true;
+}
+
+bool FFTWisdom::save(const char *path, const char *renderer) const
+{
+    auto blob = serialize(renderer);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        glfft_log("Failed to open wisdom file %s for writing.\n", path);
+        return false;
+    }
+
+    bool ok = fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok)
+    {
+        glfft_log("Failed to write wisdom file %s.\n", path);
+        remove(path);
+    }
+
+    return ok;
+}
+
+bool FFTWisdom::load(const char *path, const char *renderer)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    vector<uint8_t> blob;
+    uint8_t buffer[4096];
+    size_t read_size;
+    while ((read_size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        blob.insert(end(blob), buffer, buffer + read_size);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+
+    return ok && deserialize(blob.data(), blob.size(), renderer);
+}
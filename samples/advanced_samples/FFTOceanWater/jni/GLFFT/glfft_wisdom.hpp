@@ -22,6 +22,8 @@
 #include <unordered_map>
 #include <utility>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include "glfft_common.hpp"
 
 namespace GLFFT
@@ -57,13 +59,19 @@ namespace std
     {
         std::size_t operator()(const GLFFT::WisdomPass &params) const
         {
+            using GLFFT::hash_combine;
             std::size_t h = 0;
-            hash<uint8_t> hasher;
-            for (std::size_t i = 0; i < sizeof(params.pass); i++)
-            {
-                h ^= hasher(reinterpret_cast<const uint8_t*>(&params.pass)[i]);
-            }
-
+            h = hash_combine(h, params.pass.Nx);
+            h = hash_combine(h, params.pass.Ny);
+            h = hash_combine(h, params.pass.radix);
+            h = hash_combine(h, params.pass.mode);
+            h = hash_combine(h, params.pass.input_target);
+            h = hash_combine(h, params.pass.output_target);
+            h = hash_combine(h,
+                    (params.pass.type.fp16 << 0) |
+                    (params.pass.type.input_fp16 << 1) |
+                    (params.pass.type.output_fp16 << 2) |
+                    (params.pass.type.normalize << 3));
             return h;
         }
     };
@@ -104,6 +112,25 @@ class FFTWisdom
         void set_static_wisdom(FFTStaticWisdom static_wisdom) { this->static_wisdom = static_wisdom; }
         static FFTStaticWisdom get_static_wisdom_from_renderer(const char *renderer);
 
+        /// Serializes all learned passes into a versioned, endian-independent blob.
+        /// Wisdom is only meaningful for the GPU and driver it was learned on,
+        /// so the renderer string is stored alongside the passes.
+        std::vector<uint8_t> serialize(const char *renderer) const;
+
+        /// Merges passes from a blob created by serialize().
+        /// Returns false and leaves the library untouched if the blob is malformed,
+        /// was written by a different format version or for a different renderer.
+        bool deserialize(const void *data, std::size_t size, const char *renderer);
+
+        /// Writes serialize() output to path. Returns false on I/O failure.
+        bool save(const char *path, const char *renderer) const;
+
+        /// Reads a file written by save() and merges it with deserialize().
+        bool load(const char *path, const char *renderer);
+
+        /// Number of passes currently in the library.
+        std::size_t size() const { return library.size(); }
+
         void set_bench_params(unsigned warmup, unsigned iterations, unsigned dispatches,
                 double timeout)
         {
@@ -20,6 +20,10 @@
 
 #define FFT_FP16 1
 
+// Set to 1 to benchmark FFT passes which are missing from the stored wisdom file and save the result.
+// Learning is slow, but only has to happen once per device and driver.
+#define FFT_LEARN_WISDOM 0
+
 #include "vector_math.h"
 
 #include "fftwater.hpp"
@@ -39,7 +43,8 @@ FFTWater::FFTWater(
     :
         wind_velocity(wind_velocity),
         wind_dir(vec_normalize(wind_velocity)),
-        Nx(resolution.x), Nz(resolution.y), size(size), size_normal(size / normalmap_freq_mod)
+        Nx(resolution.x), Nz(resolution.y), size(size), size_normal(size / normalmap_freq_mod),
+        normalmap_freq_mod(normalmap_freq_mod)
 {
     // Factor in Phillips spectrum.
     L = vec_dot(wind_velocity, wind_velocity) / G;
@@ -47,18 +52,17 @@ FFTWater::FFTWater(
     // Use half-res for displacementmap since it's so low-resolution.
     displacement_downsample = 1;
 
-    distribution.resize(Nx * Nz);
-    distribution_normal.resize(Nx * Nz);
-
-    // Normalize amplitude a bit based on the heightmap size.
-    amplitude *= 0.3f / sqrt(size.x * size.y);
+    thread_pool = make_shared<GLFFT::ThreadPool>();
+    spectrum = unique_ptr<PhillipsSpectrum>(new PhillipsSpectrum(Nx, Nz, size, 0.02f, thread_pool));
+    spectrum_normal = unique_ptr<PhillipsSpectrum>(new PhillipsSpectrum(Nx, Nz, size_normal, 0.02f, thread_pool));
 
-    generate_distribution(distribution.data(), size, amplitude, 0.02f);
-    generate_distribution(distribution_normal.data(), size_normal,
-            amplitude * sqrt(normalmap_freq_mod.x * normalmap_freq_mod.y), 0.02f);
+    spectrum->generate_noise(engine, normal_dist);
+    spectrum_normal->generate_noise(engine, normal_dist);
 
-    distribution_displacement.resize((Nx * Nz) >> (displacement_downsample * 2));
-    downsample_distribution(distribution_displacement.data(), distribution.data(), displacement_downsample);
+    spectrum->set_wind(wind_dir, L);
+    spectrum_normal->set_wind(wind_dir, L);
+    set_amplitude(amplitude);
+    generate_distributions();
 
     // Check if we can render to FP16, if so, we can do mipmaping of FP16 in fragment instead where appropriate.
     mipmap_fp16 = common_has_extension("GL_EXT_color_buffer_half_float");
@@ -76,68 +80,193 @@ static inline int alias(int x, int N)
 void FFTWater::downsample_distribution(cfloat *out, const cfloat *in, unsigned rate_log2)
 {
     // Pick out the lower frequency samples only which is the same as downsampling "perfectly".
+    // Non-negative and negative frequencies are both contiguous in a row, so every row is two copies.
     unsigned out_width = Nx >> rate_log2;
     unsigned out_height = Nz >> rate_log2;
+    unsigned positive_x = out_width / 2 + 1;
+    unsigned negative_x = out_width - positive_x;
 
-    for (unsigned z = 0; z < out_height; z++)
-    {
-        for (unsigned x = 0; x < out_width; x++)
+    thread_pool->parallel_for(out_height, [=](unsigned begin, unsigned end) {
+        for (unsigned z = begin; z < end; z++)
         {
-            int alias_x = alias(x, out_width);
             int alias_z = alias(z, out_height);
-
-            if (alias_x < 0)
-            {
-                alias_x += Nx;
-            }
-
             if (alias_z < 0)
             {
                 alias_z += Nz;
             }
 
-            out[z * out_width + x] = in[alias_z * Nx + alias_x];
+            const cfloat *in_row = in + alias_z * Nx;
+            cfloat *out_row = out + z * out_width;
+            copy(in_row, in_row + positive_x, out_row);
+            copy(in_row + Nx - negative_x, in_row + Nx, out_row + positive_x);
         }
+    }, 16);
+}
+
+void FFTWater::generate_distributions()
+{
+    distribution.resize(Nx * Nz);
+    distribution_normal.resize(Nx * Nz);
+    distribution_displacement.resize((Nx * Nz) >> (displacement_downsample * 2));
+
+    spectrum->generate(distribution.data());
+    spectrum_normal->generate(distribution_normal.data());
+    downsample_distribution(distribution_displacement.data(), distribution.data(), displacement_downsample);
+}
+
+void FFTWater::upload_distributions()
+{
+    distribution_buffer.init(distribution.data(), Nx * Nz * sizeof(cfloat), GL_STATIC_COPY);
+    distribution_buffer_displacement.init(distribution_displacement.data(),
+            (Nx * Nz * sizeof(cfloat)) >> (displacement_downsample * 2),
+            GL_STATIC_COPY);
+    distribution_buffer_normal.init(distribution_normal.data(), Nx * Nz * sizeof(cfloat), GL_STATIC_COPY);
+
+    release_distributions();
+}
+
+void FFTWater::release_distributions()
+{
+    // The CPU copies are regenerated on demand.
+    distribution.clear();
+    distribution.shrink_to_fit();
+    distribution_displacement.clear();
+    distribution_displacement.shrink_to_fit();
+    distribution_normal.clear();
+    distribution_normal.shrink_to_fit();
+}
+
+void FFTWater::set_wind_velocity(vec2 wind_velocity)
+{
+    this->wind_velocity = wind_velocity;
+    wind_dir = vec_normalize(wind_velocity);
+    L = vec_dot(wind_velocity, wind_velocity) / G;
+
+    spectrum->set_wind(wind_dir, L);
+    spectrum_normal->set_wind(wind_dir, L);
+    generate_distributions();
+    upload_distributions();
+}
+
+void FFTWater::set_amplitude(float amplitude)
+{
+    // Normalize amplitude a bit based on the heightmap size.
+    amplitude *= 0.3f / sqrt(size.x * size.y);
+
+    spectrum->set_amplitude(amplitude);
+    spectrum_normal->set_amplitude(amplitude * sqrt(normalmap_freq_mod.x * normalmap_freq_mod.y));
+
+    // Before init_gl_fft() there are no buffers yet, the constructor uploads once everything is set up.
+    if (distribution_buffer.get())
+    {
+        generate_distributions();
+        upload_distributions();
     }
 }
 
-cfloat FFTWater::phillips(vec2 k, float max_l)
+unique_ptr<CPUWater> FFTWater::create_cpu_water(unsigned ring_size)
+{
+    // The CPU copies of the distributions are dropped after upload, so regenerate them.
+    generate_distributions();
+    unique_ptr<CPUWater> cpu_water(new CPUWater(Nx, Nz, displacement_downsample,
+                distribution, distribution_displacement, distribution_normal,
+                vec2(2.0f * M_PI) / size, vec2(2.0f * M_PI) / size_normal,
+                ring_size, thread_pool));
+
+    release_distributions();
+    return cpu_water;
+}
+
+bool FFTWater::validate_cpu_water(float time, unsigned bench_frames)
 {
-    // See Tessendorf paper for details.
-    float k_len = vec_length(k);
-    if (k_len == 0.0f)
+    // Check the CPU transforms against a naive DFT first, so a heightmap mismatch can be told apart from an FFT bug.
+    // All three run in FP32, the naive DFT in double.
+    const double fft_tolerance = 1e-5;
+    struct Transform
     {
-        return 0.0f;
+        unsigned Nx, Nz;
+        Type type;
+        const char *name;
+    };
+    const Transform transforms[] = {
+        { Nx, Nz, ComplexToReal, "height" },
+        { Nx >> displacement_downsample, Nz >> displacement_downsample, ComplexToComplex, "displacement" },
+        { Nx, Nz, ComplexToComplex, "normal" },
+    };
+
+    bool valid = true;
+    for (auto &transform : transforms)
+    {
+        double error = CPUFFT::validate(transform.Nx, transform.Nz, transform.type, Inverse, thread_pool);
+        if (error > fft_tolerance)
+        {
+            LOGE("CPU %s FFT %ux%u differs from a naive DFT by %.3g, tolerance is %.3g.",
+                    transform.name, transform.Nx, transform.Nz, error, fft_tolerance);
+            valid = false;
+        }
+        else
+        {
+            LOGI("CPU %s FFT %ux%u matches a naive DFT within %.3g.", transform.name, transform.Nx, transform.Nz, error);
+        }
     }
 
-    float kL = k_len * L;
-    vec2 k_dir = vec_normalize(k);
-    float kw = vec_dot(k_dir, wind_dir);
+    // The GPU FFTs run in FP16, which only has about three significant decimal digits.
+    const float height_tolerance = FFT_FP16 ? 1e-2f : 1e-4f;
+
+    unique_ptr<CPUWater> cpu_water = create_cpu_water(1);
+    cpu_water->bench(bench_frames, 1.0f / 60.0f);
 
-    return
-        pow(kw * kw, 1.0f) *                        // Directional
-        exp(-1.0 * k_len * k_len * max_l * max_l) * // Suppress small waves at ~max_l.
-        exp(-1.0f / (kL * kL)) *
-        pow(k_len, -4.0f);
+    update_phase(time);
+    compute_ifft();
+    vector<float> gpu_height = read_heightmap();
+    const float *cpu_height = cpu_water->compute_frame(time).height;
+
+    // Compare relative to the highest wave, heights close to zero have no meaningful relative error.
+    float max_error = 0.0f;
+    float max_height = 0.0f;
+    for (unsigned i = 0; i < Nx * Nz; i++)
+    {
+        max_error = max(max_error, fabs(gpu_height[i] - cpu_height[i]));
+        max_height = max(max_height, fabs(cpu_height[i]));
+    }
+
+    float error = max_height > 0.0f ? max_error / max_height : max_error;
+    if (error > height_tolerance)
+    {
+        LOGE("CPU water heightmap differs from GPU by %.3g of the peak height, tolerance is %.3g.",
+                error, height_tolerance);
+        return false;
+    }
+
+    LOGI("CPU water heightmap matches GPU within %.3g of the peak height.", error);
+    return valid;
 }
 
-void FFTWater::generate_distribution(cfloat *distribution, vec2 size, float amplitude, float max_l)
+vector<float> FFTWater::read_heightmap()
 {
-    // Modifier to find spatial frequency.
-    vec2 mod = vec2(2.0f * M_PI) / size;
+    Program prog_read_height(common_compile_compute_shader_from_file("read_height.comp"));
+    Buffer heights;
+    heights.init(nullptr, Nx * Nz * sizeof(float), GL_STREAM_READ);
 
-    for (unsigned z = 0; z < Nz; z++)
-    {
-        for (unsigned x = 0; x < Nx; x++)
-        {
-            auto &v = distribution[z * Nx + x];
-            vec2 k = mod * vec2(alias(x, Nx), alias(z, Nz));
+    GL_CHECK(glUseProgram(prog_read_height.get()));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, heightmap[texture_index].get()));
+    GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, heights.get()));
+    GL_CHECK(glUniform1ui(0, Nx));
+    GL_CHECK(glDispatchCompute(Nx / 8, Nz / 8, 1));
+    GL_CHECK(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
 
-            // Gaussian distributed noise with unit variance.
-            cfloat dist = cfloat(normal_dist(engine), normal_dist(engine));
-            v = dist * amplitude * sqrt(0.5f * phillips(k, max_l));
-        }
+    vector<float> result(Nx * Nz);
+    GL_CHECK(glBindBuffer(GL_SHADER_STORAGE_BUFFER, heights.get()));
+    GL_CHECK(const float *ptr = static_cast<const float*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
+                    0, Nx * Nz * sizeof(float), GL_MAP_READ_BIT)));
+    if (ptr)
+    {
+        copy(ptr, ptr + Nx * Nz, result.begin());
+        GL_CHECK(glUnmapBuffer(GL_SHADER_STORAGE_BUFFER));
     }
+
+    return result;
 }
 
 void FFTWater::update_phase(float time)
@@ -303,7 +432,9 @@ void FFTWater::init_gl_fft()
     prog_mipmap_normal = Program(common_compile_compute_shader_from_file("mipmap_normal.comp"));
     prog_mipmap_gradient_jacobian = Program(common_compile_compute_shader_from_file("mipmap_gradjacobian.comp"));
 
+    // Keep compiled FFT programs between runs so warm starts skip shader compilation.
     auto cache = make_shared<ProgramCache>();
+    cache->set_binary_store(make_shared<FileProgramBinaryStore>(common_get_path("glfft_program_")));
 
     // Use FP16 FFT.
     FFTOptions options;
@@ -317,13 +448,39 @@ void FFTWater::init_gl_fft()
     options.performance.vector_size = 4;
     options.performance.shared_banked = false;
 
+    // Reuse tuned parameters from earlier runs on this device if we have them.
+    // Passes missing from the wisdom fall back to the defaults above.
+    FFTWisdom wisdom;
+    const char *renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    string wisdom_path = common_get_path("glfft_wisdom.bin");
+    if (wisdom.load(wisdom_path.c_str(), renderer))
+    {
+        LOGI("Loaded %u FFT wisdom entries for %s.", unsigned(wisdom.size()), renderer);
+    }
+
+#if FFT_LEARN_WISDOM
+    size_t known_passes = wisdom.size();
+    wisdom.set_static_wisdom(FFTWisdom::get_static_wisdom_from_renderer(renderer));
+    wisdom.learn_optimal_options_exhaustive(Nx, Nz,
+            ComplexToReal, SSBO, ImageReal, options.type);
+    wisdom.learn_optimal_options_exhaustive(Nx >> displacement_downsample, Nz >> displacement_downsample,
+            ComplexToComplex, SSBO, Image, options.type);
+    wisdom.learn_optimal_options_exhaustive(Nx, Nz,
+            ComplexToComplex, SSBO, Image, options.type);
+
+    if (wisdom.size() != known_passes)
+    {
+        wisdom.save(wisdom_path.c_str(), renderer);
+    }
+#endif
+
     // Create three FFTs for heightmap, displacementmap and high-frequency normals.
     fft_height = unique_ptr<FFT>(new FFT(Nx, Nz,
-                ComplexToReal, Inverse, SSBO, ImageReal, cache, options));
+                ComplexToReal, Inverse, SSBO, ImageReal, cache, options, wisdom));
     fft_displacement = unique_ptr<FFT>(new FFT(Nx >> displacement_downsample, Nz >> displacement_downsample,
-                ComplexToComplex, Inverse, SSBO, Image, cache, options));
+                ComplexToComplex, Inverse, SSBO, Image, cache, options, wisdom));
     fft_normal = unique_ptr<FFT>(new FFT(Nx, Nz,
-                ComplexToComplex, Inverse, SSBO, Image, move(cache), options));
+                ComplexToComplex, Inverse, SSBO, Image, move(cache), options, wisdom));
 
     normal_levels = unsigned(log2(max(float(Nx), float(Nz)))) + 1;
 
@@ -358,15 +515,7 @@ void FFTWater::init_gl_fft()
                 GL_LINEAR_MIPMAP_LINEAR);
     }
 
-    distribution_buffer.init(distribution.data(), Nx * Nz * sizeof(cfloat), GL_STATIC_COPY);
-    distribution_buffer_displacement.init(distribution_displacement.data(),
-            (Nx * Nz * sizeof(cfloat)) >> (displacement_downsample * 2),
-            GL_STATIC_COPY);
-    distribution_buffer_normal.init(distribution_normal.data(), Nx * Nz * sizeof(cfloat), GL_STATIC_COPY);
-
-    distribution.clear();
-    distribution_displacement.clear();
-    distribution_normal.clear();
+    upload_distributions();
 
     // Copy distributions to the GPU.
     freq_height.init(nullptr, (Nx * Nz * sizeof(cfloat)) >> FFT_FP16, GL_STREAM_COPY);
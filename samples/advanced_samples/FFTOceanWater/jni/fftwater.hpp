@@ -27,22 +27,28 @@
 #include <vector>
 #include <memory>
 #include "glfft.hpp"
+#include "glfft_thread_pool.hpp"
+#include "spectrum.hpp"
+#include "water_cpu.hpp"
 #include "common.hpp"
 
-using cfloat = std::complex<float>;
-
 class FFTWater
 {
     private:
-        cfloat phillips(vec2 k, float max_l);
-
         vec2 wind_velocity;
         vec2 wind_dir;
         unsigned Nx, Nz;
         vec2 size, size_normal;
+        vec2 normalmap_freq_mod;
         float L;
 
-        void generate_distribution(cfloat *distribution, vec2 size, float amplitude, float max_l);
+        std::shared_ptr<GLFFT::ThreadPool> thread_pool;
+        std::unique_ptr<PhillipsSpectrum> spectrum;
+        std::unique_ptr<PhillipsSpectrum> spectrum_normal;
+
+        void generate_distributions();
+        void upload_distributions();
+        void release_distributions();
 
         void generate_mipmaps();
         void compute_ifft();
@@ -87,6 +93,7 @@ class FFTWater
         std::unique_ptr<GLFFT::FFT> fft_displacement;
         std::unique_ptr<GLFFT::FFT> fft_normal;
         void init_gl_fft();
+        std::vector<float> read_heightmap();
         void downsample_distribution(cfloat *out, const cfloat *in, unsigned rate_log2);
         void compute_mipmap(const GLFFT::Program &program, const GLFFT::Texture &texture, GLenum format, unsigned Nx, unsigned Nz, unsigned level);
         void init_texture(GLFFT::Texture &tex, GLenum format, unsigned levels, unsigned width, unsigned height, GLenum mag_filter, GLenum min_filter);
@@ -103,10 +110,25 @@ class FFTWater
 
         void update(float time);
 
+        // Regenerate the initial spectrum. Only the terms affected by the change are re-evaluated.
+        void set_wind_velocity(vec2 wind_velocity);
+        void set_amplitude(float amplitude);
+
+        // Creates a CPU version of update() for the current spectrum, e.g. to precompute or validate frames.
+        std::unique_ptr<CPUWater> create_cpu_water(unsigned ring_size);
+
+        // Checks the CPU FFTs against a naive DFT, benchmarks the CPU water and checks its heightmap
+        // for one frame against the GPU path.
+        // Logs the results, returns false if any FFT is off or the heights differ by more than the FP16 FFTs account for.
+        bool validate_cpu_water(float time, unsigned bench_frames);
+
         GLuint get_height_displacement() const { return heightdisplacementmap[texture_index].get(); }
         GLuint get_gradient_jacobian() const  { return gradientjacobianmap[texture_index].get(); }
         GLuint get_normal() const { return normalmap[texture_index].get(); }
         unsigned get_displacement_downsample() const { return displacement_downsample; }
+
+        // Worker threads of the CPU code paths, which other per-frame CPU work can share.
+        GLFFT::ThreadPool &get_thread_pool() { return *thread_pool; }
 };
 
 #endif
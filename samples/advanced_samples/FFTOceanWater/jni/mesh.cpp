@@ -21,6 +21,7 @@
 #include "common.hpp"
 #include "vector_math.h"
 #include "mesh.hpp"
+#include "MeshOptimizer.h"
 #include <limits.h>
 
 #include <vector>
@@ -29,6 +30,15 @@
 
 using namespace std;
 
+// Order of the triangles in the index buffer of every LOD, see MaliSDK::IndexOrder.
+// The ACMR before and after is logged for every LOD at start-up.
+static const IndexOrder index_order = IndexOrderBandedStrips;
+
+// Size of the FIFO post-transform vertex cache used to choose the band width and for the ACMR report.
+static const unsigned vertex_cache_size = MeshOptimizer::defaultCacheSize;
+
+static const GLenum index_primitive = index_order == IndexOrderForsyth ? GL_TRIANGLES : GL_TRIANGLE_STRIP;
+
 constexpr float TessellatedMesh::patch_size;
 constexpr float TessellatedMesh::lod0_distance; 
 constexpr unsigned TessellatedMesh::blocks_x;
@@ -41,14 +51,6 @@ constexpr float MorphedGeoMipMapMesh::lod0_distance;
 constexpr unsigned MorphedGeoMipMapMesh::blocks_x;
 constexpr unsigned MorphedGeoMipMapMesh::blocks_z;
 
-bool BoundingSphere::test_frustum(const vec4 *frustum) const
-{
-    for (unsigned i = 0; i < 6; i++)
-        if (vec_dot(center, frustum[i]) < -radius)
-            return false;
-    return true;
-}
-
 Mesh::Mesh(const char *vs_shader, const char *fs_shader)
 {
     prog = common_compile_shader_from_file(vs_shader, fs_shader);
@@ -131,6 +133,35 @@ static void generate_block_indices(vector<GLushort> &ibo, int vertex_buffer_offs
     }
 }
 
+// Appends the indices of a size-by-size grid, reordered for the vertex cache as selected with index_order.
+static void generate_optimized_block_indices(vector<GLushort> &ibo, int vertex_buffer_offset, int size, unsigned lod)
+{
+    vector<GLushort> rows;
+    generate_block_indices(rows, vertex_buffer_offset, size, size, size);
+
+    vector<GLushort> optimized;
+    if (index_order == IndexOrderBandedStrips)
+    {
+        unsigned band_width = MeshOptimizer::findGridBandWidth(size, size, false, vertex_cache_size);
+        MeshOptimizer::generateGridStrips(size, size, size, vertex_buffer_offset, band_width, false, optimized);
+    }
+    else if (index_order == IndexOrderForsyth)
+    {
+        MeshOptimizer::convertStripToList(rows.data(), rows.size(), optimized);
+        MeshOptimizer::optimizeVertexCache(optimized);
+    }
+    else
+        optimized = rows;
+
+    char name[32];
+    snprintf(name, sizeof(name), "Ocean LOD %u", lod);
+    MeshOptimizer::logReport(name,
+            MeshOptimizer::simulateVertexCache(rows.data(), rows.size(), true, vertex_cache_size),
+            MeshOptimizer::simulateVertexCache(optimized.data(), optimized.size(), index_primitive == GL_TRIANGLE_STRIP, vertex_cache_size));
+
+    ibo.insert(ibo.end(), optimized.begin(), optimized.end());
+}
+
 void Mesh::bind_textures(const RenderInfo &info)
 {
     GL_CHECK(glActiveTexture(GL_TEXTURE0 + 0));
@@ -143,18 +174,12 @@ void Mesh::bind_textures(const RenderInfo &info)
     GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, info.skydome));
 }
 
-MorphedGeoMipMapMesh::MorphedGeoMipMapMesh()
-    : Mesh("water.vs", "water.fs")
+MorphedGeoMipMapMesh::MorphedGeoMipMapMesh(MaliSDK::ThreadPool *thread_pool)
+    : Mesh("water.vs", "water.fs"), lod_selector(blocks_x, blocks_z, thread_pool)
 {
     init();
 }
 
-static inline float lod_factor(float max_lod, float distance_mod, vec3 dist)
-{
-    float level = log2((vec_length(dist) + 0.0001f) * distance_mod);
-    return clamp(level, 0.0f, max_lod);
-}
-
 void MorphedGeoMipMapMesh::calculate_lods(const RenderInfo &info)
 {
     vec2 patch_size_mod = vec2(patch_size) * info.tile_extent / vec2(info.fft_size);
@@ -164,47 +189,39 @@ void MorphedGeoMipMapMesh::calculate_lods(const RenderInfo &info)
     block_off -= ivec2(blocks_x >> 1, blocks_z >> 1);
     vec2 block_offset = vec2(patch_size) * vec2(block_off);
 
-    float distance_mod = 1.0f / ((info.vp_width / 1920.0f) * lod0_distance);
-    vec3 cam_pos = info.cam_pos;
+    const vec2 half_block = scale * vec2(0.5f * patch_size);
 
-    // Compute LOD and visibility.
-    for (auto &patch : patches)
-    {
-        const vec2 half_block = scale * vec2(0.5f * patch_size);
+    PatchLODSelector::Parameters params;
+    params.cam_pos = info.cam_pos;
+    params.origin = scale * block_offset + half_block;
+    params.spacing = scale * vec2(patch_size);
+    params.distance_mod = 1.0f / ((info.vp_width / 1920.0f) * lod0_distance);
+    params.max_lod = lods - 1.0f;
+    params.radius = vec_length(vec3(10.0f + half_block.x, 20.0f, 10.0f + half_block.y));
 
-        vec2 newpos = scale * (patch.pos + block_offset) + half_block;
-        vec3 dist = cam_pos - vec3(newpos.x, 0.0f, newpos.y);
-        patch.lod = lod_factor(lods - 1.0f, distance_mod, dist);
+    culler.setPlanes(value_ptr(info.frustum[0]));
+    params.culler = &culler;
 
-        BoundingSphere bs(vec3(newpos.x, 0.0f, newpos.y), vec3(10.0f + half_block.x, 20.0f, 10.0f + half_block.y));
-        patch.visible = bs.test_frustum(info.frustum);
-    }
-
-    for (unsigned z = 0; z < blocks_z; z++)
-    {
-        for (unsigned x = 0; x < blocks_x; x++)
-        {
-            float lod = patches[z * blocks_x + x].lod;
-            lod_buffer[z * blocks_x + x] = lod;
-        }
-    }
-
-    // Upload the LOD texture to a PBO first.
+    // Compute LODs and visibility, and write the quantized LOD texture straight to the PBO.
     GL_CHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo));
-    GL_CHECK(void *ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, blocks_x * blocks_z, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    GL_CHECK(uint8_t *ptr = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, blocks_x * blocks_z,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)));
     if (ptr)
     {
-        // Quantize the LOD to a R8_UNORM value as well.
-        transform(begin(lod_buffer), end(lod_buffer), static_cast<uint8_t*>(ptr), [](float v) -> GLubyte {
-            return clamp(GLubyte(round(v * 32.0f)), GLubyte(0), GLubyte(255));
-        });
-
+        lod_selector.select(params, lod_buffer.data(), ptr, patch_visible.data());
         GL_CHECK(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
 
         GL_CHECK(glBindTexture(GL_TEXTURE_2D, lod_tex));
         GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
                 blocks_x, blocks_z, GL_RED, GL_UNSIGNED_BYTE, nullptr));
     }
+    else
+    {
+        // Instancing still needs the LODs, only the LOD texture is left as is.
+        LOGE("Failed to map buffer!");
+        vector<uint8_t> quantized_lods(blocks_x * blocks_z);
+        lod_selector.select(params, lod_buffer.data(), quantized_lods.data(), patch_visible.data());
+    }
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
     GL_CHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
 
@@ -222,12 +239,12 @@ void MorphedGeoMipMapMesh::calculate_lods(const RenderInfo &info)
         return;
     }
 
-    // Fill in instancing info for all patches.
+    // Fill in instancing info for all visible patches.
     for (unsigned z = 0; z < blocks_z; z++)
     {
         for (unsigned x = 0; x < blocks_x; x++)
         {
-            if (!patches[z * blocks_x + x].visible)
+            if (!patch_visible[z * blocks_x + x])
                 continue;
 
             // Clamp-to-edge.
@@ -254,9 +271,10 @@ void MorphedGeoMipMapMesh::calculate_lods(const RenderInfo &info)
 
             unsigned ubo_offset = center_lod * blocks_x * blocks_z;
 
+            vec2 pos = vec2(ivec2(x, z) * ivec2(patch_size));
             ubo_data[ubo_offset + lod.full.instances].Offsets = vec4(
-                    patches[z * blocks_x + x].pos + block_offset, // Offset to world space.
-                    patches[z * blocks_x + x].pos);
+                    pos + block_offset, // Offset to world space.
+                    pos);
             ubo_data[ubo_offset + lod.full.instances].LODs = vec4(left_lod, top_lod, right_lod, bottom_lod);
             ubo_data[ubo_offset + lod.full.instances].InnerLOD = vec4(center);
 
@@ -274,7 +292,7 @@ void MorphedGeoMipMapMesh::LODMesh::draw(GLuint ubo, unsigned ubo_offset)
     {
         unsigned to_draw = min(instances - i, max_instances);
         GL_CHECK(glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, i * sizeof(PatchData) + ubo_offset, max_instances * sizeof(PatchData)));
-        GL_CHECK(glDrawElementsInstanced(GL_TRIANGLE_STRIP, elems, GL_UNSIGNED_SHORT,
+        GL_CHECK(glDrawElementsInstanced(index_primitive, elems, GL_UNSIGNED_SHORT,
                 reinterpret_cast<const GLvoid*>(uintptr_t(offset * sizeof(GLushort))),
                 to_draw));
     }
@@ -329,8 +347,8 @@ void MorphedGeoMipMapMesh::build_lod(unsigned lod)
             vertices.emplace_back(x * mod, y * mod);
 
     lodmesh.full.offset = indices.size();
-    // Stamp out a tight strip representation of the mesh.
-    generate_block_indices(indices, lodmesh.full_vbo, size_1, size_1, size_1);
+    // Stamp out a tight strip representation of the mesh, reordered for the vertex cache.
+    generate_optimized_block_indices(indices, lodmesh.full_vbo, size_1, lod);
     lodmesh.full.elems = indices.size() - lodmesh.full.offset;
 
     for (unsigned i = lodmesh.full_vbo; i < vertices.size(); i++)
@@ -360,13 +378,6 @@ void MorphedGeoMipMapMesh::build_lod(unsigned lod)
     lod_meshes.push_back(move(lodmesh));
 }
 
-void MorphedGeoMipMapMesh::build_patches()
-{
-    for (unsigned z = 0; z < blocks_z; z++)
-        for (unsigned x = 0; x < blocks_x; x++)
-            patches.push_back({ vec2(ivec2(x, z) * ivec2(patch_size)), 0.0f, false });
-}
-
 void MorphedGeoMipMapMesh::init_lod_tex()
 {
     GL_CHECK(glGenTextures(1, &lod_tex));
@@ -379,6 +390,7 @@ void MorphedGeoMipMapMesh::init_lod_tex()
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
 
     lod_buffer.resize(blocks_x * blocks_z);
+    patch_visible.resize(blocks_x * blocks_z);
 }
 
 MorphedGeoMipMapMesh::~MorphedGeoMipMapMesh()
@@ -394,9 +406,6 @@ void MorphedGeoMipMapMesh::init()
     for (unsigned i = 0; i < lods; i++)
         build_lod(i);
 
-    // Initalize patch data.
-    build_patches();
-
     // Create LOD texture.
     init_lod_tex();
 
@@ -23,6 +23,7 @@
 
 #include "common.hpp"
 #include "vector_math.h"
+#include "patch_lod.hpp"
 #include <vector>
 
 class Mesh
@@ -85,7 +86,8 @@ class Mesh
 class MorphedGeoMipMapMesh : public Mesh
 {
     public:
-        MorphedGeoMipMapMesh();
+        // thread_pool is used for patch LOD selection of large grids. It is not owned, and only used in render().
+        explicit MorphedGeoMipMapMesh(MaliSDK::ThreadPool *thread_pool = nullptr);
         ~MorphedGeoMipMapMesh();
 
         MorphedGeoMipMapMesh(MorphedGeoMipMapMesh&&) = delete;
@@ -95,7 +97,6 @@ class MorphedGeoMipMapMesh : public Mesh
 
     private:
         void build_lod(unsigned lod);
-        void build_patches();
         void init_lod_tex();
         void init();
 
@@ -136,15 +137,12 @@ class MorphedGeoMipMapMesh : public Mesh
             LODMesh full;
         };
 
-        struct Patch
-        {
-            vec2 pos;
-            float lod;
-            bool visible;
-        };
-
         std::vector<LOD> lod_meshes;
-        std::vector<Patch> patches;
+
+        // LOD and frustum visibility of all patches, computed in one pass every frame.
+        MaliSDK::FrustumCuller culler;
+        PatchLODSelector lod_selector;
+        std::vector<uint8_t> patch_visible;
         GLuint ubo;
         GLuint pbo;
 
@@ -193,20 +191,5 @@ class TessellatedMesh : public Mesh
         static constexpr unsigned blocks_z = 64;
 };
 
-// Simple bounding sphere implementation for MorphedGeoMipMapMesh.
-struct BoundingSphere
-{
-    BoundingSphere(vec3 center, vec3 radius)
-    {
-        this->center = vec4(center, 1.0f);
-        this->radius = vec_length(radius);
-    }
-
-    bool test_frustum(const vec4 *frustum) const;
-
-    vec4 center;
-    float radius;
-};
-
 #endif
 
@@ -54,6 +54,12 @@ using namespace GLFFT;
 #define WIND_SPEED_X +26.0f
 #define WIND_SPEED_Z -22.0f
 
+// Set to 1 to log how patch LOD selection scales with the size of the patch grid at startup.
+#define PATCH_LOD_BENCHMARK 0
+
+// Set to 1 to benchmark the CPU water and compare its heightmap against the GPU FFTs at startup.
+#define CPU_WATER_BENCHMARK 0
+
 static FFTWater *water;
 static Scattering *scatter;
 static Mesh *mesh[2];
@@ -147,13 +153,24 @@ static void app_init()
 {
     init_vao();
 
-    mesh[0] = new MorphedGeoMipMapMesh;
+    water = new FFTWater(AMPLITUDE, vec2(WIND_SPEED_X, WIND_SPEED_Z), uvec2(SIZE_X, SIZE_Z), vec2(DIST_X, DIST_Z), vec2(NORMALMAP_FREQ_MOD));
+
+    // Patch LOD selection runs on the same worker threads as the CPU side of the water.
+    MaliSDK::ThreadPool *thread_pool = &water->get_thread_pool().get_pool();
+
+#if PATCH_LOD_BENCHMARK
+    PatchLODSelector::bench(512, 100, thread_pool);
+#endif
+
+#if CPU_WATER_BENCHMARK
+    water->validate_cpu_water(1.0f, 100);
+#endif
+
+    mesh[0] = new MorphedGeoMipMapMesh(thread_pool);
     if (common_has_extension("GL_EXT_tessellation_shader"))
     {
         mesh[1] = new TessellatedMesh;
     }
-
-    water = new FFTWater(AMPLITUDE, vec2(WIND_SPEED_X, WIND_SPEED_Z), uvec2(SIZE_X, SIZE_Z), vec2(DIST_X, DIST_Z), vec2(NORMALMAP_FREQ_MOD));
     prog_quad = common_compile_shader_from_file("quad.vs", "quad.fs");
     prog_skydome = common_compile_shader_from_file("skydome.vs", "skydome.fs");
 
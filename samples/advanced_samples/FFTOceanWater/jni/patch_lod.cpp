@@ -0,0 +1,343 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "patch_lod.hpp"
+#include "common.hpp"
+#include "Timer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PATCH_LOD_USE_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PATCH_LOD_USE_SSE
+#endif
+
+using namespace std;
+
+// Grids with at least this many patches are split over worker threads.
+// Smaller grids are done before the threads would even wake up.
+#define PATCH_LOD_PARALLEL_PATCHES (128 * 128)
+
+// Rows per work item for threaded selection.
+#define PATCH_LOD_ROWS_PER_CHUNK 16
+
+// Offset which keeps log2() finite for a camera right on top of a patch center.
+#define PATCH_LOD_DISTANCE_BIAS 0.0001f
+
+// LOD steps per unit in the R8_UNORM LOD texture.
+#define PATCH_LOD_QUANTIZE_SCALE 32.0f
+
+static inline float patch_lod(float distance, float distance_mod, float max_lod)
+{
+    float level = log2((distance + PATCH_LOD_DISTANCE_BIAS) * distance_mod);
+    return clamp(level, 0.0f, max_lod);
+}
+
+static inline uint8_t quantize_lod(float lod)
+{
+    return uint8_t(clamp(round(lod * PATCH_LOD_QUANTIZE_SCALE), 0.0f, 255.0f));
+}
+
+#if defined(PATCH_LOD_USE_NEON) || defined(PATCH_LOD_USE_SSE)
+// log(1 + x) for x in [sqrt(0.5) - 1, sqrt(2) - 1], from Cephes logf.
+static const float log_coeffs[] = {
+    7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+    -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+    2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f,
+};
+#define PATCH_LOD_LOG2E 1.44269504088896341f
+#define PATCH_LOD_SQRT2 1.41421356237309505f
+#endif
+
+#if defined(PATCH_LOD_USE_NEON)
+static inline float32x4_t log2_f32(float32x4_t x)
+{
+    // Split x into exponent and a mantissa in [1, 2).
+    uint32x4_t bits = vreinterpretq_u32_f32(x);
+    int32x4_t exponent = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127));
+    float32x4_t mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+
+    // Center the mantissa around 1, where the polynomial is accurate.
+    uint32x4_t large = vcgtq_f32(mantissa, vdupq_n_f32(PATCH_LOD_SQRT2));
+    mantissa = vbslq_f32(large, vmulq_n_f32(mantissa, 0.5f), mantissa);
+    float32x4_t e = vaddq_f32(vcvtq_f32_s32(exponent), vreinterpretq_f32_u32(vandq_u32(large, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+
+    float32x4_t f = vsubq_f32(mantissa, vdupq_n_f32(1.0f));
+    float32x4_t z = vmulq_f32(f, f);
+    float32x4_t y = vdupq_n_f32(log_coeffs[0]);
+    for (unsigned i = 1; i < sizeof(log_coeffs) / sizeof(log_coeffs[0]); i++)
+    {
+        y = vmlaq_f32(vdupq_n_f32(log_coeffs[i]), y, f);
+    }
+    y = vmulq_f32(vmulq_f32(y, f), z);
+    y = vmlsq_f32(y, z, vdupq_n_f32(0.5f));
+    float32x4_t ln = vaddq_f32(f, y);
+
+    return vmlaq_f32(e, ln, vdupq_n_f32(PATCH_LOD_LOG2E));
+}
+
+static inline float32x4_t sqrt_f32(float32x4_t x)
+{
+#if defined(__aarch64__)
+    return vsqrtq_f32(x);
+#else
+    // ARMv7 has no vector square root. Refine the reciprocal square root estimate twice.
+    x = vmaxq_f32(x, vdupq_n_f32(1e-20f));
+    float32x4_t r = vrsqrteq_f32(x);
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(x, r), r));
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(x, r), r));
+    return vmulq_f32(x, r);
+#endif
+}
+
+// Narrows four small integers to bytes and stores them unaligned.
+static inline void store_u8x4(uint8_t *dst, uint32x4_t v)
+{
+    uint16x4_t narrow = vmovn_u32(v);
+    uint8x8_t bytes = vmovn_u16(vcombine_u16(narrow, narrow));
+    uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+    memcpy(dst, &packed, sizeof(packed));
+}
+#elif defined(PATCH_LOD_USE_SSE)
+static inline __m128 log2_ps(__m128 x)
+{
+    // Split x into exponent and a mantissa in [1, 2).
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+    // Center the mantissa around 1, where the polynomial is accurate.
+    __m128 large = _mm_cmpgt_ps(mantissa, _mm_set1_ps(PATCH_LOD_SQRT2));
+    mantissa = _mm_sub_ps(mantissa, _mm_and_ps(large, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))));
+    __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_and_ps(large, _mm_set1_ps(1.0f)));
+
+    __m128 f = _mm_sub_ps(mantissa, _mm_set1_ps(1.0f));
+    __m128 z = _mm_mul_ps(f, f);
+    __m128 y = _mm_set1_ps(log_coeffs[0]);
+    for (unsigned i = 1; i < sizeof(log_coeffs) / sizeof(log_coeffs[0]); i++)
+    {
+        y = _mm_add_ps(_mm_mul_ps(y, f), _mm_set1_ps(log_coeffs[i]));
+    }
+    y = _mm_mul_ps(_mm_mul_ps(y, f), z);
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    __m128 ln = _mm_add_ps(f, y);
+
+    return _mm_add_ps(e, _mm_mul_ps(ln, _mm_set1_ps(PATCH_LOD_LOG2E)));
+}
+
+// Narrows four small integers to bytes and stores them unaligned.
+static inline void store_u8x4(uint8_t *dst, __m128i v)
+{
+    __m128i words = _mm_packs_epi32(v, v);
+    __m128i bytes = _mm_packus_epi16(words, words);
+    int packed = _mm_cvtsi128_si32(bytes);
+    memcpy(dst, &packed, sizeof(packed));
+}
+#endif
+
+PatchLODSelector::PatchLODSelector(unsigned blocks_x, unsigned blocks_z, MaliSDK::ThreadPool *thread_pool)
+    : blocks_x(blocks_x), blocks_z(blocks_z),
+      thread_pool(blocks_x * blocks_z >= PATCH_LOD_PARALLEL_PATCHES ? thread_pool : nullptr)
+{
+}
+
+void PatchLODSelector::select_rows(const Parameters &params, unsigned begin, unsigned end,
+        float *lods, uint8_t *quantized_lods, uint8_t *visible) const
+{
+    const vec3 cam_pos = params.cam_pos;
+
+    for (unsigned z = begin; z < end; z++)
+    {
+        // Everything along Z is constant for a row.
+        const float center_z = params.origin.y + z * params.spacing.y;
+        const float delta_z = cam_pos.z - center_z;
+        const float distance_yz = cam_pos.y * cam_pos.y + delta_z * delta_z;
+
+        float *row_lods = lods + z * blocks_x;
+        uint8_t *row_quantized = quantized_lods + z * blocks_x;
+        uint8_t *row_visible = visible + z * blocks_x;
+        unsigned x = 0;
+
+#if defined(PATCH_LOD_USE_NEON)
+        static const float lane_offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        float32x4_t center_x = vmlaq_n_f32(vdupq_n_f32(params.origin.x), vld1q_f32(lane_offsets), params.spacing.x);
+        const float32x4_t step_x = vdupq_n_f32(4.0f * params.spacing.x);
+
+        for (; x + 4 <= blocks_x; x += 4)
+        {
+            float32x4_t delta_x = vsubq_f32(vdupq_n_f32(cam_pos.x), center_x);
+            float32x4_t distance = sqrt_f32(vmlaq_f32(vdupq_n_f32(distance_yz), delta_x, delta_x));
+
+            float32x4_t level = log2_f32(vmulq_n_f32(vaddq_f32(distance, vdupq_n_f32(PATCH_LOD_DISTANCE_BIAS)), params.distance_mod));
+            level = vminq_f32(vmaxq_f32(level, vdupq_n_f32(0.0f)), vdupq_n_f32(params.max_lod));
+            vst1q_f32(row_lods + x, level);
+
+            // LODs are never negative, so adding 0.5 and truncating rounds like round().
+            uint32x4_t quantized = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), level, PATCH_LOD_QUANTIZE_SCALE));
+            store_u8x4(row_quantized + x, vminq_u32(quantized, vdupq_n_u32(255)));
+
+            center_x = vaddq_f32(center_x, step_x);
+        }
+#elif defined(PATCH_LOD_USE_SSE)
+        __m128 center_x = _mm_add_ps(_mm_set1_ps(params.origin.x),
+                _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(params.spacing.x)));
+        const __m128 step_x = _mm_set1_ps(4.0f * params.spacing.x);
+
+        for (; x + 4 <= blocks_x; x += 4)
+        {
+            __m128 delta_x = _mm_sub_ps(_mm_set1_ps(cam_pos.x), center_x);
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(delta_x, delta_x), _mm_set1_ps(distance_yz)));
+
+            __m128 level = log2_ps(_mm_mul_ps(_mm_add_ps(distance, _mm_set1_ps(PATCH_LOD_DISTANCE_BIAS)),
+                        _mm_set1_ps(params.distance_mod)));
+            level = _mm_min_ps(_mm_max_ps(level, _mm_setzero_ps()), _mm_set1_ps(params.max_lod));
+            _mm_storeu_ps(row_lods + x, level);
+
+            // LODs are never negative, so adding 0.5 and truncating rounds like round().
+            __m128 quantized = _mm_add_ps(_mm_mul_ps(level, _mm_set1_ps(PATCH_LOD_QUANTIZE_SCALE)), _mm_set1_ps(0.5f));
+            quantized = _mm_min_ps(quantized, _mm_set1_ps(255.0f));
+            store_u8x4(row_quantized + x, _mm_cvttps_epi32(quantized));
+
+            center_x = _mm_add_ps(center_x, step_x);
+        }
+#endif
+
+        for (; x < blocks_x; x++)
+        {
+            float center_x = params.origin.x + x * params.spacing.x;
+            float delta_x = cam_pos.x - center_x;
+            float level = patch_lod(sqrt(delta_x * delta_x + distance_yz), params.distance_mod, params.max_lod);
+            row_lods[x] = level;
+            row_quantized[x] = quantize_lod(level);
+        }
+
+        // Patch spheres are centered at y = 0. Test the row while it is still in the cache.
+        params.culler->cullSphereRow(params.origin.x, params.spacing.x, 0.0f, center_z, params.radius, blocks_x, row_visible);
+    }
+}
+
+void PatchLODSelector::select(const Parameters &params, float *lods, uint8_t *quantized_lods, uint8_t *visible)
+{
+    if (thread_pool)
+    {
+        thread_pool->parallelFor(blocks_z, [&](unsigned begin, unsigned end) {
+            select_rows(params, begin, end, lods, quantized_lods, visible);
+        }, PATCH_LOD_ROWS_PER_CHUNK);
+    }
+    else
+    {
+        select_rows(params, 0, blocks_z, lods, quantized_lods, visible);
+    }
+}
+
+void PatchLODSelector::select_reference(const Parameters &params, float *lods, uint8_t *quantized_lods, uint8_t *visible) const
+{
+    for (unsigned z = 0; z < blocks_z; z++)
+    {
+        for (unsigned x = 0; x < blocks_x; x++)
+        {
+            unsigned index = z * blocks_x + x;
+            vec3 center = vec3(params.origin.x + x * params.spacing.x, 0.0f, params.origin.y + z * params.spacing.y);
+
+            lods[index] = patch_lod(vec_length(params.cam_pos - center), params.distance_mod, params.max_lod);
+            quantized_lods[index] = quantize_lod(lods[index]);
+
+            visible[index] = 1;
+            for (unsigned i = 0; i < MaliSDK::FrustumCuller::NUMBER_OF_PLANES; i++)
+            {
+                const float *plane = params.culler->getPlane(i);
+                if (vec_dot(vec4(plane[0], plane[1], plane[2], plane[3]), vec4(center, 1.0f)) < -params.radius)
+                {
+                    visible[index] = 0;
+                }
+            }
+        }
+    }
+}
+
+void PatchLODSelector::bench(unsigned max_blocks, unsigned iterations, MaliSDK::ThreadPool *thread_pool)
+{
+    static const float frustum_planes[] = {
+        // A camera at the origin looking down -Z with a 90 degree field of view.
+        0.7071f, 0.0f, -0.7071f, 0.0f,
+        -0.7071f, 0.0f, -0.7071f, 0.0f,
+        0.0f, 0.7071f, -0.7071f, 0.0f,
+        0.0f, -0.7071f, -0.7071f, 0.0f,
+        0.0f, 0.0f, -1.0f, -1.0f,
+        0.0f, 0.0f, 1.0f, 2000.0f,
+    };
+    MaliSDK::FrustumCuller culler;
+    culler.setPlanes(frustum_planes);
+
+    MaliSDK::Timer timer;
+    for (unsigned blocks = 32; blocks <= max_blocks; blocks *= 2)
+    {
+        PatchLODSelector selector(blocks, blocks, thread_pool);
+
+        // Same layout as MorphedGeoMipMapMesh, a grid centered on the camera.
+        Parameters params;
+        params.cam_pos = vec3(0.0f, 10.0f, 0.0f);
+        params.spacing = vec2(50.0f);
+        params.origin = vec2(-0.5f * blocks * params.spacing.x);
+        params.distance_mod = 1.0f / 50.0f;
+        params.max_lod = 5.0f;
+        params.radius = 40.0f;
+        params.culler = &culler;
+
+        unsigned count = blocks * blocks;
+        vector<float> lods(count), reference_lods(count);
+        vector<uint8_t> quantized(count), reference_quantized(count);
+        vector<uint8_t> visible(count), reference_visible(count);
+
+        selector.select_reference(params, reference_lods.data(), reference_quantized.data(), reference_visible.data());
+        selector.select(params, lods.data(), quantized.data(), visible.data());
+
+        float max_error = 0.0f;
+        unsigned mismatches = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            max_error = max(max_error, fabs(lods[i] - reference_lods[i]));
+            mismatches += visible[i] != reference_visible[i];
+        }
+
+        float start = timer.getTime();
+        for (unsigned i = 0; i < iterations; i++)
+        {
+            selector.select_reference(params, reference_lods.data(), reference_quantized.data(), reference_visible.data());
+        }
+        float reference_time = (timer.getTime() - start) / iterations;
+
+        start = timer.getTime();
+        for (unsigned i = 0; i < iterations; i++)
+        {
+            selector.select(params, lods.data(), quantized.data(), visible.data());
+        }
+        float time = (timer.getTime() - start) / iterations;
+
+        LOGI("Patch LODs %ux%u: %.4f ms per frame (%.4f ms reference, %.1fx), max LOD error %g, %u visibility mismatches.\n",
+                blocks, blocks, 1000.0f * time, 1000.0f * reference_time,
+                time > 0.0f ? reference_time / time : 0.0f, max_error, mismatches);
+    }
+}
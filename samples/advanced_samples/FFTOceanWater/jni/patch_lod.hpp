@@ -0,0 +1,83 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PATCH_LOD_HPP__
+#define PATCH_LOD_HPP__
+
+#include "vector_math.h"
+#include "FrustumCulling.h"
+#include "ThreadPool.h"
+#include <cstdint>
+
+// Selects a LOD and tests frustum visibility for every patch in a grid of water patches.
+//
+// Patch centers follow directly from grid coordinates, so no per-patch data is read.
+// Distance, LOD, frustum test and R8 quantization are fused in one SIMD pass over each row of patches,
+// and rows are split over worker threads for large grids. The frustum test is FrustumCuller::cullSphereRow().
+class PatchLODSelector
+{
+    public:
+        struct Parameters
+        {
+            vec3 cam_pos;
+
+            // World space center of patch (0, 0) and distance between patch centers along X and Z.
+            vec2 origin;
+            vec2 spacing;
+
+            // LOD is log2(distance * distance_mod) clamped to [0, max_lod].
+            float distance_mod;
+            float max_lod;
+
+            // Patches are bounded by spheres of this radius centered at y = 0.
+            float radius;
+
+            // Culler holding the frustum planes of the camera.
+            const MaliSDK::FrustumCuller *culler;
+        };
+
+        // Rows are split over thread_pool for grids which are large enough to gain from it,
+        // otherwise, or without a pool, everything runs on the calling thread. The pool is not owned.
+        PatchLODSelector(unsigned blocks_x, unsigned blocks_z, MaliSDK::ThreadPool *thread_pool = nullptr);
+
+        // Writes blocks_x * blocks_z values in row-major order to each output.
+        // lods gets the LOD as a float, quantized_lods gets it as R8_UNORM with 32 steps per LOD,
+        // and visible gets 1 for patches which intersect the frustum and 0 otherwise.
+        // quantized_lods is only written to, so it can point straight into a mapped pixel buffer.
+        void select(const Parameters &params, float *lods, uint8_t *quantized_lods, uint8_t *visible);
+
+        // Plain scalar version of select() for validation and benchmarking.
+        void select_reference(const Parameters &params, float *lods, uint8_t *quantized_lods, uint8_t *visible) const;
+
+        // Logs the time per frame of select() and select_reference() for grids from 32x32 up to max_blocks x max_blocks.
+        static void bench(unsigned max_blocks, unsigned iterations, MaliSDK::ThreadPool *thread_pool);
+
+    private:
+        unsigned blocks_x;
+        unsigned blocks_z;
+
+        // Only set for grids which are large enough to gain from threading.
+        MaliSDK::ThreadPool *thread_pool;
+
+        void select_rows(const Parameters &params, unsigned begin, unsigned end,
+                float *lods, uint8_t *quantized_lods, uint8_t *visible) const;
+};
+
+#endif
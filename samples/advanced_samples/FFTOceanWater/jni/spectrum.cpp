@@ -0,0 +1,167 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "spectrum.hpp"
+#include "glfft_simd.hpp"
+#include <cmath>
+
+using namespace std;
+using namespace GLFFT;
+
+static inline int alias(int x, int N)
+{
+    if (x > N / 2)
+        x -= N;
+    return x;
+}
+
+PhillipsSpectrum::PhillipsSpectrum(unsigned Nx, unsigned Nz, vec2 size, float max_l,
+        shared_ptr<ThreadPool> pool)
+    : Nx(Nx), Nz(Nz), mod(vec2(2.0f * M_PI) / size), max_l(max_l), pool(move(pool))
+{
+    kx.resize(Nx);
+    for (unsigned x = 0; x < Nx; x++)
+    {
+        kx[x] = mod.x * alias(x, Nx);
+    }
+
+    noise.resize(Nx * Nz);
+    radial.resize(Nx * Nz);
+    directional.resize(Nx * Nz);
+    wind.resize(Nx * Nz);
+}
+
+void PhillipsSpectrum::generate_noise(default_random_engine &engine, normal_distribution<float> &dist)
+{
+    for (auto &n : noise)
+    {
+        // Gaussian distributed noise with unit variance.
+        // Evaluate real before imaginary part explicitly, argument evaluation order is unspecified.
+        float re = dist(engine);
+        float im = dist(engine);
+        n = cfloat(re, im);
+    }
+}
+
+void PhillipsSpectrum::set_wind(vec2 wind_dir, float L)
+{
+    if (wind_dir.x != this->wind_dir.x || wind_dir.y != this->wind_dir.y)
+    {
+        this->wind_dir = wind_dir;
+        directional_dirty = true;
+    }
+
+    if (L != this->L)
+    {
+        this->L = L;
+        wind_dirty = true;
+    }
+}
+
+void PhillipsSpectrum::set_amplitude(float amplitude)
+{
+    // Amplitude is applied when combining the terms, nothing to re-evaluate.
+    this->amplitude = amplitude;
+}
+
+template<typename T>
+void PhillipsSpectrum::evaluate(unsigned row, unsigned x, float kz, float *scale)
+{
+    typedef SimdTraits<T> S;
+    unsigned offset = row + x;
+
+    T k_x = S::load(&kx[x]);
+    T k_z = S::splat(kz);
+
+    // Clamp so the DC bin stays finite. Its directional term is 0, so it ends up 0 like in the Tessendorf paper.
+    T k2 = S::max(k_x * k_x + k_z * k_z, S::splat(1e-12f));
+
+    T r;
+    if (radial_dirty)
+    {
+        r = S::splat(sqrt(0.5f)) * exp_approx(k2 * (-0.5f * max_l * max_l)) / (k2 * S::sqrt(k2));
+        S::store(&radial[offset], r);
+    }
+    else
+    {
+        r = S::load(&radial[offset]);
+    }
+
+    T d;
+    if (directional_dirty)
+    {
+        d = S::abs(k_x * wind_dir.x + k_z * wind_dir.y);
+        S::store(&directional[offset], d);
+    }
+    else
+    {
+        d = S::load(&directional[offset]);
+    }
+
+    T w;
+    if (wind_dirty)
+    {
+        w = exp_approx(S::splat(-0.5f / (L * L)) / k2);
+        S::store(&wind[offset], w);
+    }
+    else
+    {
+        w = S::load(&wind[offset]);
+    }
+
+    S::store(scale, r * d * w * amplitude);
+}
+
+void PhillipsSpectrum::generate_rows(cfloat *distribution, unsigned begin, unsigned end)
+{
+    vector<float> scale(Nx);
+
+    for (unsigned z = begin; z < end; z++)
+    {
+        float kz = mod.y * alias(z, Nz);
+        unsigned row = z * Nx;
+
+        unsigned x = 0;
+        for (; x + 4 <= Nx; x += 4)
+        {
+            evaluate<SimdFloat4>(row, x, kz, &scale[x]);
+        }
+        for (; x < Nx; x++)
+        {
+            evaluate<float>(row, x, kz, &scale[x]);
+        }
+
+        for (x = 0; x < Nx; x++)
+        {
+            distribution[row + x] = noise[row + x] * scale[x];
+        }
+    }
+}
+
+void PhillipsSpectrum::generate(cfloat *distribution)
+{
+    pool->parallel_for(Nz, [this, distribution](unsigned begin, unsigned end) {
+        generate_rows(distribution, begin, end);
+    }, 4);
+
+    radial_dirty = false;
+    directional_dirty = false;
+    wind_dirty = false;
+}
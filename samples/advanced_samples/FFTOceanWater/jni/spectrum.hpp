@@ -0,0 +1,84 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPECTRUM_HPP__
+#define SPECTRUM_HPP__
+
+#include "vector_math.h"
+#include <complex>
+#include <memory>
+#include <random>
+#include <vector>
+#include "glfft_thread_pool.hpp"
+
+using cfloat = std::complex<float>;
+
+// Generates the initial Phillips spectrum h0(k) for one FFTWater heightfield.
+//
+// sqrt(Phillips) factors into terms which depend on different inputs:
+//   |h0(k)| = amplitude * |dot(k, wind_dir)| * exp(-1 / (2 k^2 L^2)) * radial(k)
+//   radial(k) = sqrt(1 / 2) * exp(-k^2 max_l^2 / 2) / |k|^3
+// Every term is kept per frequency bin, so changing wind direction, wind speed or amplitude
+// only re-evaluates the terms which depend on it. Rows are split across a thread pool
+// and evaluated four bins at a time with SIMD.
+class PhillipsSpectrum
+{
+    public:
+        PhillipsSpectrum(unsigned Nx, unsigned Nz, vec2 size, float max_l,
+                std::shared_ptr<GLFFT::ThreadPool> pool);
+
+        // Draws the complex Gaussian noise for every bin.
+        // Serial and row-major so the result only depends on the engine state.
+        void generate_noise(std::default_random_engine &engine, std::normal_distribution<float> &dist);
+
+        // L is the largest wave arising from the wind speed, i.e. |wind|^2 / g.
+        void set_wind(vec2 wind_dir, float L);
+        void set_amplitude(float amplitude);
+
+        // Writes h0(k) for all Nx * Nz bins, re-evaluating only what changed since the last call.
+        void generate(cfloat *distribution);
+
+    private:
+        unsigned Nx, Nz;
+        vec2 mod;
+        float max_l;
+        std::shared_ptr<GLFFT::ThreadPool> pool;
+
+        vec2 wind_dir = vec2(0.0f);
+        float L = 0.0f;
+        float amplitude = 0.0f;
+
+        bool radial_dirty = true;
+        bool directional_dirty = true;
+        bool wind_dirty = true;
+
+        std::vector<float> kx;
+        std::vector<cfloat> noise;
+        std::vector<float> radial;
+        std::vector<float> directional;
+        std::vector<float> wind;
+
+        void generate_rows(cfloat *distribution, unsigned begin, unsigned end);
+
+        template<typename T>
+        void evaluate(unsigned row, unsigned x, float kz, float *scale);
+};
+
+#endif
@@ -0,0 +1,228 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "water_cpu.hpp"
+#include "common.hpp"
+#include <cmath>
+#include <cstring>
+#include <new>
+
+using namespace std;
+using namespace GLFFT;
+
+static const float G = 9.81f;
+
+// Large enough for a cache line on every CPU we care about.
+static const size_t cache_line_size = 64;
+
+static inline int alias(int x, int N)
+{
+    if (x > N / 2)
+        x -= N;
+    return x;
+}
+
+CPUWater::AlignedFloats CPUWater::allocate(size_t count)
+{
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, cache_line_size, count * sizeof(float)) != 0)
+    {
+        throw bad_alloc();
+    }
+
+    memset(ptr, 0, count * sizeof(float));
+    return AlignedFloats(static_cast<float*>(ptr));
+}
+
+CPUWater::CPUWater(unsigned Nx, unsigned Nz, unsigned displacement_downsample,
+        const vector<cfloat> &distribution,
+        const vector<cfloat> &distribution_displacement,
+        const vector<cfloat> &distribution_normal,
+        vec2 mod, vec2 mod_normal,
+        unsigned ring_size, shared_ptr<GLFFT::ThreadPool> pool)
+    : Nx(Nx), Nz(Nz), displacement_downsample(displacement_downsample), pool(move(pool))
+{
+    unsigned disp_x = Nx >> displacement_downsample;
+    unsigned disp_z = Nz >> displacement_downsample;
+
+    // The complex-to-real transform only reads the non-negative half of every row.
+    init_spectrum(spectrum_height, Nx, Nz, Nx / 2 + 1, mod, distribution);
+    init_spectrum(spectrum_displacement, disp_x, disp_z, disp_x, mod, distribution_displacement);
+    init_spectrum(spectrum_normal, Nx, Nz, Nx, mod_normal, distribution_normal);
+
+    // Same transforms as FFTWater, but FP32 all the way since CPUFFT does not take packed FP16.
+    FFTOptions options;
+    fft_height = unique_ptr<CPUFFT>(new CPUFFT(Nx, Nz, ComplexToReal, Inverse, options, FFTWisdom(), this->pool));
+    fft_displacement = unique_ptr<CPUFFT>(new CPUFFT(disp_x, disp_z, ComplexToComplex, Inverse, options, FFTWisdom(), this->pool));
+    fft_normal = unique_ptr<CPUFFT>(new CPUFFT(Nx, Nz, ComplexToComplex, Inverse, options, FFTWisdom(), this->pool));
+
+    ring.resize(ring_size ? ring_size : 1);
+    for (auto &slot : ring)
+    {
+        slot.height_spectrum = allocate(2 * Nx * Nz);
+        slot.displacement_spectrum = allocate(2 * disp_x * disp_z);
+        slot.normal_spectrum = allocate(2 * Nx * Nz);
+        slot.height = allocate(Nx * Nz);
+        slot.displacement = allocate(2 * disp_x * disp_z);
+        slot.normal = allocate(2 * Nx * Nz);
+
+        slot.frame.time = 0.0f;
+        slot.frame.height_spectrum = slot.height_spectrum.get();
+        slot.frame.displacement_spectrum = slot.displacement_spectrum.get();
+        slot.frame.normal_spectrum = slot.normal_spectrum.get();
+        slot.frame.height = slot.height.get();
+        slot.frame.displacement = slot.displacement.get();
+        slot.frame.normal = slot.normal.get();
+    }
+}
+
+void CPUWater::init_spectrum(Spectrum &spectrum, unsigned width, unsigned height, unsigned width_used,
+        vec2 mod, const vector<cfloat> &h0)
+{
+    spectrum.width = width;
+    spectrum.height = height;
+    spectrum.width_used = width_used;
+    spectrum.mod = mod;
+    spectrum.h0 = h0;
+    spectrum.omega.resize(width * height);
+
+    for (unsigned z = 0; z < height; z++)
+    {
+        for (unsigned x = 0; x < width; x++)
+        {
+            vec2 k = mod * vec2(alias(x, width), alias(z, height));
+            spectrum.omega[z * width + x] = sqrt(G * vec_length(k));
+        }
+    }
+}
+
+void CPUWater::update_phase(const Spectrum &spectrum, Output output, float time, float *out)
+{
+    unsigned width = spectrum.width;
+    unsigned height = spectrum.height;
+
+    pool->parallel_for(height, [&](unsigned begin, unsigned end) {
+        for (unsigned z = begin; z < end; z++)
+        {
+            // Pick out the negative frequency variant, see water_generate_height.comp.
+            unsigned wz = z ? height - z : 0;
+            const cfloat *row = spectrum.h0.data() + z * width;
+            const cfloat *neg_row = spectrum.h0.data() + wz * width;
+            const float *omega = spectrum.omega.data() + z * width;
+            float *out_row = out + 2 * z * width;
+            float kz = spectrum.mod.y * alias(z, height);
+
+            for (unsigned x = 0; x < spectrum.width_used; x++)
+            {
+                unsigned wx = x ? width - x : 0;
+                cfloat a = row[x];
+                cfloat b = neg_row[wx];
+
+                float w = omega[x] * time;
+                float cw = cos(w);
+                float sw = sin(w);
+
+                // Rotate positive and negative travelling waves, conjugate the latter and sum them up.
+                float re = (a.real() * cw - a.imag() * sw) + (b.real() * cw - b.imag() * sw);
+                float im = (a.imag() * cw + a.real() * sw) - (b.imag() * cw + b.real() * sw);
+
+                if (output != OutputHeight)
+                {
+                    float kx = spectrum.mod.x * alias(x, width);
+                    float dx = -kz;
+                    float dz = kx;
+
+                    if (output == OutputDisplacement)
+                    {
+                        float k_len = sqrt(kx * kx + kz * kz);
+                        dx /= k_len + 0.00001f;
+                        dz /= k_len + 0.00001f;
+                    }
+
+                    float grad_re = re * dx - im * dz;
+                    float grad_im = im * dx + re * dz;
+                    re = grad_re;
+                    im = grad_im;
+                }
+
+                out_row[2 * x + 0] = re;
+                out_row[2 * x + 1] = im;
+            }
+        }
+    }, 4);
+}
+
+const CPUWater::Frame &CPUWater::compute_frame(float time)
+{
+    auto &slot = ring[ring_index];
+    ring_index = (ring_index + 1) % ring.size();
+
+    update_phase(spectrum_height, OutputHeight, time, slot.height_spectrum.get());
+    update_phase(spectrum_displacement, OutputDisplacement, time, slot.displacement_spectrum.get());
+    update_phase(spectrum_normal, OutputNormal, time, slot.normal_spectrum.get());
+
+    fft_height->process(slot.height.get(), slot.height_spectrum.get());
+    fft_displacement->process(slot.displacement.get(), slot.displacement_spectrum.get());
+    fft_normal->process(slot.normal.get(), slot.normal_spectrum.get());
+
+    slot.frame.time = time;
+    return slot.frame;
+}
+
+double CPUWater::bench(unsigned frames, float time_step)
+{
+    // Warm up caches and the thread pool.
+    compute_frame(0.0f);
+
+    double start_time = glfft_time();
+    for (unsigned i = 0; i < frames; i++)
+    {
+        compute_frame(i * time_step);
+    }
+    double elapsed = glfft_time() - start_time;
+
+    double fps = elapsed > 0.0 ? frames / elapsed : 0.0;
+    unsigned cores = pool->get_num_threads();
+    LOGI("CPU water %ux%u: %.2f frames/s, %.2f frames/s per core (%u threads).\n",
+            Nx, Nz, fps, fps / cores, cores);
+    return fps;
+}
+
+static inline uint64_t fnv1a(uint64_t h, const float *data, size_t count)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < count * sizeof(float); i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t CPUWater::get_checksum(const Frame &frame) const
+{
+    size_t displacement_size = 2 * (Nx >> displacement_downsample) * (Nz >> displacement_downsample);
+
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = fnv1a(h, frame.height, Nx * Nz);
+    h = fnv1a(h, frame.displacement, displacement_size);
+    h = fnv1a(h, frame.normal, 2 * Nx * Nz);
+    return h;
+}
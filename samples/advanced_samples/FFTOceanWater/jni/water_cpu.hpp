@@ -0,0 +1,134 @@
+/* Copyright (c) 2015-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef WATER_CPU_HPP__
+#define WATER_CPU_HPP__
+
+#include "vector_math.h"
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "glfft_cpu.hpp"
+#include "glfft_thread_pool.hpp"
+
+using cfloat = std::complex<float>;
+
+// CPU implementation of FFTWater::update_phase() and compute_ifft().
+//
+// Evolves the initial spectra to a given time with the same Tessendorf dispersion as the
+// water_generate_*.comp shaders and runs the inverse transforms with GLFFT::CPUFFT.
+// Results are written into a ring of pre-allocated, cache-line aligned frames so a consumer can
+// stream frames while later ones are being computed, e.g. to precompute or validate ocean animation headlessly.
+//
+// Every bin and every FFT row is computed independently, so a frame only depends on the time,
+// never on thread count or scheduling. Frames are bit-identical between runs of the same build.
+class CPUWater
+{
+    public:
+        struct Frame
+        {
+            float time;
+
+            // Evolved spectra, FP32 versions of the SSBOs the GPU path feeds its FFTs with.
+            // Height is a half-spectrum with N / 2 + 1 complex samples per row and a stride of Nx.
+            const float *height_spectrum;
+            const float *displacement_spectrum;
+            const float *normal_spectrum;
+
+            // Spatial results. Height is Nx * Nz reals.
+            // Displacement is (Nx * Nz) >> (2 * displacement_downsample) complex samples, x in real and z in imaginary.
+            // Normal is Nx * Nz complex samples with the x and z gradients of the high-frequency normal map.
+            const float *height;
+            const float *displacement;
+            const float *normal;
+        };
+
+        // Distributions are h0(k) as uploaded by FFTWater, mod is 2 * pi / size of the respective patch.
+        CPUWater(unsigned Nx, unsigned Nz, unsigned displacement_downsample,
+                const std::vector<cfloat> &distribution,
+                const std::vector<cfloat> &distribution_displacement,
+                const std::vector<cfloat> &distribution_normal,
+                vec2 mod, vec2 mod_normal,
+                unsigned ring_size, std::shared_ptr<GLFFT::ThreadPool> pool);
+
+        // Computes the frame for time into the next ring slot.
+        // The returned frame stays valid until compute_frame() has been called ring_size more times.
+        const Frame &compute_frame(float time);
+
+        // Computes frames at fixed time steps and logs the throughput in frames per second, in total and per core.
+        // Returns frames per second.
+        double bench(unsigned frames, float time_step);
+
+        // FNV-1a hash over the spatial results, for validating streamed frames.
+        uint64_t get_checksum(const Frame &frame) const;
+
+        unsigned get_ring_size() const { return unsigned(ring.size()); }
+
+    private:
+        struct AlignedDeleter
+        {
+            void operator()(float *ptr) const { free(ptr); }
+        };
+        typedef std::unique_ptr<float[], AlignedDeleter> AlignedFloats;
+        static AlignedFloats allocate(size_t count);
+
+        struct Spectrum
+        {
+            unsigned width, height;
+            // Only the first width_used samples of each row are evolved.
+            unsigned width_used;
+            vec2 mod;
+            std::vector<cfloat> h0;
+            // sqrt(g * |k|), how fast waves in each bin travel.
+            std::vector<float> omega;
+        };
+
+        struct Slot
+        {
+            AlignedFloats height_spectrum, displacement_spectrum, normal_spectrum;
+            AlignedFloats height, displacement, normal;
+            Frame frame;
+        };
+
+        enum Output { OutputHeight, OutputDisplacement, OutputNormal };
+
+        unsigned Nx, Nz;
+        unsigned displacement_downsample;
+        std::shared_ptr<GLFFT::ThreadPool> pool;
+
+        Spectrum spectrum_height;
+        Spectrum spectrum_displacement;
+        Spectrum spectrum_normal;
+
+        std::unique_ptr<GLFFT::CPUFFT> fft_height;
+        std::unique_ptr<GLFFT::CPUFFT> fft_displacement;
+        std::unique_ptr<GLFFT::CPUFFT> fft_normal;
+
+        std::vector<Slot> ring;
+        unsigned ring_index = 0;
+
+        void init_spectrum(Spectrum &spectrum, unsigned width, unsigned height, unsigned width_used,
+                vec2 mod, const std::vector<cfloat> &h0);
+        void update_phase(const Spectrum &spectrum, Output output, float time, float *out);
+};
+
+#endif
@@ -0,0 +1,777 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MarchingCubes.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MARCHING_CUBES_USE_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARCHING_CUBES_USE_SSE
+#endif
+
+namespace MaliSDK
+{
+    /** The array that is used for cell triangularization.
+     *  Each row in the table represents one cell type. Each cell type contains up to 5 triangles.
+     *  Each triangle is defined by 3 sequential vertices.
+     *  These vertices are "middle" points of the cell edges specified in this table.
+     *  For example cell type 0 (see first line) does not define any triangles,
+     *  while cell type 1 (see second line) defines one triangle consisting of "middle" points of edges 0,8 and 3 of a cell.
+     *  "Middle" points are base points and can be moved closer to edge beginning point or edge ending point.
+     *  Edge numeration is according to the Marching Cubes algorithm.
+     *  There are exactly 256 cell types due to each vertex having only 2 states: it can be below isosurface or above.
+     *  Thus (having 8 corners for each cubic cell) we have 2^8 = 256 cell types.
+     *
+     *  Table data taken from http://paulbourke.net/geometry/polygonise/
+     */
+    /* [tri_table chosen part for documentation] */
+    const int MarchingCubes::triTable[256 * 15] =
+    {
+      -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  1,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  8,  3,     9,  8,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+    /* [tri_table chosen part for documentation] */
+       1,  2, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,     1,  2, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9,  2, 10,     0,  2,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       2,  8,  3,     2, 10,  8,    10,  9,  8,    -1, -1, -1,    -1, -1, -1,
+       3, 11,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0, 11,  2,     8, 11,  0,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  9,  0,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1, 11,  2,     1,  9, 11,     9,  8, 11,    -1, -1, -1,    -1, -1, -1,
+       3, 10,  1,    11, 10,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0, 10,  1,     0,  8, 10,     8, 11, 10,    -1, -1, -1,    -1, -1, -1,
+       3,  9,  0,     3, 11,  9,    11, 10,  9,    -1, -1, -1,    -1, -1, -1,
+       9,  8, 10,    10,  8, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  7,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  3,  0,     7,  3,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  1,  9,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  1,  9,     4,  7,  1,     7,  3,  1,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 10,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  4,  7,     3,  0,  4,     1,  2, 10,    -1, -1, -1,    -1, -1, -1,
+       9,  2, 10,     9,  0,  2,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,
+       2, 10,  9,     2,  9,  7,     2,  7,  3,     7,  9,  4,    -1, -1, -1,
+       8,  4,  7,     3, 11,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      11,  4,  7,    11,  2,  4,     2,  0,  4,    -1, -1, -1,    -1, -1, -1,
+       9,  0,  1,     8,  4,  7,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,
+       4,  7, 11,     9,  4, 11,     9, 11,  2,     9,  2,  1,    -1, -1, -1,
+       3, 10,  1,     3, 11, 10,     7,  8,  4,    -1, -1, -1,    -1, -1, -1,
+       1, 11, 10,     1,  4, 11,     1,  0,  4,     7, 11,  4,    -1, -1, -1,
+       4,  7,  8,     9,  0, 11,     9, 11, 10,    11,  0,  3,    -1, -1, -1,
+       4,  7, 11,     4, 11,  9,     9, 11, 10,    -1, -1, -1,    -1, -1, -1,
+       9,  5,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9,  5,  4,     0,  8,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  5,  4,     1,  5,  0,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       8,  5,  4,     8,  3,  5,     3,  1,  5,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 10,     9,  5,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  0,  8,     1,  2, 10,     4,  9,  5,    -1, -1, -1,    -1, -1, -1,
+       5,  2, 10,     5,  4,  2,     4,  0,  2,    -1, -1, -1,    -1, -1, -1,
+       2, 10,  5,     3,  2,  5,     3,  5,  4,     3,  4,  8,    -1, -1, -1,
+       9,  5,  4,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0, 11,  2,     0,  8, 11,     4,  9,  5,    -1, -1, -1,    -1, -1, -1,
+       0,  5,  4,     0,  1,  5,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,
+       2,  1,  5,     2,  5,  8,     2,  8, 11,     4,  8,  5,    -1, -1, -1,
+      10,  3, 11,    10,  1,  3,     9,  5,  4,    -1, -1, -1,    -1, -1, -1,
+       4,  9,  5,     0,  8,  1,     8, 10,  1,     8, 11, 10,    -1, -1, -1,
+       5,  4,  0,     5,  0, 11,     5, 11, 10,    11,  0,  3,    -1, -1, -1,
+       5,  4,  8,     5,  8, 10,    10,  8, 11,    -1, -1, -1,    -1, -1, -1,
+       9,  7,  8,     5,  7,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9,  3,  0,     9,  5,  3,     5,  7,  3,    -1, -1, -1,    -1, -1, -1,
+       0,  7,  8,     0,  1,  7,     1,  5,  7,    -1, -1, -1,    -1, -1, -1,
+       1,  5,  3,     3,  5,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9,  7,  8,     9,  5,  7,    10,  1,  2,    -1, -1, -1,    -1, -1, -1,
+      10,  1,  2,     9,  5,  0,     5,  3,  0,     5,  7,  3,    -1, -1, -1,
+       8,  0,  2,     8,  2,  5,     8,  5,  7,    10,  5,  2,    -1, -1, -1,
+       2, 10,  5,     2,  5,  3,     3,  5,  7,    -1, -1, -1,    -1, -1, -1,
+       7,  9,  5,     7,  8,  9,     3, 11,  2,    -1, -1, -1,    -1, -1, -1,
+       9,  5,  7,     9,  7,  2,     9,  2,  0,     2,  7, 11,    -1, -1, -1,
+       2,  3, 11,     0,  1,  8,     1,  7,  8,     1,  5,  7,    -1, -1, -1,
+      11,  2,  1,    11,  1,  7,     7,  1,  5,    -1, -1, -1,    -1, -1, -1,
+       9,  5,  8,     8,  5,  7,    10,  1,  3,    10,  3, 11,    -1, -1, -1,
+       5,  7,  0,     5,  0,  9,     7, 11,  0,     1,  0, 10,    11, 10,  0,
+      11, 10,  0,    11,  0,  3,    10,  5,  0,     8,  0,  7,     5,  7,  0,
+      11, 10,  5,     7, 11,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      10,  6,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9,  0,  1,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  8,  3,     1,  9,  8,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,
+       1,  6,  5,     2,  6,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  6,  5,     1,  2,  6,     3,  0,  8,    -1, -1, -1,    -1, -1, -1,
+       9,  6,  5,     9,  0,  6,     0,  2,  6,    -1, -1, -1,    -1, -1, -1,
+       5,  9,  8,     5,  8,  2,     5,  2,  6,     3,  2,  8,    -1, -1, -1,
+       2,  3, 11,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      11,  0,  8,    11,  2,  0,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,
+       0,  1,  9,     2,  3, 11,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,
+       5, 10,  6,     1,  9,  2,     9, 11,  2,     9,  8, 11,    -1, -1, -1,
+       6,  3, 11,     6,  5,  3,     5,  1,  3,    -1, -1, -1,    -1, -1, -1,
+       0,  8, 11,     0, 11,  5,     0,  5,  1,     5, 11,  6,    -1, -1, -1,
+       3, 11,  6,     0,  3,  6,     0,  6,  5,     0,  5,  9,    -1, -1, -1,
+       6,  5,  9,     6,  9, 11,    11,  9,  8,    -1, -1, -1,    -1, -1, -1,
+       5, 10,  6,     4,  7,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  3,  0,     4,  7,  3,     6,  5, 10,    -1, -1, -1,    -1, -1, -1,
+       1,  9,  0,     5, 10,  6,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,
+      10,  6,  5,     1,  9,  7,     1,  7,  3,     7,  9,  4,    -1, -1, -1,
+       6,  1,  2,     6,  5,  1,     4,  7,  8,    -1, -1, -1,    -1, -1, -1,
+       1,  2,  5,     5,  2,  6,     3,  0,  4,     3,  4,  7,    -1, -1, -1,
+       8,  4,  7,     9,  0,  5,     0,  6,  5,     0,  2,  6,    -1, -1, -1,
+       7,  3,  9,     7,  9,  4,     3,  2,  9,     5,  9,  6,     2,  6,  9,
+       3, 11,  2,     7,  8,  4,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,
+       5, 10,  6,     4,  7,  2,     4,  2,  0,     2,  7, 11,    -1, -1, -1,
+       0,  1,  9,     4,  7,  8,     2,  3, 11,     5, 10,  6,    -1, -1, -1,
+       9,  2,  1,     9, 11,  2,     9,  4, 11,     7, 11,  4,     5, 10,  6,
+       8,  4,  7,     3, 11,  5,     3,  5,  1,     5, 11,  6,    -1, -1, -1,
+       5,  1, 11,     5, 11,  6,     1,  0, 11,     7, 11,  4,     0,  4, 11,
+       0,  5,  9,     0,  6,  5,     0,  3,  6,    11,  6,  3,     8,  4,  7,
+       6,  5,  9,     6,  9, 11,     4,  7,  9,     7, 11,  9,    -1, -1, -1,
+      10,  4,  9,     6,  4, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4, 10,  6,     4,  9, 10,     0,  8,  3,    -1, -1, -1,    -1, -1, -1,
+      10,  0,  1,    10,  6,  0,     6,  4,  0,    -1, -1, -1,    -1, -1, -1,
+       8,  3,  1,     8,  1,  6,     8,  6,  4,     6,  1, 10,    -1, -1, -1,
+       1,  4,  9,     1,  2,  4,     2,  6,  4,    -1, -1, -1,    -1, -1, -1,
+       3,  0,  8,     1,  2,  9,     2,  4,  9,     2,  6,  4,    -1, -1, -1,
+       0,  2,  4,     4,  2,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       8,  3,  2,     8,  2,  4,     4,  2,  6,    -1, -1, -1,    -1, -1, -1,
+      10,  4,  9,    10,  6,  4,    11,  2,  3,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  2,     2,  8, 11,     4,  9, 10,     4, 10,  6,    -1, -1, -1,
+       3, 11,  2,     0,  1,  6,     0,  6,  4,     6,  1, 10,    -1, -1, -1,
+       6,  4,  1,     6,  1, 10,     4,  8,  1,     2,  1, 11,     8, 11,  1,
+       9,  6,  4,     9,  3,  6,     9,  1,  3,    11,  6,  3,    -1, -1, -1,
+       8, 11,  1,     8,  1,  0,    11,  6,  1,     9,  1,  4,     6,  4,  1,
+       3, 11,  6,     3,  6,  0,     0,  6,  4,    -1, -1, -1,    -1, -1, -1,
+       6,  4,  8,    11,  6,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       7, 10,  6,     7,  8, 10,     8,  9, 10,    -1, -1, -1,    -1, -1, -1,
+       0,  7,  3,     0, 10,  7,     0,  9, 10,     6,  7, 10,    -1, -1, -1,
+      10,  6,  7,     1, 10,  7,     1,  7,  8,     1,  8,  0,    -1, -1, -1,
+      10,  6,  7,    10,  7,  1,     1,  7,  3,    -1, -1, -1,    -1, -1, -1,
+       1,  2,  6,     1,  6,  8,     1,  8,  9,     8,  6,  7,    -1, -1, -1,
+       2,  6,  9,     2,  9,  1,     6,  7,  9,     0,  9,  3,     7,  3,  9,
+       7,  8,  0,     7,  0,  6,     6,  0,  2,    -1, -1, -1,    -1, -1, -1,
+       7,  3,  2,     6,  7,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       2,  3, 11,    10,  6,  8,    10,  8,  9,     8,  6,  7,    -1, -1, -1,
+       2,  0,  7,     2,  7, 11,     0,  9,  7,     6,  7, 10,     9, 10,  7,
+       1,  8,  0,     1,  7,  8,     1, 10,  7,     6,  7, 10,     2,  3, 11,
+      11,  2,  1,    11,  1,  7,    10,  6,  1,     6,  7,  1,    -1, -1, -1,
+       8,  9,  6,     8,  6,  7,     9,  1,  6,    11,  6,  3,     1,  3,  6,
+       0,  9,  1,    11,  6,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       7,  8,  0,     7,  0,  6,     3, 11,  0,    11,  6,  0,    -1, -1, -1,
+       7, 11,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       7,  6, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  0,  8,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  1,  9,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       8,  1,  9,     8,  3,  1,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,
+      10,  1,  2,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 10,     3,  0,  8,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,
+       2,  9,  0,     2, 10,  9,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,
+       6, 11,  7,     2, 10,  3,    10,  8,  3,    10,  9,  8,    -1, -1, -1,
+       7,  2,  3,     6,  2,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       7,  0,  8,     7,  6,  0,     6,  2,  0,    -1, -1, -1,    -1, -1, -1,
+       2,  7,  6,     2,  3,  7,     0,  1,  9,    -1, -1, -1,    -1, -1, -1,
+       1,  6,  2,     1,  8,  6,     1,  9,  8,     8,  7,  6,    -1, -1, -1,
+      10,  7,  6,    10,  1,  7,     1,  3,  7,    -1, -1, -1,    -1, -1, -1,
+      10,  7,  6,     1,  7, 10,     1,  8,  7,     1,  0,  8,    -1, -1, -1,
+       0,  3,  7,     0,  7, 10,     0, 10,  9,     6, 10,  7,    -1, -1, -1,
+       7,  6, 10,     7, 10,  8,     8, 10,  9,    -1, -1, -1,    -1, -1, -1,
+       6,  8,  4,    11,  8,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  6, 11,     3,  0,  6,     0,  4,  6,    -1, -1, -1,    -1, -1, -1,
+       8,  6, 11,     8,  4,  6,     9,  0,  1,    -1, -1, -1,    -1, -1, -1,
+       9,  4,  6,     9,  6,  3,     9,  3,  1,    11,  3,  6,    -1, -1, -1,
+       6,  8,  4,     6, 11,  8,     2, 10,  1,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 10,     3,  0, 11,     0,  6, 11,     0,  4,  6,    -1, -1, -1,
+       4, 11,  8,     4,  6, 11,     0,  2,  9,     2, 10,  9,    -1, -1, -1,
+      10,  9,  3,    10,  3,  2,     9,  4,  3,    11,  3,  6,     4,  6,  3,
+       8,  2,  3,     8,  4,  2,     4,  6,  2,    -1, -1, -1,    -1, -1, -1,
+       0,  4,  2,     4,  6,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  9,  0,     2,  3,  4,     2,  4,  6,     4,  3,  8,    -1, -1, -1,
+       1,  9,  4,     1,  4,  2,     2,  4,  6,    -1, -1, -1,    -1, -1, -1,
+       8,  1,  3,     8,  6,  1,     8,  4,  6,     6, 10,  1,    -1, -1, -1,
+      10,  1,  0,    10,  0,  6,     6,  0,  4,    -1, -1, -1,    -1, -1, -1,
+       4,  6,  3,     4,  3,  8,     6, 10,  3,     0,  3,  9,    10,  9,  3,
+      10,  9,  4,     6, 10,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  9,  5,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,     4,  9,  5,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,
+       5,  0,  1,     5,  4,  0,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,
+      11,  7,  6,     8,  3,  4,     3,  5,  4,     3,  1,  5,    -1, -1, -1,
+       9,  5,  4,    10,  1,  2,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,
+       6, 11,  7,     1,  2, 10,     0,  8,  3,     4,  9,  5,    -1, -1, -1,
+       7,  6, 11,     5,  4, 10,     4,  2, 10,     4,  0,  2,    -1, -1, -1,
+       3,  4,  8,     3,  5,  4,     3,  2,  5,    10,  5,  2,    11,  7,  6,
+       7,  2,  3,     7,  6,  2,     5,  4,  9,    -1, -1, -1,    -1, -1, -1,
+       9,  5,  4,     0,  8,  6,     0,  6,  2,     6,  8,  7,    -1, -1, -1,
+       3,  6,  2,     3,  7,  6,     1,  5,  0,     5,  4,  0,    -1, -1, -1,
+       6,  2,  8,     6,  8,  7,     2,  1,  8,     4,  8,  5,     1,  5,  8,
+       9,  5,  4,    10,  1,  6,     1,  7,  6,     1,  3,  7,    -1, -1, -1,
+       1,  6, 10,     1,  7,  6,     1,  0,  7,     8,  7,  0,     9,  5,  4,
+       4,  0, 10,     4, 10,  5,     0,  3, 10,     6, 10,  7,     3,  7, 10,
+       7,  6, 10,     7, 10,  8,     5,  4, 10,     4,  8, 10,    -1, -1, -1,
+       6,  9,  5,     6, 11,  9,    11,  8,  9,    -1, -1, -1,    -1, -1, -1,
+       3,  6, 11,     0,  6,  3,     0,  5,  6,     0,  9,  5,    -1, -1, -1,
+       0, 11,  8,     0,  5, 11,     0,  1,  5,     5,  6, 11,    -1, -1, -1,
+       6, 11,  3,     6,  3,  5,     5,  3,  1,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 10,     9,  5, 11,     9, 11,  8,    11,  5,  6,    -1, -1, -1,
+       0, 11,  3,     0,  6, 11,     0,  9,  6,     5,  6,  9,     1,  2, 10,
+      11,  8,  5,    11,  5,  6,     8,  0,  5,    10,  5,  2,     0,  2,  5,
+       6, 11,  3,     6,  3,  5,     2, 10,  3,    10,  5,  3,    -1, -1, -1,
+       5,  8,  9,     5,  2,  8,     5,  6,  2,     3,  8,  2,    -1, -1, -1,
+       9,  5,  6,     9,  6,  0,     0,  6,  2,    -1, -1, -1,    -1, -1, -1,
+       1,  5,  8,     1,  8,  0,     5,  6,  8,     3,  8,  2,     6,  2,  8,
+       1,  5,  6,     2,  1,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  3,  6,     1,  6, 10,     3,  8,  6,     5,  6,  9,     8,  9,  6,
+      10,  1,  0,    10,  0,  6,     9,  5,  0,     5,  6,  0,    -1, -1, -1,
+       0,  3,  8,     5,  6, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      10,  5,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      11,  5, 10,     7,  5, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      11,  5, 10,    11,  7,  5,     8,  3,  0,    -1, -1, -1,    -1, -1, -1,
+       5, 11,  7,     5, 10, 11,     1,  9,  0,    -1, -1, -1,    -1, -1, -1,
+      10,  7,  5,    10, 11,  7,     9,  8,  1,     8,  3,  1,    -1, -1, -1,
+      11,  1,  2,    11,  7,  1,     7,  5,  1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,     1,  2,  7,     1,  7,  5,     7,  2, 11,    -1, -1, -1,
+       9,  7,  5,     9,  2,  7,     9,  0,  2,     2, 11,  7,    -1, -1, -1,
+       7,  5,  2,     7,  2, 11,     5,  9,  2,     3,  2,  8,     9,  8,  2,
+       2,  5, 10,     2,  3,  5,     3,  7,  5,    -1, -1, -1,    -1, -1, -1,
+       8,  2,  0,     8,  5,  2,     8,  7,  5,    10,  2,  5,    -1, -1, -1,
+       9,  0,  1,     5, 10,  3,     5,  3,  7,     3, 10,  2,    -1, -1, -1,
+       9,  8,  2,     9,  2,  1,     8,  7,  2,    10,  2,  5,     7,  5,  2,
+       1,  3,  5,     3,  7,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  7,     0,  7,  1,     1,  7,  5,    -1, -1, -1,    -1, -1, -1,
+       9,  0,  3,     9,  3,  5,     5,  3,  7,    -1, -1, -1,    -1, -1, -1,
+       9,  8,  7,     5,  9,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       5,  8,  4,     5, 10,  8,    10, 11,  8,    -1, -1, -1,    -1, -1, -1,
+       5,  0,  4,     5, 11,  0,     5, 10, 11,    11,  3,  0,    -1, -1, -1,
+       0,  1,  9,     8,  4, 10,     8, 10, 11,    10,  4,  5,    -1, -1, -1,
+      10, 11,  4,    10,  4,  5,    11,  3,  4,     9,  4,  1,     3,  1,  4,
+       2,  5,  1,     2,  8,  5,     2, 11,  8,     4,  5,  8,    -1, -1, -1,
+       0,  4, 11,     0, 11,  3,     4,  5, 11,     2, 11,  1,     5,  1, 11,
+       0,  2,  5,     0,  5,  9,     2, 11,  5,     4,  5,  8,    11,  8,  5,
+       9,  4,  5,     2, 11,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       2,  5, 10,     3,  5,  2,     3,  4,  5,     3,  8,  4,    -1, -1, -1,
+       5, 10,  2,     5,  2,  4,     4,  2,  0,    -1, -1, -1,    -1, -1, -1,
+       3, 10,  2,     3,  5, 10,     3,  8,  5,     4,  5,  8,     0,  1,  9,
+       5, 10,  2,     5,  2,  4,     1,  9,  2,     9,  4,  2,    -1, -1, -1,
+       8,  4,  5,     8,  5,  3,     3,  5,  1,    -1, -1, -1,    -1, -1, -1,
+       0,  4,  5,     1,  0,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       8,  4,  5,     8,  5,  3,     9,  0,  5,     0,  3,  5,    -1, -1, -1,
+       9,  4,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4, 11,  7,     4,  9, 11,     9, 10, 11,    -1, -1, -1,    -1, -1, -1,
+       0,  8,  3,     4,  9,  7,     9, 11,  7,     9, 10, 11,    -1, -1, -1,
+       1, 10, 11,     1, 11,  4,     1,  4,  0,     7,  4, 11,    -1, -1, -1,
+       3,  1,  4,     3,  4,  8,     1, 10,  4,     7,  4, 11,    10, 11,  4,
+       4, 11,  7,     9, 11,  4,     9,  2, 11,     9,  1,  2,    -1, -1, -1,
+       9,  7,  4,     9, 11,  7,     9,  1, 11,     2, 11,  1,     0,  8,  3,
+      11,  7,  4,    11,  4,  2,     2,  4,  0,    -1, -1, -1,    -1, -1, -1,
+      11,  7,  4,    11,  4,  2,     8,  3,  4,     3,  2,  4,    -1, -1, -1,
+       2,  9, 10,     2,  7,  9,     2,  3,  7,     7,  4,  9,    -1, -1, -1,
+       9, 10,  7,     9,  7,  4,    10,  2,  7,     8,  7,  0,     2,  0,  7,
+       3,  7, 10,     3, 10,  2,     7,  4, 10,     1, 10,  0,     4,  0, 10,
+       1, 10,  2,     8,  7,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  9,  1,     4,  1,  7,     7,  1,  3,    -1, -1, -1,    -1, -1, -1,
+       4,  9,  1,     4,  1,  7,     0,  8,  1,     8,  7,  1,    -1, -1, -1,
+       4,  0,  3,     7,  4,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       4,  8,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       9, 10,  8,    10, 11,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  0,  9,     3,  9, 11,    11,  9, 10,    -1, -1, -1,    -1, -1, -1,
+       0,  1, 10,     0, 10,  8,     8, 10, 11,    -1, -1, -1,    -1, -1, -1,
+       3,  1, 10,    11,  3, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  2, 11,     1, 11,  9,     9, 11,  8,    -1, -1, -1,    -1, -1, -1,
+       3,  0,  9,     3,  9, 11,     1,  2,  9,     2, 11,  9,    -1, -1, -1,
+       0,  2, 11,     8,  0, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       3,  2, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       2,  3,  8,     2,  8, 10,    10,  8,  9,    -1, -1, -1,    -1, -1, -1,
+       9, 10,  2,     0,  9,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       2,  3,  8,     2,  8, 10,     0,  1,  8,     1, 10,  8,    -1, -1, -1,
+       1, 10,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       1,  3,  8,     9,  1,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  9,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+       0,  3,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
+      -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1
+    };
+    const int MarchingCubes::edgeCorners[12][2] =
+    {
+        {0, 1}, {1, 2}, {2, 3}, {3, 0},
+        {4, 5}, {5, 6}, {6, 7}, {7, 4},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}
+    };
+
+    const int MarchingCubes::cornerOffsets[8][3] =
+    {
+        {0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1},
+        {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}
+    };
+
+    /* Precision to avoid division-by-zero errors, as in the shaders. */
+    static const float epsilon = 0.000001f;
+
+    MarchingCubes::MarchingCubes(int samplesPerAxis, ThreadPool* threadPool)
+        : samplesPerAxis(samplesPerAxis)
+        , threadPool(threadPool)
+    {
+        const unsigned int samples      = samplesPerAxis * samplesPerAxis * samplesPerAxis;
+        const unsigned int cellsPerAxis = samplesPerAxis - 1;
+
+        field.assign(samples, 0.0f);
+        inside.resize(samples);
+        cellTypes.resize(cellsPerAxis * cellsPerAxis * cellsPerAxis);
+        edgeVertices.resize(3 * samples);
+
+        planeVertices.resize(samplesPerAxis);
+        planeActiveCells.resize(samplesPerAxis);
+        planeIndices.resize(samplesPerAxis);
+
+        for (int type = 0; type < 256; type++)
+        {
+            int count = 0;
+
+            while (count < 5 && triTable[15 * type + 3 * count] != -1)
+            {
+                count++;
+            }
+            triangleCount[type] = (unsigned char)count;
+        }
+
+        /* Every cell edge is one of the three edges leaving the corner with the lower coordinates. */
+        for (int edge = 0; edge < 12; edge++)
+        {
+            const int* start = cornerOffsets[edgeCorners[edge][0]];
+            const int* end   = cornerOffsets[edgeCorners[edge][1]];
+            int origin[3];
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                origin[axis] = start[axis] < end[axis] ? start[axis] : end[axis];
+                if (start[axis] != end[axis])
+                {
+                    edgeAxis[edge] = axis;
+                }
+            }
+            edgeSample[edge] = origin[0] + samplesPerAxis * (origin[1] + samplesPerAxis * origin[2]);
+        }
+    }
+
+    void MarchingCubes::forEachPlane(unsigned int count, const std::function<void (unsigned int)>& function)
+    {
+        std::function<void (unsigned int, unsigned int)> planes = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int plane = begin; plane < end; plane++)
+            {
+                function(plane);
+            }
+        };
+
+        if (threadPool != NULL)
+        {
+            threadPool->parallelFor(count, planes);
+        }
+        else
+        {
+            planes(0, count);
+        }
+    }
+
+    void MarchingCubes::evaluatePlane(int z, const float* spheres, int numberOfSpheres)
+    {
+        const float scale = 1.0f / float(samplesPerAxis - 1);
+        const float pz    = z * scale;
+
+        for (int y = 0; y < samplesPerAxis; y++)
+        {
+            const float py  = y * scale;
+            float*      row = &field[samplesPerAxis * (y + samplesPerAxis * z)];
+            int         x   = 0;
+
+            /* Field value is a sum of weight / distance^2 over all spheres, with the distance clamped to epsilon. */
+#if defined(MARCHING_CUBES_USE_NEON)
+            static const float firstOffsets[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+            const float32x4_t offsets = vld1q_f32(firstOffsets);
+            const float32x4_t minimum = vdupq_n_f32(epsilon * epsilon);
+
+            for (; x + 4 <= samplesPerAxis; x += 4)
+            {
+                const float32x4_t px  = vmulq_n_f32(vaddq_f32(vdupq_n_f32(float(x)), offsets), scale);
+                float32x4_t       sum = vdupq_n_f32(0.0f);
+
+                for (int sphere = 0; sphere < numberOfSpheres; sphere++)
+                {
+                    const float* s  = spheres + 4 * sphere;
+                    const float  dy = py - s[1];
+                    const float  dz = pz - s[2];
+
+                    float32x4_t dx       = vsubq_f32(px, vdupq_n_f32(s[0]));
+                    float32x4_t distance = vmaxq_f32(vmlaq_f32(vdupq_n_f32(dy * dy + dz * dz), dx, dx), minimum);
+
+                    /* Reciprocal estimate refined by two Newton-Raphson steps, which is close to full precision. */
+                    float32x4_t reciprocal = vrecpeq_f32(distance);
+                    reciprocal = vmulq_f32(vrecpsq_f32(distance, reciprocal), reciprocal);
+                    reciprocal = vmulq_f32(vrecpsq_f32(distance, reciprocal), reciprocal);
+
+                    sum = vmlaq_n_f32(sum, reciprocal, s[3]);
+                }
+                vst1q_f32(row + x, sum);
+            }
+#elif defined(MARCHING_CUBES_USE_SSE)
+            const __m128 offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            const __m128 minimum = _mm_set1_ps(epsilon * epsilon);
+
+            for (; x + 4 <= samplesPerAxis; x += 4)
+            {
+                const __m128 px  = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(x)), offsets), _mm_set1_ps(scale));
+                __m128       sum = _mm_setzero_ps();
+
+                for (int sphere = 0; sphere < numberOfSpheres; sphere++)
+                {
+                    const float* s  = spheres + 4 * sphere;
+                    const float  dy = py - s[1];
+                    const float  dz = pz - s[2];
+
+                    __m128 dx       = _mm_sub_ps(px, _mm_set1_ps(s[0]));
+                    __m128 distance = _mm_max_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_set1_ps(dy * dy + dz * dz)), minimum);
+
+                    sum = _mm_add_ps(sum, _mm_div_ps(_mm_set1_ps(s[3]), distance));
+                }
+                _mm_storeu_ps(row + x, sum);
+            }
+#endif
+            for (; x < samplesPerAxis; x++)
+            {
+                const float px  = x * scale;
+                float       sum = 0.0f;
+
+                for (int sphere = 0; sphere < numberOfSpheres; sphere++)
+                {
+                    const float* s        = spheres + 4 * sphere;
+                    const float  dx       = px - s[0];
+                    const float  dy       = py - s[1];
+                    const float  dz       = pz - s[2];
+                    const float  distance = dx * dx + dy * dy + dz * dz;
+
+                    sum += s[3] / (distance > epsilon * epsilon ? distance : epsilon * epsilon);
+                }
+                row[x] = sum;
+            }
+        }
+    }
+
+    void MarchingCubes::evaluateField(const float* spheres, int numberOfSpheres)
+    {
+        forEachPlane(samplesPerAxis, [&](unsigned int z)
+        {
+            evaluatePlane(z, spheres, numberOfSpheres);
+        });
+    }
+
+    void MarchingCubes::classifyPlane(int z, float isoLevel)
+    {
+        const unsigned int count  = samplesPerAxis * samplesPerAxis;
+        const float*       values = &field[count * z];
+        unsigned char*     masks  = &inside[count * z];
+        unsigned int       i      = 0;
+
+        /* Compare 16 samples at a time and narrow the 32-bit comparison masks to bytes. */
+#if defined(MARCHING_CUBES_USE_NEON)
+        const float32x4_t level = vdupq_n_f32(isoLevel);
+
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint16x8_t low  = vcombine_u16(vmovn_u32(vcltq_f32(vld1q_f32(values + i),      level)),
+                                                 vmovn_u32(vcltq_f32(vld1q_f32(values + i + 4),  level)));
+            const uint16x8_t high = vcombine_u16(vmovn_u32(vcltq_f32(vld1q_f32(values + i + 8),  level)),
+                                                 vmovn_u32(vcltq_f32(vld1q_f32(values + i + 12), level)));
+
+            vst1q_u8(masks + i, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+#elif defined(MARCHING_CUBES_USE_SSE)
+        const __m128 level = _mm_set1_ps(isoLevel);
+
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i low  = _mm_packs_epi32(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i),      level)),
+                                                 _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 4),  level)));
+            const __m128i high = _mm_packs_epi32(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 8),  level)),
+                                                 _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 12), level)));
+
+            _mm_storeu_si128((__m128i*)(masks + i), _mm_packs_epi16(low, high));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            masks[i] = values[i] < isoLevel ? 0xFF : 0;
+        }
+    }
+
+    void MarchingCubes::countPlane(int z)
+    {
+        const int            planeSize   = samplesPerAxis * samplesPerAxis;
+        const unsigned char* plane       = &inside[planeSize * z];
+        const bool           lastPlane   = z == samplesPerAxis - 1;
+        unsigned int         vertexCount = 0;
+
+        /* A vertex is created on every edge between a sample inside and a sample outside. */
+        for (int y = 0; y < samplesPerAxis; y++)
+        {
+            for (int x = 0; x < samplesPerAxis; x++)
+            {
+                const int sample = x + samplesPerAxis * y;
+
+                vertexCount += (x + 1 < samplesPerAxis && plane[sample] != plane[sample + 1])              ? 1 : 0;
+                vertexCount += (y + 1 < samplesPerAxis && plane[sample] != plane[sample + samplesPerAxis]) ? 1 : 0;
+                vertexCount += (!lastPlane             && plane[sample] != plane[sample + planeSize])      ? 1 : 0;
+            }
+        }
+        planeVertices[z] = vertexCount;
+
+        if (lastPlane)
+        {
+            planeActiveCells[z] = 0;
+            planeIndices[z]     = 0;
+            return;
+        }
+
+        /* Cell type bit i is set if corner i of the cell is inside, as in the cell splitting shader. */
+        const int    cellsPerAxis = samplesPerAxis - 1;
+        unsigned int activeCount  = 0;
+        unsigned int indexCount   = 0;
+
+        for (int y = 0; y < cellsPerAxis; y++)
+        {
+            const unsigned char* row00 = plane + samplesPerAxis * y;
+            const unsigned char* row10 = row00 + samplesPerAxis;
+            const unsigned char* row01 = row00 + planeSize;
+            const unsigned char* row11 = row10 + planeSize;
+            unsigned char*       types = &cellTypes[cellsPerAxis * (y + cellsPerAxis * z)];
+            int                  x     = 0;
+
+#if defined(MARCHING_CUBES_USE_NEON)
+            for (; x + 16 <= cellsPerAxis; x += 16)
+            {
+                uint8x16_t type = vandq_u8(vld1q_u8(row00 + x), vdupq_n_u8(1));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row00 + x + 1), vdupq_n_u8(2)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row01 + x + 1), vdupq_n_u8(4)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row01 + x),     vdupq_n_u8(8)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row10 + x),     vdupq_n_u8(16)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row10 + x + 1), vdupq_n_u8(32)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row11 + x + 1), vdupq_n_u8(64)));
+                type = vorrq_u8(type, vandq_u8(vld1q_u8(row11 + x),     vdupq_n_u8(128)));
+                vst1q_u8(types + x, type);
+            }
+#elif defined(MARCHING_CUBES_USE_SSE)
+            for (; x + 16 <= cellsPerAxis; x += 16)
+            {
+                __m128i type = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row00 + x)), _mm_set1_epi8(1));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row00 + x + 1)), _mm_set1_epi8(2)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row01 + x + 1)), _mm_set1_epi8(4)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row01 + x)),     _mm_set1_epi8(8)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row10 + x)),     _mm_set1_epi8(16)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row10 + x + 1)), _mm_set1_epi8(32)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row11 + x + 1)), _mm_set1_epi8(64)));
+                type = _mm_or_si128(type, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row11 + x)),     _mm_set1_epi8((char)128)));
+                _mm_storeu_si128((__m128i*)(types + x), type);
+            }
+#endif
+            for (; x < cellsPerAxis; x++)
+            {
+                types[x] = (row00[x]     & 1)  | (row00[x + 1] & 2)  | (row01[x + 1] & 4)  | (row01[x] & 8)
+                         | (row10[x]     & 16) | (row10[x + 1] & 32) | (row11[x + 1] & 64) | (row11[x] & 128);
+            }
+
+            for (x = 0; x < cellsPerAxis; x++)
+            {
+                const unsigned int triangles = triangleCount[types[x]];
+
+                activeCount += triangles != 0 ? 1 : 0;
+                indexCount  += 3 * triangles;
+            }
+        }
+        planeActiveCells[z] = activeCount;
+        planeIndices[z]     = indexCount;
+    }
+
+    void MarchingCubes::getGradient(unsigned int sample, float* gradient) const
+    {
+        /* Central differences, clamped at the borders of the field. The distance between samples is 1 / (samplesPerAxis - 1). */
+        const float  scale      = 0.5f * float(samplesPerAxis - 1);
+        unsigned int coordinate = sample;
+        unsigned int stride     = 1;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const int          position = coordinate % samplesPerAxis;
+            const unsigned int previous = position > 0                  ? sample - stride : sample;
+            const unsigned int next     = position + 1 < samplesPerAxis ? sample + stride : sample;
+
+            gradient[axis] = (field[next] - field[previous]) * scale;
+
+            coordinate /= samplesPerAxis;
+            stride     *= samplesPerAxis;
+        }
+    }
+
+    void MarchingCubes::emitPlane(int z, float isoLevel)
+    {
+        const float        scale      = 1.0f / float(samplesPerAxis - 1);
+        const unsigned int planeSize  = samplesPerAxis * samplesPerAxis;
+        const unsigned int strides[3] = {1, (unsigned int)samplesPerAxis, planeSize};
+        unsigned int       vertex     = planeVertices[z];
+
+        /* Create the vertices in the same order as countPlane() counted them, starting at this plane's offset. */
+        for (int y = 0; y < samplesPerAxis; y++)
+        {
+            for (int x = 0; x < samplesPerAxis; x++)
+            {
+                const unsigned int sample      = x + samplesPerAxis * (y + samplesPerAxis * z);
+                const int          position[3] = {x, y, z};
+
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    if (position[axis] + 1 >= samplesPerAxis || inside[sample] == inside[sample + strides[axis]])
+                    {
+                        continue;
+                    }
+
+                    const unsigned int other = sample + strides[axis];
+                    const float        delta = fabsf(field[sample] - field[other]);
+                    /* Share of the sample at the start of the edge, as in the triangle generation shader. */
+                    const float        share = delta > epsilon ? fabsf(field[other] - isoLevel) / delta : 0.5f;
+                    float*             out   = &vertices[floatsPerVertex * vertex];
+                    float              startNormal[3];
+                    float              endNormal[3];
+
+                    getGradient(sample, startNormal);
+                    getGradient(other,  endNormal);
+
+                    for (int component = 0; component < 3; component++)
+                    {
+                        out[component]     = position[component] * scale + (component == axis ? (1.0f - share) * scale : 0.0f);
+                        out[3 + component] = endNormal[component] + (startNormal[component] - endNormal[component]) * share;
+                    }
+
+                    edgeVertices[3 * sample + axis] = vertex++;
+                }
+            }
+        }
+
+        if (z == samplesPerAxis - 1)
+        {
+            return;
+        }
+
+        /* Compact the cells that have triangles, and give each one its place in the index array. */
+        const int    cellsPerAxis = samplesPerAxis - 1;
+        unsigned int activeCell   = planeActiveCells[z];
+        unsigned int index        = planeIndices[z];
+
+        for (int y = 0; y < cellsPerAxis; y++)
+        {
+            const unsigned char* types = &cellTypes[cellsPerAxis * (y + cellsPerAxis * z)];
+
+            for (int x = 0; x < cellsPerAxis; x++)
+            {
+                if (triangleCount[types[x]] == 0)
+                {
+                    continue;
+                }
+
+                ActiveCell& cell = activeCells[activeCell++];
+
+                cell.sample     = x + samplesPerAxis * (y + samplesPerAxis * z);
+                cell.firstIndex = index;
+                cell.type       = types[x];
+
+                index += 3 * triangleCount[types[x]];
+            }
+        }
+    }
+
+    void MarchingCubes::emitTriangles(unsigned int begin, unsigned int end)
+    {
+        for (unsigned int activeCell = begin; activeCell < end; activeCell++)
+        {
+            const ActiveCell&  cell  = activeCells[activeCell];
+            const int*         edges = &triTable[15 * cell.type];
+            unsigned int*      out   = &indices[cell.firstIndex];
+            const unsigned int count = 3 * triangleCount[cell.type];
+
+            for (unsigned int i = 0; i < count; i++)
+            {
+                out[i] = edgeVertices[3 * (cell.sample + edgeSample[edges[i]]) + edgeAxis[edges[i]]];
+            }
+        }
+    }
+
+    void MarchingCubes::extract(float isoLevel)
+    {
+        forEachPlane(samplesPerAxis, [&](unsigned int z)
+        {
+            classifyPlane(z, isoLevel);
+        });
+
+        forEachPlane(samplesPerAxis, [&](unsigned int z)
+        {
+            countPlane(z);
+        });
+
+        /* Exclusive prefix sums turn the per plane counts into offsets in the output arrays. */
+        unsigned int vertexCount = 0;
+        unsigned int activeCount = 0;
+        unsigned int indexCount  = 0;
+
+        for (int z = 0; z < samplesPerAxis; z++)
+        {
+            const unsigned int planeVertexCount = planeVertices[z];
+            const unsigned int planeActiveCount = planeActiveCells[z];
+            const unsigned int planeIndexCount  = planeIndices[z];
+
+            planeVertices[z]    = vertexCount;
+            planeActiveCells[z] = activeCount;
+            planeIndices[z]     = indexCount;
+
+            vertexCount += planeVertexCount;
+            activeCount += planeActiveCount;
+            indexCount  += planeIndexCount;
+        }
+
+        vertices.resize(floatsPerVertex * vertexCount);
+        activeCells.resize(activeCount);
+        indices.resize(indexCount);
+
+        forEachPlane(samplesPerAxis, [&](unsigned int z)
+        {
+            emitPlane(z, isoLevel);
+        });
+
+        /* Vertices on all planes have to exist before the triangles of any cell can refer to them. */
+        std::function<void (unsigned int, unsigned int)> triangles = [&](unsigned int begin, unsigned int end)
+        {
+            emitTriangles(begin, end);
+        };
+
+        if (threadPool != NULL)
+        {
+            threadPool->parallelFor(activeCount, triangles, 256);
+        }
+        else
+        {
+            triangles(0, activeCount);
+        }
+    }
+}
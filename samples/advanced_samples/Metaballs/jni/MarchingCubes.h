@@ -0,0 +1,150 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MARCHING_CUBES_H
+#define MARCHING_CUBES_H
+
+#include "ThreadPool.h"
+
+#include <vector>
+
+namespace MaliSDK
+{
+    /**
+     * \brief CPU isosurface extraction with the Marching Cubes algorithm.
+     *
+     * Produces the same surface as the transform feedback stages of the Metaballs sample,
+     * from the same tables, but as an indexed mesh: vertices on edges shared by several cells
+     * are created once, and only cells that the isosurface passes through emit triangles.
+     *
+     * The field is sampled samplesPerAxis times along each axis of the [0..1] cube,
+     * and sample (x, y, z) is stored at x + samplesPerAxis * (y + samplesPerAxis * z).
+     * Work is split into planes of constant z, which are processed in parallel.
+     */
+    class MarchingCubes
+    {
+    public:
+        /** Number of floats per vertex: position followed by normal. */
+        static const int floatsPerVertex = 6;
+
+        /**
+         * \brief Triangles for each of the 256 cell types, as 5 triangles of 3 edge numbers each.
+         *
+         * Unused entries are -1. Bit i of a cell type is set if corner i of the cell is inside the isosurface.
+         */
+        static const int triTable[256 * 15];
+
+        /** Corners at the start and at the end of each of the 12 cell edges. */
+        static const int edgeCorners[12][2];
+
+        /** Offsets of the 8 cell corners from the cell origin. */
+        static const int cornerOffsets[8][3];
+
+        /**
+         * \brief Allocates the field and working memory.
+         * \param[in] samplesPerAxis Number of field samples along each axis. Has to be at least 2.
+         * \param[in] threadPool     Pool used to process planes in parallel. NULL processes them on the calling thread.
+         */
+        MarchingCubes(int samplesPerAxis, ThreadPool* threadPool = NULL);
+
+        /**
+         * \brief Computes the metaball field in every sample, the same way as the scalar field shader.
+         * \param[in] spheres         numberOfSpheres vec4 values: position in xyz and weight in w.
+         * \param[in] numberOfSpheres Number of spheres.
+         */
+        void evaluateField(const float* spheres, int numberOfSpheres);
+
+        /**
+         * \brief Returns the field samples, which can also be filled directly instead of calling evaluateField().
+         */
+        float* getField() { return &field[0]; }
+
+        /**
+         * \brief Builds the mesh of the isosurface of the current field.
+         * \param[in] isoLevel Field value at the surface. Samples with lower values are inside.
+         */
+        void extract(float isoLevel);
+
+        /**
+         * \brief Returns the cell types found by the last call to extract(), in the layout used for samples but with samplesPerAxis - 1 cells per axis.
+         */
+        const std::vector<unsigned char>& getCellTypes() const { return cellTypes; }
+
+        /**
+         * \brief Returns the vertices of the last extracted mesh, floatsPerVertex floats each.
+         *
+         * Positions are in the [0..1] cube. Normals are field gradients and are not normalized.
+         */
+        const std::vector<float>& getVertices() const { return vertices; }
+
+        /**
+         * \brief Returns three vertex indices for each triangle of the last extracted mesh.
+         */
+        const std::vector<unsigned int>& getIndices() const { return indices; }
+
+        /**
+         * \brief Returns the number of field samples along each axis.
+         */
+        int getSamplesPerAxis() const { return samplesPerAxis; }
+
+    private:
+        /** A cell the isosurface passes through. */
+        struct ActiveCell
+        {
+            unsigned int sample;     /**< Sample at the cell origin. */
+            unsigned int firstIndex; /**< Offset of the cell's triangles in indices. */
+            unsigned int type;       /**< Cell type. */
+        };
+
+        int samplesPerAxis;
+        ThreadPool* threadPool;
+
+        std::vector<float> field;
+        /* 0xFF for samples inside the isosurface, 0 for samples outside. */
+        std::vector<unsigned char> inside;
+        std::vector<unsigned char> cellTypes;
+        /* Index of the vertex on each of the three edges leaving a sample in the positive x, y and z directions. */
+        std::vector<unsigned int> edgeVertices;
+        std::vector<ActiveCell> activeCells;
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+
+        /* Per plane counts, turned into offsets by a prefix sum. */
+        std::vector<unsigned int> planeVertices;
+        std::vector<unsigned int> planeActiveCells;
+        std::vector<unsigned int> planeIndices;
+
+        /* Number of triangles of each cell type. */
+        unsigned char triangleCount[256];
+        /* Sample at the start of each cell edge, relative to the cell origin, and the axis the edge runs along. */
+        unsigned int edgeSample[12];
+        unsigned int edgeAxis[12];
+
+        void forEachPlane(unsigned int count, const std::function<void (unsigned int)>& function);
+
+        void evaluatePlane(int z, const float* spheres, int numberOfSpheres);
+        void classifyPlane(int z, float isoLevel);
+        void countPlane(int z);
+        void emitPlane(int z, float isoLevel);
+        void emitTriangles(unsigned int begin, unsigned int end);
+        void getGradient(unsigned int sample, float* gradient) const;
+    };
+}
+#endif /* MARCHING_CUBES_H */
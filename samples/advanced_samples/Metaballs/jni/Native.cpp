@@ -30,6 +30,9 @@
  * 3D textures are used to provide access to three dimentional arrays in shaders.
  *
  * For more information please see documentation.
+ *
+ * Setting use_cpu_mesher builds the surface on the CPU with MarchingCubes instead,
+ * as an indexed mesh that only contains triangles of cells the surface passes through.
  */
 
 #include <cstdio>
@@ -41,6 +44,7 @@
 #include "Shader.h"
 #include "Timer.h"
 #include "Matrix.h"
+#include "MarchingCubes.h"
 
 #include "GLES3/gl3.h"
 #include "EGL/egl.h"
@@ -48,6 +52,7 @@
 
 #include <string>
 #include <cmath>
+#include <chrono>
 
 #define LOG_TAG "libNative"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -763,6 +768,36 @@ const char* marching_cubes_triangles_frag_shader = "#version 300 es\n"
 "    FragColor = vec4(ambient_lighting + diffuse_reflection + specular_reflection, 1.0);\n"
 "}\n";
 
+/**
+ * Vertex shader used to render the mesh built on the CPU by MarchingCubes.
+ * It passes the same values to the fragment shader as the triangle generation vertex shader.
+ */
+const char* cpu_mesh_vert_shader                 = "#version 300 es\n"
+"\n"
+"/* Uniforms: */\n"
+"/** Model view projection matrix. */\n"
+"uniform mat4 mvp;\n"
+"\n"
+"/* Input data: */\n"
+"/** Vertex position in model space. */\n"
+"in vec3 vertex_position;\n"
+"/** Scalar field gradient in the vertex position. */\n"
+"in vec3 vertex_normal;\n"
+"\n"
+"/* Phong shading output variables for fragment shader. */\n"
+"out vec4 phong_vertex_position;      /**< position of the vertex in world space.  */\n"
+"out vec3 phong_vertex_normal_vector; /**< surface normal vector in world space.   */\n"
+"out vec3 phong_vertex_color;         /**< vertex color for fragment colorisation. */\n"
+"\n"
+"/** Shader entry point. */\n"
+"void main()\n"
+"{\n"
+"    gl_Position                = mvp * vec4(vertex_position, 1.0);\n"
+"    phong_vertex_position      = gl_Position;\n"
+"    phong_vertex_normal_vector = vertex_normal;\n"
+"    phong_vertex_color         = vec3(0.7);\n"
+"}\n";
+
 /* General metaballs example properties. */
 GLfloat      model_time        = 0.0f;  /**< Time (in seconds), increased each rendering iteration.                                         */
 const GLuint tesselation_level = 32;    /**< Level of details you would like to split model into. Please use values from th range [8..256]. */
@@ -770,6 +805,11 @@ GLfloat      isosurface_level  = 12.0f; /**< Scalar field's isosurface level.
 unsigned int window_width      = 256;   /**< Window width resolution (pixels).                                                              */
 unsigned int window_height     = 256;   /**< Window height resolution (pixels).                                                             */
 
+/* CPU mesher properties. */
+const bool   use_cpu_mesher        = false; /**< Build the surface on the CPU with MarchingCubes instead of using the transform feedback stages. */
+const GLuint cpu_tesselation_level = 128;   /**< Samples per axis used by the CPU mesher. Only cells the surface passes through produce triangles, so it can be much higher than tesselation_level. */
+const int    cpu_mesher_log_frames = 100;   /**< Amount of frames between reports of the CPU mesher's performance. */
+
 /* Marching Cubes algorithm-specific constants. */
 const GLuint samples_per_axis      = tesselation_level;                                      /**< Amount of samples we break scalar space into (per each axis). */
 const GLuint samples_in_3d_space   = samples_per_axis * samples_per_axis * samples_per_axis; /**< Amount of samples in 3D space. */
@@ -780,280 +820,8 @@ const GLuint triangles_per_cell    = 5;
 const GLuint mc_vertices_per_cell  = vertices_per_triangle * triangles_per_cell;             /**< Amount of vertices in tri_table representing triangles by vertices for one cell. */
 const GLuint mc_cells_types_count  = 256;                                                    /**< Amount of cell types. */
 
-/** The array that is used for cell triangularization.
- *  Each row in table represents one cell type. Each cell type contains up to 5 triangles.
- *  Each triangle is defined by 3 sequential vertices.
- *  These vertices are "middle" points of the cell edges specified in this table.
- *  For example cell type 0 (see first line) does not define any triangles,
- *  while cell type 1 (see second line) defines one triangle consisting of "middle" points of edges 0,8 and 3 of a cell.
- *  "Middle" points are base points and can be moved closer to edge beginning point or edge ending point.
- *  Edge numeration is according to the Marching Cubes algorithm.
- *  There are exactly 256 cell types due to each vertex having only 2 states: it can be below isosurface or above.
- *  Thus (having 8 corners for each cubic cell) we have 2^8 = 256 cell types.
- *
- *  Table data taken from http://paulbourke.net/geometry/polygonise/
- */
-/* [tri_table chosen part for documentation] */
-const GLint tri_table[mc_cells_types_count * mc_vertices_per_cell] =
-{
-  -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  1,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  8,  3,     9,  8,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-/* [tri_table chosen part for documentation] */
-   1,  2, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,     1,  2, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9,  2, 10,     0,  2,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   2,  8,  3,     2, 10,  8,    10,  9,  8,    -1, -1, -1,    -1, -1, -1,
-   3, 11,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0, 11,  2,     8, 11,  0,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  9,  0,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1, 11,  2,     1,  9, 11,     9,  8, 11,    -1, -1, -1,    -1, -1, -1,
-   3, 10,  1,    11, 10,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0, 10,  1,     0,  8, 10,     8, 11, 10,    -1, -1, -1,    -1, -1, -1,
-   3,  9,  0,     3, 11,  9,    11, 10,  9,    -1, -1, -1,    -1, -1, -1,
-   9,  8, 10,    10,  8, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  7,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  3,  0,     7,  3,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  1,  9,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  1,  9,     4,  7,  1,     7,  3,  1,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 10,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  4,  7,     3,  0,  4,     1,  2, 10,    -1, -1, -1,    -1, -1, -1,
-   9,  2, 10,     9,  0,  2,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,
-   2, 10,  9,     2,  9,  7,     2,  7,  3,     7,  9,  4,    -1, -1, -1,
-   8,  4,  7,     3, 11,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  11,  4,  7,    11,  2,  4,     2,  0,  4,    -1, -1, -1,    -1, -1, -1,
-   9,  0,  1,     8,  4,  7,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,
-   4,  7, 11,     9,  4, 11,     9, 11,  2,     9,  2,  1,    -1, -1, -1,
-   3, 10,  1,     3, 11, 10,     7,  8,  4,    -1, -1, -1,    -1, -1, -1,
-   1, 11, 10,     1,  4, 11,     1,  0,  4,     7, 11,  4,    -1, -1, -1,
-   4,  7,  8,     9,  0, 11,     9, 11, 10,    11,  0,  3,    -1, -1, -1,
-   4,  7, 11,     4, 11,  9,     9, 11, 10,    -1, -1, -1,    -1, -1, -1,
-   9,  5,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9,  5,  4,     0,  8,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  5,  4,     1,  5,  0,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   8,  5,  4,     8,  3,  5,     3,  1,  5,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 10,     9,  5,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  0,  8,     1,  2, 10,     4,  9,  5,    -1, -1, -1,    -1, -1, -1,
-   5,  2, 10,     5,  4,  2,     4,  0,  2,    -1, -1, -1,    -1, -1, -1,
-   2, 10,  5,     3,  2,  5,     3,  5,  4,     3,  4,  8,    -1, -1, -1,
-   9,  5,  4,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0, 11,  2,     0,  8, 11,     4,  9,  5,    -1, -1, -1,    -1, -1, -1,
-   0,  5,  4,     0,  1,  5,     2,  3, 11,    -1, -1, -1,    -1, -1, -1,
-   2,  1,  5,     2,  5,  8,     2,  8, 11,     4,  8,  5,    -1, -1, -1,
-  10,  3, 11,    10,  1,  3,     9,  5,  4,    -1, -1, -1,    -1, -1, -1,
-   4,  9,  5,     0,  8,  1,     8, 10,  1,     8, 11, 10,    -1, -1, -1,
-   5,  4,  0,     5,  0, 11,     5, 11, 10,    11,  0,  3,    -1, -1, -1,
-   5,  4,  8,     5,  8, 10,    10,  8, 11,    -1, -1, -1,    -1, -1, -1,
-   9,  7,  8,     5,  7,  9,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9,  3,  0,     9,  5,  3,     5,  7,  3,    -1, -1, -1,    -1, -1, -1,
-   0,  7,  8,     0,  1,  7,     1,  5,  7,    -1, -1, -1,    -1, -1, -1,
-   1,  5,  3,     3,  5,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9,  7,  8,     9,  5,  7,    10,  1,  2,    -1, -1, -1,    -1, -1, -1,
-  10,  1,  2,     9,  5,  0,     5,  3,  0,     5,  7,  3,    -1, -1, -1,
-   8,  0,  2,     8,  2,  5,     8,  5,  7,    10,  5,  2,    -1, -1, -1,
-   2, 10,  5,     2,  5,  3,     3,  5,  7,    -1, -1, -1,    -1, -1, -1,
-   7,  9,  5,     7,  8,  9,     3, 11,  2,    -1, -1, -1,    -1, -1, -1,
-   9,  5,  7,     9,  7,  2,     9,  2,  0,     2,  7, 11,    -1, -1, -1,
-   2,  3, 11,     0,  1,  8,     1,  7,  8,     1,  5,  7,    -1, -1, -1,
-  11,  2,  1,    11,  1,  7,     7,  1,  5,    -1, -1, -1,    -1, -1, -1,
-   9,  5,  8,     8,  5,  7,    10,  1,  3,    10,  3, 11,    -1, -1, -1,
-   5,  7,  0,     5,  0,  9,     7, 11,  0,     1,  0, 10,    11, 10,  0,
-  11, 10,  0,    11,  0,  3,    10,  5,  0,     8,  0,  7,     5,  7,  0,
-  11, 10,  5,     7, 11,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  10,  6,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9,  0,  1,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  8,  3,     1,  9,  8,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,
-   1,  6,  5,     2,  6,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  6,  5,     1,  2,  6,     3,  0,  8,    -1, -1, -1,    -1, -1, -1,
-   9,  6,  5,     9,  0,  6,     0,  2,  6,    -1, -1, -1,    -1, -1, -1,
-   5,  9,  8,     5,  8,  2,     5,  2,  6,     3,  2,  8,    -1, -1, -1,
-   2,  3, 11,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  11,  0,  8,    11,  2,  0,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,
-   0,  1,  9,     2,  3, 11,     5, 10,  6,    -1, -1, -1,    -1, -1, -1,
-   5, 10,  6,     1,  9,  2,     9, 11,  2,     9,  8, 11,    -1, -1, -1,
-   6,  3, 11,     6,  5,  3,     5,  1,  3,    -1, -1, -1,    -1, -1, -1,
-   0,  8, 11,     0, 11,  5,     0,  5,  1,     5, 11,  6,    -1, -1, -1,
-   3, 11,  6,     0,  3,  6,     0,  6,  5,     0,  5,  9,    -1, -1, -1,
-   6,  5,  9,     6,  9, 11,    11,  9,  8,    -1, -1, -1,    -1, -1, -1,
-   5, 10,  6,     4,  7,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  3,  0,     4,  7,  3,     6,  5, 10,    -1, -1, -1,    -1, -1, -1,
-   1,  9,  0,     5, 10,  6,     8,  4,  7,    -1, -1, -1,    -1, -1, -1,
-  10,  6,  5,     1,  9,  7,     1,  7,  3,     7,  9,  4,    -1, -1, -1,
-   6,  1,  2,     6,  5,  1,     4,  7,  8,    -1, -1, -1,    -1, -1, -1,
-   1,  2,  5,     5,  2,  6,     3,  0,  4,     3,  4,  7,    -1, -1, -1,
-   8,  4,  7,     9,  0,  5,     0,  6,  5,     0,  2,  6,    -1, -1, -1,
-   7,  3,  9,     7,  9,  4,     3,  2,  9,     5,  9,  6,     2,  6,  9,
-   3, 11,  2,     7,  8,  4,    10,  6,  5,    -1, -1, -1,    -1, -1, -1,
-   5, 10,  6,     4,  7,  2,     4,  2,  0,     2,  7, 11,    -1, -1, -1,
-   0,  1,  9,     4,  7,  8,     2,  3, 11,     5, 10,  6,    -1, -1, -1,
-   9,  2,  1,     9, 11,  2,     9,  4, 11,     7, 11,  4,     5, 10,  6,
-   8,  4,  7,     3, 11,  5,     3,  5,  1,     5, 11,  6,    -1, -1, -1,
-   5,  1, 11,     5, 11,  6,     1,  0, 11,     7, 11,  4,     0,  4, 11,
-   0,  5,  9,     0,  6,  5,     0,  3,  6,    11,  6,  3,     8,  4,  7,
-   6,  5,  9,     6,  9, 11,     4,  7,  9,     7, 11,  9,    -1, -1, -1,
-  10,  4,  9,     6,  4, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4, 10,  6,     4,  9, 10,     0,  8,  3,    -1, -1, -1,    -1, -1, -1,
-  10,  0,  1,    10,  6,  0,     6,  4,  0,    -1, -1, -1,    -1, -1, -1,
-   8,  3,  1,     8,  1,  6,     8,  6,  4,     6,  1, 10,    -1, -1, -1,
-   1,  4,  9,     1,  2,  4,     2,  6,  4,    -1, -1, -1,    -1, -1, -1,
-   3,  0,  8,     1,  2,  9,     2,  4,  9,     2,  6,  4,    -1, -1, -1,
-   0,  2,  4,     4,  2,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   8,  3,  2,     8,  2,  4,     4,  2,  6,    -1, -1, -1,    -1, -1, -1,
-  10,  4,  9,    10,  6,  4,    11,  2,  3,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  2,     2,  8, 11,     4,  9, 10,     4, 10,  6,    -1, -1, -1,
-   3, 11,  2,     0,  1,  6,     0,  6,  4,     6,  1, 10,    -1, -1, -1,
-   6,  4,  1,     6,  1, 10,     4,  8,  1,     2,  1, 11,     8, 11,  1,
-   9,  6,  4,     9,  3,  6,     9,  1,  3,    11,  6,  3,    -1, -1, -1,
-   8, 11,  1,     8,  1,  0,    11,  6,  1,     9,  1,  4,     6,  4,  1,
-   3, 11,  6,     3,  6,  0,     0,  6,  4,    -1, -1, -1,    -1, -1, -1,
-   6,  4,  8,    11,  6,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   7, 10,  6,     7,  8, 10,     8,  9, 10,    -1, -1, -1,    -1, -1, -1,
-   0,  7,  3,     0, 10,  7,     0,  9, 10,     6,  7, 10,    -1, -1, -1,
-  10,  6,  7,     1, 10,  7,     1,  7,  8,     1,  8,  0,    -1, -1, -1,
-  10,  6,  7,    10,  7,  1,     1,  7,  3,    -1, -1, -1,    -1, -1, -1,
-   1,  2,  6,     1,  6,  8,     1,  8,  9,     8,  6,  7,    -1, -1, -1,
-   2,  6,  9,     2,  9,  1,     6,  7,  9,     0,  9,  3,     7,  3,  9,
-   7,  8,  0,     7,  0,  6,     6,  0,  2,    -1, -1, -1,    -1, -1, -1,
-   7,  3,  2,     6,  7,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   2,  3, 11,    10,  6,  8,    10,  8,  9,     8,  6,  7,    -1, -1, -1,
-   2,  0,  7,     2,  7, 11,     0,  9,  7,     6,  7, 10,     9, 10,  7,
-   1,  8,  0,     1,  7,  8,     1, 10,  7,     6,  7, 10,     2,  3, 11,
-  11,  2,  1,    11,  1,  7,    10,  6,  1,     6,  7,  1,    -1, -1, -1,
-   8,  9,  6,     8,  6,  7,     9,  1,  6,    11,  6,  3,     1,  3,  6,
-   0,  9,  1,    11,  6,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   7,  8,  0,     7,  0,  6,     3, 11,  0,    11,  6,  0,    -1, -1, -1,
-   7, 11,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   7,  6, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  0,  8,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  1,  9,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   8,  1,  9,     8,  3,  1,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,
-  10,  1,  2,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 10,     3,  0,  8,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,
-   2,  9,  0,     2, 10,  9,     6, 11,  7,    -1, -1, -1,    -1, -1, -1,
-   6, 11,  7,     2, 10,  3,    10,  8,  3,    10,  9,  8,    -1, -1, -1,
-   7,  2,  3,     6,  2,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   7,  0,  8,     7,  6,  0,     6,  2,  0,    -1, -1, -1,    -1, -1, -1,
-   2,  7,  6,     2,  3,  7,     0,  1,  9,    -1, -1, -1,    -1, -1, -1,
-   1,  6,  2,     1,  8,  6,     1,  9,  8,     8,  7,  6,    -1, -1, -1,
-  10,  7,  6,    10,  1,  7,     1,  3,  7,    -1, -1, -1,    -1, -1, -1,
-  10,  7,  6,     1,  7, 10,     1,  8,  7,     1,  0,  8,    -1, -1, -1,
-   0,  3,  7,     0,  7, 10,     0, 10,  9,     6, 10,  7,    -1, -1, -1,
-   7,  6, 10,     7, 10,  8,     8, 10,  9,    -1, -1, -1,    -1, -1, -1,
-   6,  8,  4,    11,  8,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  6, 11,     3,  0,  6,     0,  4,  6,    -1, -1, -1,    -1, -1, -1,
-   8,  6, 11,     8,  4,  6,     9,  0,  1,    -1, -1, -1,    -1, -1, -1,
-   9,  4,  6,     9,  6,  3,     9,  3,  1,    11,  3,  6,    -1, -1, -1,
-   6,  8,  4,     6, 11,  8,     2, 10,  1,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 10,     3,  0, 11,     0,  6, 11,     0,  4,  6,    -1, -1, -1,
-   4, 11,  8,     4,  6, 11,     0,  2,  9,     2, 10,  9,    -1, -1, -1,
-  10,  9,  3,    10,  3,  2,     9,  4,  3,    11,  3,  6,     4,  6,  3,
-   8,  2,  3,     8,  4,  2,     4,  6,  2,    -1, -1, -1,    -1, -1, -1,
-   0,  4,  2,     4,  6,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  9,  0,     2,  3,  4,     2,  4,  6,     4,  3,  8,    -1, -1, -1,
-   1,  9,  4,     1,  4,  2,     2,  4,  6,    -1, -1, -1,    -1, -1, -1,
-   8,  1,  3,     8,  6,  1,     8,  4,  6,     6, 10,  1,    -1, -1, -1,
-  10,  1,  0,    10,  0,  6,     6,  0,  4,    -1, -1, -1,    -1, -1, -1,
-   4,  6,  3,     4,  3,  8,     6, 10,  3,     0,  3,  9,    10,  9,  3,
-  10,  9,  4,     6, 10,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  9,  5,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,     4,  9,  5,    11,  7,  6,    -1, -1, -1,    -1, -1, -1,
-   5,  0,  1,     5,  4,  0,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,
-  11,  7,  6,     8,  3,  4,     3,  5,  4,     3,  1,  5,    -1, -1, -1,
-   9,  5,  4,    10,  1,  2,     7,  6, 11,    -1, -1, -1,    -1, -1, -1,
-   6, 11,  7,     1,  2, 10,     0,  8,  3,     4,  9,  5,    -1, -1, -1,
-   7,  6, 11,     5,  4, 10,     4,  2, 10,     4,  0,  2,    -1, -1, -1,
-   3,  4,  8,     3,  5,  4,     3,  2,  5,    10,  5,  2,    11,  7,  6,
-   7,  2,  3,     7,  6,  2,     5,  4,  9,    -1, -1, -1,    -1, -1, -1,
-   9,  5,  4,     0,  8,  6,     0,  6,  2,     6,  8,  7,    -1, -1, -1,
-   3,  6,  2,     3,  7,  6,     1,  5,  0,     5,  4,  0,    -1, -1, -1,
-   6,  2,  8,     6,  8,  7,     2,  1,  8,     4,  8,  5,     1,  5,  8,
-   9,  5,  4,    10,  1,  6,     1,  7,  6,     1,  3,  7,    -1, -1, -1,
-   1,  6, 10,     1,  7,  6,     1,  0,  7,     8,  7,  0,     9,  5,  4,
-   4,  0, 10,     4, 10,  5,     0,  3, 10,     6, 10,  7,     3,  7, 10,
-   7,  6, 10,     7, 10,  8,     5,  4, 10,     4,  8, 10,    -1, -1, -1,
-   6,  9,  5,     6, 11,  9,    11,  8,  9,    -1, -1, -1,    -1, -1, -1,
-   3,  6, 11,     0,  6,  3,     0,  5,  6,     0,  9,  5,    -1, -1, -1,
-   0, 11,  8,     0,  5, 11,     0,  1,  5,     5,  6, 11,    -1, -1, -1,
-   6, 11,  3,     6,  3,  5,     5,  3,  1,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 10,     9,  5, 11,     9, 11,  8,    11,  5,  6,    -1, -1, -1,
-   0, 11,  3,     0,  6, 11,     0,  9,  6,     5,  6,  9,     1,  2, 10,
-  11,  8,  5,    11,  5,  6,     8,  0,  5,    10,  5,  2,     0,  2,  5,
-   6, 11,  3,     6,  3,  5,     2, 10,  3,    10,  5,  3,    -1, -1, -1,
-   5,  8,  9,     5,  2,  8,     5,  6,  2,     3,  8,  2,    -1, -1, -1,
-   9,  5,  6,     9,  6,  0,     0,  6,  2,    -1, -1, -1,    -1, -1, -1,
-   1,  5,  8,     1,  8,  0,     5,  6,  8,     3,  8,  2,     6,  2,  8,
-   1,  5,  6,     2,  1,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  3,  6,     1,  6, 10,     3,  8,  6,     5,  6,  9,     8,  9,  6,
-  10,  1,  0,    10,  0,  6,     9,  5,  0,     5,  6,  0,    -1, -1, -1,
-   0,  3,  8,     5,  6, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  10,  5,  6,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  11,  5, 10,     7,  5, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  11,  5, 10,    11,  7,  5,     8,  3,  0,    -1, -1, -1,    -1, -1, -1,
-   5, 11,  7,     5, 10, 11,     1,  9,  0,    -1, -1, -1,    -1, -1, -1,
-  10,  7,  5,    10, 11,  7,     9,  8,  1,     8,  3,  1,    -1, -1, -1,
-  11,  1,  2,    11,  7,  1,     7,  5,  1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,     1,  2,  7,     1,  7,  5,     7,  2, 11,    -1, -1, -1,
-   9,  7,  5,     9,  2,  7,     9,  0,  2,     2, 11,  7,    -1, -1, -1,
-   7,  5,  2,     7,  2, 11,     5,  9,  2,     3,  2,  8,     9,  8,  2,
-   2,  5, 10,     2,  3,  5,     3,  7,  5,    -1, -1, -1,    -1, -1, -1,
-   8,  2,  0,     8,  5,  2,     8,  7,  5,    10,  2,  5,    -1, -1, -1,
-   9,  0,  1,     5, 10,  3,     5,  3,  7,     3, 10,  2,    -1, -1, -1,
-   9,  8,  2,     9,  2,  1,     8,  7,  2,    10,  2,  5,     7,  5,  2,
-   1,  3,  5,     3,  7,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  7,     0,  7,  1,     1,  7,  5,    -1, -1, -1,    -1, -1, -1,
-   9,  0,  3,     9,  3,  5,     5,  3,  7,    -1, -1, -1,    -1, -1, -1,
-   9,  8,  7,     5,  9,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   5,  8,  4,     5, 10,  8,    10, 11,  8,    -1, -1, -1,    -1, -1, -1,
-   5,  0,  4,     5, 11,  0,     5, 10, 11,    11,  3,  0,    -1, -1, -1,
-   0,  1,  9,     8,  4, 10,     8, 10, 11,    10,  4,  5,    -1, -1, -1,
-  10, 11,  4,    10,  4,  5,    11,  3,  4,     9,  4,  1,     3,  1,  4,
-   2,  5,  1,     2,  8,  5,     2, 11,  8,     4,  5,  8,    -1, -1, -1,
-   0,  4, 11,     0, 11,  3,     4,  5, 11,     2, 11,  1,     5,  1, 11,
-   0,  2,  5,     0,  5,  9,     2, 11,  5,     4,  5,  8,    11,  8,  5,
-   9,  4,  5,     2, 11,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   2,  5, 10,     3,  5,  2,     3,  4,  5,     3,  8,  4,    -1, -1, -1,
-   5, 10,  2,     5,  2,  4,     4,  2,  0,    -1, -1, -1,    -1, -1, -1,
-   3, 10,  2,     3,  5, 10,     3,  8,  5,     4,  5,  8,     0,  1,  9,
-   5, 10,  2,     5,  2,  4,     1,  9,  2,     9,  4,  2,    -1, -1, -1,
-   8,  4,  5,     8,  5,  3,     3,  5,  1,    -1, -1, -1,    -1, -1, -1,
-   0,  4,  5,     1,  0,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   8,  4,  5,     8,  5,  3,     9,  0,  5,     0,  3,  5,    -1, -1, -1,
-   9,  4,  5,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4, 11,  7,     4,  9, 11,     9, 10, 11,    -1, -1, -1,    -1, -1, -1,
-   0,  8,  3,     4,  9,  7,     9, 11,  7,     9, 10, 11,    -1, -1, -1,
-   1, 10, 11,     1, 11,  4,     1,  4,  0,     7,  4, 11,    -1, -1, -1,
-   3,  1,  4,     3,  4,  8,     1, 10,  4,     7,  4, 11,    10, 11,  4,
-   4, 11,  7,     9, 11,  4,     9,  2, 11,     9,  1,  2,    -1, -1, -1,
-   9,  7,  4,     9, 11,  7,     9,  1, 11,     2, 11,  1,     0,  8,  3,
-  11,  7,  4,    11,  4,  2,     2,  4,  0,    -1, -1, -1,    -1, -1, -1,
-  11,  7,  4,    11,  4,  2,     8,  3,  4,     3,  2,  4,    -1, -1, -1,
-   2,  9, 10,     2,  7,  9,     2,  3,  7,     7,  4,  9,    -1, -1, -1,
-   9, 10,  7,     9,  7,  4,    10,  2,  7,     8,  7,  0,     2,  0,  7,
-   3,  7, 10,     3, 10,  2,     7,  4, 10,     1, 10,  0,     4,  0, 10,
-   1, 10,  2,     8,  7,  4,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  9,  1,     4,  1,  7,     7,  1,  3,    -1, -1, -1,    -1, -1, -1,
-   4,  9,  1,     4,  1,  7,     0,  8,  1,     8,  7,  1,    -1, -1, -1,
-   4,  0,  3,     7,  4,  3,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   4,  8,  7,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   9, 10,  8,    10, 11,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  0,  9,     3,  9, 11,    11,  9, 10,    -1, -1, -1,    -1, -1, -1,
-   0,  1, 10,     0, 10,  8,     8, 10, 11,    -1, -1, -1,    -1, -1, -1,
-   3,  1, 10,    11,  3, 10,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  2, 11,     1, 11,  9,     9, 11,  8,    -1, -1, -1,    -1, -1, -1,
-   3,  0,  9,     3,  9, 11,     1,  2,  9,     2, 11,  9,    -1, -1, -1,
-   0,  2, 11,     8,  0, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   3,  2, 11,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   2,  3,  8,     2,  8, 10,    10,  8,  9,    -1, -1, -1,    -1, -1, -1,
-   9, 10,  2,     0,  9,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   2,  3,  8,     2,  8, 10,     0,  1,  8,     1, 10,  8,    -1, -1, -1,
-   1, 10,  2,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   1,  3,  8,     9,  1,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  9,  1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-   0,  3,  8,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,
-  -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1,    -1, -1, -1
-};
+/** The array that is used for cell triangularization (see MarchingCubes::triTable). The CPU mesher uses the same table. */
+const GLint* const tri_table = MarchingCubes::triTable;
 
 /** Instance of a timer to measure time moments. */
 Timer timer;
@@ -1064,6 +832,27 @@ const int n_spheres = 3;
 /** Amount of components in sphere position varying. */
 const int n_sphere_position_components = 4;
 
+/** Parameters of a single sphere moving across the scalar field. */
+struct sphere_descriptor
+{
+    /* Coefficients for Lissajou equations. Current coordinates calculated by formula:
+     * v(t) = start_center + lissajou_amplitude * sin(lissajou_frequency * t + lissajou_phase) */
+    float start_center[3];       /**< Center in space around which sphere moves.              */
+    float lissajou_amplitude[3]; /**< Lissajou equation amplitudes for all axes.              */
+    float lissajou_frequency[3]; /**< Lissajou equation frequencies for all axes, in degrees. */
+    float lissajou_phase[3];     /**< Lissajou equation phases for all axes, in degrees.      */
+    float size;                  /**< Size of a sphere (weight or charge).                    */
+};
+
+/** Spheres used by the CPU mesher. This data should be synchronized with spheres_updater_vert_shader. */
+const sphere_descriptor cpu_spheres[n_spheres] =
+{
+    /* (---- center ----)   (--- amplitude --)   (--- frequency ---)   (----- phase -----) (weight) */
+    { {0.50, 0.50, 0.50}, {0.20, 0.25, 0.25}, { 11.0, 21.0, 31.0}, { 30.0, 45.0, 90.0},  0.100 },
+    { {0.50, 0.50, 0.50}, {0.25, 0.20, 0.25}, { 22.0, 32.0, 12.0}, { 45.0, 90.0,120.0},  0.050 },
+    { {0.50, 0.50, 0.50}, {0.25, 0.25, 0.20}, { 33.0, 13.0, 23.0}, { 90.0,120.0,150.0},  0.250 }
+};
+
 /** Matrix that transforms vertices from model space to perspective projected world space. */
 Matrix        mvp;
 
@@ -1213,6 +1002,35 @@ GLuint        marching_cubes_triangles_lookup_table_texture_id           = 0;
 GLuint        marching_cubes_triangles_vao_id                            = 0;
 
 
+/* CPU mesher variable data. */
+/** Worker threads used by the CPU mesher. */
+ThreadPool*    cpu_mesher_thread_pool                                    = NULL;
+/** Isosurface extraction on the CPU. */
+MarchingCubes* cpu_mesher                                                = NULL;
+
+/** Program object id for rendering the CPU mesh. */
+GLuint        cpu_mesh_program_id                                        = 0;
+/** Vertex shader id for rendering the CPU mesh. The fragment shader of the triangle generation stage is reused. */
+GLuint        cpu_mesh_vert_shader_id                                    = 0;
+
+/** Location of mvp uniform for rendering the CPU mesh. */
+GLint         cpu_mesh_uniform_mvp_id                                    = 0;
+/** Location of time uniform for rendering the CPU mesh. */
+GLint         cpu_mesh_uniform_time_id                                   = 0;
+
+/** Buffer object id to hold CPU mesh vertices. */
+GLuint        cpu_mesh_vertex_buffer_object_id                           = 0;
+/** Buffer object id to hold CPU mesh indices. */
+GLuint        cpu_mesh_index_buffer_object_id                            = 0;
+/** Id of vertex array object for rendering the CPU mesh. */
+GLuint        cpu_mesh_vao_id                                            = 0;
+
+/** Time (in milliseconds) spent by the CPU mesher since the last report. */
+double        cpu_mesher_milliseconds                                    = 0.0;
+/** Amount of frames meshed on the CPU since the last report. */
+int           cpu_mesher_frames                                          = 0;
+
+
 /** Calculates combined model view and projection matrix.
  *
  *  @param mvp combined mvp matrix
@@ -1248,6 +1066,126 @@ void calc_mvp(Matrix& mvp)
 }
 
 
+/** Calculates sphere positions at the specified time moment, the same way as spheres_updater_vert_shader.
+ *
+ *  @param time      time moment
+ *  @param positions n_spheres positions, with sphere weight stored in w-coordinate
+ */
+void calc_sphere_positions(float time, float* positions)
+{
+    const float degrees_to_radians = atanf(1) / 45;
+
+    for (int sphere = 0; sphere < n_spheres; sphere++)
+    {
+        const sphere_descriptor& descriptor = cpu_spheres[sphere];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            positions[n_sphere_position_components * sphere + axis] = descriptor.start_center[axis]
+                                                                    + descriptor.lissajou_amplitude[axis]
+                                                                    * sinf(degrees_to_radians * (descriptor.lissajou_frequency[axis] * time + descriptor.lissajou_phase[axis]));
+        }
+        positions[n_sphere_position_components * sphere + 3] = descriptor.size;
+    }
+}
+
+/** Creates the CPU mesher and the program, buffers and vertex array object used to render its mesh.
+ *  Must be called after the triangle generation stage is set up, as its fragment shader is reused.
+ */
+void setup_cpu_mesher()
+{
+    cpu_mesher_thread_pool = new ThreadPool();
+    cpu_mesher             = new MarchingCubes(cpu_tesselation_level, cpu_mesher_thread_pool);
+
+    /* Create a program object from the CPU mesh vertex shader and the triangle generation stage fragment shader. */
+    cpu_mesh_program_id = GL_CHECK(glCreateProgram());
+
+    Shader::processShader(&cpu_mesh_vert_shader_id, cpu_mesh_vert_shader, GL_VERTEX_SHADER);
+
+    GL_CHECK(glAttachShader(cpu_mesh_program_id, cpu_mesh_vert_shader_id                ));
+    GL_CHECK(glAttachShader(cpu_mesh_program_id, marching_cubes_triangles_frag_shader_id));
+    GL_CHECK(glLinkProgram (cpu_mesh_program_id));
+
+    /* Get input uniform and attribute locations. */
+    cpu_mesh_uniform_mvp_id  = GL_CHECK(glGetUniformLocation(cpu_mesh_program_id, "mvp" ));
+    cpu_mesh_uniform_time_id = GL_CHECK(glGetUniformLocation(cpu_mesh_program_id, "time"));
+
+    GLint position_attribute_id = GL_CHECK(glGetAttribLocation(cpu_mesh_program_id, "vertex_position"));
+    GLint normal_attribute_id   = GL_CHECK(glGetAttribLocation(cpu_mesh_program_id, "vertex_normal"  ));
+
+    /* Initialize uniforms constant throughout rendering loop. */
+    GL_CHECK(glUseProgram      (cpu_mesh_program_id));
+    GL_CHECK(glUniformMatrix4fv(cpu_mesh_uniform_mvp_id, 1, GL_FALSE, mvp.getAsArray()));
+
+    /* The buffers are filled every frame, as the size of the mesh changes. */
+    GL_CHECK(glGenBuffers     (1, &cpu_mesh_vertex_buffer_object_id));
+    GL_CHECK(glGenBuffers     (1, &cpu_mesh_index_buffer_object_id ));
+    GL_CHECK(glGenVertexArrays(1, &cpu_mesh_vao_id                 ));
+
+    GL_CHECK(glBindVertexArray(cpu_mesh_vao_id));
+    GL_CHECK(glBindBuffer     (GL_ARRAY_BUFFER,         cpu_mesh_vertex_buffer_object_id));
+    GL_CHECK(glBindBuffer     (GL_ELEMENT_ARRAY_BUFFER, cpu_mesh_index_buffer_object_id ));
+
+    /* Vertices hold a position followed by a normal vector. */
+    const GLsizei stride = MarchingCubes::floatsPerVertex * sizeof(GLfloat);
+
+    GL_CHECK(glEnableVertexAttribArray(position_attribute_id));
+    GL_CHECK(glVertexAttribPointer    (position_attribute_id, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*) 0));
+    GL_CHECK(glEnableVertexAttribArray(normal_attribute_id  ));
+    GL_CHECK(glVertexAttribPointer    (normal_attribute_id,   3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(3 * sizeof(GLfloat))));
+
+    /* Restore the vertex array object used by the transform feedback stages. */
+    GL_CHECK(glBindVertexArray(marching_cubes_triangles_vao_id));
+}
+
+/** Builds the isosurface on the CPU for the current time moment and renders it. */
+void render_cpu_mesh()
+{
+    /* Calculate sphere positions and build the mesh. */
+    GLfloat sphere_positions[n_spheres * n_sphere_position_components];
+
+    calc_sphere_positions(model_time, sphere_positions);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    cpu_mesher->evaluateField(sphere_positions, n_spheres);
+    cpu_mesher->extract(isosurface_level);
+
+    cpu_mesher_milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const std::vector<float>&        vertices = cpu_mesher->getVertices();
+    const std::vector<unsigned int>& indices  = cpu_mesher->getIndices();
+
+    /* Upload the mesh. */
+    GL_CHECK(glBindVertexArray(cpu_mesh_vao_id));
+    GL_CHECK(glBindBuffer     (GL_ARRAY_BUFFER, cpu_mesh_vertex_buffer_object_id));
+    GL_CHECK(glBufferData     (GL_ARRAY_BUFFER,
+                               vertices.size() * sizeof(GLfloat),
+                               vertices.empty() ? NULL : &vertices[0],
+                               GL_STREAM_DRAW));
+    GL_CHECK(glBufferData     (GL_ELEMENT_ARRAY_BUFFER,
+                               indices.size() * sizeof(GLuint),
+                               indices.empty() ? NULL : &indices[0],
+                               GL_STREAM_DRAW));
+
+    /* Render the mesh. */
+    GL_CHECK(glUseProgram  (cpu_mesh_program_id));
+    GL_CHECK(glUniform1f   (cpu_mesh_uniform_time_id, model_time));
+    GL_CHECK(glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0));
+
+    if (++cpu_mesher_frames == cpu_mesher_log_frames)
+    {
+        LOGI("CPU mesher: %u samples per axis, %u triangles, %.2f ms per frame on %u threads.\n",
+             cpu_tesselation_level,
+             (unsigned int)(indices.size() / 3),
+             cpu_mesher_milliseconds / cpu_mesher_frames,
+             cpu_mesher_thread_pool->getNumberOfThreads());
+
+        cpu_mesher_milliseconds = 0.0;
+        cpu_mesher_frames       = 0;
+    }
+}
+
 /** Initialises OpenGL ES and model environments.
  *
  *  @param width  window width reported by operating system
@@ -1528,6 +1466,11 @@ void setupGraphics(int width, int height)
     GL_CHECK(glEnable   (GL_CULL_FACE ));
     GL_CHECK(glFrontFace(GL_CW        ));
 
+    if (use_cpu_mesher)
+    {
+        setup_cpu_mesher();
+    }
+
     /* Start counting time. */
     timer.reset();
 }
@@ -1544,6 +1487,13 @@ void renderFrame(void)
     /* Clear the buffers that we are going to render to in a moment. */
     GL_CHECK(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
+    if (use_cpu_mesher)
+    {
+        /* The CPU mesher replaces all four transform feedback stages. */
+        render_cpu_mesh();
+        return;
+    }
+
     /* [Stage 1 Calculate sphere positions stage] */
     /* 1. Calculate sphere positions stage.
      *
@@ -1718,6 +1668,11 @@ void renderFrame(void)
 /** Deinitialises OpenGL ES environment. */
 void cleanup()
 {
+    GL_CHECK(glDeleteVertexArrays      (1, &cpu_mesh_vao_id                                  ));
+    GL_CHECK(glDeleteBuffers           (1, &cpu_mesh_index_buffer_object_id                  ));
+    GL_CHECK(glDeleteBuffers           (1, &cpu_mesh_vertex_buffer_object_id                 ));
+    GL_CHECK(glDeleteShader            (    cpu_mesh_vert_shader_id                          ));
+    GL_CHECK(glDeleteProgram           (    cpu_mesh_program_id                              ));
     GL_CHECK(glDeleteVertexArrays      (1, &marching_cubes_triangles_vao_id                  ));
     GL_CHECK(glDeleteShader            (    marching_cubes_triangles_frag_shader_id          ));
     GL_CHECK(glDeleteShader            (    marching_cubes_triangles_vert_shader_id          ));
@@ -1740,6 +1695,11 @@ void cleanup()
     GL_CHECK(glDeleteShader            (    spheres_updater_frag_shader_id                   ));
     GL_CHECK(glDeleteShader            (    spheres_updater_vert_shader_id                   ));
     GL_CHECK(glDeleteProgram           (    spheres_updater_program_id                       ));
+
+    delete cpu_mesher;
+    cpu_mesher = NULL;
+    delete cpu_mesher_thread_pool;
+    cpu_mesher_thread_pool = NULL;
 }
 
 
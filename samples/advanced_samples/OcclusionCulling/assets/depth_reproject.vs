@@ -0,0 +1,49 @@
+#version 310 es
+
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Used by Hi-Z culler to reproject last frame's depth map into the current view.
+// One point is drawn for every texel of the previous depth map.
+
+precision highp float;
+
+layout(location = 0) uniform mat4 uInvPrevVP;
+layout(location = 1) uniform mat4 uVP;
+layout(binding = 0) uniform highp sampler2D uPrevDepth;
+
+void main()
+{
+    ivec2 size = textureSize(uPrevDepth, 0);
+    ivec2 coord = ivec2(gl_VertexID % size.x, gl_VertexID / size.x);
+    float depth = texelFetch(uPrevDepth, coord, 0).x;
+
+    // Reconstruct the world space position seen by the texel in the previous frame.
+    vec2 ndc = (vec2(coord) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec4 world = uInvPrevVP * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    gl_Position = uVP * vec4(world.xyz / world.w, 1.0);
+    gl_PointSize = 1.0;
+
+    // Texels which did not see any occluder carry no information, so move them outside the clip volume.
+    if (depth >= 1.0)
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    }
+}
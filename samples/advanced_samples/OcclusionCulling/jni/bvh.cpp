@@ -0,0 +1,406 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bvh.hpp"
+#include <algorithm>
+#include <float.h>
+
+using namespace std;
+
+// Maximum number of primitives in a leaf.
+#define BVH_LEAF_SIZE 4
+
+// The top of the tree is split until there are this many subtrees per thread to build in parallel.
+#define BVH_SUBTREES_PER_THREAD 4
+
+// Rebuild instead of refitting when the surface area heuristic has grown this much since the last build.
+#define BVH_REBUILD_COST_RATIO 2.0f
+
+// Enough for any tree built from a 32-bit primitive count, as median splits keep the tree balanced.
+#define BVH_MAX_STACK 64
+
+#define BVH_ALL_PLANES ((1u << MaliSDK::FrustumCuller::NUMBER_OF_PLANES) - 1)
+
+BVH::BVH(MaliSDK::ThreadPool *thread_pool)
+    : build_cost(0.0f), thread_pool(thread_pool)
+{
+}
+
+void BVH::parallel_for(unsigned count, const function<void (unsigned, unsigned)> &function, unsigned minimum_chunk)
+{
+    if (thread_pool)
+    {
+        thread_pool->parallelFor(count, function, minimum_chunk);
+    }
+    else if (count)
+    {
+        function(0, count);
+    }
+}
+
+unsigned BVH::split(unsigned begin, unsigned end)
+{
+    float center_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float center_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (unsigned i = begin; i < end; i++)
+    {
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            float center = centers[axis][primitives[i]];
+            center_min[axis] = min(center_min[axis], center);
+            center_max[axis] = max(center_max[axis], center);
+        }
+    }
+
+    unsigned axis = 0;
+    for (unsigned i = 1; i < 3; i++)
+    {
+        if (center_max[i] - center_min[i] > center_max[axis] - center_min[axis])
+        {
+            axis = i;
+        }
+    }
+
+    // Median split. Both halves get the same number of primitives, which keeps the tree balanced
+    // even if primitives are unevenly distributed.
+    unsigned middle = begin + (end - begin) / 2;
+    const float *axis_centers = &centers[axis][0];
+    nth_element(primitives.begin() + begin, primitives.begin() + middle, primitives.begin() + end,
+            [axis_centers](uint32_t a, uint32_t b) { return axis_centers[a] < axis_centers[b]; });
+    return middle;
+}
+
+void BVH::build_subtree(vector<Node> &subtree, unsigned node, unsigned begin, unsigned end)
+{
+    if (end - begin <= BVH_LEAF_SIZE)
+    {
+        subtree[node].first = begin;
+        subtree[node].second = 0;
+        subtree[node].count = end - begin;
+        return;
+    }
+
+    unsigned middle = split(begin, end);
+    unsigned children = subtree.size();
+    subtree.resize(children + 2);
+
+    subtree[node].first = children;
+    subtree[node].second = children + 1;
+    subtree[node].count = 0;
+
+    build_subtree(subtree, children, begin, middle);
+    build_subtree(subtree, children + 1, middle, end);
+}
+
+void BVH::build(const MaliSDK::BoundingBoxArray &bounds)
+{
+    const unsigned count = bounds.size();
+
+    nodes.clear();
+    leaves.clear();
+    primitives.resize(count);
+    for (unsigned axis = 0; axis < 3; axis++)
+    {
+        centers[axis].resize(count);
+    }
+
+    if (count == 0)
+    {
+        build_cost = 0.0f;
+        return;
+    }
+
+    // Splits only look at the centers of the boxes.
+    parallel_for(count, [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; i++)
+        {
+            primitives[i] = i;
+            centers[0][i] = 0.5f * (bounds.minX[i] + bounds.maxX[i]);
+            centers[1][i] = 0.5f * (bounds.minY[i] + bounds.maxY[i]);
+            centers[2][i] = 0.5f * (bounds.minZ[i] + bounds.maxZ[i]);
+        }
+    }, 1024);
+
+    // Split the top of the tree serially until there are enough independent subtrees to keep every thread busy.
+    const unsigned num_threads = thread_pool ? thread_pool->getNumberOfThreads() : 1;
+    const unsigned target_tasks = num_threads > 1 ? num_threads * BVH_SUBTREES_PER_THREAD : 1;
+
+    vector<BuildTask> tasks;
+    nodes.resize(1);
+    BuildTask root = { 0, 0, count };
+    tasks.push_back(root);
+
+    while (tasks.size() < target_tasks)
+    {
+        vector<BuildTask> next_tasks;
+        bool did_split = false;
+
+        for (unsigned i = 0; i < tasks.size(); i++)
+        {
+            const BuildTask &task = tasks[i];
+            if (task.end - task.begin <= BVH_LEAF_SIZE * BVH_LEAF_SIZE)
+            {
+                next_tasks.push_back(task);
+                continue;
+            }
+
+            unsigned middle = split(task.begin, task.end);
+            unsigned children = nodes.size();
+            nodes.resize(children + 2);
+            nodes[task.node].first = children;
+            nodes[task.node].second = children + 1;
+            nodes[task.node].count = 0;
+
+            BuildTask left = { children, task.begin, middle };
+            BuildTask right = { children + 1, middle, task.end };
+            next_tasks.push_back(left);
+            next_tasks.push_back(right);
+            did_split = true;
+        }
+
+        tasks.swap(next_tasks);
+        if (!did_split)
+        {
+            break;
+        }
+    }
+
+    // Tasks cover disjoint ranges of primitives, so they can be built at the same time.
+    vector<vector<Node> > subtrees(tasks.size());
+    parallel_for(tasks.size(), [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; i++)
+        {
+            subtrees[i].resize(1);
+            build_subtree(subtrees[i], 0, tasks[i].begin, tasks[i].end);
+        }
+    }, 1);
+
+    // Append the subtrees after the top of the tree. The root of every subtree replaces its placeholder node.
+    for (unsigned i = 0; i < tasks.size(); i++)
+    {
+        const vector<Node> &subtree = subtrees[i];
+        const unsigned base = nodes.size() - 1;
+
+        for (unsigned j = 0; j < subtree.size(); j++)
+        {
+            Node node = subtree[j];
+            if (node.count == 0)
+            {
+                node.first += base;
+                node.second += base;
+            }
+
+            if (j == 0)
+            {
+                nodes[tasks[i].node] = node;
+            }
+            else
+            {
+                nodes.push_back(node);
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].count)
+        {
+            leaves.push_back(i);
+        }
+    }
+
+    refit(bounds);
+    build_cost = compute_cost();
+}
+
+void BVH::refit(const MaliSDK::BoundingBoxArray &bounds)
+{
+    // Leaves only depend on primitives.
+    parallel_for(leaves.size(), [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; i++)
+        {
+            Node &node = nodes[leaves[i]];
+            node.bounds_min[0] = node.bounds_min[1] = node.bounds_min[2] = FLT_MAX;
+            node.bounds_max[0] = node.bounds_max[1] = node.bounds_max[2] = -FLT_MAX;
+
+            for (unsigned j = node.first; j < node.first + node.count; j++)
+            {
+                uint32_t primitive = primitives[j];
+                node.bounds_min[0] = min(node.bounds_min[0], bounds.minX[primitive]);
+                node.bounds_min[1] = min(node.bounds_min[1], bounds.minY[primitive]);
+                node.bounds_min[2] = min(node.bounds_min[2], bounds.minZ[primitive]);
+                node.bounds_max[0] = max(node.bounds_max[0], bounds.maxX[primitive]);
+                node.bounds_max[1] = max(node.bounds_max[1], bounds.maxY[primitive]);
+                node.bounds_max[2] = max(node.bounds_max[2], bounds.maxZ[primitive]);
+            }
+        }
+    }, 256);
+
+    // Children always come after their parent.
+    for (unsigned i = nodes.size(); i-- > 0; )
+    {
+        Node &node = nodes[i];
+        if (node.count)
+        {
+            continue;
+        }
+
+        const Node &left = nodes[node.first];
+        const Node &right = nodes[node.second];
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            node.bounds_min[axis] = min(left.bounds_min[axis], right.bounds_min[axis]);
+            node.bounds_max[axis] = max(left.bounds_max[axis], right.bounds_max[axis]);
+        }
+    }
+}
+
+static inline float surface_area(const float *bounds_min, const float *bounds_max)
+{
+    float x = bounds_max[0] - bounds_min[0];
+    float y = bounds_max[1] - bounds_min[1];
+    float z = bounds_max[2] - bounds_min[2];
+    return x * y + y * z + z * x;
+}
+
+float BVH::compute_cost() const
+{
+    // The cost of a ray or frustum query is roughly proportional to the total surface area of the nodes it visits.
+    float root_area = surface_area(nodes[0].bounds_min, nodes[0].bounds_max);
+    if (root_area <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float area = 0.0f;
+    for (unsigned i = 0; i < nodes.size(); i++)
+    {
+        area += surface_area(nodes[i].bounds_min, nodes[i].bounds_max);
+    }
+    return area / root_area;
+}
+
+void BVH::update(const MaliSDK::BoundingBoxArray &bounds)
+{
+    if (bounds.size() != primitives.size() || nodes.empty())
+    {
+        build(bounds);
+        return;
+    }
+
+    // Refitting is linear, but the tree slowly gets worse as primitives move away from the ones they were grouped with.
+    refit(bounds);
+    if (compute_cost() > BVH_REBUILD_COST_RATIO * build_cost)
+    {
+        build(bounds);
+    }
+}
+
+void BVH::query_frustum(const MaliSDK::FrustumCuller &frustum, const vec3 &eye, vector<unsigned> &result) const
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    // Every entry carries the planes its parent intersected.
+    // Once a node is completely inside a plane, its children do not have to be tested against it.
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t planes;
+    };
+    Entry stack[BVH_MAX_STACK];
+    unsigned stack_size = 0;
+
+    Entry root = { 0, BVH_ALL_PLANES };
+    stack[stack_size++] = root;
+
+    while (stack_size)
+    {
+        Entry entry = stack[--stack_size];
+        const Node &node = nodes[entry.node];
+
+        bool outside = false;
+        for (unsigned i = 0; i < MaliSDK::FrustumCuller::NUMBER_OF_PLANES && !outside; i++)
+        {
+            if (!(entry.planes & (1u << i)))
+            {
+                continue;
+            }
+
+            // Test the corners which are furthest in front of and behind the plane.
+            const float *plane = frustum.getPlane(i);
+            float front = plane[3];
+            float back = plane[3];
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                float a = plane[axis] * node.bounds_min[axis];
+                float b = plane[axis] * node.bounds_max[axis];
+                front += max(a, b);
+                back += min(a, b);
+            }
+
+            if (front < 0.0f)
+            {
+                outside = true;
+            }
+            else if (back >= 0.0f)
+            {
+                entry.planes &= ~(1u << i);
+            }
+        }
+
+        if (outside)
+        {
+            continue;
+        }
+
+        if (node.count)
+        {
+            result.insert(result.end(), primitives.begin() + node.first, primitives.begin() + node.first + node.count);
+            continue;
+        }
+
+        // Push the far child first so the near child is visited first.
+        uint32_t near_child = node.first;
+        uint32_t far_child = node.second;
+
+        float near_distance = 0.0f;
+        float far_distance = 0.0f;
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            float near_delta = 0.5f * (nodes[near_child].bounds_min[axis] + nodes[near_child].bounds_max[axis]) - eye.data[axis];
+            float far_delta = 0.5f * (nodes[far_child].bounds_min[axis] + nodes[far_child].bounds_max[axis]) - eye.data[axis];
+            near_distance += near_delta * near_delta;
+            far_distance += far_delta * far_delta;
+        }
+        if (far_distance < near_distance)
+        {
+            swap(near_child, far_child);
+        }
+
+        Entry far_entry = { far_child, entry.planes };
+        Entry near_entry = { near_child, entry.planes };
+        stack[stack_size++] = far_entry;
+        stack[stack_size++] = near_entry;
+    }
+}
@@ -0,0 +1,96 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef BVH_HPP__
+#define BVH_HPP__
+
+#include "vector_math.h"
+#include "FrustumCulling.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <stdint.h>
+
+// Bounding volume hierarchy over axis aligned boxes.
+//
+// The tree is built top-down by splitting at the median centroid along the longest axis.
+// The top of the tree is split serially, and the remaining subtrees are built in parallel on a thread pool.
+//
+// Primitives which move can be updated with update(), which refits the bounds of the existing tree.
+// If refitting degrades the tree too much, it is rebuilt instead.
+class BVH
+{
+    public:
+        // Builds and refits on thread_pool if it is not NULL. The pool must outlive the tree.
+        BVH(MaliSDK::ThreadPool *thread_pool = NULL);
+
+        // Builds a new tree over all boxes in bounds. Primitive i is the i-th box.
+        void build(const MaliSDK::BoundingBoxArray &bounds);
+
+        // Moves primitives to new bounds. bounds must contain as many boxes as the tree was built with.
+        void update(const MaliSDK::BoundingBoxArray &bounds);
+
+        // Appends primitives in leaves which intersect frustum to result.
+        // Closer subtrees are visited first, so the result is roughly sorted front-to-back as seen from eye.
+        // Leaves are only tested as a whole, so some primitives outside the frustum may be returned.
+        void query_frustum(const MaliSDK::FrustumCuller &frustum, const vec3 &eye, std::vector<unsigned> &result) const;
+
+        unsigned get_num_primitives() const { return primitives.size(); }
+        unsigned get_num_nodes() const { return nodes.size(); }
+
+    private:
+        struct Node
+        {
+            float bounds_min[3];
+            float bounds_max[3];
+
+            // Leaves reference count primitives starting at primitives[first].
+            // Interior nodes have count == 0, and children at first and second.
+            uint32_t first;
+            uint32_t second;
+            uint32_t count;
+        };
+
+        // Parents always come before their children, so bounds can be refitted by walking backwards.
+        std::vector<Node> nodes;
+        std::vector<uint32_t> leaves;
+        std::vector<uint32_t> primitives;
+        std::vector<float> centers[3];
+
+        // Surface area heuristic of the tree when it was built, relative to the root.
+        float build_cost;
+
+        MaliSDK::ThreadPool *thread_pool;
+
+        struct BuildTask
+        {
+            uint32_t node;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        unsigned split(unsigned begin, unsigned end);
+        void build_subtree(std::vector<Node> &subtree, unsigned node, unsigned begin, unsigned end);
+        void refit(const MaliSDK::BoundingBoxArray &bounds);
+        float compute_cost() const;
+        void parallel_for(unsigned count, const std::function<void (unsigned, unsigned)> &function, unsigned minimum_chunk);
+};
+
+#endif
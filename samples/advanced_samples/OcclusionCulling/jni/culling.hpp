@@ -23,6 +23,7 @@
 
 #include "common.hpp"
 #include "mesh.hpp"
+#include "softwarerasterizer.hpp"
 #include <vector>
 #include <stdint.h>
 #include <stddef.h>
@@ -45,6 +46,10 @@ class CullingInterface
         // Sets up occlusion geometry. This is mostly static and should be done at startup of a scene.
         virtual void setup_occluder_geometry(const std::vector<vec4> &positions, const std::vector<uint32_t> &indices) = 0;
 
+        // Replaces the occluder index list, e.g. to reorder occluders or leave out occluders outside the frustum.
+        // Positions from setup_occluder_geometry are kept.
+        virtual void set_occluder_indices(const std::vector<uint32_t> &indices) = 0;
+
         // Sets current view and projection matrices.
         virtual void set_view_projection(const mat4 &projection, const mat4& view, const vec2 &zNearFar) = 0;
 
@@ -76,6 +81,7 @@ class HiZCulling : public CullingInterface
         ~HiZCulling();
 
         void setup_occluder_geometry(const std::vector<vec4> &positions, const std::vector<uint32_t> &indices);
+        void set_occluder_indices(const std::vector<uint32_t> &indices);
         void set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar);
 
         void rasterize_occluders();
@@ -83,11 +89,16 @@ class HiZCulling : public CullingInterface
                 const GLuint *culled_instance_buffer, GLuint instance_data_buffer,
                 unsigned num_instances);
 
-        GLuint get_depth_texture() const { return depth_texture; }
+        GLuint get_depth_texture() const { return depth_textures[current_depth]; }
+
+        // Reuse the depth map of earlier frames when the camera moves little or not at all.
+        // Enabled by default. Occluder geometry must be static between calls to setup_occluder_geometry().
+        void set_temporal_reuse(bool enable);
 
     private:
         GLuint depth_render_program;
         GLuint depth_mip_program;
+        GLuint depth_reproject_program;
         GLuint culling_program;
 
         GLDrawable quad;
@@ -98,12 +109,23 @@ class HiZCulling : public CullingInterface
             GLuint index;
             GLuint vao;
             unsigned elements;
+            unsigned index_capacity;
         } occluder;
 
-        GLuint depth_texture;
+        // Two depth maps, so the previous frame can be reprojected while rendering the current one.
+        GLuint depth_textures[2];
+        std::vector<GLuint> framebuffers[2];
+        unsigned current_depth;
         GLuint shadow_sampler;
         unsigned lod_levels;
-        std::vector<GLuint> framebuffers;
+
+        // Draws one point per depth texel, which needs no vertex data.
+        GLuint reproject_vao;
+
+        bool temporal_reuse;
+        bool depth_valid;
+        unsigned reprojected_frames;
+        mat4 depth_view_projection;
 
         GLuint uniform_buffer;
         struct Uniforms
@@ -117,6 +139,10 @@ class HiZCulling : public CullingInterface
         Uniforms uniforms;
 
         void init();
+        void render_occluders();
+        void build_depth_mips();
+        bool get_reprojected_rect(int &x0, int &y0, int &x1, int &y1) const;
+        void reproject_depth(int x0, int y0, int x1, int y1);
 };
 
 // Variant of HiZRasterizer which only uses a single LOD.
@@ -129,5 +155,34 @@ class HiZCullingNoLOD : public HiZCulling
         unsigned get_num_lods() const { return 1; }
 };
 
+// Same algorithm as HiZCulling, but depth rasterization and testing are done on the CPU with SoftwareRasterizer.
+// Results are uploaded to the same indirect and instance buffers, so rendering does not change.
+// Useful on GPUs where compute is slow. Instance data has to be read back from the GPU, which stalls on physics.
+class SoftwareCulling : public CullingInterface
+{
+    public:
+        // Rasterization and sphere tests run on thread_pool, which must outlive the culler.
+        explicit SoftwareCulling(MaliSDK::ThreadPool *thread_pool);
+        ~SoftwareCulling();
+
+        void setup_occluder_geometry(const std::vector<vec4> &positions, const std::vector<uint32_t> &indices);
+        void set_occluder_indices(const std::vector<uint32_t> &indices);
+        void set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar);
+
+        void rasterize_occluders();
+        void test_bounding_boxes(GLuint counter_buffer, const unsigned *counter_offsets, unsigned num_offsets,
+                const GLuint *culled_instance_buffer, GLuint instance_data_buffer,
+                unsigned num_instances);
+
+        GLuint get_depth_texture() const { return depth_texture; }
+
+    private:
+        SoftwareRasterizer rasterizer;
+        std::vector<vec4> lod_instances[SPHERE_LODS];
+
+        // Copy of the CPU depth pyramid for debugging.
+        GLuint depth_texture;
+};
+
 #endif
 
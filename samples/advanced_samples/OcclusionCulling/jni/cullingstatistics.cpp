@@ -0,0 +1,399 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "cullingstatistics.hpp"
+#include <string.h>
+
+using namespace std;
+
+// From GL_EXT_disjoint_timer_query.
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+typedef void (GL_APIENTRYP GetQueryObjectui64vEXTProc)(GLuint id, GLenum pname, GLuint64 *params);
+static GetQueryObjectui64vEXTProc get_query_object_ui64v;
+
+static const char *pass_names[] = { "rasterize", "test", "render" };
+
+CullingStatistics::CullingStatistics(unsigned num_slots, unsigned max_history)
+    : slots(num_slots), current(NULL), max_history(max_history), frame(0), dropped_frames(0)
+{
+    const char *extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    timer_queries_supported = extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+    if (timer_queries_supported)
+    {
+        get_query_object_ui64v = reinterpret_cast<GetQueryObjectui64vEXTProc>(eglGetProcAddress("glGetQueryObjectui64vEXT"));
+        timer_queries_supported = get_query_object_ui64v != NULL;
+    }
+
+    for (unsigned i = 0; i < slots.size(); i++)
+    {
+        Slot &slot = slots[i];
+        slot.fence = NULL;
+        memset(slot.queries, 0, sizeof(slot.queries));
+        memset(slot.query_used, 0, sizeof(slot.query_used));
+        memset(&slot.statistics, 0, sizeof(slot.statistics));
+
+        if (timer_queries_supported)
+        {
+            GL_CHECK(glGenQueries(PassCount, slot.queries));
+        }
+    }
+
+    memset(pass_start, 0, sizeof(pass_start));
+}
+
+CullingStatistics::~CullingStatistics()
+{
+    for (unsigned i = 0; i < slots.size(); i++)
+    {
+        if (slots[i].fence)
+        {
+            GL_CHECK(glDeleteSync(slots[i].fence));
+        }
+
+        if (timer_queries_supported)
+        {
+            GL_CHECK(glDeleteQueries(PassCount, slots[i].queries));
+        }
+    }
+}
+
+void CullingStatistics::read_timer_queries(Slot &slot)
+{
+    // Timings are meaningless if the GPU was disjoint, e.g. because of frequency changes.
+    GLint disjoint = 0;
+    if (timer_queries_supported)
+    {
+        GL_CHECK(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+    }
+
+    for (unsigned pass = 0; pass < PassCount; pass++)
+    {
+        slot.statistics.gpu_ms[pass] = -1.0f;
+        if (!slot.query_used[pass])
+        {
+            continue;
+        }
+        slot.query_used[pass] = false;
+
+        // The fence has signalled, so this should not have to wait, but checking is cheap.
+        GLuint available = 0;
+        GL_CHECK(glGetQueryObjectuiv(slot.queries[pass], GL_QUERY_RESULT_AVAILABLE, &available));
+        if (available && !disjoint)
+        {
+            GLuint64 elapsed = 0;
+            GL_CHECK(get_query_object_ui64v(slot.queries[pass], GL_QUERY_RESULT, &elapsed));
+            slot.statistics.gpu_ms[pass] = float(elapsed * 1e-6);
+        }
+    }
+}
+
+void CullingStatistics::collect(unsigned slot_index, GLuint indirect_buffer)
+{
+    Slot &slot = slots[slot_index];
+    if (!slot.fence)
+    {
+        return;
+    }
+
+    // Never wait for the GPU. If it is not done with the frame yet, the frame is dropped.
+    GL_CHECK(GLenum status = glClientWaitSync(slot.fence, 0, 0));
+    GL_CHECK(glDeleteSync(slot.fence));
+    slot.fence = NULL;
+
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        memset(slot.query_used, 0, sizeof(slot.query_used));
+        dropped_frames++;
+        return;
+    }
+
+    CullingFrameStatistics &statistics = slot.statistics;
+
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, indirect_buffer));
+    GL_CHECK(const IndirectCommand *commands = static_cast<const IndirectCommand*>(glMapBufferRange(GL_COPY_READ_BUFFER,
+                0, statistics.num_lods * sizeof(IndirectCommand), GL_MAP_READ_BIT)));
+
+    if (!commands)
+    {
+        LOGE("Failed to map indirect buffer!");
+        GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        memset(slot.query_used, 0, sizeof(slot.query_used));
+        dropped_frames++;
+        return;
+    }
+
+    statistics.total_visible = 0;
+    for (unsigned lod = 0; lod < statistics.num_lods; lod++)
+    {
+        statistics.visible[lod] = commands[lod].instanceCount;
+        statistics.total_visible += commands[lod].instanceCount;
+    }
+
+    GL_CHECK(glUnmapBuffer(GL_COPY_READ_BUFFER));
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+    if (statistics.num_instances)
+    {
+        statistics.cull_ratio = 1.0f - float(statistics.total_visible) / float(statistics.num_instances);
+    }
+
+    read_timer_queries(slot);
+
+    history.push_back(statistics);
+    while (history.size() > max_history)
+    {
+        history.pop_front();
+    }
+}
+
+void CullingStatistics::begin_frame(unsigned slot_index, int method, unsigned num_instances, unsigned num_lods)
+{
+    Slot &slot = slots[slot_index];
+
+    // The previous frame in this slot was never collected.
+    if (slot.fence)
+    {
+        GL_CHECK(glDeleteSync(slot.fence));
+        slot.fence = NULL;
+        dropped_frames++;
+    }
+
+    CullingFrameStatistics &statistics = slot.statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    statistics.frame = frame++;
+    statistics.method = method;
+    statistics.num_instances = num_instances;
+    statistics.num_lods = min(num_lods, unsigned(SPHERE_LODS));
+    for (unsigned pass = 0; pass < PassCount; pass++)
+    {
+        statistics.gpu_ms[pass] = -1.0f;
+    }
+    memset(slot.query_used, 0, sizeof(slot.query_used));
+
+    current = &slot;
+}
+
+void CullingStatistics::begin_pass(Pass pass)
+{
+    if (!current)
+    {
+        return;
+    }
+
+    if (timer_queries_supported)
+    {
+        GL_CHECK(glBeginQuery(GL_TIME_ELAPSED_EXT, current->queries[pass]));
+        current->query_used[pass] = true;
+    }
+    pass_start[pass] = timer.getTime();
+}
+
+void CullingStatistics::end_pass(Pass pass)
+{
+    if (!current)
+    {
+        return;
+    }
+
+    current->statistics.cpu_ms[pass] = 1000.0f * (timer.getTime() - pass_start[pass]);
+    if (timer_queries_supported)
+    {
+        GL_CHECK(glEndQuery(GL_TIME_ELAPSED_EXT));
+    }
+}
+
+void CullingStatistics::end_frame()
+{
+    if (!current)
+    {
+        return;
+    }
+
+    GL_CHECK(current->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    current = NULL;
+}
+
+bool CullingStatistics::get_average(int method, CullingFrameStatistics &average) const
+{
+    memset(&average, 0, sizeof(average));
+    average.method = method;
+
+    unsigned count = 0;
+    unsigned gpu_count[PassCount] = {};
+    double visible[SPHERE_LODS] = {};
+    double total_visible = 0.0;
+    double num_instances = 0.0;
+    double cpu_ms[PassCount] = {};
+    double gpu_ms[PassCount] = {};
+
+    for (deque<CullingFrameStatistics>::const_iterator itr = history.begin(); itr != history.end(); ++itr)
+    {
+        if (itr->method != method)
+        {
+            continue;
+        }
+
+        count++;
+        average.num_lods = max(average.num_lods, itr->num_lods);
+        for (unsigned lod = 0; lod < SPHERE_LODS; lod++)
+        {
+            visible[lod] += itr->visible[lod];
+        }
+        total_visible += itr->total_visible;
+        num_instances += itr->num_instances;
+
+        for (unsigned pass = 0; pass < PassCount; pass++)
+        {
+            cpu_ms[pass] += itr->cpu_ms[pass];
+            if (itr->gpu_ms[pass] >= 0.0f)
+            {
+                gpu_ms[pass] += itr->gpu_ms[pass];
+                gpu_count[pass]++;
+            }
+        }
+    }
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    average.frame = count;
+    for (unsigned lod = 0; lod < SPHERE_LODS; lod++)
+    {
+        average.visible[lod] = unsigned(visible[lod] / count + 0.5);
+    }
+    average.total_visible = unsigned(total_visible / count + 0.5);
+    average.num_instances = unsigned(num_instances / count + 0.5);
+    average.cull_ratio = num_instances > 0.0 ? float(1.0 - total_visible / num_instances) : 0.0f;
+
+    for (unsigned pass = 0; pass < PassCount; pass++)
+    {
+        average.cpu_ms[pass] = float(cpu_ms[pass] / count);
+        average.gpu_ms[pass] = gpu_count[pass] ? float(gpu_ms[pass] / gpu_count[pass]) : -1.0f;
+    }
+    return true;
+}
+
+void CullingStatistics::clear()
+{
+    history.clear();
+    dropped_frames = 0;
+}
+
+bool CullingStatistics::write_csv(const char *path) const
+{
+    FILE *file = common_fopen(path, "w");
+    if (!file)
+    {
+        LOGE("Failed to open %s for writing.\n", path);
+        return false;
+    }
+
+    fprintf(file, "frame,method,instances");
+    for (unsigned lod = 0; lod < SPHERE_LODS; lod++)
+    {
+        fprintf(file, ",visible_lod%u", lod);
+    }
+    fprintf(file, ",visible,cull_ratio");
+    for (unsigned pass = 0; pass < PassCount; pass++)
+    {
+        fprintf(file, ",cpu_%s_ms", pass_names[pass]);
+    }
+    for (unsigned pass = 0; pass < PassCount; pass++)
+    {
+        fprintf(file, ",gpu_%s_ms", pass_names[pass]);
+    }
+    fprintf(file, "\n");
+
+    for (deque<CullingFrameStatistics>::const_iterator itr = history.begin(); itr != history.end(); ++itr)
+    {
+        fprintf(file, "%u,%d,%u", itr->frame, itr->method, itr->num_instances);
+        for (unsigned lod = 0; lod < SPHERE_LODS; lod++)
+        {
+            fprintf(file, ",%u", itr->visible[lod]);
+        }
+        fprintf(file, ",%u,%.4f", itr->total_visible, itr->cull_ratio);
+        for (unsigned pass = 0; pass < PassCount; pass++)
+        {
+            fprintf(file, ",%.3f", itr->cpu_ms[pass]);
+        }
+        for (unsigned pass = 0; pass < PassCount; pass++)
+        {
+            fprintf(file, ",%.3f", itr->gpu_ms[pass]);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool CullingStatistics::write_json(const char *path) const
+{
+    FILE *file = common_fopen(path, "w");
+    if (!file)
+    {
+        LOGE("Failed to open %s for writing.\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\n  \"dropped_frames\": %u,\n  \"gpu_timings\": %s,\n  \"frames\": [",
+            dropped_frames, timer_queries_supported ? "true" : "false");
+
+    for (deque<CullingFrameStatistics>::const_iterator itr = history.begin(); itr != history.end(); ++itr)
+    {
+        fprintf(file, "%s\n    { \"frame\": %u, \"method\": %d, \"instances\": %u, \"visible_per_lod\": [",
+                itr == history.begin() ? "" : ",", itr->frame, itr->method, itr->num_instances);
+        for (unsigned lod = 0; lod < itr->num_lods; lod++)
+        {
+            fprintf(file, "%s%u", lod ? ", " : "", itr->visible[lod]);
+        }
+        fprintf(file, "], \"visible\": %u, \"cull_ratio\": %.4f", itr->total_visible, itr->cull_ratio);
+
+        for (unsigned pass = 0; pass < PassCount; pass++)
+        {
+            fprintf(file, ", \"cpu_%s_ms\": %.3f", pass_names[pass], itr->cpu_ms[pass]);
+        }
+        for (unsigned pass = 0; pass < PassCount; pass++)
+        {
+            // JSON has no way to represent a missing number other than null.
+            if (itr->gpu_ms[pass] >= 0.0f)
+            {
+                fprintf(file, ", \"gpu_%s_ms\": %.3f", pass_names[pass], itr->gpu_ms[pass]);
+            }
+            else
+            {
+                fprintf(file, ", \"gpu_%s_ms\": null", pass_names[pass]);
+            }
+        }
+        fprintf(file, " }");
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,117 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef CULLING_STATISTICS_HPP__
+#define CULLING_STATISTICS_HPP__
+
+#include "common.hpp"
+#include "culling.hpp"
+#include "Timer.h"
+#include <deque>
+#include <vector>
+
+// Culling results and timings of a single frame.
+struct CullingFrameStatistics
+{
+    unsigned frame;
+    // Scene::CullingMethod used for the frame.
+    int method;
+
+    unsigned num_instances;
+    unsigned num_lods;
+    unsigned visible[SPHERE_LODS];
+    unsigned total_visible;
+    // Fraction of instances which were culled.
+    float cull_ratio;
+
+    // Time spent on the CPU in each pass, including driver overhead, in milliseconds.
+    float cpu_ms[3];
+    // Time spent on the GPU in each pass in milliseconds, or negative if it could not be measured.
+    float gpu_ms[3];
+};
+
+// Reads back culling results without stalling the GPU pipeline.
+//
+// Every frame is recorded in one of a ring of slots, one per indirect draw buffer, and a fence is inserted when
+// the frame is done. The results of a slot are only read back when the slot comes around again,
+// and only if its fence has already signalled. Otherwise, the frame is dropped rather than waited for.
+//
+// GPU timings need GL_EXT_disjoint_timer_query. CPU timings are always available.
+class CullingStatistics
+{
+    public:
+        enum Pass
+        {
+            PassRasterize = 0,
+            PassTest = 1,
+            PassRender = 2,
+            PassCount = 3
+        };
+
+        CullingStatistics(unsigned num_slots, unsigned max_history = 4096);
+        ~CullingStatistics();
+
+        // Reads back the frame last recorded in slot, if the GPU is done with it.
+        // Must be called before indirect_buffer is written to again.
+        void collect(unsigned slot, GLuint indirect_buffer);
+
+        // Starts recording a frame in slot.
+        void begin_frame(unsigned slot, int method, unsigned num_instances, unsigned num_lods);
+        void begin_pass(Pass pass);
+        void end_pass(Pass pass);
+        // Inserts the fence which collect() waits for. Does nothing if no frame was begun.
+        void end_frame();
+
+        const std::deque<CullingFrameStatistics> &get_history() const { return history; }
+        unsigned get_dropped_frames() const { return dropped_frames; }
+        bool has_gpu_timings() const { return timer_queries_supported; }
+
+        // Average over the history, frames with a different method than method are skipped.
+        bool get_average(int method, CullingFrameStatistics &average) const;
+        void clear();
+
+        bool write_csv(const char *path) const;
+        bool write_json(const char *path) const;
+
+    private:
+        struct Slot
+        {
+            GLsync fence;
+            GLuint queries[PassCount];
+            bool query_used[PassCount];
+            CullingFrameStatistics statistics;
+        };
+        std::vector<Slot> slots;
+        Slot *current;
+
+        std::deque<CullingFrameStatistics> history;
+        unsigned max_history;
+        unsigned frame;
+        unsigned dropped_frames;
+
+        Timer timer;
+        float pass_start[PassCount];
+
+        bool timer_queries_supported;
+        void read_timer_queries(Slot &slot);
+};
+
+#endif
@@ -20,11 +20,18 @@
 
 #include "culling.hpp"
 #include <string.h>
+#include <math.h>
+#include <algorithm>
 
 using namespace std;
 
 #define GROUP_SIZE_AABB 64
 
+// Re-render the full depth map regularly so reprojection holes and stale disocclusions cannot pile up.
+#define HIZ_MAX_REPROJECTED_FRAMES 16
+// Minimum fraction of the depth map which must be reusable from the previous frame to bother reprojecting.
+#define HIZ_MIN_REPROJECTED_COVERAGE 0.5f
+
 HiZCulling::HiZCulling()
 {
     culling_program = common_compile_compute_shader_from_file("hiz_cull.cs");
@@ -45,47 +52,60 @@ void HiZCulling::init()
     // Shader for manually mipmapping a depth texture.
     depth_mip_program = common_compile_shader_from_file("quad.vs", "depth_mip.fs");
 
-    lod_levels = DEPTH_SIZE_LOG2 + 1;
-
-    GL_CHECK(glGenTextures(1, &depth_texture));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_texture));
-    GL_CHECK(glTexStorage2D(GL_TEXTURE_2D, lod_levels, GL_DEPTH24_STENCIL8,
-                DEPTH_SIZE, DEPTH_SIZE));
-
-    // We cannot do filtering on depth textures unless we're doing shadow compare (PCF).
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
-
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    // Scatters the previous depth map into the current one for temporal reuse.
+    depth_reproject_program = common_compile_shader_from_file("depth_reproject.vs", "depth.fs");
+    if (!depth_reproject_program)
+    {
+        LOGE("Failed to build depth reprojection program, temporal reuse is disabled.\n");
+    }
 
-    // Useful for debugging purposes so depth shows up as graytone and not just red.
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+    lod_levels = DEPTH_SIZE_LOG2 + 1;
 
-    // Create FBO chain for each miplevel.
-    framebuffers.resize(lod_levels);
-    GL_CHECK(glGenFramebuffers(lod_levels, &framebuffers[0]));
-    for (unsigned i = 0; i < lod_levels; i++)
+    GL_CHECK(glGenTextures(2, depth_textures));
+    for (unsigned d = 0; d < 2; d++)
     {
-        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]));
-        GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-                    GL_TEXTURE_2D, depth_texture, i));
-
-        GL_CHECK(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
-        if (status != GL_FRAMEBUFFER_COMPLETE)
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_textures[d]));
+        GL_CHECK(glTexStorage2D(GL_TEXTURE_2D, lod_levels, GL_DEPTH24_STENCIL8,
+                    DEPTH_SIZE, DEPTH_SIZE));
+
+        // We cannot do filtering on depth textures unless we're doing shadow compare (PCF).
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
+
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+        // Useful for debugging purposes so depth shows up as graytone and not just red.
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE));
+
+        // Create FBO chain for each miplevel.
+        framebuffers[d].resize(lod_levels);
+        GL_CHECK(glGenFramebuffers(lod_levels, &framebuffers[d][0]));
+        for (unsigned i = 0; i < lod_levels; i++)
         {
-            LOGE("Framebuffer for LOD %u is incomplete!", i);
+            GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[d][i]));
+            GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                        GL_TEXTURE_2D, depth_textures[d], i));
+
+            GL_CHECK(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+            if (status != GL_FRAMEBUFFER_COMPLETE)
+            {
+                LOGE("Framebuffer for LOD %u is incomplete!", i);
+            }
         }
     }
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
     GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
 
     GL_CHECK(glGenBuffers(1, &occluder.vertex));
     GL_CHECK(glGenBuffers(1, &occluder.index));
     GL_CHECK(glGenVertexArrays(1, &occluder.vao));
+    occluder.elements = 0;
+    occluder.index_capacity = 0;
+    GL_CHECK(glGenVertexArrays(1, &reproject_vao));
 
     // Sampler object that is used during occlusion culling.
     // We want GL_LINEAR shadow mode (PCF), but no filtering between miplevels as we manually specify the miplevel in the compute shader.
@@ -100,6 +120,11 @@ void HiZCulling::init()
     GL_CHECK(glGenBuffers(1, &uniform_buffer));
     GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer));
     GL_CHECK(glBufferData(GL_UNIFORM_BUFFER, sizeof(Uniforms), NULL, GL_STREAM_DRAW));
+
+    current_depth = 0;
+    temporal_reuse = depth_reproject_program != 0;
+    depth_valid = false;
+    reprojected_frames = 0;
 }
 
 void HiZCulling::test_bounding_boxes(GLuint counter_buffer, const unsigned *counter_offsets, unsigned num_offsets,
@@ -126,7 +151,7 @@ void HiZCulling::test_bounding_boxes(GLuint counter_buffer, const unsigned *coun
 
     // Bind Hi-Z depth map.
     GL_CHECK(glActiveTexture(GL_TEXTURE0));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_texture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_textures[current_depth]));
     GL_CHECK(glBindSampler(0, shadow_sampler));
 
     // Dispatch occlusion culling job.
@@ -158,29 +183,54 @@ void HiZCulling::setup_occluder_geometry(const vector<vec4> &position, const vec
     GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 
     occluder.elements = indices.size();
+    occluder.index_capacity = indices.size();
+
+    // Whatever was rasterized before is stale now.
+    depth_valid = false;
 }
 
-void HiZCulling::rasterize_occluders()
+void HiZCulling::set_occluder_indices(const vector<uint32_t> &indices)
 {
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
-    GL_CHECK(glEnable(GL_DEPTH_TEST));
+    // The same occluders are rasterized in a different order, or fewer of them.
+    // Neither changes the depth map inside the frustum, so the reusable depth map stays valid.
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, occluder.index));
+    if (indices.size() > occluder.index_capacity)
+    {
+        GL_CHECK(glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint32_t), &indices[0], GL_STATIC_DRAW));
+        occluder.index_capacity = indices.size();
+    }
+    else if (!indices.empty())
+    {
+        GL_CHECK(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, indices.size() * sizeof(uint32_t), &indices[0]));
+    }
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
 
-    GL_CHECK(glUseProgram(depth_render_program));
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]));
+    occluder.elements = indices.size();
+}
 
-    // Render occlusion geometry to miplevel 0.
+void HiZCulling::set_temporal_reuse(bool enable)
+{
+    // Without the reprojection program, the depth map is rendered from scratch every frame.
+    temporal_reuse = enable && depth_reproject_program != 0;
+    depth_valid = false;
+}
+
+void HiZCulling::render_occluders()
+{
+    GL_CHECK(glUseProgram(depth_render_program));
     GL_CHECK(glBindVertexArray(occluder.vao));
-    GL_CHECK(glViewport(0, 0, DEPTH_SIZE, DEPTH_SIZE));
-    GL_CHECK(glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
     GL_CHECK(glDrawElements(GL_TRIANGLES, occluder.elements, GL_UNSIGNED_INT, 0));
+}
 
+void HiZCulling::build_depth_mips()
+{
     GL_CHECK(glBindVertexArray(quad.get_vertex_array()));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_texture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_textures[current_depth]));
     GL_CHECK(glUseProgram(depth_mip_program));
 
     for (unsigned lod = 1; lod < lod_levels; lod++)
     {
-        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[lod]));
+        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current_depth][lod]));
         GL_CHECK(glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
         GL_CHECK(glViewport(0, 0, DEPTH_SIZE >> lod, DEPTH_SIZE >> lod));
 
@@ -196,7 +246,142 @@ void HiZCulling::rasterize_occluders()
     // Restore miplevels. MAX_LEVEL will be clamped accordingly.
     GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
     GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000));
+}
+
+bool HiZCulling::get_reprojected_rect(int &x0, int &y0, int &x1, int &y1) const
+{
+    // Find a screen rectangle which was entirely visible to the previous camera as well.
+    // The previous frustum is a convex volume, so for a small camera movement its corners at the near and far planes
+    // bound the part of the new screen it still covers.
+    mat4 inv_prev_view_projection = mat_inverse(depth_view_projection);
+    float left = -1.0f, right = 1.0f, bottom = -1.0f, top = 1.0f;
+
+    for (unsigned i = 0; i < 8; i++)
+    {
+        float x = (i & 1) ? 1.0f : -1.0f;
+        float y = (i & 2) ? 1.0f : -1.0f;
+        float z = (i & 4) ? 1.0f : -1.0f;
+
+        vec4 world = inv_prev_view_projection * vec4(x, y, z, 1.0f);
+        world = world / vec4(world.c.w);
+        vec4 clip = uniforms.uVP * world;
+
+        // The old corner is behind the new camera, the movement is too large to reason about.
+        if (clip.c.w <= 0.0f)
+        {
+            return false;
+        }
+
+        float ndc_x = clip.c.x / clip.c.w;
+        float ndc_y = clip.c.y / clip.c.w;
+        if (x < 0.0f)
+            left = max(left, ndc_x);
+        else
+            right = min(right, ndc_x);
+        if (y < 0.0f)
+            bottom = max(bottom, ndc_y);
+        else
+            top = min(top, ndc_y);
+    }
+
+    // Shrink by a texel so edges which only got partial coverage from the point splats are rasterized again.
+    x0 = int(ceil((0.5f * left + 0.5f) * DEPTH_SIZE)) + 1;
+    y0 = int(ceil((0.5f * bottom + 0.5f) * DEPTH_SIZE)) + 1;
+    x1 = int(floor((0.5f * right + 0.5f) * DEPTH_SIZE)) - 1;
+    y1 = int(floor((0.5f * top + 0.5f) * DEPTH_SIZE)) - 1;
+
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return false;
+    }
+
+    // If most of the screen is new, rasterizing everything is cheaper than splatting plus rasterizing strips.
+    float coverage = float((x1 - x0) * (y1 - y0)) / float(DEPTH_SIZE * DEPTH_SIZE);
+    return coverage >= HIZ_MIN_REPROJECTED_COVERAGE;
+}
+
+void HiZCulling::reproject_depth(int x0, int y0, int x1, int y1)
+{
+    unsigned previous_depth = current_depth;
+    current_depth ^= 1;
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current_depth][0]));
+    GL_CHECK(glViewport(0, 0, DEPTH_SIZE, DEPTH_SIZE));
+    GL_CHECK(glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+
+    // Splat every texel of the previous depth map into the new view.
+    // Texels which receive no splat keep the cleared far depth, so holes only make culling less aggressive.
+    GL_CHECK(glUseProgram(depth_reproject_program));
+    GL_CHECK(glProgramUniformMatrix4fv(depth_reproject_program, 0, 1, GL_FALSE,
+                value_ptr(mat_inverse(depth_view_projection))));
+    GL_CHECK(glProgramUniformMatrix4fv(depth_reproject_program, 1, 1, GL_FALSE, value_ptr(uniforms.uVP)));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_textures[previous_depth]));
+    GL_CHECK(glBindVertexArray(reproject_vao));
+    GL_CHECK(glDrawArrays(GL_POINTS, 0, DEPTH_SIZE * DEPTH_SIZE));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+
+    // Rasterize occluders only in the strips around the rectangle which was visible last frame.
+    const int strips[4][4] = {
+        { 0, 0, DEPTH_SIZE, y0 },
+        { 0, y1, DEPTH_SIZE, DEPTH_SIZE - y1 },
+        { 0, y0, x0, y1 - y0 },
+        { x1, y0, DEPTH_SIZE - x1, y1 - y0 },
+    };
+
+    GL_CHECK(glEnable(GL_SCISSOR_TEST));
+    for (unsigned i = 0; i < 4; i++)
+    {
+        if (strips[i][2] <= 0 || strips[i][3] <= 0)
+        {
+            continue;
+        }
+
+        GL_CHECK(glScissor(strips[i][0], strips[i][1], strips[i][2], strips[i][3]));
+        render_occluders();
+    }
+    GL_CHECK(glDisable(GL_SCISSOR_TEST));
+}
+
+void HiZCulling::rasterize_occluders()
+{
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+    GL_CHECK(glEnable(GL_DEPTH_TEST));
+
+    if (temporal_reuse && depth_valid)
+    {
+        // Occluders are static, so the same camera gives the same depth map.
+        if (memcmp(&depth_view_projection, &uniforms.uVP, sizeof(mat4)) == 0)
+        {
+            return;
+        }
+
+        int x0, y0, x1, y1;
+        if (reprojected_frames < HIZ_MAX_REPROJECTED_FRAMES && get_reprojected_rect(x0, y0, x1, y1))
+        {
+            reproject_depth(x0, y0, x1, y1);
+            build_depth_mips();
+            GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+            depth_view_projection = uniforms.uVP;
+            reprojected_frames++;
+            return;
+        }
+    }
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current_depth][0]));
+
+    // Render occlusion geometry to miplevel 0.
+    GL_CHECK(glViewport(0, 0, DEPTH_SIZE, DEPTH_SIZE));
+    GL_CHECK(glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+    render_occluders();
+
+    build_depth_mips();
     GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+    depth_view_projection = uniforms.uVP;
+    depth_valid = true;
+    reprojected_frames = 0;
 }
 
 void HiZCulling::set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar)
@@ -215,16 +400,21 @@ void HiZCulling::set_view_projection(const mat4 &projection, const mat4 &view, c
 
 HiZCulling::~HiZCulling()
 {
-    GL_CHECK(glDeleteTextures(1, &depth_texture));
+    GL_CHECK(glDeleteTextures(2, depth_textures));
     GL_CHECK(glDeleteProgram(depth_render_program));
     GL_CHECK(glDeleteProgram(depth_mip_program));
+    GL_CHECK(glDeleteProgram(depth_reproject_program));
     GL_CHECK(glDeleteProgram(culling_program));
-    GL_CHECK(glDeleteFramebuffers(framebuffers.size(), &framebuffers[0]));
+    for (unsigned d = 0; d < 2; d++)
+    {
+        GL_CHECK(glDeleteFramebuffers(framebuffers[d].size(), &framebuffers[d][0]));
+    }
 
     GL_CHECK(glDeleteBuffers(1, &occluder.vertex));
     GL_CHECK(glDeleteBuffers(1, &occluder.index));
     GL_CHECK(glDeleteBuffers(1, &uniform_buffer));
     GL_CHECK(glDeleteVertexArrays(1, &occluder.vao));
+    GL_CHECK(glDeleteVertexArrays(1, &reproject_vao));
 
     GL_CHECK(glDeleteSamplers(1, &shadow_sampler));
 }
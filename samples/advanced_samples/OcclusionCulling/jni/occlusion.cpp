@@ -29,6 +29,9 @@
 
 using namespace std;
 
+// Set to 1 to check the CPU occlusion culling against a scene with a known result at startup.
+#define SOFTWARE_RASTERIZER_SELF_TEST 0
+
 int surface_width, surface_height;
 
 static void render_text(Text &text, const char *method, float current_time)
@@ -52,6 +55,25 @@ static void render_text(Text &text, const char *method, float current_time)
     GL_CHECK(glDisable(GL_BLEND));
 }
 
+static void log_statistics(Scene &scene, Scene::CullingMethod method, const char *name)
+{
+    CullingFrameStatistics average;
+    if (!scene.get_statistics().get_average(method, average))
+    {
+        return;
+    }
+
+    LOGI("%s: %u of %u spheres visible (LOD 0-3: %u, %u, %u, %u), %.1f%% culled, "
+            "CPU rasterize %.3f ms, test %.3f ms, render %.3f ms, GPU rasterize %.3f ms, test %.3f ms, render %.3f ms\n",
+            name, average.total_visible, average.num_instances,
+            average.visible[0], average.visible[1], average.visible[2], average.visible[3],
+            100.0f * average.cull_ratio,
+            average.cpu_ms[CullingStatistics::PassRasterize], average.cpu_ms[CullingStatistics::PassTest],
+            average.cpu_ms[CullingStatistics::PassRender],
+            average.gpu_ms[CullingStatistics::PassRasterize], average.gpu_ms[CullingStatistics::PassTest],
+            average.gpu_ms[CullingStatistics::PassRender]);
+}
+
 Scene *scene = NULL;
 Text *text = NULL;
 
@@ -59,6 +81,13 @@ Timer timer;
 unsigned phase = 0;
 float culling_timer = 0.0f;
 
+static const char *methods[] = {
+    "Hierarchical-Z occlusion culling with level-of-detail",
+    "Hierarchical-Z occlusion culling without level-of-detail",
+    "Hierarchical-Z occlusion culling on the CPU",
+    "No culling"
+};
+
 extern "C"
 {
     JNIEXPORT void JNICALL Java_com_arm_malideveloper_openglessdk_occlusionculling_OcclusionCulling_init
@@ -66,6 +95,20 @@ extern "C"
     {
       common_set_basedir("/data/data/com.arm.malideveloper.openglessdk.occlusionculling/files/");
     
+#if SOFTWARE_RASTERIZER_SELF_TEST
+      {
+          MaliSDK::ThreadPool thread_pool;
+          if (SoftwareRasterizer::self_test(&thread_pool))
+          {
+              LOGI("Software rasterizer self test passed.\n");
+          }
+          else
+          {
+              LOGE("Software rasterizer self test failed.\n");
+          }
+      }
+#endif
+
       delete scene;
       scene = new Scene;
       scene->set_show_redundant(true);
@@ -89,11 +132,6 @@ extern "C"
         scene->update(delta_time, surface_width, surface_height);
         scene->render(surface_width, surface_height);
 
-        static const char *methods[] = {
-            "Hierarchical-Z occlusion culling with level-of-detail",
-            "Hierarchical-Z occlusion culling without level-of-detail",
-            "No culling"
-        };
         render_text(*text, methods[phase], culling_timer);
 
         // Don't need depth nor stencil buffers anymore. Just discard them so they are not written out to memory on Mali.
@@ -105,7 +143,13 @@ extern "C"
         if (culling_timer > 10.0f)
         {
             culling_timer = 0.0f;
-            phase = (phase + 1) % 3;
+
+            // Summarize the method we are leaving. Statistics are only recorded when culling is enabled.
+            if (phase < 3)
+            {
+                log_statistics(*scene, static_cast<Scene::CullingMethod>(phase), methods[phase]);
+            }
+            phase = (phase + 1) % 4;
 
             switch (phase)
             {
@@ -116,6 +160,9 @@ extern "C"
                     scene->set_culling_method(Scene::CullHiZNoLOD);
                     break;
                 case 2:
+                    scene->set_culling_method(Scene::CullSoftware);
+                    break;
+                case 3:
                     scene->set_culling_method(Scene::CullNone);
                     break;
             }
@@ -127,6 +174,12 @@ extern "C"
     JNIEXPORT void JNICALL Java_com_arm_malideveloper_openglessdk_occlusionculling_OcclusionCulling_uninit
     (JNIEnv *, jclass)
     {
+      if (scene)
+      {
+          scene->get_statistics().write_csv("culling_statistics.csv");
+          scene->get_statistics().write_json("culling_statistics.json");
+      }
+
       delete scene;
       scene = NULL;
       delete text;
@@ -20,8 +20,10 @@
 
 #include "scene.hpp"
 #include "mesh.hpp"
+#include "CounterRandom.h"
 #include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 
@@ -54,6 +56,7 @@ static const unsigned verts_per_circ[] = {
 };
 
 Scene::Scene()
+    : occluder_tree(&thread_pool), statistics(INDIRECT_BUFFERS)
 {
     // Compile shaders.
     occluder_program = common_compile_shader_from_file("scene.vs", "scene.fs");
@@ -64,6 +67,7 @@ Scene::Scene()
     // Instantiate our various culling methods.
     culling_implementations.push_back(new HiZCulling);
     culling_implementations.push_back(new HiZCullingNoLOD);
+    culling_implementations.push_back(new SoftwareCulling(&thread_pool));
     culling_implementation_index = CullHiZ;
     enable_culling = true;
 
@@ -94,41 +98,29 @@ void Scene::move_camera(float delta_x, float delta_y)
 void Scene::bake_occluder_geometry(vector<vec4> &occluder_positions, vector<uint32_t> &occluder_indices,
         const Mesh &box_mesh, const vec4 *instances, unsigned num_instances)
 {
-    unsigned total_vertices = num_instances * box_mesh.vbo.size();
-    occluder_positions.reserve(total_vertices);
+    const unsigned box_vertices = box_mesh.vbo.size();
+    const unsigned box_indices = box_mesh.ibo.size();
 
-    unsigned total_indices = num_instances * box_mesh.ibo.size();
-    occluder_indices.reserve(total_indices);
+    occluder_positions.resize(num_instances * box_vertices);
+    occluder_indices.resize(num_instances * box_indices);
 
-    // Bake the index buffer.
-    for (unsigned i = 0; i < total_indices; i++)
+    for (unsigned instance = 0; instance < num_instances; instance++)
     {
-        unsigned instance = i / box_mesh.ibo.size();
-        unsigned index = i % box_mesh.ibo.size();
-
-        unsigned baked_index = box_mesh.ibo[index] + instance * box_mesh.vbo.size();
-        occluder_indices.push_back(baked_index);
-    }
-
-    // Bake the vertex buffer.
-    for (unsigned i = 0; i < total_vertices; i++)
-    {
-        unsigned instance = i / box_mesh.vbo.size();
-        unsigned index = i % box_mesh.vbo.size();
+        vec4 *positions = &occluder_positions[instance * box_vertices];
+        for (unsigned i = 0; i < box_vertices; i++)
+        {
+            positions[i] = instances[instance] + vec4(box_mesh.vbo[i].position, 1.0f);
+        }
 
-        vec4 pos = instances[instance] + vec4(box_mesh.vbo[index].position, 1.0f);
-        occluder_positions.push_back(pos);
+        uint32_t *indices = &occluder_indices[instance * box_indices];
+        const uint32_t base = instance * box_vertices;
+        for (unsigned i = 0; i < box_indices; i++)
+        {
+            indices[i] = box_mesh.ibo[i] + base;
+        }
     }
 }
 
-struct OccluderSorter
-{
-    bool operator()(const vec4 &a, const vec4 &b)
-    {
-        return vec_dot(a, a) < vec_dot(b, b);
-    }
-};
-
 struct SphereInstance
 {
     vec4 position;
@@ -162,8 +154,16 @@ void Scene::init_instances()
             occluder_instances.push_back(vec4(3.0f) * vec4(x - 6, 0, z - 6, 0));
         }
     }
-    // Rough front-to-back ordering to get more ideal rendering order.
-    sort(occluder_instances.begin(), occluder_instances.end(), OccluderSorter());
+    // Occluders are ordered front-to-back for the current camera in select_occluders().
+    MaliSDK::BoundingBoxArray occluder_bounds;
+    occluder_bounds.reserve(occluder_instances.size());
+    for (unsigned i = 0; i < occluder_instances.size(); i++)
+    {
+        vec4 minpos = occluder_instances[i] + aabb.minpos;
+        vec4 maxpos = occluder_instances[i] + aabb.maxpos;
+        occluder_bounds.push(minpos.c.x, minpos.c.y, minpos.c.z, maxpos.c.x, maxpos.c.y, maxpos.c.z);
+    }
+    occluder_tree.build(occluder_bounds);
 
     num_occluder_instances = occluder_instances.size();
 
@@ -174,6 +174,8 @@ void Scene::init_instances()
 
     // Place out spheres with different positions and velocities.
     // The W component contains the sphere radius, which is random.
+    // Every sphere draws its radius from its own index in a counter-based generator, so the scene is the same on every run.
+    const MaliSDK::CounterRandom random;
     std::vector<SphereInstance> sphere_instances;
     for (int x = 0; x < SPHERE_INSTANCES_X; x++)
     {
@@ -183,7 +185,8 @@ void Scene::init_instances()
             {
                 SphereInstance instance;
                 instance.position = vec4(1.0f) * vec4(x - 11.35f, y * 0.10f + 0.5f, z - 11.45f, 0);
-                instance.position.c.w = SPHERE_RADIUS * (1.0f - 0.5f * rand() / RAND_MAX);
+                unsigned index = (x * SPHERE_INSTANCES_Y + y) * SPHERE_INSTANCES_Z + z;
+                instance.position.c.w = SPHERE_RADIUS * (1.0f - 0.5f * random.generateFloat(index));
                 instance.velocity = vec4(vec3(4.0) * vec_normalize(vec3(x - 11.35f, 0.5f * y - 11.55f, z - 11.25f)), 0.0f);
 
                 sphere_instances.push_back(instance);
@@ -215,10 +218,15 @@ void Scene::init_instances()
         culling_implementations[i]->setup_occluder_geometry(occluder_positions, occluder_indices);
     }
 
+    occluder_box_indices.resize(box_mesh.ibo.size());
+    copy(box_mesh.ibo.begin(), box_mesh.ibo.end(), occluder_box_indices.begin());
+    occluder_box_vertices = box_mesh.vbo.size();
+    occluder_view_projection = mat4(0.0f);
+
     // Initialize our indirect draw buffers.
     // Use a ring buffer of them, since we might want to read back old results to monitor our culling performance without stalling the pipeline.
     GL_CHECK(glGenBuffers(INDIRECT_BUFFERS, indirect.buffer));
-    for (unsigned i = 0; i < SPHERE_LODS; i++)
+    for (unsigned i = 0; i < INDIRECT_BUFFERS; i++)
     {
         GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.buffer[i]));
         GL_CHECK(glBufferData(GL_DRAW_INDIRECT_BUFFER, SPHERE_LODS * sizeof(IndirectCommand), NULL, GL_DYNAMIC_COPY));
@@ -238,7 +246,7 @@ void Scene::update_camera(float rotation_y, float rotation_x, unsigned viewport_
     mat4 rotation_matrix_x = mat_rotate_x(radians_x);
     vec3 camera_dir = vec3(rotation_matrix_y * rotation_matrix_x * vec4(0, 0, -1, 1));
 
-    vec3 camera_position = vec3(0, 2, 0);
+    camera_position = vec3(0, 2, 0);
 
     view = mat_look_at(camera_position, camera_position + camera_dir, vec3(0, 1, 0));
     projection = mat_perspective_fov(60.0f, float(viewport_width) / viewport_height, Z_NEAR, Z_FAR);
@@ -260,6 +268,41 @@ void Scene::set_culling_method(CullingMethod method)
         enable_culling = true;
         culling_implementation_index = static_cast<unsigned>(method);
     }
+
+    // The new implementation has not seen the current occluder selection.
+    occluder_view_projection = mat4(0.0f);
+}
+
+void Scene::select_occluders(CullingInterface *culler)
+{
+    // Occluders are static, so the selection only changes when the camera does.
+    mat4 view_projection = projection * view;
+    if (memcmp(&view_projection, &occluder_view_projection, sizeof(mat4)) == 0)
+    {
+        return;
+    }
+    occluder_view_projection = view_projection;
+
+    MaliSDK::FrustumCuller frustum;
+    frustum.setViewProjection(value_ptr(view_projection));
+
+    visible_occluders.clear();
+    occluder_tree.query_frustum(frustum, camera_position, visible_occluders);
+
+    // Rasterizing front-to-back lets early depth testing reject most of the hidden occluder fragments.
+    const unsigned box_indices = occluder_box_indices.size();
+    visible_occluder_indices.resize(visible_occluders.size() * box_indices);
+    for (unsigned i = 0; i < visible_occluders.size(); i++)
+    {
+        uint32_t *indices = &visible_occluder_indices[i * box_indices];
+        const uint32_t base = visible_occluders[i] * occluder_box_vertices;
+        for (unsigned j = 0; j < box_indices; j++)
+        {
+            indices[j] = occluder_box_indices[j] + base;
+        }
+    }
+
+    culler->set_occluder_indices(visible_occluder_indices);
 }
 
 void Scene::apply_physics(float delta_time)
@@ -297,9 +340,17 @@ void Scene::update(float delta_time, unsigned width, unsigned height)
         CullingInterface *culler = culling_implementations[culling_implementation_index];
         num_sphere_render_lods = culler->get_num_lods();
 
+        // Read back the results from the last time this indirect buffer was used before it is overwritten.
+        statistics.collect(indirect.buffer_index, indirect.buffer[indirect.buffer_index]);
+        statistics.begin_frame(indirect.buffer_index, culling_implementation_index,
+                num_render_sphere_instances, num_sphere_render_lods);
+
         // Rasterize occluders to depth map and mipmap it.
+        statistics.begin_pass(CullingStatistics::PassRasterize);
         culler->set_view_projection(projection, view, vec2(Z_NEAR, Z_FAR));
+        select_occluders(culler);
         culler->rasterize_occluders();
+        statistics.end_pass(CullingStatistics::PassRasterize);
 
         // We need physics results after this.
         GL_CHECK(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
@@ -320,9 +371,11 @@ void Scene::update(float delta_time, unsigned width, unsigned height)
         GL_CHECK(glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(indirect_command), indirect_command, GL_STREAM_DRAW));
 
         // Test occluders and build indirect commands as well as per-instance buffers for every LOD.
+        statistics.begin_pass(CullingStatistics::PassTest);
         culler->test_bounding_boxes(indirect.buffer[indirect.buffer_index], offsets, SPHERE_LODS,
                 indirect.instance_buffer, sphere_instances_buffer,
                 num_render_sphere_instances);
+        statistics.end_pass(CullingStatistics::PassTest);
     }
     else
     {
@@ -390,6 +443,7 @@ void Scene::render(unsigned width, unsigned height)
     GL_CHECK(glViewport(0, 0, width, height));
 
     // Render occluder boxes.
+    statistics.begin_pass(CullingStatistics::PassRender);
     GL_CHECK(glUseProgram(occluder_program));
     GL_CHECK(glProgramUniform3f(occluder_program, UNIFORM_COLOR_LOCATION, 1.2f, 0.6f, 0.6f));
     GL_CHECK(glBindVertexArray(box->get_vertex_array()));
@@ -413,12 +467,16 @@ void Scene::render(unsigned width, unsigned height)
         GL_CHECK(glDepthFunc(GL_LESS));
     }
     render_spheres(vec3(1.0f));
+    statistics.end_pass(CullingStatistics::PassRender);
 
     if (enable_culling)
     {
         render_depth_map();
     }
 
+    // Results in this indirect buffer can be read back once the GPU is done with this frame.
+    statistics.end_frame();
+
     // Restore viewport (for text rendering).
     GL_CHECK(glViewport(0, 0, width, height));
 
@@ -23,6 +23,9 @@
 
 #include "mesh.hpp"
 #include "culling.hpp"
+#include "bvh.hpp"
+#include "ThreadPool.h"
+#include "cullingstatistics.hpp"
 #include <vector>
 #include <stdint.h>
 
@@ -39,6 +42,7 @@ class Scene
         enum CullingMethod {
             CullHiZ = 0,
             CullHiZNoLOD = 1,
+            CullSoftware = 2,
             CullNone = -1
         };
         void set_culling_method(CullingMethod method);
@@ -48,7 +52,13 @@ class Scene
         void set_show_redundant(bool enable) { show_redundant = enable; }
         bool get_show_redundant() const { return show_redundant; }
 
+        // Culling results of earlier frames, read back without stalling.
+        CullingStatistics &get_statistics() { return statistics; }
+
     private:
+        // Worker threads for the occluder tree and software culling.
+        MaliSDK::ThreadPool thread_pool;
+
         GLDrawable *box;
         GLDrawable *sphere[SPHERE_LODS];
         std::vector<CullingInterface*> culling_implementations;
@@ -64,6 +74,15 @@ class Scene
                 std::vector<uint32_t> &occluder_indices,
                 const Mesh &box_mesh, const vec4 *instances, unsigned num_instances);
 
+        // Occluder instances, used to pick occluders in the frustum and rasterize them front-to-back.
+        BVH occluder_tree;
+        std::vector<uint32_t> occluder_box_indices;
+        unsigned occluder_box_vertices;
+        std::vector<unsigned> visible_occluders;
+        std::vector<uint32_t> visible_occluder_indices;
+        mat4 occluder_view_projection;
+        void select_occluders(CullingInterface *culler);
+
         GLuint occluder_program;
         GLuint sphere_program;
 
@@ -78,6 +97,7 @@ class Scene
             unsigned buffer_index;
             GLuint instance_buffer[SPHERE_LODS];
         } indirect;
+        CullingStatistics statistics;
 
         void init_instances();
         GLuint physics_program;
@@ -94,6 +114,7 @@ class Scene
 
         mat4 projection;
         mat4 view;
+        vec3 camera_position;
 
         float camera_rotation_y;
         float camera_rotation_x;
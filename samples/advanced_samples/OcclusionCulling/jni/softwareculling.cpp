@@ -0,0 +1,127 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "culling.hpp"
+
+using namespace std;
+
+// Instance data is laid out as SphereInstance in scene.cpp, a position and radius followed by a velocity.
+#define SPHERE_INSTANCE_STRIDE (2 * sizeof(vec4))
+
+SoftwareCulling::SoftwareCulling(MaliSDK::ThreadPool *thread_pool)
+    : rasterizer(DEPTH_SIZE_LOG2, thread_pool)
+{
+    GL_CHECK(glGenTextures(1, &depth_texture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_texture));
+    GL_CHECK(glTexStorage2D(GL_TEXTURE_2D, rasterizer.get_num_levels(), GL_R32F, DEPTH_SIZE, DEPTH_SIZE));
+
+    // Float textures are not filterable.
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+    // Show depth as graytone like HiZCulling.
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+SoftwareCulling::~SoftwareCulling()
+{
+    GL_CHECK(glDeleteTextures(1, &depth_texture));
+}
+
+void SoftwareCulling::setup_occluder_geometry(const vector<vec4> &positions, const vector<uint32_t> &indices)
+{
+    rasterizer.set_occluder_geometry(positions, indices);
+}
+
+void SoftwareCulling::set_occluder_indices(const vector<uint32_t> &indices)
+{
+    rasterizer.set_occluder_indices(indices);
+}
+
+void SoftwareCulling::set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar)
+{
+    rasterizer.set_view_projection(projection, view, zNearFar);
+}
+
+void SoftwareCulling::rasterize_occluders()
+{
+    rasterizer.rasterize();
+
+    // Upload the depth pyramid so it can be shown by the debug view.
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, depth_texture));
+    for (unsigned level = 0; level < rasterizer.get_num_levels(); level++)
+    {
+        unsigned level_size = DEPTH_SIZE >> level;
+        GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, level_size, level_size,
+                    GL_RED, GL_FLOAT, rasterizer.get_level(level)));
+    }
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+void SoftwareCulling::test_bounding_boxes(GLuint counter_buffer, const unsigned *counter_offsets, unsigned num_offsets,
+        const GLuint *culled_instance_buffer, GLuint instance_data_buffer,
+        unsigned num_instances)
+{
+    for (unsigned i = 0; i < SPHERE_LODS; i++)
+    {
+        lod_instances[i].clear();
+    }
+
+    // Read back the instance data written by the physics compute shader.
+    GL_CHECK(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, instance_data_buffer));
+    GL_CHECK(const vec4 *instance_data = static_cast<const vec4*>(glMapBufferRange(GL_COPY_READ_BUFFER,
+                0, num_instances * SPHERE_INSTANCE_STRIDE, GL_MAP_READ_BIT)));
+
+    if (instance_data)
+    {
+        rasterizer.test_spheres(instance_data, SPHERE_INSTANCE_STRIDE, num_instances, lod_instances, min(num_offsets, unsigned(SPHERE_LODS)));
+        GL_CHECK(glUnmapBuffer(GL_COPY_READ_BUFFER));
+    }
+    else
+    {
+        LOGE("Failed to map instance buffer!");
+    }
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+    // Write the same results as the culling compute shader,
+    // visible instances per LOD and the instanceCount member of each IndirectCommand.
+    for (unsigned i = 0; i < num_offsets && i < SPHERE_LODS; i++)
+    {
+        GLuint instance_count = lod_instances[i].size();
+
+        if (instance_count)
+        {
+            GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, culled_instance_buffer[i]));
+            GL_CHECK(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, instance_count * sizeof(vec4), &lod_instances[i][0]));
+        }
+
+        GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, counter_buffer));
+        GL_CHECK(glBufferSubData(GL_COPY_WRITE_BUFFER, counter_offsets[i], sizeof(GLuint), &instance_count));
+    }
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
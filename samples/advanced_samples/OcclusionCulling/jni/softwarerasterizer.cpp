@@ -0,0 +1,642 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "softwarerasterizer.hpp"
+#include <algorithm>
+#include <math.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RASTERIZER_USE_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RASTERIZER_USE_SSE
+#endif
+
+using namespace std;
+
+// Pixels along each side of a tile. Tiles are rasterized independently on worker threads.
+#define TILE_SIZE 32
+
+// Spheres are occlusion tested in chunks of this size on worker threads.
+#define SPHERE_CHUNK_SIZE 1024
+
+// Depth thresholds for the LOD selection in hiz_cull.cs.
+static const float lod_depths[] = { 0.8f, 0.9f, 0.95f };
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned size_log2, MaliSDK::ThreadPool *thread_pool)
+    : size(1u << size_log2), sphere_tree(thread_pool), thread_pool(thread_pool)
+{
+    tile_size = min(size, unsigned(TILE_SIZE));
+    tiles_per_row = size / tile_size;
+    tile_bins.resize(tiles_per_row * tiles_per_row);
+
+    levels.resize(size_log2 + 1);
+    for (unsigned i = 0; i <= size_log2; i++)
+    {
+        levels[i].resize((size >> i) * (size >> i), 1.0f);
+    }
+
+    view = mat_look_at(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+    projection = mat_perspective_fov(60.0f, 1.0f, 1.0f, 500.0f);
+    z_near_far = vec2(1.0f, 500.0f);
+    eye = vec3(0.0f);
+}
+
+void SoftwareRasterizer::set_occluder_geometry(const vector<vec4> &positions, const vector<uint32_t> &indices)
+{
+    occluder_positions = positions;
+    occluder_indices = indices;
+}
+
+void SoftwareRasterizer::set_occluder_indices(const vector<uint32_t> &indices)
+{
+    occluder_indices = indices;
+}
+
+void SoftwareRasterizer::set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar)
+{
+    this->projection = projection;
+    this->view = view;
+    z_near_far = zNearFar;
+    eye = vec3(mat_inverse(view) * vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    frustum.setViewProjection(value_ptr(projection * view));
+}
+
+void SoftwareRasterizer::setup_triangle(const vec4 &a, const vec4 &b, const vec4 &c)
+{
+    const vec4 *vertices[3] = { &a, &b, &c };
+    float x[3], y[3], z[3];
+
+    // Perspective divide and viewport transform, window space depth is [0, 1] like glDepthRangef(0, 1).
+    for (unsigned i = 0; i < 3; i++)
+    {
+        float inv_w = 1.0f / vertices[i]->c.w;
+        x[i] = (vertices[i]->c.x * inv_w * 0.5f + 0.5f) * size;
+        y[i] = (vertices[i]->c.y * inv_w * 0.5f + 0.5f) * size;
+        z[i] = vertices[i]->c.z * inv_w * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (!(fabsf(area) > 0.0f))
+    {
+        return;
+    }
+
+    // Pixel centers which are inside the triangle, clamped to the screen.
+    float min_x = max(min(min(x[0], x[1]), x[2]) - 0.5f, 0.0f);
+    float min_y = max(min(min(y[0], y[1]), y[2]) - 0.5f, 0.0f);
+    float max_x = min(max(max(x[0], x[1]), x[2]) - 0.5f, float(size - 1));
+    float max_y = min(max(max(y[0], y[1]), y[2]) - 0.5f, float(size - 1));
+    if (min_x > max_x || min_y > max_y)
+    {
+        return;
+    }
+
+    Triangle tri;
+    tri.min_x = int(ceilf(min_x));
+    tri.min_y = int(ceilf(min_y));
+    tri.max_x = int(floorf(max_x));
+    tri.max_y = int(floorf(max_y));
+    if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+    {
+        return;
+    }
+
+    // Edge function for the edge from vertex i to vertex i + 1.
+    // Divided by the area it is the barycentric weight of the opposite vertex.
+    for (unsigned i = 0; i < 3; i++)
+    {
+        unsigned j = (i + 1) % 3;
+        tri.edges[i][0] = y[i] - y[j];
+        tri.edges[i][1] = x[j] - x[i];
+        tri.edges[i][2] = x[i] * y[j] - y[i] * x[j];
+    }
+
+    // Depth is affine in window space.
+    float inv_area = 1.0f / area;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        tri.depth[i] = (tri.edges[0][i] * z[2] + tri.edges[1][i] * z[0] + tri.edges[2][i] * z[1]) * inv_area;
+    }
+
+    // Occluders are rendered without backface culling, so flip clockwise triangles
+    // to have positive edge functions on the inside.
+    if (area < 0.0f)
+    {
+        for (unsigned i = 0; i < 3; i++)
+        {
+            for (unsigned j = 0; j < 3; j++)
+            {
+                tri.edges[i][j] = -tri.edges[i][j];
+            }
+        }
+    }
+
+    triangles.push_back(tri);
+}
+
+void SoftwareRasterizer::clip_triangle(const vec4 &a, const vec4 &b, const vec4 &c)
+{
+    const vec4 *vertices[3] = { &a, &b, &c };
+
+    // Trivially reject triangles which are completely outside one of the clip planes.
+    for (unsigned axis = 0; axis < 3; axis++)
+    {
+        if (a.data[axis] > a.c.w && b.data[axis] > b.c.w && c.data[axis] > c.c.w)
+        {
+            return;
+        }
+
+        if (a.data[axis] < -a.c.w && b.data[axis] < -b.c.w && c.data[axis] < -c.c.w)
+        {
+            return;
+        }
+    }
+
+    // Only the near plane needs real clipping, as it keeps w positive.
+    // Triangles crossing the other planes are handled by clamping the rasterized area to the screen.
+    float distance[3];
+    unsigned inside = 0;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        distance[i] = vertices[i]->c.z + vertices[i]->c.w;
+        if (distance[i] >= 0.0f)
+        {
+            inside++;
+        }
+    }
+
+    if (inside == 3)
+    {
+        setup_triangle(a, b, c);
+        return;
+    }
+
+    // Clip against the near plane, which leaves a triangle or a quad.
+    vec4 polygon[4];
+    unsigned num_vertices = 0;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        unsigned j = (i + 1) % 3;
+        if (distance[i] >= 0.0f)
+        {
+            polygon[num_vertices++] = *vertices[i];
+        }
+
+        if ((distance[i] >= 0.0f) != (distance[j] >= 0.0f))
+        {
+            float t = distance[i] / (distance[i] - distance[j]);
+            polygon[num_vertices++] = *vertices[i] + (*vertices[j] - *vertices[i]) * vec4(t);
+        }
+    }
+
+    for (unsigned i = 1; i + 1 < num_vertices; i++)
+    {
+        setup_triangle(polygon[0], polygon[i], polygon[i + 1]);
+    }
+}
+
+void SoftwareRasterizer::bin_triangles()
+{
+    for (unsigned i = 0; i < tile_bins.size(); i++)
+    {
+        tile_bins[i].clear();
+    }
+
+    for (unsigned i = 0; i < triangles.size(); i++)
+    {
+        const Triangle &tri = triangles[i];
+        for (unsigned y = tri.min_y / tile_size; y <= tri.max_y / tile_size; y++)
+        {
+            for (unsigned x = tri.min_x / tile_size; x <= tri.max_x / tile_size; x++)
+            {
+                tile_bins[y * tiles_per_row + x].push_back(i);
+            }
+        }
+    }
+}
+
+// Rasterizes pixels [x, end) of a row, keeping the minimum depth of pixels inside the triangle.
+// edges and depth are the plane equations evaluated at the center of pixel x.
+static inline void rasterize_span(float *row, unsigned x, unsigned end,
+        const float *edges, float depth, const float *edge_steps, float depth_step)
+{
+#if defined(RASTERIZER_USE_NEON)
+    // Spans are aligned to four pixels, the caller has made sure the extra pixels are within the tile.
+    static const float lane_offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    const float32x4_t lanes = vld1q_f32(lane_offsets);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    float32x4_t e0 = vmlaq_n_f32(vdupq_n_f32(edges[0]), lanes, edge_steps[0]);
+    float32x4_t e1 = vmlaq_n_f32(vdupq_n_f32(edges[1]), lanes, edge_steps[1]);
+    float32x4_t e2 = vmlaq_n_f32(vdupq_n_f32(edges[2]), lanes, edge_steps[2]);
+    float32x4_t z = vmlaq_n_f32(vdupq_n_f32(depth), lanes, depth_step);
+    const float32x4_t step0 = vdupq_n_f32(4.0f * edge_steps[0]);
+    const float32x4_t step1 = vdupq_n_f32(4.0f * edge_steps[1]);
+    const float32x4_t step2 = vdupq_n_f32(4.0f * edge_steps[2]);
+    const float32x4_t step_z = vdupq_n_f32(4.0f * depth_step);
+
+    for (; x < end; x += 4)
+    {
+        uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+        float32x4_t old_depth = vld1q_f32(row + x);
+        vst1q_f32(row + x, vbslq_f32(inside, vminq_f32(old_depth, z), old_depth));
+
+        e0 = vaddq_f32(e0, step0);
+        e1 = vaddq_f32(e1, step1);
+        e2 = vaddq_f32(e2, step2);
+        z = vaddq_f32(z, step_z);
+    }
+#elif defined(RASTERIZER_USE_SSE)
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 e0 = _mm_add_ps(_mm_set1_ps(edges[0]), _mm_mul_ps(lanes, _mm_set1_ps(edge_steps[0])));
+    __m128 e1 = _mm_add_ps(_mm_set1_ps(edges[1]), _mm_mul_ps(lanes, _mm_set1_ps(edge_steps[1])));
+    __m128 e2 = _mm_add_ps(_mm_set1_ps(edges[2]), _mm_mul_ps(lanes, _mm_set1_ps(edge_steps[2])));
+    __m128 z = _mm_add_ps(_mm_set1_ps(depth), _mm_mul_ps(lanes, _mm_set1_ps(depth_step)));
+    const __m128 step0 = _mm_set1_ps(4.0f * edge_steps[0]);
+    const __m128 step1 = _mm_set1_ps(4.0f * edge_steps[1]);
+    const __m128 step2 = _mm_set1_ps(4.0f * edge_steps[2]);
+    const __m128 step_z = _mm_set1_ps(4.0f * depth_step);
+
+    for (; x < end; x += 4)
+    {
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+        __m128 old_depth = _mm_loadu_ps(row + x);
+        __m128 new_depth = _mm_min_ps(old_depth, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+
+        e0 = _mm_add_ps(e0, step0);
+        e1 = _mm_add_ps(e1, step1);
+        e2 = _mm_add_ps(e2, step2);
+        z = _mm_add_ps(z, step_z);
+    }
+#else
+    for (unsigned i = 0; x < end; x++, i++)
+    {
+        float e0 = edges[0] + i * edge_steps[0];
+        float e1 = edges[1] + i * edge_steps[1];
+        float e2 = edges[2] + i * edge_steps[2];
+        if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+        {
+            row[x] = min(row[x], depth + i * depth_step);
+        }
+    }
+#endif
+}
+
+void SoftwareRasterizer::rasterize_tile(unsigned tile)
+{
+    const int tile_x = (tile % tiles_per_row) * tile_size;
+    const int tile_y = (tile / tiles_per_row) * tile_size;
+    const vector<unsigned> &bin = tile_bins[tile];
+    float *depth_buffer = &levels[0][0];
+
+#if defined(RASTERIZER_USE_NEON) || defined(RASTERIZER_USE_SSE)
+    // SIMD spans cover whole groups of four pixels.
+    const int align = tile_size >= 4 ? 4 : 1;
+#else
+    const int align = 1;
+#endif
+
+    for (unsigned i = 0; i < bin.size(); i++)
+    {
+        const Triangle &tri = triangles[bin[i]];
+
+        int x0 = max(tri.min_x, tile_x) & ~(align - 1);
+        int x1 = (min(tri.max_x, tile_x + int(tile_size) - 1) + align) & ~(align - 1);
+        int y0 = max(tri.min_y, tile_y);
+        int y1 = min(tri.max_y, tile_y + int(tile_size) - 1);
+
+        const float edge_steps[3] = { tri.edges[0][0], tri.edges[1][0], tri.edges[2][0] };
+        const float center_x = x0 + 0.5f;
+
+        for (int y = y0; y <= y1; y++)
+        {
+            // Evaluate the planes from scratch on every row to avoid accumulating error.
+            const float center_y = y + 0.5f;
+            float edges[3];
+            for (unsigned e = 0; e < 3; e++)
+            {
+                edges[e] = tri.edges[e][0] * center_x + tri.edges[e][1] * center_y + tri.edges[e][2];
+            }
+            float depth = tri.depth[0] * center_x + tri.depth[1] * center_y + tri.depth[2];
+
+            rasterize_span(depth_buffer + y * size, x0, x1, edges, depth, edge_steps, tri.depth[0]);
+        }
+    }
+}
+
+// Each output texel is the maximum of a 2x2 block of input texels, like depth_mip.fs.
+static void reduce_row(const float *row0, const float *row1, float *output, unsigned width)
+{
+    unsigned x = 0;
+
+#if defined(RASTERIZER_USE_NEON)
+    for (; x + 4 <= width; x += 4)
+    {
+        float32x4_t a = vmaxq_f32(vld1q_f32(row0 + 2 * x), vld1q_f32(row1 + 2 * x));
+        float32x4_t b = vmaxq_f32(vld1q_f32(row0 + 2 * x + 4), vld1q_f32(row1 + 2 * x + 4));
+        float32x4x2_t pairs = vuzpq_f32(a, b);
+        vst1q_f32(output + x, vmaxq_f32(pairs.val[0], pairs.val[1]));
+    }
+#elif defined(RASTERIZER_USE_SSE)
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 a = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x), _mm_loadu_ps(row1 + 2 * x));
+        __m128 b = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x + 4), _mm_loadu_ps(row1 + 2 * x + 4));
+        __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(output + x, _mm_max_ps(even, odd));
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        output[x] = max(max(row0[2 * x], row0[2 * x + 1]), max(row1[2 * x], row1[2 * x + 1]));
+    }
+}
+
+void SoftwareRasterizer::build_pyramid()
+{
+    for (unsigned level = 1; level < levels.size(); level++)
+    {
+        const unsigned level_size = size >> level;
+        const float *input = &levels[level - 1][0];
+        float *output = &levels[level][0];
+
+        thread_pool->parallelFor(level_size, [=](unsigned begin, unsigned end) {
+            for (unsigned y = begin; y < end; y++)
+            {
+                reduce_row(input + (2 * y) * (2 * level_size), input + (2 * y + 1) * (2 * level_size),
+                        output + y * level_size, level_size);
+            }
+        }, 16);
+    }
+}
+
+void SoftwareRasterizer::rasterize()
+{
+    // Transform occluders to clip space.
+    const mat4 view_projection = projection * view;
+    clip_positions.resize(occluder_positions.size());
+    thread_pool->parallelFor(occluder_positions.size(), [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; i++)
+        {
+            clip_positions[i] = view_projection * occluder_positions[i];
+        }
+    }, 256);
+
+    // Clip and set up triangles, then sort them into the tiles they touch.
+    triangles.clear();
+    for (size_t i = 0; i + 2 < occluder_indices.size(); i += 3)
+    {
+        clip_triangle(clip_positions[occluder_indices[i + 0]],
+                clip_positions[occluder_indices[i + 1]],
+                clip_positions[occluder_indices[i + 2]]);
+    }
+    bin_triangles();
+
+    // Tiles do not overlap, so they can be rasterized in parallel without synchronization.
+    fill(levels[0].begin(), levels[0].end(), 1.0f);
+    thread_pool->parallelFor(tile_bins.size(), [this](unsigned begin, unsigned end) {
+        for (unsigned tile = begin; tile < end; tile++)
+        {
+            rasterize_tile(tile);
+        }
+    });
+
+    build_pyramid();
+}
+
+bool SoftwareRasterizer::test_sphere(const vec4 &sphere, float &depth) const
+{
+    // This follows hiz_cull.cs, see there for details.
+    const float radius = sphere.c.w;
+    const vec4 view_center = view * vec4(sphere.c.x, sphere.c.y, sphere.c.z, 1.0f);
+    const float nearest_z = view_center.c.z + radius;
+
+    // Sphere clips against near plane, just assume visibility.
+    if (nearest_z >= -z_near_far.c.x)
+    {
+        depth = 0.0f;
+        return true;
+    }
+
+    // Find the tangent points of the sphere in the horizontal and vertical planes through the camera.
+    // The sphere is in front of the near plane here, so the tangent lengths are real.
+    const float horiz_length = sqrtf(view_center.c.x * view_center.c.x + view_center.c.z * view_center.c.z);
+    const float vert_length = sqrtf(view_center.c.y * view_center.c.y + view_center.c.z * view_center.c.z);
+    const float horiz_tangent = sqrtf(horiz_length * horiz_length - radius * radius);
+    const float vert_tangent = sqrtf(vert_length * vert_length - radius * radius);
+
+    const float horiz_cos = horiz_tangent / horiz_length;
+    const float horiz_sin = radius / horiz_length;
+    const float vert_cos = vert_tangent / vert_length;
+    const float vert_sin = radius / vert_length;
+
+    const float horiz_x = view_center.c.x / horiz_length;
+    const float horiz_z = view_center.c.z / horiz_length;
+    const float vert_y = view_center.c.y / vert_length;
+    const float vert_z = view_center.c.z / vert_length;
+
+    // Rotate the direction to the center both ways, and project the tangent directions.
+    // The tangent lengths cancel out in the perspective divide.
+    const float *proj = projection.data;
+    const float max_x = -0.5f * proj[0] * (horiz_x * horiz_cos - horiz_z * horiz_sin) / (horiz_z * horiz_cos + horiz_x * horiz_sin) + 0.5f;
+    const float min_x = -0.5f * proj[0] * (horiz_x * horiz_cos + horiz_z * horiz_sin) / (horiz_z * horiz_cos - horiz_x * horiz_sin) + 0.5f;
+    const float max_y = -0.5f * proj[5] * (vert_y * vert_cos - vert_z * vert_sin) / (vert_z * vert_cos + vert_y * vert_sin) + 0.5f;
+    const float min_y = -0.5f * proj[5] * (vert_y * vert_cos + vert_z * vert_sin) / (vert_z * vert_cos - vert_y * vert_sin) + 0.5f;
+
+    // Project our nearest Z value in view space.
+    depth = 0.5f * (proj[10] * nearest_z + proj[14]) / (proj[11] * nearest_z + proj[15]) + 0.5f;
+
+    // Pick the pyramid level where the bounding box covers at most 2x2 texels.
+    const float max_diff = max(max((max_x - min_x) * size, (max_y - min_y) * size), 1.0f);
+    const unsigned level = min(unsigned(ceilf(log2f(max_diff))), unsigned(levels.size() - 1));
+    const int level_size = size >> level;
+
+    const int x0 = int(clamp(min_x, 0.0f, 1.0f) * level_size);
+    const int x1 = int(clamp(max_x, 0.0f, 1.0f) * level_size);
+    const int y0 = int(clamp(min_y, 0.0f, 1.0f) * level_size);
+    const int y1 = int(clamp(max_y, 0.0f, 1.0f) * level_size);
+    const float *texels = &levels[level][0];
+
+    // Visible if any texel under the bounding box is further away than the nearest point of the sphere.
+    for (int y = y0; y <= min(y1, level_size - 1); y++)
+    {
+        for (int x = x0; x <= min(x1, level_size - 1); x++)
+        {
+            if (depth <= texels[y * level_size + x])
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void SoftwareRasterizer::test_spheres(const vec4 *spheres, size_t stride, unsigned num_spheres,
+        vector<vec4> *lod_instances, unsigned num_lods)
+{
+    const uint8_t *sphere_data = reinterpret_cast<const uint8_t*>(spheres);
+    sphere_boxes.clear();
+    sphere_boxes.reserve(num_spheres);
+    for (unsigned i = 0; i < num_spheres; i++)
+    {
+        const vec4 &sphere = *reinterpret_cast<const vec4*>(sphere_data + i * stride);
+        sphere_boxes.push(sphere.c.x - sphere.c.w, sphere.c.y - sphere.c.w, sphere.c.z - sphere.c.w,
+                sphere.c.x + sphere.c.w, sphere.c.y + sphere.c.w, sphere.c.z + sphere.c.w);
+    }
+
+    // Spheres move between calls, refitting is much cheaper than rebuilding the tree.
+    sphere_tree.update(sphere_boxes);
+
+    // Only spheres in leaves intersecting the frustum come back from the tree.
+    candidate_spheres.clear();
+    sphere_tree.query_frustum(frustum, eye, candidate_spheres);
+
+    // Leaves are only tested as a whole, so frustum test the candidates themselves with SIMD.
+    const unsigned num_candidates = candidate_spheres.size();
+    sphere_bounds.clear();
+    sphere_bounds.reserve(num_candidates);
+    for (unsigned i = 0; i < num_candidates; i++)
+    {
+        const vec4 &sphere = *reinterpret_cast<const vec4*>(sphere_data + candidate_spheres[i] * stride);
+        sphere_bounds.push(sphere.c.x, sphere.c.y, sphere.c.z, sphere.c.w);
+    }
+
+    visible_spheres.resize(num_candidates);
+    const unsigned num_visible = frustum.cullSpheres(sphere_bounds, visible_spheres.data());
+    for (unsigned i = 0; i < num_visible; i++)
+    {
+        visible_spheres[i] = candidate_spheres[visible_spheres[i]];
+    }
+
+    // Occlusion test the remaining spheres in chunks on worker threads.
+    // Every chunk has its own output lists which are merged in order afterwards,
+    // so the result does not depend on how the chunks were scheduled.
+    const unsigned num_chunks = (num_visible + SPHERE_CHUNK_SIZE - 1) / SPHERE_CHUNK_SIZE;
+    chunk_instances.resize(num_chunks * num_lods);
+
+    thread_pool->parallelFor(num_chunks, [&](unsigned begin, unsigned end) {
+        for (unsigned chunk = begin; chunk < end; chunk++)
+        {
+            vector<vec4> *outputs = &chunk_instances[chunk * num_lods];
+            for (unsigned lod = 0; lod < num_lods; lod++)
+            {
+                outputs[lod].clear();
+            }
+
+            const unsigned chunk_end = min((chunk + 1) * SPHERE_CHUNK_SIZE, num_visible);
+            for (unsigned i = chunk * SPHERE_CHUNK_SIZE; i < chunk_end; i++)
+            {
+                const vec4 &sphere = *reinterpret_cast<const vec4*>(sphere_data + visible_spheres[i] * stride);
+
+                float depth;
+                if (!test_sphere(sphere, depth))
+                {
+                    continue;
+                }
+
+                unsigned lod = 0;
+                while (lod + 1 < num_lods && lod < sizeof(lod_depths) / sizeof(lod_depths[0]) && depth >= lod_depths[lod])
+                {
+                    lod++;
+                }
+                outputs[lod].push_back(sphere);
+            }
+        }
+    });
+
+    for (unsigned chunk = 0; chunk < num_chunks; chunk++)
+    {
+        for (unsigned lod = 0; lod < num_lods; lod++)
+        {
+            const vector<vec4> &output = chunk_instances[chunk * num_lods + lod];
+            lod_instances[lod].insert(lod_instances[lod].end(), output.begin(), output.end());
+        }
+    }
+}
+
+bool SoftwareRasterizer::self_test(MaliSDK::ThreadPool *thread_pool)
+{
+    SoftwareRasterizer rasterizer(6, thread_pool);
+
+    // A 4x4 quad 10 units in front of the camera, which looks down -Z from the origin.
+    vector<vec4> positions;
+    positions.push_back(vec4(-2.0f, -2.0f, -10.0f, 1.0f));
+    positions.push_back(vec4(+2.0f, -2.0f, -10.0f, 1.0f));
+    positions.push_back(vec4(-2.0f, +2.0f, -10.0f, 1.0f));
+    positions.push_back(vec4(+2.0f, +2.0f, -10.0f, 1.0f));
+    static const uint32_t quad_indices[] = { 0, 1, 2, 2, 1, 3 };
+    vector<uint32_t> indices(quad_indices, quad_indices + 6);
+
+    rasterizer.set_occluder_geometry(positions, indices);
+    rasterizer.set_view_projection(mat_perspective_fov(60.0f, 1.0f, 1.0f, 500.0f),
+            mat_look_at(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f)),
+            vec2(1.0f, 500.0f));
+    rasterizer.rasterize();
+
+    // Behind the quad, beside it, in front of it and behind the camera.
+    // The radius tells the spheres apart in the output.
+    const vec4 spheres[] = {
+        vec4(0.0f, 0.0f, -30.0f, 1.0f),
+        vec4(10.0f, 0.0f, -30.0f, 2.0f),
+        vec4(0.0f, 0.0f, -5.0f, 0.5f),
+        vec4(0.0f, 0.0f, 30.0f, 1.5f),
+    };
+    static const bool expected[] = { false, true, true, false };
+    const unsigned num_spheres = sizeof(spheres) / sizeof(spheres[0]);
+
+    vector<vec4> lod_instances[4];
+    rasterizer.test_spheres(spheres, sizeof(vec4), num_spheres, lod_instances, 4);
+
+    unsigned num_kept = 0;
+    for (unsigned lod = 0; lod < 4; lod++)
+    {
+        num_kept += lod_instances[lod].size();
+    }
+
+    unsigned num_expected = 0;
+    for (unsigned i = 0; i < num_spheres; i++)
+    {
+        bool kept = false;
+        for (unsigned lod = 0; lod < 4; lod++)
+        {
+            for (size_t j = 0; j < lod_instances[lod].size(); j++)
+            {
+                kept = kept || lod_instances[lod][j].c.w == spheres[i].c.w;
+            }
+        }
+
+        if (kept != expected[i])
+        {
+            return false;
+        }
+        num_expected += expected[i] ? 1 : 0;
+    }
+
+    return num_kept == num_expected;
+}
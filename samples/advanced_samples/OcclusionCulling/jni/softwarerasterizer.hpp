@@ -0,0 +1,120 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef SOFTWARE_RASTERIZER_HPP__
+#define SOFTWARE_RASTERIZER_HPP__
+
+#include "vector_math.h"
+#include "FrustumCulling.h"
+#include "ThreadPool.h"
+#include "bvh.hpp"
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// CPU implementation of the Hi-Z occlusion test done by HiZCulling.
+//
+// Occluders are rasterized into a small depth buffer which is split into tiles, and tiles are rasterized on worker threads.
+// The depth buffer is then reduced to a max-depth pyramid, and bounding spheres are tested against it with the same
+// algorithm as hiz_cull.cs.
+//
+// There are no GL dependencies here, SoftwareCulling takes care of moving data to and from the GPU.
+class SoftwareRasterizer
+{
+    public:
+        // The depth buffer is (1 << size_log2) pixels in both directions, like the depth texture in HiZCulling.
+        // Work is split across thread_pool, which must outlive the rasterizer.
+        SoftwareRasterizer(unsigned size_log2, MaliSDK::ThreadPool *thread_pool);
+
+        // Occluder geometry is an indexed triangle list. This should be mostly static.
+        void set_occluder_geometry(const std::vector<vec4> &positions, const std::vector<uint32_t> &indices);
+        void set_occluder_indices(const std::vector<uint32_t> &indices);
+        void set_view_projection(const mat4 &projection, const mat4 &view, const vec2 &zNearFar);
+
+        // Rasterize occluders to the depth buffer and build the depth pyramid.
+        void rasterize();
+
+        // Test spheres (xyz = center, w = radius) stride bytes apart against the frustum and the depth pyramid.
+        // Visible spheres are appended to lod_instances[lod], where the LOD is selected from depth like hiz_cull.cs.
+        // Spheres are kept in a BVH which is refitted on every call, so they may move between calls.
+        // Only spheres in subtrees intersecting the frustum are tested, roughly in front-to-back order.
+        void test_spheres(const vec4 *spheres, size_t stride, unsigned num_spheres,
+                std::vector<vec4> *lod_instances, unsigned num_lods);
+
+        // Rasterizes one occluder quad and tests spheres behind, beside, in front of and behind the camera
+        // against it. Returns true if exactly the spheres beside and in front of the quad are kept.
+        // Needs no GL context, so culling can be checked on a headless machine.
+        static bool self_test(MaliSDK::ThreadPool *thread_pool);
+
+        unsigned get_size() const { return size; }
+        unsigned get_num_levels() const { return levels.size(); }
+
+        // Window space depth of a pyramid level, (size >> level) squared texels with the bottom row first like a GL texture.
+        const float *get_level(unsigned level) const { return &levels[level][0]; }
+
+    private:
+        // Screen space triangle ready for rasterization.
+        // Both edge functions and depth are planes evaluated as a * x + b * y + c.
+        struct Triangle
+        {
+            float edges[3][3];
+            float depth[3];
+            int min_x, min_y, max_x, max_y;
+        };
+
+        unsigned size;
+        unsigned tile_size;
+        unsigned tiles_per_row;
+
+        std::vector<vec4> occluder_positions;
+        std::vector<uint32_t> occluder_indices;
+        std::vector<vec4> clip_positions;
+
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<unsigned> > tile_bins;
+
+        // levels[0] is the depth buffer itself.
+        std::vector<std::vector<float> > levels;
+
+        mat4 view;
+        mat4 projection;
+        vec2 z_near_far;
+        vec3 eye;
+        MaliSDK::FrustumCuller frustum;
+
+        BVH sphere_tree;
+        MaliSDK::BoundingBoxArray sphere_boxes;
+        std::vector<unsigned> candidate_spheres;
+        MaliSDK::BoundingSphereArray sphere_bounds;
+        std::vector<unsigned> visible_spheres;
+        std::vector<std::vector<vec4> > chunk_instances;
+
+        MaliSDK::ThreadPool *thread_pool;
+
+        void setup_triangle(const vec4 &a, const vec4 &b, const vec4 &c);
+        void clip_triangle(const vec4 &a, const vec4 &b, const vec4 &c);
+        void bin_triangles();
+        void rasterize_tile(unsigned tile);
+        void build_pyramid();
+        bool test_sphere(const vec4 &sphere, float &depth) const;
+};
+
+#endif
@@ -36,12 +36,16 @@
 #include "Texture.h"
 #include "Shader.h"
 #include "Matrix.h"
+#include "MatrixBenchmark.h"
 #include "Platform.h"
 #include "Mathematics.h"
 
 using std::string;
 using namespace MaliSDK;
 
+/* Set to 1 to log the cost of per-vertex and batched matrix transforms at start-up. */
+#define MATRIX_BENCHMARK 0
+
 /* Asset directories and filenames. */
 string resourceDirectory = "/data/data/com.arm.malideveloper.openglessdk.rotozoom/";
 string textureFilename = "RotoZoom.raw";
@@ -78,6 +82,14 @@ bool setupGraphics(int width, int height)
     
     windowWidth = width;
     windowHeight = height;
+
+#if MATRIX_BENCHMARK
+    if (!MatrixBenchmark::run(4096, 1000))
+    {
+        LOGE("Batched matrix transforms do not match the per-vertex path\n");
+        return false;
+    }
+#endif
     
     /* Full paths to the shader and texture files */
     string texturePath = resourceDirectory + textureFilename;   
@@ -105,10 +117,11 @@ bool setupGraphics(int width, int height)
     /* Load just base level texture data. */
     GL_CHECK(glGenTextures(1, &textureID));
     GL_CHECK(glBindTexture(GL_TEXTURE_2D, textureID));
-    unsigned char *textureData = NULL;
-    Texture::loadData(texturePath.c_str(), &textureData);
+    MappedFile textureFile;
+    Texture::loadData(texturePath.c_str(), textureFile);
         
-    GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData));        
+    GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureFile.getData()));
+    textureFile.close();
 
     /* Set texture mode. */
     GL_CHECK(glGenerateMipmap(GL_TEXTURE_2D));
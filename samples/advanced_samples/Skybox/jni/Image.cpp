@@ -18,6 +18,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -25,8 +26,41 @@
 #include "Skybox.h"
 #include "Image.h"
 
+/**
+ * \brief Copy the next line of a mapped file into a null-terminated buffer, like fgets() does for a FILE.
+ *
+ * \param[out]    line_str           Buffer receiving the line, including the line break.
+ * \param[in]     read_buffer_length Size of line_str.
+ * \param[in,out] cursor             Position in the file, moved past the copied characters.
+ * \param[in]     end                End of the file.
+ * \return        line_str, or NULL if the end of the file has been reached.
+ */
+static char* read_line(char* line_str, int read_buffer_length, const char*& cursor, const char* end)
+{
+    int n_chars = 0;
+
+    if (cursor >= end)
+    {
+        return NULL;
+    }
+
+    while (cursor < end && n_chars < read_buffer_length - 1)
+    {
+        line_str[n_chars++] = *cursor;
+
+        if (*cursor++ == '\n')
+        {
+            break;
+        }
+    }
+
+    line_str[n_chars] = '\0';
+
+    return line_str;
+}
+
 /* Please see the header for specification. */
-ImageFile load_ppm_file(const char* ppm_file_name)
+ImageFile load_ppm_file(const char* ppm_file_name, MaliSDK::MappedFile& ppm_file)
 {
     ImageFile image = { 0, 0, NULL };
 
@@ -39,32 +73,34 @@ ImageFile load_ppm_file(const char* ppm_file_name)
     const char comment_id    = '#';
     const char pixmap_mark[] = "P6\n";
 
-    int   id_255          = 0;
-    int   height          = 0;
-    char* line_str        = NULL;
-    int   n_loaded_pixels = 0;
-    char* pixels          = NULL;
-    char* returned_str    = NULL;
-    int   returned_value  = 0;
-    int   width           = 0;
-
-    FILE* pFile = fopen(ppm_file_name, "rb");
-
-    if (pFile == NULL)
+    int         id_255         = 0;
+    int         height         = 0;
+    char*       line_str       = NULL;
+    const char* cursor         = NULL;
+    const char* end            = NULL;
+    char*       returned_str   = NULL;
+    int         returned_value = 0;
+    int         width          = 0;
+
+    /* The pixels are used straight from the mapped file, so there is no need for a pixel buffer. */
+    if (!ppm_file.open(ppm_file_name))
     {
         LOGF("Error opening .ppm file.");
 
         exit(EXIT_FAILURE);
     }
 
+    cursor = (const char*) ppm_file.getData();
+    end    = cursor + ppm_file.getSize();
+
     MALLOC_CHECK(char*, line_str, read_buffer_length);
 
     /* Read the first line. */
-    returned_str = fgets(line_str, read_buffer_length, pFile);
+    returned_str = read_line(line_str, read_buffer_length, cursor, end);
 
     if (returned_str == NULL)
     {
-    	LOGF("Error reading .ppm file.");
+        LOGF("Error reading .ppm file.");
 
         exit(EXIT_FAILURE);
     }
@@ -74,23 +110,30 @@ ImageFile load_ppm_file(const char* ppm_file_name)
 
     if (returned_value != 0)
     {
-    	LOGF("File does not contain P6 string in the header.");
+        LOGF("File does not contain P6 string in the header.");
 
-    	exit(EXIT_FAILURE);
+        exit(EXIT_FAILURE);
     }
 
-    returned_str = fgets(line_str, read_buffer_length, pFile);
+    returned_str = read_line(line_str, read_buffer_length, cursor, end);
+
+    if (returned_str == NULL)
+    {
+        LOGF("Error reading .ppm file.");
+
+        exit(EXIT_FAILURE);
+    }
 
     /* Ignore any comments after P6 identifier, beginning with '#' */
     while (strncmp(line_str, &comment_id, sizeof(comment_id)) == 0)
     {
-        returned_str = fgets(line_str, read_buffer_length, pFile);
+        returned_str = read_line(line_str, read_buffer_length, cursor, end);
 
         if (returned_str == NULL)
         {
-        	LOGF("Error reading .ppm file.");
+            LOGF("Error reading .ppm file.");
 
-        	exit(EXIT_FAILURE);
+            exit(EXIT_FAILURE);
         }
     }
 
@@ -100,47 +143,44 @@ ImageFile load_ppm_file(const char* ppm_file_name)
     /* Make sure both width and height have been read correctly. */
     if (returned_value != 2)
     {
-    	LOGF("Error reading image width/height from the .ppm file.");
+        LOGF("Error reading image width/height from the .ppm file.");
 
-    	exit(EXIT_FAILURE);
+        exit(EXIT_FAILURE);
     }
 
     /* Check if the maximum color value is 255. */
-    returned_value = fscanf(pFile, "%d", &id_255);
-
-    if (!(returned_value == 1 && id_255 == max_color_value))
+    while (cursor < end && isspace(*cursor))
     {
-    	LOGF("Error reading 255 mark in the .ppm file.");
-
-    	exit(EXIT_FAILURE);
+        cursor++;
     }
 
-    fseek(pFile, 1, SEEK_CUR);
-
-    /* Each pixel consists of 3 bytes for GL_RGB storage. */
-    pixels = (char*) calloc(width * height, num_of_bytes_per_pixel);
+    while (cursor < end && isdigit(*cursor))
+    {
+        id_255 = id_255 * 10 + (*cursor++ - '0');
+    }
 
-    if (pixels == NULL)
+    if (id_255 != max_color_value)
     {
-    	LOGF("Error allocating memory for pixels buffer.");
+        LOGF("Error reading 255 mark in the .ppm file.");
 
-    	exit(EXIT_FAILURE);
+        exit(EXIT_FAILURE);
     }
 
-    /* Load image into the pixel buffer. */
-    n_loaded_pixels = fread(pixels, num_of_bytes_per_pixel, width * height, pFile);
+    /* Skip the single white space character which separates the header from the pixels. */
+    cursor++;
 
-    if (n_loaded_pixels != width * height)
+    /* Each pixel consists of 3 bytes for GL_RGB storage. */
+    if (end - cursor < (long) width * height * num_of_bytes_per_pixel)
     {
-    	LOGF("Error reading .ppm file.");
+        LOGF("Error reading .ppm file.");
 
-    	exit(EXIT_FAILURE);
+        exit(EXIT_FAILURE);
     }
 
     /* Finally, put all needed info into the Image struct. */
     image.width  = width;
     image.height = height;
-    image.pixels = pixels;
+    image.pixels = cursor;
 
     FREE_CHECK(line_str);
 
@@ -21,6 +21,8 @@
 #ifndef PIXMAP_H
     #define PIXMAP_H
 
+    #include "MappedFile.h"
+
     /**
      * \brief Struct representing texture image.
      */
@@ -31,14 +33,15 @@
         /** Height of texture. */
         int   height;
         /** Pointer to the pixel data. */
-        char* pixels; 
+        const char* pixels; 
     } ImageFile;
 
-    /** Reads the pixmap file and loads the texture image information into Image struct.
+    /** Maps the pixmap file into memory and loads the texture image information into Image struct.
      *
      *  @param ppm_file_name Path to the .ppm file.
+     *  @param ppm_file      Holds the file contents. The pixel data points into it, so it is only valid while ppm_file is open.
      *  @return              Filled TextureImage struct with texture image params and data.
      */
-    ImageFile load_ppm_file(const char* ppm_file_name);
+    ImageFile load_ppm_file(const char* ppm_file_name, MaliSDK::MappedFile& ppm_file);
 
 #endif /* PIXMAP_H */
@@ -188,7 +188,9 @@ void setup_graphics(int width, int height)
     GL_CHECK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
 
     /* Load cubemap texture. */
-    cubemap_image = load_ppm_file(file_name);
+    MaliSDK::MappedFile cubemap_file;
+
+    cubemap_image = load_ppm_file(file_name, cubemap_file);
 
     /* Specify storage for all levels of a cubemap texture. */
     GL_CHECK(glTexStorage2D(GL_TEXTURE_CUBE_MAP,    /* Texture target */
@@ -203,7 +205,7 @@ void setup_graphics(int width, int height)
         {
             sprintf(file_name, "/data/data/com.arm.malideveloper.openglessdk.skybox/files/greenhouse_skybox-%d.ppm", n_face);
 
-            cubemap_image = load_ppm_file(file_name);
+            cubemap_image = load_ppm_file(file_name, cubemap_file);
         }
 
         GL_CHECK(glTexSubImage2D(cubemap_faces[n_face],                  /* Texture target. */
@@ -216,7 +218,7 @@ void setup_graphics(int width, int height)
                                  GL_UNSIGNED_BYTE,                       /* Type of the pixel data. */
                                  (const GLvoid*) cubemap_image.pixels)); /* Pointer to the image data. */
 
-        FREE_CHECK(cubemap_image.pixels);
+        cubemap_file.close();
     }
 
     /* Create a program object that we will attach the fragment and vertex shader to. */
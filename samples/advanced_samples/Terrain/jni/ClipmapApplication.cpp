@@ -21,13 +21,26 @@
 #include "ClipmapApplication.h"
 #include "shaders.h"
 #include "Platform.h"
+#include "FrustumCullingBenchmark.h"
 #include <cstdio>
 
 using namespace MaliSDK;
 using namespace std;
 
-ClipmapApplication::ClipmapApplication(unsigned int size, unsigned int levels, float clip_scale)
-    : mesh(size, levels, clip_scale), heightmap(size * 4 - 1, levels), frame(0)
+// Set to 1 to log the CPU cost of heightmap updates per clip level at start-up.
+#define HEIGHTMAP_BENCHMARK 0
+
+// Set to 1 to log the cost of batched and one-at-a-time frustum culling at start-up.
+#define FRUSTUM_CULLING_BENCHMARK 0
+
+// Set to 1 to check block culling of the draw list against a fixed camera at start-up.
+#define DRAW_LIST_SELF_TEST 0
+
+// Set to 0 to cull and draw the terrain blocks from the CPU, even if OpenGL ES 3.1 is available.
+#define INDIRECT_DRAW 1
+
+ClipmapApplication::ClipmapApplication(unsigned int size, unsigned int levels, float clip_scale, const char *heightmap_path)
+    : mesh(size, levels, clip_scale), heightmap(size * 4 - 1, levels, heightmap_path), frame(0)
 {
     // Compile shaders and grab uniform locations for later use.
     program = compile_program(vertex_shader_source, fragment_shader_source);
@@ -51,6 +64,34 @@ ClipmapApplication::ClipmapApplication(unsigned int size, unsigned int levels, f
     GL_CHECK(GLint inv_level_size_loc = glGetUniformLocation(program, "uInvLevelSize"));
     GL_CHECK(glUniform1fv(inv_level_size_loc, inv_level_size.size(), &inv_level_size[0]));
     GL_CHECK(glUseProgram(0));
+
+#if INDIRECT_DRAW
+    if (mesh.set_draw_mode(GroundMesh::DrawIndirect))
+    {
+        LOGI("Terrain blocks are culled by a compute shader and drawn indirectly.\n");
+    }
+#endif
+
+#if HEIGHTMAP_BENCHMARK
+    // The sample camera moves about 4.5 texels per frame, also measure faster flight.
+    static const float speeds[] = { 1.0f, 4.5f, 16.0f, 64.0f };
+    heightmap.benchmark(speeds, sizeof(speeds) / sizeof(speeds[0]), 300);
+#endif
+
+#if FRUSTUM_CULLING_BENCHMARK
+    FrustumCullingBenchmark::run(100000, 100);
+#endif
+
+#if DRAW_LIST_SELF_TEST
+    if (ClipmapDrawList::self_test())
+    {
+        LOGI("Draw list self test passed.\n");
+    }
+    else
+    {
+        LOGE("Draw list self test failed.\n");
+    }
+#endif
 }
 
 ClipmapApplication::~ClipmapApplication()
@@ -31,7 +31,8 @@
 class ClipmapApplication
 {
 public:
-    ClipmapApplication(unsigned int size, unsigned int levels, float clip_scale);
+    // heightmap_path is passed on to Heightmap, NULL uses the in-memory heightmap.
+    ClipmapApplication(unsigned int size, unsigned int levels, float clip_scale, const char *heightmap_path = NULL);
     ~ClipmapApplication();
     void render(unsigned int viewport_width, unsigned int viewport_height);
 
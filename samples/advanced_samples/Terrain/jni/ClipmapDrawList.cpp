@@ -0,0 +1,306 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ClipmapDrawList.h"
+#include <algorithm>
+
+using namespace MaliSDK;
+using namespace std;
+
+// The culling compute shader gets these through #defines, see GroundMeshIndirect.cpp.
+const float ClipmapDrawList::height_min = -20.0f;
+const float ClipmapDrawList::height_max = 20.0f;
+const float ClipmapDrawList::bounds_epsilon = 0.01f;
+
+ClipmapDrawList::ClipmapDrawList(unsigned int size, unsigned int levels, float clip_scale)
+    : size(size), levels(levels), clipmap_scale(clip_scale), texture_scale(1.0f / (4 * size - 1)), instance_capacity(0)
+{
+}
+
+void ClipmapDrawList::begin_draw(size_t first_index, size_t indices)
+{
+    Draw draw;
+    draw.first_index = first_index;
+    draw.indices = indices;
+    draw.first_candidate = candidates.size();
+    draw.num_candidates = 0;
+    draw.first_instance = 0;
+    draws.push_back(draw);
+}
+
+void ClipmapDrawList::add_candidate(const vec2& offset, const vec2& range, unsigned int level, TrimCondition trim)
+{
+    Candidate candidate;
+    candidate.offset = offset;
+    candidate.range = range;
+    candidate.level = level;
+    candidate.trim = trim;
+    candidates.push_back(candidate);
+    draws.back().num_candidates++;
+}
+
+// Round up to nearest aligned offset.
+static inline size_t realign_offset(size_t offset, size_t align)
+{
+    return (offset + align - 1) & ~(align - 1);
+}
+
+size_t ClipmapDrawList::layout_instances(size_t align)
+{
+    size_t offset = 0;
+    for (vector<Draw>::iterator itr = draws.begin(); itr != draws.end(); ++itr)
+    {
+        // The instance data is 32 bytes, and uniform buffer alignment is a power of two, typically 256 bytes or less.
+        // Either way, aligned offsets are a whole number of instances.
+        offset = realign_offset(offset, align);
+        itr->first_instance = offset / sizeof(InstanceData);
+        offset += itr->num_candidates * sizeof(InstanceData);
+    }
+
+    offset = realign_offset(offset, align);
+    instance_capacity = offset / sizeof(InstanceData);
+    return offset;
+}
+
+unsigned int ClipmapDrawList::get_max_candidates_per_draw() const
+{
+    unsigned int max_candidates = 0;
+    for (vector<Draw>::const_iterator itr = draws.begin(); itr != draws.end(); ++itr)
+        max_candidates = max(max_candidates, (unsigned int)itr->num_candidates);
+    return max_candidates;
+}
+
+// offset.x and offset.y are either 0 or at least 1.
+// Using 0.5f as threshold is a safe way to check for this difference.
+bool ClipmapDrawList::trim_visible(const vector<vec2>& level_offsets, const Candidate& candidate) const
+{
+    if (candidate.trim == TrimAlways)
+        return true;
+
+    // There are four different ways (top-right, bottom-right, top-left, bottom-left)
+    // to apply a trim region depending on how camera snapping is done in GroundMesh::get_offset_level().
+    // Only one of the conditions will be true for a given level.
+    unsigned int level = candidate.level;
+    vec2 offset_prev_level = level_offsets[level - 1];
+    vec2 offset_current_level = level_offsets[level] + vec2((size - 1) << level);
+    vec2 offset = offset_prev_level - offset_current_level;
+
+    switch (candidate.trim)
+    {
+        case TrimTopRight:
+            return offset.c.x < 0.5f && offset.c.y > 0.5f;
+        case TrimTopLeft:
+            return offset.c.x > 0.5f && offset.c.y > 0.5f;
+        case TrimBottomRight:
+            return offset.c.x < 0.5f && offset.c.y < 0.5f;
+        case TrimBottomLeft:
+            return offset.c.x > 0.5f && offset.c.y < 0.5f;
+        default:
+            return false;
+    }
+}
+
+void ClipmapDrawList::build(const vector<vec2>& level_offsets, const FrustumCuller& culler,
+        DrawCommand *commands, InstanceData *instances)
+{
+    candidate_instances.clear();
+    candidate_indices.clear();
+    candidate_bounds.clear();
+
+    // Place every candidate in the world.
+    //
+    // It is important to note that instance.offset is a pre-scaled offset which denotes the
+    // world-space X/Z position of the top-left vertex in the block.
+    // instance.scale is used to scale vertex data in a block (which are just integers).
+    //
+    // World space X/Z coordinates are computed as instance.offset + vertex_coord * instance.scale.
+    for (unsigned int i = 0; i < candidates.size(); i++)
+    {
+        const Candidate& candidate = candidates[i];
+        if (!trim_visible(level_offsets, candidate))
+            continue;
+
+        float level_scale = float(1 << candidate.level);
+
+        InstanceData instance;
+        instance.offset = level_offsets[candidate.level] + candidate.offset * vec2(level_scale);
+
+        // Texel coordinates are derived by just dividing the world space offset with texture size.
+        // The 0.5 texel offset required to sample exactly at the texel center is done in vertex shader.
+        // Avoid texture coordinates which are very large as this can be difficult for the texture sampler
+        // to handle (float precision). Since we use GL_REPEAT, fract() does not change the result.
+        // Scale the offset down by 2^level first to get the appropriate texel.
+        instance.texture_scale = vec2(texture_scale);
+        instance.texture_offset = vec_fract((instance.offset / vec2(level_scale)) * instance.texture_scale);
+        instance.offset *= vec2(clipmap_scale);
+        instance.scale = clipmap_scale * level_scale;
+        instance.level = candidate.level;
+
+        vec2 extent = candidate.range * vec2(level_scale * clipmap_scale);
+        candidate_bounds.push(instance.offset.c.x - bounds_epsilon, height_min - bounds_epsilon, instance.offset.c.y - bounds_epsilon,
+                instance.offset.c.x + extent.c.x + bounds_epsilon, height_max + bounds_epsilon, instance.offset.c.y + extent.c.y + bounds_epsilon);
+        candidate_instances.push_back(instance);
+        candidate_indices.push_back(i);
+    }
+
+    // Cull all candidates in one batch. The visible indices come back in ascending order,
+    // so the visible instances of each draw are found in order as well.
+    visible_candidates.resize(candidate_instances.size());
+    unsigned int num_visible = candidate_instances.empty() ? 0 : culler.cullBoxes(candidate_bounds, &visible_candidates[0]);
+
+    unsigned int visible_index = 0;
+    for (unsigned int i = 0; i < draws.size(); i++)
+    {
+        const Draw& draw = draws[i];
+        unsigned int candidates_end = draw.first_candidate + draw.num_candidates;
+        InstanceData *draw_instances = instances + draw.first_instance;
+
+        DrawCommand& command = commands[i];
+        command.count = draw.indices;
+        command.instance_count = 0;
+        command.first_index = draw.first_index;
+        command.base_vertex = 0;
+        command.reserved_must_be_zero = 0;
+
+        while (visible_index < num_visible && candidate_indices[visible_candidates[visible_index]] < candidates_end)
+            draw_instances[command.instance_count++] = candidate_instances[visible_candidates[visible_index++]];
+    }
+}
+
+void ClipmapDrawList::build_reference(const vector<vec2>& level_offsets, const FrustumCuller& culler,
+        vector<DrawCommand>& commands, vector<InstanceData>& instances)
+{
+    commands.resize(draws.size());
+    instances.resize(instance_capacity);
+    if (!draws.empty())
+        build(level_offsets, culler, &commands[0], instances.empty() ? NULL : &instances[0]);
+}
+
+bool ClipmapDrawList::self_test()
+{
+    // Same candidate layout as GroundMesh::setup_draw_list() for size 5, 3 levels and clip scale 1.
+    // Every draw uses its own index as the index count, so commands can be matched to draws.
+    const unsigned int size = 5;
+    const unsigned int levels = 3;
+    const unsigned int n = size - 1;
+    ClipmapDrawList list(size, levels, 1.0f);
+
+    // Main blocks, a full 4x4 grid at level 0 and a ring of 12 above that.
+    list.begin_draw(0, 0);
+    for (unsigned int z = 0; z < 4; z++)
+        for (unsigned int x = 0; x < 4; x++)
+            list.add_candidate(vec2(x, z) * vec2(n), vec2(n), 0);
+    for (unsigned int i = 1; i < levels; i++)
+    {
+        for (unsigned int z = 0; z < 4; z++)
+        {
+            for (unsigned int x = 0; x < 4; x++)
+            {
+                if (z != 0 && z != 3 && x != 0 && x != 3)
+                    continue;
+                list.add_candidate(vec2(x * n + (x >= 2 ? 2 : 0), z * n + (z >= 2 ? 2 : 0)), vec2(n), i);
+            }
+        }
+    }
+
+    // Vertical and horizontal fixups.
+    list.begin_draw(0, 1);
+    for (unsigned int i = 1; i < levels; i++)
+    {
+        list.add_candidate(vec2(2 * n, 0), vec2(2, n), i);
+        list.add_candidate(vec2(2 * n, 3 * n + 2), vec2(2, n), i);
+    }
+    list.begin_draw(0, 2);
+    for (unsigned int i = 1; i < levels; i++)
+    {
+        list.add_candidate(vec2(0, 2 * n), vec2(n, 2), i);
+        list.add_candidate(vec2(3 * n + 2, 2 * n), vec2(n, 2), i);
+    }
+
+    // Left and right degenerates.
+    list.begin_draw(0, 3);
+    for (unsigned int i = 0; i < levels - 1; i++)
+        list.add_candidate(vec2(0.0f), vec2(0, 4 * size - 2), i);
+    list.begin_draw(0, 4);
+    for (unsigned int i = 0; i < levels - 1; i++)
+        list.add_candidate(vec2(4 * n, 0) + (i > 0 ? vec2(2, 0) : vec2(0.0f)), vec2(0, 4 * size - 2), i);
+
+    // Full trim, and the four conditional trims.
+    list.begin_draw(0, 5);
+    list.add_candidate(vec2(n), vec2(2 * size), 1);
+    const TrimCondition trims[] = { TrimTopRight, TrimTopLeft, TrimBottomRight, TrimBottomLeft };
+    for (unsigned int t = 0; t < 4; t++)
+    {
+        list.begin_draw(0, 6 + t);
+        for (unsigned int i = 2; i < levels; i++)
+            list.add_candidate(vec2(n), vec2(2 * size), i, trims[t]);
+    }
+
+    list.layout_instances(sizeof(InstanceData));
+
+    // Level offsets as GroundMesh::get_offset_level() places them for a camera at the origin.
+    // Level 1 and 2 share their snapped position, so only the bottom-right trim is used.
+    vector<vec2> level_offsets;
+    level_offsets.push_back(vec2(-6.0f));
+    level_offsets.push_back(vec2(-16.0f));
+    level_offsets.push_back(vec2(-32.0f));
+
+    // Only keep what is on the x >= 1 side. The other planes are far away.
+    const float planes[] = {
+        1.0f, 0.0f, 0.0f, -1.0f,
+        -1.0f, 0.0f, 0.0f, 1000.0f,
+        0.0f, 1.0f, 0.0f, 1000.0f,
+        0.0f, -1.0f, 0.0f, 1000.0f,
+        0.0f, 0.0f, 1.0f, 1000.0f,
+        0.0f, 0.0f, -1.0f, 1000.0f,
+    };
+    FrustumCuller culler;
+    culler.setPlanes(planes);
+
+    vector<DrawCommand> commands;
+    vector<InstanceData> instances;
+    list.build_reference(level_offsets, culler, commands, instances);
+
+    // Blocks: 3 of 4 columns at level 0, the 2 right columns of each ring.
+    // Fixups: the vertical ones of both levels start at x = 0 and reach past the plane, only the right horizontal ones are kept.
+    // Degenerates: the left ones are at the left edge of each level, the right ones at the right edge.
+    // Trims: the full trim and the bottom-right trim are kept, the other trims do not apply.
+    static const GLuint expected_instances[] = { 24, 4, 2, 0, 2, 1, 0, 0, 1, 0 };
+    const unsigned int num_draws = sizeof(expected_instances) / sizeof(expected_instances[0]);
+    if (commands.size() != num_draws)
+        return false;
+
+    for (unsigned int i = 0; i < num_draws; i++)
+    {
+        if (commands[i].count != i || commands[i].instance_count != expected_instances[i])
+            return false;
+
+        // Every kept instance has to be on the visible side of the plane.
+        const InstanceData *draw_instances = &instances[list.get_draws()[i].first_instance];
+        for (unsigned int j = 0; j < commands[i].instance_count; j++)
+        {
+            const Candidate& first = list.get_candidates()[list.get_draws()[i].first_candidate];
+            if (draw_instances[j].offset.c.x + first.range.c.x * draw_instances[j].scale < 1.0f)
+                return false;
+        }
+    }
+
+    return true;
+}
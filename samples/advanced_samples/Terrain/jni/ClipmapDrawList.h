@@ -0,0 +1,153 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CLIPMAP_DRAW_LIST_H__
+#define CLIPMAP_DRAW_LIST_H__
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <vector>
+#include "vector_math.h"
+#include "FrustumCulling.h"
+
+// Every place in the clipmap where a block might be drawn, independent of where the camera is.
+//
+// Each block type (regular block, fixups, trims, degenerates) is one draw with a list of candidate instances.
+// A candidate stores its offset in the units of its clipmap level, so the world space position is found by
+// adding the snapped offset of the level once per frame. build() does this, culls the candidates in one batch
+// and writes one DrawElementsIndirect command per draw along with the visible instances.
+//
+// The culling compute shader in GroundMesh does exactly the same thing on the GPU from the same candidate
+// list, so build() doubles as the CPU reference of the indirect draw path. Nothing in here calls into GL.
+class ClipmapDrawList
+{
+public:
+    // Only one trim region is used per level, which one depends on how the levels were snapped.
+    enum TrimCondition
+    {
+        TrimAlways,
+        TrimTopRight,
+        TrimTopLeft,
+        TrimBottomRight,
+        TrimBottomLeft
+    };
+
+    // Matches PerInstanceData in the shaders, both as std140 (uniform buffer) and std430 (storage buffer).
+    struct InstanceData
+    {
+        vec2 offset; // Offset of the block in XZ plane (world space). This is prescaled.
+        vec2 texture_scale; // Scale factor of local offsets (vertex coordinates) translated into texture coordinates.
+        vec2 texture_offset; // Offset for texture coordinates, similar to offset. Also prescaled.
+        float scale; // Scale factor of local offsets (vertex coordinates).
+        float level; // Clipmap LOD level of block.
+    };
+
+    // Matches Candidate in the culling compute shader (std430).
+    struct Candidate
+    {
+        vec2 offset; // Offset of the top-left vertex relative to the level offset, in texels of the level.
+        vec2 range; // Number of vertices covered minus 1, used for the bounding box.
+        GLuint level;
+        GLuint trim; // TrimCondition
+    };
+
+    // Matches DrawType in the culling compute shader (std430).
+    struct Draw
+    {
+        GLuint first_index;
+        GLuint indices;
+        GLuint first_candidate;
+        GLuint num_candidates;
+        GLuint first_instance; // Where the instances of this draw start in the instance buffer.
+    };
+
+    // Same layout as the DrawElementsIndirectCommand read by glDrawElementsIndirect().
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint reserved_must_be_zero;
+    };
+
+    // These depend on the heightmap itself. These should be as small as possible to be able to cull more blocks.
+    // We know the range of a block in the XZ-plane, but not in Y as it depends on the heightmap texture.
+    // In the vertex shader, we enforce a min/max height, so it is safe to assume a range for Y.
+    static const float height_min;
+    static const float height_max;
+
+    // Twiddle factor for the bounding boxes to account for potential precision issues.
+    static const float bounds_epsilon;
+
+    ClipmapDrawList(unsigned int size, unsigned int levels, float clip_scale);
+
+    // Starts a new draw, following candidates are instances of it.
+    void begin_draw(size_t first_index, size_t indices);
+    void add_candidate(const vec2& offset, const vec2& range, unsigned int level, TrimCondition trim = TrimAlways);
+
+    // Gives each draw room for all of its candidates in the instance buffer.
+    // The instances of a draw start at a multiple of align bytes, so they can be bound as a uniform buffer range.
+    // Returns the size of the instance buffer in bytes.
+    size_t layout_instances(size_t align);
+
+    // Finds the visible instances for the given level offsets.
+    // commands must have room for get_draws().size() commands and instances for get_instance_capacity() instances.
+    // The instances of draw i end up at instances[get_draws()[i].first_instance], in candidate order.
+    void build(const std::vector<vec2>& level_offsets, const MaliSDK::FrustumCuller& culler,
+            DrawCommand *commands, InstanceData *instances);
+
+    // Same as build(), but into plain vectors. Used to check the GPU path without a GL context.
+    void build_reference(const std::vector<vec2>& level_offsets, const MaliSDK::FrustumCuller& culler,
+            std::vector<DrawCommand>& commands, std::vector<InstanceData>& instances);
+
+    // Builds a small clipmap with the block types GroundMesh uses, culls it against a fixed camera
+    // and checks the command and instance count of every draw against hand-computed counts.
+    // Returns true if they all match. Needs no GL context.
+    static bool self_test();
+
+    const std::vector<Candidate>& get_candidates() const { return candidates; }
+    const std::vector<Draw>& get_draws() const { return draws; }
+    size_t get_instance_capacity() const { return instance_capacity; }
+    unsigned int get_max_candidates_per_draw() const;
+
+    float get_texture_scale() const { return texture_scale; }
+    float get_trim_offset() const { return float(size - 1); }
+
+private:
+    unsigned int size;
+    unsigned int levels;
+    float clipmap_scale;
+    float texture_scale;
+    size_t instance_capacity;
+
+    std::vector<Candidate> candidates;
+    std::vector<Draw> draws;
+
+    // Scratch space for build(), reused every frame.
+    std::vector<InstanceData> candidate_instances;
+    std::vector<unsigned int> candidate_indices;
+    std::vector<unsigned int> visible_candidates;
+    MaliSDK::BoundingBoxArray candidate_bounds;
+
+    bool trim_visible(const std::vector<vec2>& level_offsets, const Candidate& candidate) const;
+};
+
+#endif
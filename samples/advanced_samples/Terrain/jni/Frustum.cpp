@@ -19,7 +19,6 @@
  */
 
 #include "Frustum.h"
-#include "AABB.h"
 
 Frustum::Frustum() {}
 
@@ -80,37 +79,3 @@ Frustum::Frustum(const mat4& view_projection)
     planes[5] = vec4(bottom_normal, -vec_dot(bottom_normal, lbn_pos)); // Bottom
 }
 //! [Compute plane equations]
-
-//! [Test for intersection]
-bool Frustum::intersects_aabb(const AABB& aabb) const
-{
-    // If all corners of an axis-aligned bounding box are on the "wrong side" (negative distance)
-    // of at least one of the frustum planes, we can safely cull the mesh.
-    vec4 corners[8];
-    for (unsigned int c = 0; c < 8; c++)
-    {
-        // Require 4-dimensional coordinates for plane equations.
-        corners[c] = vec4(aabb.corner(c), 1.0f);
-    }
-
-    for (unsigned int p = 0; p < 6; p++)
-    {
-        bool inside_plane = false;
-        for (unsigned int c = 0; c < 8; c++)
-        {
-            // If dot product > 0, we're "inside" the frustum plane,
-            // otherwise, outside.
-            if (vec_dot(corners[c], planes[p]) > 0.0f)
-            {
-                inside_plane = true;
-                break;
-            }
-        }
-
-        if (!inside_plane)
-            return false;
-    }
-
-    return true;
-}
-//! [Test for intersection]
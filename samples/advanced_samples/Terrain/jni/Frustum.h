@@ -25,13 +25,14 @@
 
 // Representation of a frustum using 6 plane equations.
 
-class AABB;
 class Frustum
 {
 public:
     Frustum();
     Frustum(const mat4& view_projection);
-    bool intersects_aabb(const AABB& aabb) const;
+
+    // The six plane equations as 24 consecutive floats, for batched tests with MaliSDK::FrustumCuller.
+    const float *get_planes() const { return planes[0].data; }
 
 private:
     vec4 planes[6];
@@ -26,6 +26,8 @@
 #include <stddef.h>
 #include "vector_math.h"
 #include "Frustum.h"
+#include "FrustumCulling.h"
+#include "ClipmapDrawList.h"
 
 class GroundMesh
 {
@@ -33,12 +35,32 @@ public:
     GroundMesh(unsigned int size, unsigned int levels, float clip_scale);
     ~GroundMesh();
 
-    void set_frustum(const Frustum& frustum) { view_proj_frustum = frustum; }
+    void set_frustum(const Frustum& frustum)
+    {
+        view_proj_frustum = frustum;
+        culler.setPlanes(frustum.get_planes());
+    }
     void update_level_offsets(const vec2& camera_pos);
     const std::vector<vec2>& get_level_offsets() const { return level_offsets; }
 
     void render();
 
+    enum DrawMode
+    {
+        // Blocks are culled on the CPU, which writes the visible instances to the uniform buffer
+        // and makes one instanced draw per block type.
+        DrawInstanced,
+
+        // Blocks are culled by a compute shader, which writes the visible instances and one
+        // DrawElementsIndirect command per block type. No buffers are written by the CPU in the frame loop.
+        // Needs OpenGL ES 3.1.
+        DrawIndirect
+    };
+
+    // Returns false and keeps the current mode if the mode is not supported.
+    bool set_draw_mode(DrawMode mode);
+    DrawMode get_draw_mode() const { return draw_mode; }
+
 private:
     GLuint vertex_buffer, index_buffer, vertex_array, uniform_buffer;
     unsigned int size;
@@ -56,15 +78,6 @@ private:
         vec2 range;
     };
 
-    struct InstanceData
-    {
-        vec2 offset; // Offset of the block in XZ plane (world space). This is prescaled.
-        vec2 texture_scale; // Scale factor of local offsets (vertex coordinates) translated into texture coordinates.
-        vec2 texture_offset; // Offset for texture coordinates, similar to offset. Also prescaled.
-        float scale; // Scale factor of local offsets (vertex coordinates).
-        float level; // Clipmap LOD level of block.
-    };
-
     Block block;
     Block vertical;
     Block horizontal;
@@ -83,43 +96,48 @@ private:
     void setup_block_ranges(unsigned int size);
     void setup_uniform_buffer();
     void setup_vertex_array();
+    void optimize_index_buffer(const GLushort *indices, std::vector<GLushort>& optimized);
+    GLenum primitive_mode;
 
     void update_draw_list();
     void render_draw_list();
-    struct DrawInfo
-    {
-        size_t index_buffer_offset;
-        size_t uniform_buffer_offset;
-        unsigned int indices;
-        unsigned int instances;
-    };
-    std::vector<DrawInfo> draw_list;
     GLint uniform_buffer_align;
 
     std::vector<vec2> level_offsets;
 
-    typedef bool (*TrimConditional)(const vec2& offset);
-
     vec2 get_offset_level(const vec2& camera_pos, unsigned int level);
-    void update_draw_list(DrawInfo& info, size_t& ubo_offset);
-    DrawInfo get_draw_info_blocks(InstanceData *instance_data);
-    DrawInfo get_draw_info_vert_fixup(InstanceData *instance_data);
-    DrawInfo get_draw_info_horiz_fixup(InstanceData *instance_data);
-    DrawInfo get_draw_info_degenerate(InstanceData *instance_data, const Block& block, const vec2& offset, const vec2& ring_offset);
-    DrawInfo get_draw_info_degenerate_left(InstanceData *instance_data);
-    DrawInfo get_draw_info_degenerate_right(InstanceData *instance_data);
-    DrawInfo get_draw_info_degenerate_top(InstanceData *instance_data);
-    DrawInfo get_draw_info_degenerate_bottom(InstanceData *instance_data);
-    DrawInfo get_draw_info_trim_full(InstanceData *instance_data);
-    DrawInfo get_draw_info_trim(InstanceData *instance_data, const Block& block, TrimConditional cond);
-    DrawInfo get_draw_info_trim_top_right(InstanceData *instance_data);
-    DrawInfo get_draw_info_trim_top_left(InstanceData *instance_data);
-    DrawInfo get_draw_info_trim_bottom_right(InstanceData *instance_data);
-    DrawInfo get_draw_info_trim_bottom_left(InstanceData *instance_data);
-
-    bool intersects_frustum(const vec2& offset, const vec2& range, unsigned int level);
+
+    void setup_draw_list();
+    void add_draw_info_blocks();
+    void add_draw_info_vert_fixup();
+    void add_draw_info_horiz_fixup();
+    void add_draw_info_degenerate(const Block& block, const vec2& offset, const vec2& ring_offset);
+    void add_draw_info_degenerate_left();
+    void add_draw_info_degenerate_right();
+    void add_draw_info_degenerate_top();
+    void add_draw_info_degenerate_bottom();
+    void add_draw_info_trim_full();
+    void add_draw_info_trim(const Block& block, ClipmapDrawList::TrimCondition cond);
+
+    // Every block instance which might be drawn, with one draw per block type.
+    // In DrawInstanced mode, draw_commands are built from it on the CPU every frame.
+    ClipmapDrawList draw_list;
+    std::vector<ClipmapDrawList::DrawCommand> draw_commands;
 
     Frustum view_proj_frustum;
+    MaliSDK::FrustumCuller culler;
+
+    DrawMode draw_mode;
+
+    // DrawIndirect mode, see GroundMeshIndirect.cpp.
+    GLuint cull_program;
+    GLuint candidate_buffer, draw_info_buffer, indirect_buffer;
+    GLint cull_level_offsets_loc, cull_planes_loc;
+
+    bool setup_indirect();
+    void update_draw_list_indirect();
+    void render_draw_list_indirect();
+    void verify_draw_list_indirect();
 };
 
 #endif
@@ -0,0 +1,306 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// DrawIndirect mode of GroundMesh.
+// The candidate instances from ClipmapDrawList are uploaded once. Every frame, a compute shader places them
+// in the world with the current level offsets, culls them against the frustum and writes the visible instances
+// to the uniform buffer, along with one DrawElementsIndirect command per block type.
+// The CPU only updates a few uniforms and issues the draws, it never needs to know how many instances are visible.
+
+#include "GroundMesh.h"
+#include "shaders.h"
+#include "Platform.h"
+#include <GLES3/gl31.h>
+#include <EGL/egl.h>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace MaliSDK;
+using namespace std;
+
+// Set to 1 to read back the output of the culling compute shader every frame and compare it
+// with ClipmapDrawList::build_reference(). This stalls the pipeline, so only use it for testing.
+#define VERIFY_INDIRECT_DRAW_LIST 0
+
+// The sample links against OpenGL ES 3.0, so get the OpenGL ES 3.1 entry points at runtime.
+typedef void (GL_APIENTRYP DispatchComputeProc)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (GL_APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+typedef void (GL_APIENTRYP DrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect);
+static DispatchComputeProc dispatch_compute;
+static MemoryBarrierProc memory_barrier;
+static DrawElementsIndirectProc draw_elements_indirect;
+
+// Binding points of the storage buffers in cull_compute_shader_source.
+#define BINDING_CANDIDATES 0
+#define BINDING_DRAWS 1
+#define BINDING_INSTANCES 2
+#define BINDING_COMMANDS 3
+
+// Sizes of the work group and uLevelOffsets in cull_compute_shader_source.
+#define CULL_WORK_GROUP_SIZE 128
+#define CULL_MAX_LEVELS 10
+
+// Puts the culling bounds of ClipmapDrawList in front of cull_compute_shader_source,
+// so the CPU and the GPU path can never disagree about them.
+static string get_cull_shader_source()
+{
+    // %e always prints a decimal point, GLSL does not convert integer literals to float.
+    char header[256];
+    snprintf(header, sizeof(header),
+            "#version 310 es\n"
+            "#define HEIGHTMAP_MIN %.9e\n"
+            "#define HEIGHTMAP_MAX %.9e\n"
+            "#define BOUNDS_EPSILON %.9e\n",
+            ClipmapDrawList::height_min, ClipmapDrawList::height_max, ClipmapDrawList::bounds_epsilon);
+    return string(header) + cull_compute_shader_source;
+}
+
+static GLuint compile_compute_program(const char *source)
+{
+    GL_CHECK(GLuint shader = glCreateShader(GL_COMPUTE_SHADER));
+    GL_CHECK(glShaderSource(shader, 1, &source, NULL));
+    GL_CHECK(glCompileShader(shader));
+
+    GLint status = 0;
+    GL_CHECK(glGetShaderiv(shader, GL_COMPILE_STATUS, &status));
+    if (!status)
+    {
+        GLint info_len = 0;
+        GL_CHECK(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len));
+        if (info_len)
+        {
+            vector<char> buffer(info_len);
+            GLint actual_len;
+            GL_CHECK(glGetShaderInfoLog(shader, info_len, &actual_len, &buffer[0]));
+            LOGE("Shader error: %s.\n", &buffer[0]);
+        }
+        GL_CHECK(glDeleteShader(shader));
+        return 0;
+    }
+
+    GL_CHECK(GLuint prog = glCreateProgram());
+    GL_CHECK(glAttachShader(prog, shader));
+    GL_CHECK(glLinkProgram(prog));
+    GL_CHECK(glDeleteShader(shader));
+
+    GL_CHECK(glGetProgramiv(prog, GL_LINK_STATUS, &status));
+    if (!status)
+    {
+        LOGE("Program failed to link.\n");
+        GL_CHECK(glDeleteProgram(prog));
+        return 0;
+    }
+
+    return prog;
+}
+
+bool GroundMesh::set_draw_mode(DrawMode mode)
+{
+    if (mode == DrawIndirect && !cull_program && !setup_indirect())
+        return false;
+
+    draw_mode = mode;
+    return true;
+}
+
+bool GroundMesh::setup_indirect()
+{
+    GLint major = 0, minor = 0;
+    GL_CHECK(glGetIntegerv(GL_MAJOR_VERSION, &major));
+    GL_CHECK(glGetIntegerv(GL_MINOR_VERSION, &minor));
+    if (major < 3 || (major == 3 && minor < 1))
+    {
+        LOGI("Indirect draws need OpenGL ES 3.1, context is %d.%d.\n", major, minor);
+        return false;
+    }
+
+    if (levels > CULL_MAX_LEVELS || draw_list.get_max_candidates_per_draw() > CULL_WORK_GROUP_SIZE)
+    {
+        LOGI("Too many clipmap levels for the culling compute shader.\n");
+        return false;
+    }
+
+    dispatch_compute = reinterpret_cast<DispatchComputeProc>(eglGetProcAddress("glDispatchCompute"));
+    memory_barrier = reinterpret_cast<MemoryBarrierProc>(eglGetProcAddress("glMemoryBarrier"));
+    draw_elements_indirect = reinterpret_cast<DrawElementsIndirectProc>(eglGetProcAddress("glDrawElementsIndirect"));
+    if (!dispatch_compute || !memory_barrier || !draw_elements_indirect)
+    {
+        LOGE("Failed to get OpenGL ES 3.1 entry points.\n");
+        return false;
+    }
+
+    cull_program = compile_compute_program(get_cull_shader_source().c_str());
+    if (!cull_program)
+        return false;
+
+    // Everything except the level offsets and the frustum is fixed.
+    GL_CHECK(glUseProgram(cull_program));
+    GL_CHECK(glUniform1f(glGetUniformLocation(cull_program, "uClipmapScale"), clipmap_scale));
+    GL_CHECK(glUniform1f(glGetUniformLocation(cull_program, "uTextureScale"), draw_list.get_texture_scale()));
+    GL_CHECK(glUniform1ui(glGetUniformLocation(cull_program, "uTrimOffset"), size - 1));
+    GL_CHECK(cull_level_offsets_loc = glGetUniformLocation(cull_program, "uLevelOffsets"));
+    GL_CHECK(cull_planes_loc = glGetUniformLocation(cull_program, "uPlanes"));
+    GL_CHECK(glUseProgram(0));
+
+    const vector<ClipmapDrawList::Candidate>& candidates = draw_list.get_candidates();
+    const vector<ClipmapDrawList::Draw>& draws = draw_list.get_draws();
+
+    GL_CHECK(glGenBuffers(1, &candidate_buffer));
+    GL_CHECK(glBindBuffer(GL_SHADER_STORAGE_BUFFER, candidate_buffer));
+    GL_CHECK(glBufferData(GL_SHADER_STORAGE_BUFFER, candidates.size() * sizeof(ClipmapDrawList::Candidate), &candidates[0], GL_STATIC_DRAW));
+
+    GL_CHECK(glGenBuffers(1, &draw_info_buffer));
+    GL_CHECK(glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_info_buffer));
+    GL_CHECK(glBufferData(GL_SHADER_STORAGE_BUFFER, draws.size() * sizeof(ClipmapDrawList::Draw), &draws[0], GL_STATIC_DRAW));
+    GL_CHECK(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    // Written by the compute shader every frame.
+    GL_CHECK(glGenBuffers(1, &indirect_buffer));
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer));
+    GL_CHECK(glBufferData(GL_DRAW_INDIRECT_BUFFER, draws.size() * sizeof(ClipmapDrawList::DrawCommand), NULL, GL_DYNAMIC_COPY));
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+
+    return true;
+}
+
+void GroundMesh::update_draw_list_indirect()
+{
+    // The terrain program is already bound, restore it once the draw list is built.
+    GLint render_program = 0;
+    GL_CHECK(glGetIntegerv(GL_CURRENT_PROGRAM, &render_program));
+
+    GL_CHECK(glUseProgram(cull_program));
+    GL_CHECK(glUniform2fv(cull_level_offsets_loc, levels, level_offsets[0].data));
+    GL_CHECK(glUniform4fv(cull_planes_loc, 6, view_proj_frustum.get_planes()));
+
+    GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CANDIDATES, candidate_buffer));
+    GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_DRAWS, draw_info_buffer));
+    GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCES, uniform_buffer));
+    GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COMMANDS, indirect_buffer));
+
+    // One work group per block type.
+    GL_CHECK(dispatch_compute(draw_list.get_draws().size(), 1, 1));
+
+    // The instances are read as a uniform buffer and the commands as indirect draw parameters.
+    GL_CHECK(memory_barrier(GL_UNIFORM_BARRIER_BIT | GL_COMMAND_BARRIER_BIT));
+
+    for (unsigned int i = BINDING_CANDIDATES; i <= BINDING_COMMANDS; i++)
+    {
+        GL_CHECK(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0));
+    }
+    GL_CHECK(glUseProgram(render_program));
+
+#if VERIFY_INDIRECT_DRAW_LIST
+    verify_draw_list_indirect();
+#endif
+}
+
+// Same as render_draw_list(), but the number of instances is only known by the GPU,
+// so every block type is drawn even if there might be nothing to draw.
+void GroundMesh::render_draw_list_indirect()
+{
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer));
+
+    const vector<ClipmapDrawList::Draw>& draws = draw_list.get_draws();
+    for (unsigned int i = 0; i < draws.size(); i++)
+    {
+        if (!draws[i].num_candidates)
+            continue;
+
+        // Bind uniform buffer at the range reserved for this block type.
+        GL_CHECK(glBindBufferRange(GL_UNIFORM_BUFFER, 0, uniform_buffer,
+                    draws[i].first_instance * sizeof(ClipmapDrawList::InstanceData),
+                    draws[i].num_candidates * sizeof(ClipmapDrawList::InstanceData)));
+
+        GL_CHECK(draw_elements_indirect(primitive_mode, GL_UNSIGNED_SHORT,
+                    reinterpret_cast<const GLvoid*>(i * sizeof(ClipmapDrawList::DrawCommand))));
+    }
+
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+
+void GroundMesh::verify_draw_list_indirect()
+{
+    vector<ClipmapDrawList::DrawCommand> commands;
+    vector<ClipmapDrawList::InstanceData> instances;
+    draw_list.build_reference(level_offsets, culler, commands, instances);
+
+    GL_CHECK(memory_barrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer));
+    GL_CHECK(const ClipmapDrawList::DrawCommand *gpu_commands = static_cast<const ClipmapDrawList::DrawCommand*>(
+                glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(ClipmapDrawList::DrawCommand), GL_MAP_READ_BIT)));
+    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer));
+    GL_CHECK(const ClipmapDrawList::InstanceData *gpu_instances = static_cast<const ClipmapDrawList::InstanceData*>(
+                glMapBufferRange(GL_UNIFORM_BUFFER, 0, uniform_buffer_size, GL_MAP_READ_BIT)));
+
+    if (gpu_commands && gpu_instances)
+    {
+        const vector<ClipmapDrawList::Draw>& draws = draw_list.get_draws();
+        unsigned int mismatches = 0;
+        unsigned int total_instances = 0;
+
+        for (unsigned int i = 0; i < draws.size(); i++)
+        {
+            // Instance counts can only differ if a bounding box is right at the edge of the frustum.
+            if (gpu_commands[i].count != commands[i].count || gpu_commands[i].first_index != commands[i].first_index ||
+                    gpu_commands[i].instance_count != commands[i].instance_count)
+            {
+                LOGI("Draw %u: GPU draws %u instances, CPU reference draws %u.\n", i, gpu_commands[i].instance_count, commands[i].instance_count);
+                mismatches++;
+                continue;
+            }
+
+            for (unsigned int j = 0; j < commands[i].instance_count; j++)
+            {
+                const ClipmapDrawList::InstanceData& a = gpu_instances[draws[i].first_instance + j];
+                const ClipmapDrawList::InstanceData& b = instances[draws[i].first_instance + j];
+                if (fabsf(a.offset.c.x - b.offset.c.x) > 1e-3f || fabsf(a.offset.c.y - b.offset.c.y) > 1e-3f ||
+                        fabsf(a.texture_offset.c.x - b.texture_offset.c.x) > 1e-5f || fabsf(a.texture_offset.c.y - b.texture_offset.c.y) > 1e-5f ||
+                        a.scale != b.scale || a.level != b.level)
+                {
+                    mismatches++;
+                }
+            }
+
+            total_instances += commands[i].instance_count;
+        }
+
+        LOGI("Indirect draw list: %u draws, %u instances, %u mismatches against CPU reference.\n",
+                (unsigned int)draws.size(), total_instances, mismatches);
+    }
+    else
+    {
+        LOGE("Failed to map indirect draw buffers.\n");
+    }
+
+    if (gpu_instances)
+    {
+        GL_CHECK(glUnmapBuffer(GL_UNIFORM_BUFFER));
+    }
+    if (gpu_commands)
+    {
+        GL_CHECK(glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER));
+    }
+    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
@@ -20,9 +20,18 @@
 
 #include "GroundMesh.h"
 #include "Platform.h"
+#include "MeshOptimizer.h"
 #include <assert.h>
 
 using namespace MaliSDK;
+using namespace std;
+
+// Order of the triangles in the index buffer, see MaliSDK::IndexOrder.
+// With banded strips, only the block and fixup grids are reordered. The ACMR before and after is logged at start-up.
+static const IndexOrder index_order = IndexOrderBandedStrips;
+
+// Size of the FIFO post-transform vertex cache used to choose the band width and for the ACMR report.
+static const unsigned int vertex_cache_size = MeshOptimizer::defaultCacheSize;
 
 void GroundMesh::setup_vertex_buffer(unsigned int size)
 {
@@ -394,22 +403,98 @@ void GroundMesh::setup_index_buffer(unsigned int size)
         pi += 6;
     }
 
+    vector<GLushort> optimized_indices;
+    optimize_index_buffer(indices, optimized_indices);
+    num_indices = optimized_indices.size();
+
     GL_CHECK(glGenBuffers(1, &index_buffer));
     GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer));
-    GL_CHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLushort), indices, GL_STATIC_DRAW));
+    GL_CHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLushort), &optimized_indices[0], GL_STATIC_DRAW));
     GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 
     delete[] indices;
 }
 
+static void add_statistics(VertexCacheStatistics& total, const VertexCacheStatistics& statistics)
+{
+    total.triangles += statistics.triangles;
+    total.transformedVertices += statistics.transformedVertices;
+    total.uniqueVertices += statistics.uniqueVertices;
+    total.acmr = float(total.transformedVertices) / total.triangles;
+    total.atvr = float(total.transformedVertices) / total.uniqueVertices;
+}
+
+// Reorders the triangles of every block type for the post-transform vertex cache, as selected with index_order.
+// Each block type is drawn with instancing, so each range is simulated on its own.
+void GroundMesh::optimize_index_buffer(const GLushort *indices, vector<GLushort>& optimized)
+{
+    Block *blocks[] = {
+        &block, &vertical, &horizontal,
+        &trim_full, &trim_top_right, &trim_bottom_right, &trim_bottom_left, &trim_top_left,
+        &degenerate_left, &degenerate_right, &degenerate_top, &degenerate_bottom,
+    };
+
+    primitive_mode = index_order == IndexOrderForsyth ? GL_TRIANGLES : GL_TRIANGLE_STRIP;
+
+    VertexCacheStatistics before = VertexCacheStatistics();
+    VertexCacheStatistics after = VertexCacheStatistics();
+
+    for (unsigned int i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        Block *b = blocks[i];
+        const GLushort *strip = indices + b->offset;
+        size_t offset = optimized.size();
+
+        if (index_order == IndexOrderBandedStrips)
+        {
+            // Trims are only two rows high and degenerates one column wide, there is nothing to gain for these.
+            // The vertex layout of the grids is found in setup_vertex_buffer().
+            // generate_block_indices() runs back and forth, so every other row is split along the other diagonal.
+            // Keep it that way so the terrain looks exactly the same.
+            if (b == &block)
+                MeshOptimizer::generateGridStrips(size, size, size, 0,
+                        MeshOptimizer::findGridBandWidth(size, size, true, vertex_cache_size), true, optimized);
+            else if (b == &vertical)
+                MeshOptimizer::generateGridStrips(3, size, 3, size * size,
+                        MeshOptimizer::findGridBandWidth(3, size, true, vertex_cache_size), true, optimized);
+            else if (b == &horizontal)
+                MeshOptimizer::generateGridStrips(size, 3, size, size * size + 3 * size,
+                        MeshOptimizer::findGridBandWidth(size, 3, true, vertex_cache_size), true, optimized);
+            else
+                optimized.insert(optimized.end(), strip, strip + b->count);
+        }
+        else if (index_order == IndexOrderForsyth)
+        {
+            vector<GLushort> triangles;
+            MeshOptimizer::convertStripToList(strip, b->count, triangles);
+            MeshOptimizer::optimizeVertexCache(triangles);
+            optimized.insert(optimized.end(), triangles.begin(), triangles.end());
+        }
+        else
+            optimized.insert(optimized.end(), strip, strip + b->count);
+
+        add_statistics(before, MeshOptimizer::simulateVertexCache(strip, b->count, true, vertex_cache_size));
+        add_statistics(after, MeshOptimizer::simulateVertexCache(&optimized[offset], optimized.size() - offset,
+                    primitive_mode == GL_TRIANGLE_STRIP, vertex_cache_size));
+
+        // The regular block is first, so the totals so far are its own.
+        if (b == &block)
+            MeshOptimizer::logReport("Terrain block", before, after);
+
+        b->offset = offset;
+        b->count = optimized.size() - offset;
+    }
+
+    MeshOptimizer::logReport("Terrain all block types", before, after);
+}
+
 void GroundMesh::setup_uniform_buffer()
 {
     GL_CHECK(glGenBuffers(1, &uniform_buffer));
     GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer));
 
-    // Per level we can draw up to 12 regular blocks, 4 vert/horiz rings, one trim, and four degenerate strips.
-    // Double the UBO size just in case we have very high levels for UBO buffer alignment.
-    uniform_buffer_size = 2 * (12 + 4 + 1 + 4) * levels * sizeof(InstanceData);
+    // Sized in setup_draw_list() to hold every candidate instance of every draw.
+    // In DrawIndirect mode, the culling compute shader writes to this buffer as a shader storage buffer.
     GL_CHECK(glBufferData(GL_UNIFORM_BUFFER, uniform_buffer_size, NULL, GL_STREAM_DRAW));
 
     GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, 0));
@@ -20,16 +20,34 @@
 
 #include "Heightmap.h"
 #include "Platform.h"
+#include "SeparableFilter.h"
+#include "Timer.h"
+#include <algorithm>
+#include <climits>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstdio>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HEIGHTMAP_USE_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HEIGHTMAP_USE_SSE
+#endif
+
 using namespace MaliSDK;
 using namespace std;
 
-Heightmap::Heightmap(unsigned int size, unsigned int levels)
-    : size(size), levels(levels)
+// Tile size used when baking the procedural heightmap into a tiled file.
+#define HEIGHTMAP_TILE_SIZE 64
+
+// Number of streamed tiles kept in memory. 512 tiles of 64x64 floats is 8 MB.
+#define HEIGHTMAP_TILE_CACHE_SIZE 512
+
+Heightmap::Heightmap(unsigned int size, unsigned int levels, const char *tile_path)
+    : size(size), levels(levels), reference_fill(false)
 {
     //! [Initializing texture array]
     GL_CHECK(glGenTextures(1, &texture));
@@ -63,15 +81,52 @@ Heightmap::Heightmap(unsigned int size, unsigned int levels)
     }
     GL_CHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
 
+    // Every level gets an equal, fixed part of the PBO so levels can be updated in parallel.
+    level_updates.resize(levels);
+    for (unsigned int i = 0; i < levels; i++)
+    {
+        level_updates[i].pixel_begin = i * 2 * size * size;
+        level_updates[i].pixel_end = (i + 1) * 2 * size * size;
+    }
+
+    init_source(tile_path);
     reset();
 }
 
+void Heightmap::init_source(const char *tile_path)
+{
+    if (tile_path)
+    {
+        // Bake the procedural heightmap on first run. A real application would ship the tiled file instead.
+        if (!tile_file.open(tile_path))
+        {
+            init_heightmap();
+            if (TiledHeightmapFile::write(tile_path, &heightmap[0], heightmap_size, HEIGHTMAP_TILE_SIZE))
+                tile_file.open(tile_path);
+        }
+
+        if (tile_file.is_open())
+        {
+            tile_cache.reset(new TileCache(tile_file, HEIGHTMAP_TILE_CACHE_SIZE));
+            vector<float>().swap(heightmap);
+            return;
+        }
+
+        LOGI("Streaming heightmap unavailable, using in-memory heightmap.\n");
+    }
+
+    if (heightmap.empty())
+        init_heightmap();
+}
+
 void Heightmap::reset()
 {
-    init_heightmap();
     level_info.resize(levels);
     for (unsigned int i = 0; i < levels; i++)
         level_info[i].cleared = true;
+
+    pending_regions.clear();
+    pending_regions.resize(levels);
 }
 
 Heightmap::~Heightmap()
@@ -112,14 +167,12 @@ static inline double sinc(double v)
 
 // Can really do anything we want, but keep it simple here,
 // so just generate a bandpass-filtered 2D grid and repeat it infinitely.
-// This causes a second or two of startup time depending on optimization level and platform.
 void Heightmap::init_heightmap()
 {
     heightmap_size = 1024;
     heightmap.resize(heightmap_size * heightmap_size);
 
     vector<float> orig(heightmap_size * heightmap_size);
-    vector<float> horiz(heightmap_size * heightmap_size);
 
     // Create some simple bandpass filters. Modulate up lanczos-windowed sinc low-pass filters.
 #define FILTER_LEN 65
@@ -150,33 +203,11 @@ void Heightmap::init_heightmap()
         for (unsigned int x = 0; x < heightmap_size; x++)
             orig[y * heightmap_size + x] = 50.0f * (float(rand()) / RAND_MAX - 0.5f);
 
-    // Bandpass horizontally
-    for (unsigned int y = 0; y < heightmap_size; y++)
-    {
-        const float *src = &orig[y * heightmap_size];
-        float *dst = &horiz[y * heightmap_size];
-        for (unsigned int x = 0; x < heightmap_size; x++)
-        {
-            float sum = 0.0f;
-            for (unsigned int i = 0; i < FILTER_LEN; i++)
-                sum += src[(x - i) & (heightmap_size - 1)] * filter[i];
-            dst[x] = sum;
-        }
-    }
-
-    // Bandpass vertically
-    for (unsigned int x = 0; x < heightmap_size; x++)
-    {
-        const float *src = &horiz[x];
-        float *dst = &heightmap[x];
-        for (unsigned int y = 0; y < heightmap_size; y++)
-        {
-            float sum = 0.0f;
-            for (unsigned int i = 0; i < FILTER_LEN; i++)
-                sum += src[((y - i) & (heightmap_size - 1)) * heightmap_size] * filter[i];
-            dst[y * heightmap_size] = sum;
-        }
-    }
+    // Bandpass horizontally and vertically.
+    // The filter engine splits rows across the thread pool and vectorizes the taps,
+    // which keeps startup time reasonable even for much larger heightmaps.
+    SeparableFilter bandpass(vector<float>(filter, filter + FILTER_LEN), thread_pool);
+    bandpass.filter(&orig[0], &heightmap[0], heightmap_size, heightmap_size);
 }
 
 // LUT-based approach. In a real application this would likely be way more complicated.
@@ -208,6 +239,150 @@ vec2 Heightmap::compute_heightmap(int x, int y, int level)
 }
 //! [Compute heightmap]
 
+// Builds one row of (height, coarse height) pairs from gathered samples.
+// fine[i] is the height of texel start_x + i. even0 and even1 hold the even texels
+// (start_x & ~1) + 2 * k of the two even rows surrounding the row, for k = 0 ... width / 2 + 1.
+// The coarse height of an even texel is the average of its own column,
+// for an odd texel it is the average of the columns on both sides, as in compute_heightmap().
+static void combine_row(vec2 *dst, const float *fine, const float *even0, const float *even1,
+                        float *coarse, int width, int parity)
+{
+    int even_count = ((width + parity) >> 1) + 1;
+
+    // coarse[m] is the coarse height of texel (start_x & ~1) + m.
+    int k = 0;
+#if defined(HEIGHTMAP_USE_NEON)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t quarter = vdupq_n_f32(0.25f);
+    for (; k + 5 <= even_count; k += 4)
+    {
+        float32x4_t v0 = vaddq_f32(vld1q_f32(even0 + k), vld1q_f32(even1 + k));
+        float32x4_t v1 = vaddq_f32(vld1q_f32(even0 + k + 1), vld1q_f32(even1 + k + 1));
+        float32x4x2_t pairs;
+        pairs.val[0] = vmulq_f32(v0, half);
+        pairs.val[1] = vmulq_f32(vaddq_f32(v0, v1), quarter);
+        vst2q_f32(coarse + 2 * k, pairs);
+    }
+#elif defined(HEIGHTMAP_USE_SSE)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; k + 5 <= even_count; k += 4)
+    {
+        __m128 v0 = _mm_add_ps(_mm_loadu_ps(even0 + k), _mm_loadu_ps(even1 + k));
+        __m128 v1 = _mm_add_ps(_mm_loadu_ps(even0 + k + 1), _mm_loadu_ps(even1 + k + 1));
+        __m128 even = _mm_mul_ps(v0, half);
+        __m128 odd = _mm_mul_ps(_mm_add_ps(v0, v1), quarter);
+        _mm_storeu_ps(coarse + 2 * k + 0, _mm_unpacklo_ps(even, odd));
+        _mm_storeu_ps(coarse + 2 * k + 4, _mm_unpackhi_ps(even, odd));
+    }
+#endif
+    for (; k < even_count; k++)
+    {
+        float v0 = even0[k] + even1[k];
+        coarse[2 * k] = 0.5f * v0;
+        if (k + 1 < even_count)
+            coarse[2 * k + 1] = 0.25f * (v0 + even0[k + 1] + even1[k + 1]);
+    }
+
+    // Interleave with the fine heights.
+    coarse += parity;
+    float *out = dst[0].data;
+    int x = 0;
+#if defined(HEIGHTMAP_USE_NEON)
+    for (; x + 4 <= width; x += 4)
+    {
+        float32x4x2_t pairs;
+        pairs.val[0] = vld1q_f32(fine + x);
+        pairs.val[1] = vld1q_f32(coarse + x);
+        vst2q_f32(out + 2 * x, pairs);
+    }
+#elif defined(HEIGHTMAP_USE_SSE)
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 h = _mm_loadu_ps(fine + x);
+        __m128 c = _mm_loadu_ps(coarse + x);
+        _mm_storeu_ps(out + 2 * x + 0, _mm_unpacklo_ps(h, c));
+        _mm_storeu_ps(out + 2 * x + 4, _mm_unpackhi_ps(h, c));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        out[2 * x + 0] = fine[x];
+        out[2 * x + 1] = coarse[x];
+    }
+}
+
+// Fills a region with the same values as compute_heightmap(), but row by row.
+// Each texel is looked up once for its own height, and the even texels used for the coarse average
+// are looked up once per even row and shared by the rows on either side,
+// instead of five lookups per texel. sample(x, y) returns the height of texel (x, y) of the level.
+template <typename Sampler>
+void Heightmap::fill_region(LevelUpdate& work, vec2 *buffer, int width, int height, int start_x, int start_y, const Sampler& sample)
+{
+    int parity = start_x & 1;
+    int first_even = start_x & ~1;
+    int even_count = ((width + parity) >> 1) + 1;
+
+    work.row_fine.resize(width);
+    work.row_coarse.resize(2 * even_count);
+    work.row_even[0].resize(even_count);
+    work.row_even[1].resize(even_count);
+    work.row_even_index[0] = work.row_even_index[1] = INT_MIN;
+
+    const float *even[2];
+    for (int y = 0; y < height; y++)
+    {
+        int cy = start_y + y;
+        int rows[2] = { cy & ~1, (cy + 1) & ~1 };
+
+        for (int r = 0; r < 2; r++)
+        {
+            int slot;
+            if (work.row_even_index[0] == rows[r])
+                slot = 0;
+            else if (work.row_even_index[1] == rows[r])
+                slot = 1;
+            else
+            {
+                // Rows only move forward, so replace the older one.
+                slot = work.row_even_index[0] < work.row_even_index[1] ? 0 : 1;
+                float *dst = &work.row_even[slot][0];
+                for (int k = 0; k < even_count; k++)
+                    dst[k] = sample(first_even + 2 * k, rows[r]);
+                work.row_even_index[slot] = rows[r];
+            }
+            even[r] = &work.row_even[slot][0];
+        }
+
+        float *fine = &work.row_fine[0];
+        for (int x = 0; x < width; x++)
+            fine[x] = sample(start_x + x, cy);
+
+        combine_row(buffer + y * width, fine, even[0], even[1], &work.row_coarse[0], width, parity);
+    }
+}
+
+// Samples the in-memory heightmap at the resolution of a clip level.
+struct HeightmapSampler
+{
+    HeightmapSampler(const vector<float>& heightmap, unsigned int heightmap_size, int level)
+        : heightmap(&heightmap[0]), mask(heightmap_size - 1), shift(0), level(level)
+    {
+        while ((1u << shift) < heightmap_size)
+            shift++;
+    }
+
+    float operator()(int x, int y) const
+    {
+        return heightmap[(((y << level) & mask) << shift) + ((x << level) & mask)];
+    }
+
+    const float *heightmap;
+    int mask;
+    int shift;
+    int level;
+};
+
 //! [Update region]
 void Heightmap::update_region(vec2 *buffer, unsigned int& pixel_offset, int tex_x, int tex_y,
                               int width, int height,
@@ -217,12 +392,26 @@ void Heightmap::update_region(vec2 *buffer, unsigned int& pixel_offset, int tex_
     if (width == 0 || height == 0)
         return;
 
-    // Here we could either stream a "real" heightmap, or generate it procedurally on the GPU by rendering to these regions.
+    // Either stream a "real" heightmap, or sample the procedural one.
+    // It could also be generated procedurally on the GPU by rendering to these regions.
 
     buffer += pixel_offset;
-    for (int y = 0; y < height; y++)
-        for (int x = 0; x < width; x++)
-            buffer[y * width + x] = compute_heightmap(start_x + x, start_y + y, level);
+    if (tile_cache)
+    {
+        if (!stream_region(buffer, width, height, start_x, start_y, level))
+        {
+            PendingRegion region = { start_x, start_y, width, height };
+            pending_regions[level].push_back(region);
+        }
+    }
+    else if (reference_fill)
+    {
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                buffer[y * width + x] = compute_heightmap(start_x + x, start_y + y, level);
+    }
+    else
+        fill_region(level_updates[level], buffer, width, height, start_x, start_y, HeightmapSampler(heightmap, heightmap_size, level));
 
     UploadInfo info;
     info.x = tex_x;
@@ -231,12 +420,118 @@ void Heightmap::update_region(vec2 *buffer, unsigned int& pixel_offset, int tex_
     info.height = height;
     info.level = level;
     info.offset = pixel_offset * sizeof(vec2);
-    upload_info.push_back(info);
+    level_updates[level].uploads.push_back(info);
 
     pixel_offset += width * height;
 }
 //! [Update region]
 
+// Converts level texel coordinates to texel coordinates of a mip which is shift levels finer (or -shift levels coarser).
+static inline int scale_coord(int v, int shift)
+{
+    return shift >= 0 ? (v << shift) : (v >> -shift);
+}
+
+bool Heightmap::acquire_tiles(TileRegion& tiles, const PendingRegion& region, unsigned int mip, int shift, bool request)
+{
+    // compute_heightmap() also reads one texel past the region for the coarser level's samples.
+    return tiles.acquire(*tile_cache, mip,
+        scale_coord(region.x, shift), scale_coord(region.y, shift),
+        scale_coord(region.x + region.width, shift), scale_coord(region.y + region.height, shift),
+        request);
+}
+
+// Fills a region from the tile cache without ever waiting for I/O.
+// Clip level L maps to mip L of the file. If those tiles are not resident yet, they are requested
+// and the region is filled from the finest coarser mip which is. Returns true if the proper mip was used.
+bool Heightmap::stream_region(vec2 *buffer, int width, int height, int start_x, int start_y, int level)
+{
+    unsigned int last_mip = tile_file.get_mip_count() - 1;
+    unsigned int mip = min(unsigned(level), last_mip);
+    int shift = level - mip; // Clip levels beyond the mip chain point sample the smallest mip.
+
+    LevelUpdate& work = level_updates[level];
+    PendingRegion region = { start_x, start_y, width, height };
+    bool exact = acquire_tiles(work.tile_region, region, mip, shift, true);
+    if (!exact && mip < last_mip)
+    {
+        // The smallest mips are pinned in the cache, so this always terminates with something to show.
+        do
+        {
+            mip++;
+            shift--;
+        } while (mip < last_mip && !acquire_tiles(work.tile_region, region, mip, shift, false));
+
+        if (mip == last_mip)
+            acquire_tiles(work.tile_region, region, mip, shift, false);
+    }
+
+    const TileRegion& tiles = work.tile_region;
+    fill_region(work, buffer, width, height, start_x, start_y, [&tiles, shift](int x, int y) {
+        return tiles.sample(scale_coord(x, shift), scale_coord(y, shift));
+    });
+
+    return exact;
+}
+
+// Texel (x, y) of a level always lives at (x mod size, y mod size) in its texture layer,
+// so a region in level coordinates splits into at most four texture regions.
+void Heightmap::update_world_region(vec2 *buffer, unsigned int& pixel_offset, const PendingRegion& region, int level)
+{
+    int tex_x = imod(region.x, size);
+    int tex_y = imod(region.y, size);
+    int width0 = min(region.width, int(size) - tex_x);
+    int height0 = min(region.height, int(size) - tex_y);
+    int width1 = region.width - width0;
+    int height1 = region.height - height0;
+
+    update_region(buffer, pixel_offset, tex_x, tex_y, width0, height0,
+        region.x, region.y, level);
+    update_region(buffer, pixel_offset, 0, tex_y, width1, height0,
+        region.x + width0, region.y, level);
+    update_region(buffer, pixel_offset, tex_x, 0, width0, height1,
+        region.x, region.y + height0, level);
+    update_region(buffer, pixel_offset, 0, 0, width1, height1,
+        region.x + width0, region.y + height0, level);
+}
+
+// Uploads regions of a level again which were previously filled from a coarser mip, once their tiles have arrived.
+void Heightmap::refine_level(vec2 *buffer, unsigned int& pixel_offset, unsigned int level)
+{
+    vector<PendingRegion>& pending = pending_regions[level];
+    if (pending.empty())
+        return;
+
+    const LevelInfo& info = level_info[level];
+    unsigned int mip = min(level, tile_file.get_mip_count() - 1);
+    int shift = level - mip;
+
+    vector<PendingRegion> regions;
+    regions.swap(pending);
+    for (vector<PendingRegion>::const_iterator itr = regions.begin(); itr != regions.end(); ++itr)
+    {
+        // Anything which has scrolled out of the level since is no longer relevant.
+        PendingRegion region;
+        region.x = max(itr->x, info.x);
+        region.y = max(itr->y, info.y);
+        region.width = min(itr->x + itr->width, info.x + int(size)) - region.x;
+        region.height = min(itr->y + itr->height, info.y + int(size)) - region.y;
+        if (region.width <= 0 || region.height <= 0)
+            continue;
+
+        // Keep waiting if tiles are still missing, or if the level's part of this frame's PBO is full.
+        LevelUpdate& work = level_updates[level];
+        if (!acquire_tiles(work.tile_region, region, mip, shift, true) ||
+            pixel_offset + region.width * region.height > work.pixel_end)
+        {
+            pending.push_back(region);
+            continue;
+        }
+
+        update_world_region(buffer, pixel_offset, region, level);
+    }
+}
+
 void Heightmap::update_level(vec2 *buffer, unsigned int& pixel_offset, const vec2& offset, unsigned int level)
 {
     LevelInfo& info = level_info[level];
@@ -258,6 +553,8 @@ void Heightmap::update_level(vec2 *buffer, unsigned int& pixel_offset, const vec
     // We have suddenly moved to a completely different place in the heightmap, or we need to recompute everything.
     if (abs(delta_x) >= int(size) || abs(delta_y) >= int(size) || info.cleared)
     {
+        pending_regions[level].clear();
+
         int wrapped_x = start_x - base_x;
         int wrapped_y = start_y - base_y;
 
@@ -412,6 +709,118 @@ void Heightmap::update_level(vec2 *buffer, unsigned int& pixel_offset, const vec
     info.y = start_y;
 }
 
+void Heightmap::benchmark(const float *speeds, unsigned int num_speeds, unsigned int frames)
+{
+    vector<LevelInfo> saved_level_info = level_info;
+    vector<vector<PendingRegion> > saved_pending_regions = pending_regions;
+    vector<vec2> scratch(pixel_buffer_size / sizeof(vec2));
+    vector<vec2> level_offsets(levels);
+    vector<float> level_time(levels);
+    vector<unsigned int> level_texels(levels);
+    Timer timer;
+
+    // Streamed heightmaps are always filled row by row.
+    unsigned int variants = tile_cache ? 1 : 2;
+    for (unsigned int variant = 0; variant < variants; variant++)
+    {
+        reference_fill = variant == 1;
+        for (unsigned int s = 0; s < num_speeds; s++)
+        {
+            reset();
+            fill(level_time.begin(), level_time.end(), 0.0f);
+            fill(level_texels.begin(), level_texels.end(), 0u);
+
+            for (unsigned int frame = 0; frame <= frames; frame++)
+            {
+                // Fly in the same direction as the sample camera, with every level centered on it.
+                vec2 camera_pos = vec2(0.4472136f, 0.8944272f) * vec2(frame * speeds[s]);
+                for (unsigned int i = 0; i < levels; i++)
+                {
+                    vec2 snap = vec2(float(1 << (i + 1)));
+                    level_offsets[i] = vec_floor(camera_pos / snap) * snap - vec2(float((size >> 1) << i));
+                }
+
+                if (tile_cache)
+                    tile_cache->poll();
+
+                for (unsigned int i = 0; i < levels; i++)
+                {
+                    timer.reset();
+                    unsigned int texels = update_level_range(&scratch[0], level_offsets[i], i);
+
+                    // The first frame fills every level from scratch, only measure the incremental updates.
+                    float elapsed = timer.getTime();
+                    if (frame > 0)
+                    {
+                        level_time[i] += elapsed;
+                        level_texels[i] += texels;
+                    }
+                }
+            }
+
+            LOGI("Heightmap update (%s fill), %.1f texels/frame:\n", reference_fill ? "per-texel" : "row", speeds[s]);
+            float total = 0.0f;
+            for (unsigned int i = 0; i < levels; i++)
+            {
+                LOGI("  Level %u: %.4f ms/frame, %.0f texels/frame.\n", i,
+                    1000.0f * level_time[i] / frames, float(level_texels[i]) / frames);
+                total += level_time[i];
+            }
+            LOGI("  Total: %.4f ms/frame.\n", 1000.0f * total / frames);
+        }
+
+        // A full refresh, like after a teleport, serially and with levels spread over the thread pool.
+        level_offsets.assign(levels, vec2(0.0f));
+        reset();
+        timer.reset();
+        for (unsigned int i = 0; i < levels; i++)
+            update_level_range(&scratch[0], level_offsets[i], i);
+        float serial_time = timer.getTime();
+
+        reset();
+        timer.reset();
+        update_levels(&scratch[0], level_offsets);
+        float parallel_time = timer.getTime();
+
+        LOGI("Heightmap full refresh (%s fill): %.3f ms serial, %.3f ms on %u threads.\n",
+            reference_fill ? "per-texel" : "row", 1000.0f * serial_time, 1000.0f * parallel_time,
+            thread_pool.getNumberOfThreads());
+    }
+
+    reference_fill = false;
+    level_info = saved_level_info;
+    pending_regions = saved_pending_regions;
+    upload_info.clear();
+}
+
+// Updates one clip level into its own range of the PBO. Returns the number of texels written.
+unsigned int Heightmap::update_level_range(vec2 *buffer, const vec2& level_offset, unsigned int level)
+{
+    LevelUpdate& work = level_updates[level];
+    work.uploads.clear();
+
+    unsigned int pixel_offset = work.pixel_begin;
+    update_level(buffer, pixel_offset, level_offset, level);
+    if (tile_cache)
+        refine_level(buffer, pixel_offset, level);
+
+    return pixel_offset - work.pixel_begin;
+}
+
+void Heightmap::update_levels(vec2 *buffer, const vector<vec2>& level_offsets)
+{
+    // Clip levels are independent of each other, so update them in parallel.
+    thread_pool.parallelFor(levels, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+            update_level_range(buffer, level_offsets[i], i);
+    });
+
+    // Merge in level order, so the uploads do not depend on how levels were scheduled.
+    upload_info.clear();
+    for (unsigned int i = 0; i < levels; i++)
+        upload_info.insert(upload_info.end(), level_updates[i].uploads.begin(), level_updates[i].uploads.end());
+}
+
 void Heightmap::update_heightmap(const vector<vec2>& level_offsets)
 {
     upload_info.clear();
@@ -426,9 +835,11 @@ void Heightmap::update_heightmap(const vector<vec2>& level_offsets)
         return;
     }
 
-    unsigned int pixel_offset = 0;
-    for (unsigned int i = 0; i < levels; i++)
-        update_level(buffer, pixel_offset, level_offsets[i], i);
+    // Pick up tiles the loader has finished since last frame. This never waits for the loader.
+    if (tile_cache)
+        tile_cache->poll();
+
+    update_levels(buffer, level_offsets);
 
     GL_CHECK(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
 
@@ -23,18 +23,30 @@
 
 #include <GLES3/gl3.h>
 #include "vector_math.h"
+#include "ThreadPool.h"
+#include "TiledHeightmapFile.h"
+#include "TileCache.h"
+#include <memory>
 #include <vector>
 
 class Heightmap
 {
 public:
-    Heightmap(unsigned int size, unsigned int levels);
+    // If tile_path is set, the heightmap is streamed from that tiled heightmap file.
+    // The file is created from the procedural heightmap if it does not exist yet.
+    Heightmap(unsigned int size, unsigned int levels, const char *tile_path = NULL);
     ~Heightmap();
 
     void update_heightmap(const std::vector<vec2>& level_offsets);
     void reset();
     GLuint get_texture() const { return texture; }
 
+    // Logs the CPU cost of keeping each clip level up to date while flying in a straight line
+    // at each of the given speeds (in texels of the finest level per frame).
+    // Compares the row-oriented fill with the per-texel reference for the in-memory heightmap.
+    // Only runs the CPU side of update_heightmap(), no GL calls are made.
+    void benchmark(const float *speeds, unsigned int num_speeds, unsigned int frames);
+
 private:
     GLuint texture;
     GLuint pixel_buffer[2];
@@ -65,14 +77,60 @@ private:
     void update_level(vec2 *buffer, unsigned int& pixel_offset, const vec2& level_offset, unsigned level);
     vec2 compute_heightmap(int x, int y, int level);
     float sample_heightmap(int x, int y);
+
+    // Everything a clip level touches while it is updated, so levels can be updated in parallel.
+    // Each level writes to its own range of the PBO and records its own uploads.
+    struct LevelUpdate
+    {
+        std::vector<UploadInfo> uploads;
+        unsigned int pixel_begin; // Range of the PBO owned by the level, in texels.
+        unsigned int pixel_end;
+
+        // Scratch rows for fill_region().
+        std::vector<float> row_fine;
+        std::vector<float> row_coarse;
+        std::vector<float> row_even[2];
+        int row_even_index[2];
+
+        TileRegion tile_region;
+    };
+    std::vector<LevelUpdate> level_updates;
+    unsigned int update_level_range(vec2 *buffer, const vec2& level_offset, unsigned int level);
+    void update_levels(vec2 *buffer, const std::vector<vec2>& level_offsets);
+
+    // Row-oriented version of compute_heightmap() for a whole region.
+    template <typename Sampler>
+    void fill_region(LevelUpdate& work, vec2 *buffer, int width, int height, int start_x, int start_y, const Sampler& sample);
+    bool reference_fill;
     void update_region(vec2 *buffer, unsigned int& pixel_offset, int x, int y,
         int width, int height,
         int start_x, int start_y,
         int level);
 
+    MaliSDK::ThreadPool thread_pool;
     std::vector<float> heightmap;
     unsigned int heightmap_size;
     void init_heightmap();
+
+    // Streaming source. Regions which had to be filled from a coarser mip are kept
+    // in level texel coordinates and uploaded again once their tiles are resident.
+    TiledHeightmapFile tile_file;
+    std::unique_ptr<TileCache> tile_cache;
+
+    struct PendingRegion
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+    std::vector<std::vector<PendingRegion> > pending_regions;
+
+    void init_source(const char *tile_path);
+    bool stream_region(vec2 *buffer, int width, int height, int start_x, int start_y, int level);
+    bool acquire_tiles(TileRegion& tiles, const PendingRegion& region, unsigned int mip, int shift, bool request);
+    void refine_level(vec2 *buffer, unsigned int& pixel_offset, unsigned int level);
+    void update_world_region(vec2 *buffer, unsigned int& pixel_offset, const PendingRegion& region, int level);
 };
 
 #endif
@@ -0,0 +1,194 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SeparableFilter.h"
+#include <algorithm>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FILTER_USE_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FILTER_USE_SSE
+#endif
+
+using namespace MaliSDK;
+using namespace std;
+
+// Transpose in square tiles which fit comfortably in L1 together with their destination.
+#define TRANSPOSE_TILE 32
+
+SeparableFilter::SeparableFilter(const vector<float>& taps, ThreadPool& pool)
+    : taps(taps), pool(pool)
+{
+}
+
+void SeparableFilter::filter_row(const float *src, float *dst, float *padded, unsigned int width) const
+{
+    const unsigned int len = taps.size();
+    const float *filter = &taps[0];
+
+    // Unroll the periodic border so the inner loops need no wrapping.
+    // padded[j] = src[j - (len - 1)], i.e. dst[x] = sum(filter[i] * padded[x + len - 1 - i]).
+    for (unsigned int j = 0; j < width + len - 1; j++)
+    {
+        int src_x = int(j) - int(len - 1);
+        src_x %= int(width);
+        if (src_x < 0)
+            src_x += width;
+        padded[j] = src[src_x];
+    }
+
+    unsigned int x = 0;
+
+#if defined(FILTER_USE_NEON)
+    for (; x + 16 <= width; x += 16)
+    {
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        float32x4_t acc2 = vdupq_n_f32(0.0f);
+        float32x4_t acc3 = vdupq_n_f32(0.0f);
+        for (unsigned int i = 0; i < len; i++)
+        {
+            const float *p = padded + x + len - 1 - i;
+            float32x4_t tap = vdupq_n_f32(filter[i]);
+            acc0 = vaddq_f32(acc0, vmulq_f32(tap, vld1q_f32(p + 0)));
+            acc1 = vaddq_f32(acc1, vmulq_f32(tap, vld1q_f32(p + 4)));
+            acc2 = vaddq_f32(acc2, vmulq_f32(tap, vld1q_f32(p + 8)));
+            acc3 = vaddq_f32(acc3, vmulq_f32(tap, vld1q_f32(p + 12)));
+        }
+        vst1q_f32(dst + x + 0, acc0);
+        vst1q_f32(dst + x + 4, acc1);
+        vst1q_f32(dst + x + 8, acc2);
+        vst1q_f32(dst + x + 12, acc3);
+    }
+#elif defined(FILTER_USE_SSE)
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for (unsigned int i = 0; i < len; i++)
+        {
+            const float *p = padded + x + len - 1 - i;
+            __m128 tap = _mm_set1_ps(filter[i]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(tap, _mm_loadu_ps(p + 0)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(tap, _mm_loadu_ps(p + 4)));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(tap, _mm_loadu_ps(p + 8)));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(tap, _mm_loadu_ps(p + 12)));
+        }
+        _mm_storeu_ps(dst + x + 0, acc0);
+        _mm_storeu_ps(dst + x + 4, acc1);
+        _mm_storeu_ps(dst + x + 8, acc2);
+        _mm_storeu_ps(dst + x + 12, acc3);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < len; i++)
+            sum += filter[i] * padded[x + len - 1 - i];
+        dst[x] = sum;
+    }
+}
+
+void SeparableFilter::filter_rows(const float *src, float *dst, unsigned int width, unsigned int height)
+{
+    pool.parallelFor(height, [&](unsigned int begin, unsigned int end) {
+        vector<float> padded(width + taps.size() - 1);
+        for (unsigned int y = begin; y < end; y++)
+            filter_row(src + y * width, dst + y * width, &padded[0], width);
+    }, 4);
+}
+
+static inline void transpose_block_4x4(const float *src, float *dst, unsigned int src_stride, unsigned int dst_stride)
+{
+#if defined(FILTER_USE_NEON)
+    float32x4x2_t r01 = vtrnq_f32(vld1q_f32(src + 0 * src_stride), vld1q_f32(src + 1 * src_stride));
+    float32x4x2_t r23 = vtrnq_f32(vld1q_f32(src + 2 * src_stride), vld1q_f32(src + 3 * src_stride));
+    vst1q_f32(dst + 0 * dst_stride, vcombine_f32(vget_low_f32(r01.val[0]), vget_low_f32(r23.val[0])));
+    vst1q_f32(dst + 1 * dst_stride, vcombine_f32(vget_low_f32(r01.val[1]), vget_low_f32(r23.val[1])));
+    vst1q_f32(dst + 2 * dst_stride, vcombine_f32(vget_high_f32(r01.val[0]), vget_high_f32(r23.val[0])));
+    vst1q_f32(dst + 3 * dst_stride, vcombine_f32(vget_high_f32(r01.val[1]), vget_high_f32(r23.val[1])));
+#elif defined(FILTER_USE_SSE)
+    __m128 r0 = _mm_loadu_ps(src + 0 * src_stride);
+    __m128 r1 = _mm_loadu_ps(src + 1 * src_stride);
+    __m128 r2 = _mm_loadu_ps(src + 2 * src_stride);
+    __m128 r3 = _mm_loadu_ps(src + 3 * src_stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst + 0 * dst_stride, r0);
+    _mm_storeu_ps(dst + 1 * dst_stride, r1);
+    _mm_storeu_ps(dst + 2 * dst_stride, r2);
+    _mm_storeu_ps(dst + 3 * dst_stride, r3);
+#else
+    for (unsigned int y = 0; y < 4; y++)
+        for (unsigned int x = 0; x < 4; x++)
+            dst[x * dst_stride + y] = src[y * src_stride + x];
+#endif
+}
+
+void SeparableFilter::transpose(const float *src, float *dst, unsigned int width, unsigned int height)
+{
+    unsigned int tiles_y = (height + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    unsigned int tiles_x = (width + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+
+    pool.parallelFor(tiles_y, [=](unsigned int begin, unsigned int end) {
+        for (unsigned int tile_y = begin; tile_y < end; tile_y++)
+        {
+            unsigned int y0 = tile_y * TRANSPOSE_TILE;
+            unsigned int y1 = min(y0 + TRANSPOSE_TILE, height);
+
+            for (unsigned int tile_x = 0; tile_x < tiles_x; tile_x++)
+            {
+                unsigned int x0 = tile_x * TRANSPOSE_TILE;
+                unsigned int x1 = min(x0 + TRANSPOSE_TILE, width);
+
+                unsigned int y = y0;
+                for (; y + 4 <= y1; y += 4)
+                {
+                    unsigned int x = x0;
+                    for (; x + 4 <= x1; x += 4)
+                        transpose_block_4x4(src + y * width + x, dst + x * height + y, width, height);
+                    for (; x < x1; x++)
+                        for (unsigned int j = y; j < y + 4; j++)
+                            dst[x * height + j] = src[j * width + x];
+                }
+
+                for (; y < y1; y++)
+                    for (unsigned int x = x0; x < x1; x++)
+                        dst[x * height + y] = src[y * width + x];
+            }
+        }
+    });
+}
+
+void SeparableFilter::filter(const float *src, float *dst, unsigned int width, unsigned int height)
+{
+    scratch[0].resize(width * height);
+    scratch[1].resize(width * height);
+
+    // Horizontal pass, then run the vertical pass as a horizontal pass over the transpose.
+    filter_rows(src, &scratch[0][0], width, height);
+    transpose(&scratch[0][0], &scratch[1][0], width, height);
+    filter_rows(&scratch[1][0], &scratch[0][0], height, width);
+    transpose(&scratch[0][0], dst, height, width);
+}
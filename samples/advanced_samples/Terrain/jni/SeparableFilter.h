@@ -0,0 +1,55 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEPARABLE_FILTER_H__
+#define SEPARABLE_FILTER_H__
+
+#include "ThreadPool.h"
+#include <vector>
+
+// Separable 2D FIR filter with periodic (GL_REPEAT-like) borders.
+// Rows are filtered directly. Columns are filtered by transposing in cache-sized blocks,
+// filtering rows and transposing back, so all passes stream through memory linearly.
+// Rows and blocks are split across a thread pool, and inner loops use NEON or SSE where available.
+
+class SeparableFilter
+{
+public:
+    // dst[x] = sum(taps[i] * src[x - i]) in both dimensions.
+    SeparableFilter(const std::vector<float>& taps, MaliSDK::ThreadPool& pool);
+
+    // Filters src horizontally, then vertically. src and dst may be the same buffer.
+    void filter(const float *src, float *dst, unsigned int width, unsigned int height);
+
+    // Filters every row of src. src and dst must not overlap.
+    void filter_rows(const float *src, float *dst, unsigned int width, unsigned int height);
+
+    // Writes the height x width transpose of the width x height image src to dst.
+    void transpose(const float *src, float *dst, unsigned int width, unsigned int height);
+
+private:
+    std::vector<float> taps;
+    MaliSDK::ThreadPool& pool;
+    std::vector<float> scratch[2];
+
+    void filter_row(const float *src, float *dst, float *padded, unsigned int width) const;
+};
+
+#endif
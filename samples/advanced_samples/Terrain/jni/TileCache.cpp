@@ -0,0 +1,221 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TileCache.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Requests beyond this are dropped, oldest first. The camera has moved on from them,
+// and anything still needed will be requested again.
+#define MAX_QUEUED_REQUESTS 256
+
+TileCache::TileCache(const TiledHeightmapFile& file, unsigned int capacity)
+    : file(file), capacity(capacity), shutdown(false)
+{
+    // Keep every mip which fits in a single tile resident. This is a few kB at most and guarantees a fallback.
+    for (unsigned int mip = 0; mip < file.get_mip_count(); mip++)
+    {
+        if (file.get_tiles_per_row(mip) != 1)
+            continue;
+
+        Key key = make_key(mip, 0, 0);
+        Entry& entry = tiles[key];
+        load_tile(key, entry.texels);
+        entry.pinned = true;
+    }
+
+    loader = thread(&TileCache::loader_loop, this);
+}
+
+TileCache::~TileCache()
+{
+    {
+        lock_guard<mutex> holder(lock);
+        shutdown = true;
+    }
+    cond.notify_all();
+    loader.join();
+}
+
+void TileCache::load_tile(Key key, vector<float>& texels) const
+{
+    unsigned int mip = unsigned(key >> 48);
+    unsigned int tile_y = unsigned(key >> 24) & 0xffffff;
+    unsigned int tile_x = unsigned(key) & 0xffffff;
+    unsigned int tile_size = file.get_tile_size(mip);
+
+    const float *src = file.get_tile(mip, tile_x, tile_y);
+    texels.assign(src, src + tile_size * tile_size);
+}
+
+void TileCache::loader_loop()
+{
+    unique_lock<mutex> holder(lock);
+    for (;;)
+    {
+        cond.wait(holder, [this] { return shutdown || !requests.empty(); });
+        if (shutdown)
+            return;
+
+        // Serve the most recent request first, it is most likely to still be relevant.
+        Key key = requests.back();
+        requests.pop_back();
+
+        // Give the kernel a head start on the next tile while we copy this one.
+        if (!requests.empty())
+        {
+            Key next = requests.back();
+            file.prefetch_tile(unsigned(next >> 48), unsigned(next) & 0xffffff, unsigned(next >> 24) & 0xffffff);
+        }
+
+        holder.unlock();
+        LoadedTile tile;
+        tile.key = key;
+        load_tile(key, tile.texels);
+        holder.lock();
+
+        loaded.push_back(std::move(tile));
+    }
+}
+
+const float *TileCache::find(unsigned int mip, unsigned int tile_x, unsigned int tile_y, bool request)
+{
+    Key key = make_key(mip, tile_x, tile_y);
+    {
+        lock_guard<mutex> holder(cache_lock);
+        unordered_map<Key, Entry>::iterator itr = tiles.find(key);
+        if (itr != tiles.end())
+        {
+            Entry& entry = itr->second;
+            if (!entry.pinned)
+                lru.splice(lru.begin(), lru, entry.lru);
+            return &entry.texels[0];
+        }
+    }
+
+    if (request)
+    {
+        lock_guard<mutex> holder(lock);
+        if (in_flight.insert(key).second)
+        {
+            requests.push_back(key);
+            if (requests.size() > MAX_QUEUED_REQUESTS)
+            {
+                in_flight.erase(requests.front());
+                requests.pop_front();
+            }
+            cond.notify_one();
+        }
+    }
+
+    return NULL;
+}
+
+unsigned int TileCache::poll()
+{
+    vector<LoadedTile> completed;
+    {
+        lock_guard<mutex> holder(lock);
+        completed.swap(loaded);
+        for (vector<LoadedTile>::const_iterator itr = completed.begin(); itr != completed.end(); ++itr)
+            in_flight.erase(itr->key);
+    }
+
+    for (vector<LoadedTile>::iterator itr = completed.begin(); itr != completed.end(); ++itr)
+    {
+        if (tiles.count(itr->key))
+            continue;
+
+        if (lru.size() >= capacity && !lru.empty())
+        {
+            tiles.erase(lru.back());
+            lru.pop_back();
+        }
+
+        lru.push_front(itr->key);
+        Entry& entry = tiles[itr->key];
+        entry.texels.swap(itr->texels);
+        entry.lru = lru.begin();
+        entry.pinned = false;
+    }
+
+    return completed.size();
+}
+
+bool TileRegion::acquire(TileCache& cache, unsigned int mip, int x0, int y0, int x1, int y1, bool request)
+{
+    const TiledHeightmapFile& file = cache.get_file();
+    unsigned int tile_size = file.get_tile_size(mip);
+    int tiles_per_row = file.get_tiles_per_row(mip);
+
+    tile_shift = 0;
+    while ((1u << tile_shift) < tile_size)
+        tile_shift++;
+    tile_mask = tile_size - 1;
+
+    // If the rectangle spans the whole mip, index tiles by their wrapped coordinate instead.
+    first_x = x0 >> tile_shift;
+    first_y = y0 >> tile_shift;
+    int count_x = (x1 >> tile_shift) - first_x + 1;
+    int count_y = (y1 >> tile_shift) - first_y + 1;
+    if (count_x >= tiles_per_row)
+    {
+        first_x = 0;
+        count_x = tiles_per_row;
+        mask_x = tiles_per_row - 1;
+    }
+    else
+        mask_x = ~0;
+
+    if (count_y >= tiles_per_row)
+    {
+        first_y = 0;
+        count_y = tiles_per_row;
+        mask_y = tiles_per_row - 1;
+    }
+    else
+        mask_y = ~0;
+
+    tiles_x = count_x;
+    tiles.resize(count_x * count_y);
+
+    bool resident = true;
+    for (int y = 0; y < count_y; y++)
+    {
+        for (int x = 0; x < count_x; x++)
+        {
+            unsigned int tile_x = (first_x + x) & (tiles_per_row - 1);
+            unsigned int tile_y = (first_y + y) & (tiles_per_row - 1);
+            const float *tile = cache.find(mip, tile_x, tile_y, request);
+            tiles[y * count_x + x] = tile;
+            if (!tile)
+            {
+                resident = false;
+                // Still go through the rest so every missing tile gets requested in one go.
+                if (!request)
+                    return false;
+            }
+        }
+    }
+
+    return resident;
+}
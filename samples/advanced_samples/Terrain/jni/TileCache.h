@@ -0,0 +1,128 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_CACHE_H__
+#define TILE_CACHE_H__
+
+#include "TiledHeightmapFile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// LRU cache of heightmap tiles, filled asynchronously from a TiledHeightmapFile.
+// A loader thread copies requested tiles out of the mapping, so page faults and storage latency
+// never hit the render thread. find() may be called from several threads at once, but not
+// concurrently with poll(). Only poll() changes which tiles are resident,
+// so pointers returned by find() stay valid until the next poll().
+// The smallest mips, which fit in one tile each, are loaded up front and never evicted,
+// so there is always some level of detail available for any region.
+class TileCache
+{
+public:
+    TileCache(const TiledHeightmapFile& file, unsigned int capacity);
+    ~TileCache();
+
+    // Returns the tile if resident, otherwise NULL. If request is true, a missing tile is queued for loading.
+    const float *find(unsigned int mip, unsigned int tile_x, unsigned int tile_y, bool request);
+
+    // Moves tiles completed by the loader thread into the cache, evicting the least recently used ones.
+    // Returns the number of new tiles.
+    unsigned int poll();
+
+    const TiledHeightmapFile& get_file() const { return file; }
+
+private:
+    typedef uint64_t Key;
+
+    static Key make_key(unsigned int mip, unsigned int tile_x, unsigned int tile_y)
+    {
+        return (Key(mip) << 48) | (Key(tile_y) << 24) | Key(tile_x);
+    }
+
+    struct Entry
+    {
+        std::vector<float> texels;
+        std::list<Key>::iterator lru; // Invalid for pinned tiles.
+        bool pinned;
+    };
+
+    struct LoadedTile
+    {
+        Key key;
+        std::vector<float> texels;
+    };
+
+    const TiledHeightmapFile& file;
+    unsigned int capacity;
+
+    // Resident tiles. The lock only guards concurrent find() calls against each other.
+    std::mutex cache_lock;
+    std::unordered_map<Key, Entry> tiles;
+    std::list<Key> lru; // Most recently used first.
+
+    // Shared with the loader thread.
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<Key> requests;
+    std::unordered_set<Key> in_flight;
+    std::vector<LoadedTile> loaded;
+    bool shutdown;
+    std::thread loader;
+
+    void load_tile(Key key, std::vector<float>& texels) const;
+    void loader_loop();
+
+    TileCache(const TileCache&);
+    TileCache& operator=(const TileCache&);
+};
+
+// Gathers the tiles of one mip covering a rectangle so texels can be sampled without further lookups.
+class TileRegion
+{
+public:
+    // Looks up every tile covering mip texels [x0, x1] x [y0, y1] (inclusive, may wrap around).
+    // Returns false if any tile is not resident.
+    bool acquire(TileCache& cache, unsigned int mip, int x0, int y0, int x1, int y1, bool request);
+
+    // Samples mip texel (x, y), which must lie inside the acquired rectangle.
+    float sample(int x, int y) const
+    {
+        int tile_x = x >> tile_shift;
+        int tile_y = y >> tile_shift;
+        const float *tile = tiles[((tile_y - first_y) & mask_y) * tiles_x + ((tile_x - first_x) & mask_x)];
+        return tile[((y & tile_mask) << tile_shift) + (x & tile_mask)];
+    }
+
+private:
+    std::vector<const float*> tiles;
+    int first_x, first_y;
+    unsigned int tiles_x;
+    int mask_x, mask_y;
+    int tile_shift;
+    int tile_mask;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TiledHeightmapFile.h"
+#include "Platform.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace MaliSDK;
+using namespace std;
+
+static inline bool is_pow2(unsigned int v)
+{
+    return v && !(v & (v - 1));
+}
+
+TiledHeightmapFile::TiledHeightmapFile()
+    : fd(-1), mapping(NULL), mapping_size(0), size(0), tile_size(0), mip_count(0)
+{
+}
+
+TiledHeightmapFile::~TiledHeightmapFile()
+{
+    close();
+}
+
+unsigned int TiledHeightmapFile::get_tile_size(unsigned int mip) const
+{
+    return min(tile_size, get_mip_size(mip));
+}
+
+size_t TiledHeightmapFile::compute_layout(unsigned int size, unsigned int tile_size, unsigned int mip_count, size_t *mip_offsets)
+{
+    size_t offset = HEADER_SIZE;
+    for (unsigned int mip = 0; mip < mip_count; mip++)
+    {
+        unsigned int mip_size = size >> mip;
+        unsigned int tile = min(tile_size, mip_size);
+        mip_offsets[mip] = offset;
+        offset += size_t(mip_size / tile) * (mip_size / tile) * tile * tile * sizeof(float);
+    }
+    return offset;
+}
+
+bool TiledHeightmapFile::open(const char *path)
+{
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat s;
+    if (fstat(fd, &s) < 0 || size_t(s.st_size) < HEADER_SIZE)
+    {
+        close();
+        return false;
+    }
+
+    mapping_size = s.st_size;
+    mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = NULL;
+        close();
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, mapping, sizeof(header));
+    if (header.magic != MAGIC || header.version != VERSION || header.header_size != HEADER_SIZE ||
+        !is_pow2(header.size) || !is_pow2(header.tile_size) ||
+        header.mip_count == 0 || header.mip_count > 32 || (header.size >> (header.mip_count - 1)) == 0 ||
+        compute_layout(header.size, header.tile_size, header.mip_count, mip_offsets) > mapping_size)
+    {
+        LOGE("Invalid tiled heightmap file: %s.\n", path);
+        close();
+        return false;
+    }
+
+    size = header.size;
+    tile_size = header.tile_size;
+    mip_count = header.mip_count;
+
+    // Tiles are fetched in a mostly random order, so kernel readahead across tiles is wasted.
+    madvise(mapping, mapping_size, MADV_RANDOM);
+    return true;
+}
+
+void TiledHeightmapFile::close()
+{
+    if (mapping)
+        munmap(mapping, mapping_size);
+    if (fd >= 0)
+        ::close(fd);
+
+    fd = -1;
+    mapping = NULL;
+    mapping_size = 0;
+    size = 0;
+    tile_size = 0;
+    mip_count = 0;
+}
+
+const float *TiledHeightmapFile::get_tile(unsigned int mip, unsigned int tile_x, unsigned int tile_y) const
+{
+    unsigned int tile = get_tile_size(mip);
+    size_t index = size_t(tile_y) * get_tiles_per_row(mip) + tile_x;
+    const uint8_t *base = static_cast<const uint8_t*>(mapping) + mip_offsets[mip];
+    return reinterpret_cast<const float*>(base + index * tile * tile * sizeof(float));
+}
+
+void TiledHeightmapFile::prefetch_tile(unsigned int mip, unsigned int tile_x, unsigned int tile_y) const
+{
+    unsigned int tile = get_tile_size(mip);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(get_tile(mip, tile_x, tile_y));
+    uintptr_t page_mask = uintptr_t(sysconf(_SC_PAGESIZE)) - 1;
+    uintptr_t aligned = begin & ~page_mask;
+    madvise(reinterpret_cast<void*>(aligned), begin - aligned + tile * tile * sizeof(float), MADV_WILLNEED);
+}
+
+bool TiledHeightmapFile::write(const char *path, const float *heightmap, unsigned int size, unsigned int tile_size)
+{
+    if (!is_pow2(size) || !is_pow2(tile_size))
+        return false;
+
+    // Go all the way down to 1x1 so the coarsest mip is always tiny enough to keep resident.
+    unsigned int mip_count = 1;
+    while ((size >> (mip_count - 1)) > 1)
+        mip_count++;
+
+    // Write to a temporary file first so an interrupted write never leaves a truncated file behind.
+    string tmp_path = string(path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        LOGE("Failed to open %s for writing.\n", tmp_path.c_str());
+        return false;
+    }
+
+    vector<uint8_t> header_block(HEADER_SIZE);
+    Header header = { MAGIC, VERSION, size, tile_size, mip_count, HEADER_SIZE };
+    memcpy(&header_block[0], &header, sizeof(header));
+    bool ok = fwrite(&header_block[0], 1, header_block.size(), file) == header_block.size();
+
+    vector<float> mip(heightmap, heightmap + size * size);
+    vector<float> next;
+    vector<float> tile_data;
+    for (unsigned int level = 0; level < mip_count && ok; level++)
+    {
+        unsigned int mip_size = size >> level;
+        unsigned int tile = min(tile_size, mip_size);
+        unsigned int tiles = mip_size / tile;
+
+        tile_data.resize(tile * tile);
+        for (unsigned int tile_y = 0; tile_y < tiles && ok; tile_y++)
+        {
+            for (unsigned int tile_x = 0; tile_x < tiles && ok; tile_x++)
+            {
+                for (unsigned int y = 0; y < tile; y++)
+                    memcpy(&tile_data[y * tile], &mip[(tile_y * tile + y) * mip_size + tile_x * tile], tile * sizeof(float));
+                ok = fwrite(&tile_data[0], sizeof(float), tile_data.size(), file) == tile_data.size();
+            }
+        }
+
+        // 2x2 box filter for the next mip.
+        unsigned int next_size = mip_size >> 1;
+        next.resize(next_size * next_size);
+        for (unsigned int y = 0; y < next_size; y++)
+        {
+            const float *row0 = &mip[(2 * y + 0) * mip_size];
+            const float *row1 = &mip[(2 * y + 1) * mip_size];
+            for (unsigned int x = 0; x < next_size; x++)
+                next[y * next_size + x] = 0.25f * (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]);
+        }
+        mip.swap(next);
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+
+    if (!ok || rename(tmp_path.c_str(), path) != 0)
+    {
+        LOGE("Failed to write tiled heightmap %s.\n", path);
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILED_HEIGHTMAP_FILE_H__
+#define TILED_HEIGHTMAP_FILE_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Memory-mapped heightmap stored as square tiles, with a full mip chain.
+// Mip level m is (size >> m) texels wide, and a texel at mip m covers 2^m texels of mip 0.
+// Every mip is split into tiles of tile_size * tile_size floats (or a single smaller tile for the smallest mips).
+// Every tile is stored contiguously, so reading one tile only touches the pages it spans.
+// With 4 KB pages, tiles are also page-aligned while they are at least 32 x 32 texels (4 KB), as the header
+// is 4 KB as well. The single tile of a smaller mip is not, and shares its pages with the neighbouring mips.
+// The heightmap repeats infinitely in both directions, like GL_REPEAT.
+//
+// Layout (little-endian):
+//   Header, padded to HEADER_SIZE bytes.
+//   For each mip from 0 to mip_count - 1, tiles in row-major order, texels in row-major order.
+class TiledHeightmapFile
+{
+public:
+    TiledHeightmapFile();
+    ~TiledHeightmapFile();
+
+    // Maps a file created by write(). Returns false if the file is missing or malformed.
+    bool open(const char *path);
+    void close();
+    bool is_open() const { return mapping != NULL; }
+
+    // Builds the mip chain for a size x size heightmap with a 2x2 box filter and writes it to path.
+    // size and tile_size must be powers of two.
+    static bool write(const char *path, const float *heightmap, unsigned int size, unsigned int tile_size);
+
+    unsigned int get_size() const { return size; }
+    unsigned int get_mip_count() const { return mip_count; }
+    unsigned int get_mip_size(unsigned int mip) const { return size >> mip; }
+    unsigned int get_tile_size(unsigned int mip) const;
+    unsigned int get_tiles_per_row(unsigned int mip) const { return get_mip_size(mip) / get_tile_size(mip); }
+
+    // Returns a pointer to the texels of a tile inside the mapping.
+    // Reading through it may fault pages in from storage, so keep it off time critical threads.
+    const float *get_tile(unsigned int mip, unsigned int tile_x, unsigned int tile_y) const;
+
+    // Tells the kernel we are about to read a tile so it can start reading ahead.
+    void prefetch_tile(unsigned int mip, unsigned int tile_x, unsigned int tile_y) const;
+
+private:
+    enum { MAGIC = 0x50414d48, VERSION = 1, HEADER_SIZE = 4096 };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;
+        uint32_t tile_size;
+        uint32_t mip_count;
+        uint32_t header_size;
+    };
+
+    int fd;
+    void *mapping;
+    size_t mapping_size;
+    unsigned int size;
+    unsigned int tile_size;
+    unsigned int mip_count;
+    size_t mip_offsets[32];
+
+    static size_t compute_layout(unsigned int size, unsigned int tile_size, unsigned int mip_count, size_t *mip_offsets);
+
+    TiledHeightmapFile(const TiledHeightmapFile&);
+    TiledHeightmapFile& operator=(const TiledHeightmapFile&);
+};
+
+#endif
@@ -44,6 +44,9 @@ using namespace MaliSDK;
 // Distance between vertices.
 #define CLIPMAP_SCALE 0.25f
 
+// Tiled heightmap file to stream from. It is baked from the procedural heightmap on first run.
+#define HEIGHTMAP_PATH "/data/data/com.arm.malideveloper.openglessdk.terrain/heightmap.tiles"
+
 ClipmapApplication* app = NULL;
 int surface_width, surface_height;
 
@@ -53,7 +56,7 @@ extern "C"
     (JNIEnv *env, jclass jcls, jint width, jint height)
     {
       delete app;
-      app = new ClipmapApplication(CLIPMAP_SIZE, CLIPMAP_LEVELS, CLIPMAP_SCALE);
+      app = new ClipmapApplication(CLIPMAP_SIZE, CLIPMAP_LEVELS, CLIPMAP_SCALE, HEIGHTMAP_PATH);
       surface_width = width;
       surface_height = height;
     }
@@ -114,5 +114,134 @@ static const char fragment_shader_source[] =
     "  FragColor = vec4(final_color, 1.0);\n"
     "}\n";
 
+// Used in GroundMesh::DrawIndirect mode.
+// One work group per block type, one invocation per candidate instance, see ClipmapDrawList for the CPU equivalent.
+// Visible instances are written in candidate order, so the output can be compared directly with the CPU reference.
+// The #version line and the HEIGHTMAP_MIN, HEIGHTMAP_MAX and BOUNDS_EPSILON defines are prepended from the
+// ClipmapDrawList constants when the program is compiled.
+static const char cull_compute_shader_source[] =
+    "layout(local_size_x = 128) in; // Must be at least ClipmapDrawList::get_max_candidates_per_draw().\n"
+
+    "struct Candidate\n"
+    "{\n"
+    "  vec2 offset; // In texels of the level, relative to the level offset.\n"
+    "  vec2 range;\n"
+    "  uint level;\n"
+    "  uint trim;\n"
+    "};\n"
+
+    "struct DrawType\n"
+    "{\n"
+    "  uint first_index;\n"
+    "  uint indices;\n"
+    "  uint first_candidate;\n"
+    "  uint num_candidates;\n"
+    "  uint first_instance;\n"
+    "};\n"
+
+    "struct PerInstanceData\n"
+    "{\n"
+    "  vec2 offset;\n"
+    "  vec2 texture_scale;\n"
+    "  vec2 texture_offset;\n"
+    "  float scale;\n"
+    "  float level;\n"
+    "};\n"
+
+    "struct DrawElementsIndirectCommand\n"
+    "{\n"
+    "  uint count;\n"
+    "  uint instance_count;\n"
+    "  uint first_index;\n"
+    "  int base_vertex;\n"
+    "  uint reserved_must_be_zero;\n"
+    "};\n"
+
+    "layout(std430, binding = 0) readonly buffer Candidates { Candidate candidates[]; };\n"
+    "layout(std430, binding = 1) readonly buffer DrawTypes { DrawType draws[]; };\n"
+    "layout(std430, binding = 2) writeonly buffer Instances { PerInstanceData instances[]; };\n"
+    "layout(std430, binding = 3) writeonly buffer Commands { DrawElementsIndirectCommand commands[]; };\n"
+
+    "uniform vec4 uPlanes[6];\n"
+    "uniform vec2 uLevelOffsets[10];\n"
+    "uniform float uClipmapScale;\n"
+    "uniform float uTextureScale;\n"
+    "uniform uint uTrimOffset;\n"
+
+    "#define TRIM_ALWAYS 0u\n"
+    "#define TRIM_TOP_RIGHT 1u\n"
+    "#define TRIM_TOP_LEFT 2u\n"
+    "#define TRIM_BOTTOM_RIGHT 3u\n"
+    "#define TRIM_BOTTOM_LEFT 4u\n"
+
+    "shared uint visible[128];\n"
+
+    "bool trim_visible(Candidate candidate)\n"
+    "{\n"
+    "  if (candidate.trim == TRIM_ALWAYS)\n"
+    "    return true;\n"
+    "  vec2 offset = uLevelOffsets[candidate.level - 1u] - (uLevelOffsets[candidate.level] + vec2(float(uTrimOffset << candidate.level)));\n"
+    "  switch (candidate.trim)\n"
+    "  {\n"
+    "    case TRIM_TOP_RIGHT: return offset.x < 0.5 && offset.y > 0.5;\n"
+    "    case TRIM_TOP_LEFT: return offset.x > 0.5 && offset.y > 0.5;\n"
+    "    case TRIM_BOTTOM_RIGHT: return offset.x < 0.5 && offset.y < 0.5;\n"
+    "    case TRIM_BOTTOM_LEFT: return offset.x > 0.5 && offset.y < 0.5;\n"
+    "    default: return false;\n"
+    "  }\n"
+    "}\n"
+
+    "bool cull_candidate(Candidate candidate, out PerInstanceData instance)\n"
+    "{\n"
+    "  if (!trim_visible(candidate))\n"
+    "    return false;\n"
+
+    "  float level_scale = float(1u << candidate.level);\n"
+    "  vec2 offset = uLevelOffsets[candidate.level] + candidate.offset * level_scale;\n"
+    "  instance.texture_scale = vec2(uTextureScale);\n"
+    "  instance.texture_offset = fract((offset / level_scale) * uTextureScale);\n"
+    "  instance.offset = offset * uClipmapScale;\n"
+    "  instance.scale = uClipmapScale * level_scale;\n"
+    "  instance.level = float(candidate.level);\n"
+
+    "  vec2 extent = candidate.range * (level_scale * uClipmapScale);\n"
+    "  vec3 bounds_min = vec3(instance.offset.x - BOUNDS_EPSILON, HEIGHTMAP_MIN - BOUNDS_EPSILON, instance.offset.y - BOUNDS_EPSILON);\n"
+    "  vec3 bounds_max = vec3(instance.offset.x + extent.x + BOUNDS_EPSILON, HEIGHTMAP_MAX + BOUNDS_EPSILON, instance.offset.y + extent.y + BOUNDS_EPSILON);\n"
+
+    "  // Test the corner furthest along each plane normal, like MaliSDK::FrustumCuller does.\n"
+    "  for (int i = 0; i < 6; i++)\n"
+    "  {\n"
+    "    vec3 corner = mix(bounds_min, bounds_max, greaterThanEqual(uPlanes[i].xyz, vec3(0.0)));\n"
+    "    if (dot(uPlanes[i].xyz, corner) + uPlanes[i].w < 0.0)\n"
+    "      return false;\n"
+    "  }\n"
+    "  return true;\n"
+    "}\n"
+
+    "void main()\n"
+    "{\n"
+    "  uint draw = gl_WorkGroupID.x;\n"
+    "  uint index = gl_LocalInvocationID.x;\n"
+    "  DrawType info = draws[draw];\n"
+
+    "  PerInstanceData instance;\n"
+    "  bool is_visible = index < info.num_candidates && cull_candidate(candidates[info.first_candidate + index], instance);\n"
+    "  visible[index] = is_visible ? 1u : 0u;\n"
+    "  memoryBarrierShared();\n"
+    "  barrier();\n"
+
+    "  // Count the visible candidates in front of this one to find where to write.\n"
+    "  // This keeps the instances in candidate order, there are too few of them for a proper prefix sum to pay off.\n"
+    "  uint slot = 0u;\n"
+    "  for (uint i = 0u; i < index; i++)\n"
+    "    slot += visible[i];\n"
+
+    "  if (is_visible)\n"
+    "    instances[info.first_instance + slot] = instance;\n"
+
+    "  if (index == gl_WorkGroupSize.x - 1u)\n"
+    "    commands[draw] = DrawElementsIndirectCommand(info.indices, slot + visible[index], info.first_index, 0, 0u);\n"
+    "}\n";
+
 #endif
 
@@ -0,0 +1,91 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+namespace MaliSDK
+{
+    /**
+     * \brief Stateless counter-based random number generator (Philox4x32-10).
+     *
+     * Every (index, stream) pair maps to four random 32-bit values through a keyed bijection, as described
+     * in "Parallel Random Numbers: As Easy as 1, 2, 3" by Salmon et al. There is no state to advance,
+     * so any part of a sequence can be generated on any thread, in any order, and gives the same values.
+     * This makes it possible to fill large buffers in parallel and still get reproducible results.
+     *
+     * Use the index for the element being generated, for example a particle or a texel, and the stream
+     * to get independent values for different purposes from the same indices.
+     * The batch functions generate four indices at a time with NEON or SSE2.
+     */
+    class CounterRandom
+    {
+    public:
+        /**
+         * \brief Creates a generator. Generators with different seeds give unrelated sequences.
+         * \param[in] seed Seed of the generator.
+         */
+        explicit CounterRandom(unsigned long long seed = 0);
+
+        /**
+         * \brief Generates the four random values of one index.
+         * \param[in] index Position in the stream.
+         * \param[in] stream Selects an independent sequence.
+         * \param[out] output Receives four values.
+         */
+        void generate(unsigned long long index, unsigned int stream, unsigned int *output) const;
+
+        /**
+         * \brief Returns the first random value of one index.
+         */
+        unsigned int generateUint(unsigned long long index, unsigned int stream = 0) const;
+
+        /**
+         * \brief Returns the first random value of one index as a float in the range [0.0, 1.0).
+         */
+        float generateFloat(unsigned long long index, unsigned int stream = 0) const;
+
+        /**
+         * \brief Generates the values of count consecutive indices, the same values as calling generate() for each.
+         * \param[in] firstIndex Index of the first values to generate.
+         * \param[in] stream Selects an independent sequence.
+         * \param[in] count Number of indices.
+         * \param[out] output Receives 4 * count values, the four values of index firstIndex + i start at output[4 * i].
+         */
+        void generateBatch(unsigned long long firstIndex, unsigned int stream, unsigned int count, unsigned int *output) const;
+
+        /**
+         * \brief Like generateBatch(), with every value converted by toFloat().
+         */
+        void generateFloatBatch(unsigned long long firstIndex, unsigned int stream, unsigned int count, float *output) const;
+
+        /**
+         * \brief Converts a random value to a float in the range [0.0, 1.0), using its 24 most significant bits.
+         */
+        static float toFloat(unsigned int value)
+        {
+            return (value >> 8) * (1.0f / 16777216.0f);
+        }
+
+    private:
+        unsigned int key[2];
+    };
+}
+#endif /* COUNTERRANDOM_H */
@@ -55,7 +55,7 @@ namespace MaliSDK
         /**
          * \brief Extract the ETC header information from a loaded ETC compressed texture.
          */
-        ETCHeader(unsigned char *data);
+        ETCHeader(const unsigned char *data);
         
         /**
          * \brief The width of the original texture.
@@ -0,0 +1,155 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRUSTUMCULLING_H
+#define FRUSTUMCULLING_H
+
+#include <vector>
+
+namespace MaliSDK
+{
+    /**
+     * \brief Bounding spheres in structure-of-arrays layout, as consumed by FrustumCuller.
+     */
+    struct BoundingSphereArray
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        void clear();
+        void reserve(unsigned int count);
+        void push(float centerX, float centerY, float centerZ, float sphereRadius);
+        unsigned int size() const { return (unsigned int)x.size(); }
+    };
+
+    /**
+     * \brief Axis-aligned bounding boxes in structure-of-arrays layout, as consumed by FrustumCuller.
+     */
+    struct BoundingBoxArray
+    {
+        std::vector<float> minX;
+        std::vector<float> minY;
+        std::vector<float> minZ;
+        std::vector<float> maxX;
+        std::vector<float> maxY;
+        std::vector<float> maxZ;
+
+        void clear();
+        void reserve(unsigned int count);
+        void push(float minimumX, float minimumY, float minimumZ, float maximumX, float maximumY, float maximumZ);
+        unsigned int size() const { return (unsigned int)minX.size(); }
+    };
+
+    /**
+     * \brief Tests many bounding volumes against the six planes of a view frustum at once.
+     *
+     * Volumes are read in structure-of-arrays layout and tested four at a time with NEON or SSE,
+     * two groups of four per loop iteration. The result is a compacted list of the indices of the
+     * visible volumes in ascending order, which can be used directly to build instance or draw lists.
+     *
+     * Planes are stored as (a, b, c, d) with normalized inward-facing normals, so a point p is inside
+     * a plane when a * p.x + b * p.y + c * p.z + d >= 0.
+     */
+    class FrustumCuller
+    {
+    public:
+        /**
+         * \brief Plane indices as returned by getPlane().
+         */
+        enum Plane
+        {
+            PLANE_LEFT,
+            PLANE_RIGHT,
+            PLANE_BOTTOM,
+            PLANE_TOP,
+            PLANE_NEAR,
+            PLANE_FAR,
+            NUMBER_OF_PLANES
+        };
+
+        /**
+         * \brief Creates a culler which accepts everything.
+         */
+        FrustumCuller();
+
+        /**
+         * \brief Extracts the frustum planes from a view-projection matrix.
+         * \param[in] viewProjection Column-major matrix mapping world space to OpenGL clip space.
+         */
+        void setViewProjection(const float *viewProjection);
+
+        /**
+         * \brief Sets the frustum planes directly.
+         * \param[in] planes Six planes of four floats (a, b, c, d) each, in any order, normals facing inwards.
+         */
+        void setPlanes(const float *planes);
+
+        /**
+         * \brief Returns plane index as four floats (a, b, c, d).
+         */
+        const float *getPlane(unsigned int index) const { return planes[index]; }
+
+        /**
+         * \brief Finds the spheres which intersect the frustum.
+         * \param[in] x, y, z, radius Sphere centers and radii, numberOfSpheres of each.
+         * \param[in] numberOfSpheres Number of spheres to test.
+         * \param[out] visible Receives the indices of visible spheres. Must have room for numberOfSpheres indices.
+         * \return The number of visible spheres.
+         */
+        unsigned int cullSpheres(const float *x, const float *y, const float *z, const float *radius,
+                                 unsigned int numberOfSpheres, unsigned int *visible) const;
+        unsigned int cullSpheres(const BoundingSphereArray& spheres, unsigned int *visible) const;
+
+        /**
+         * \brief Tests a row of equally spaced spheres of the same radius, as found in regular grids.
+         *
+         * Sphere i is centered at (startX + i * stepX, y, z), so the centers do not have to be stored.
+         * Unlike cullSpheres(), the result is one flag per sphere, so rows of a grid can be tested independently.
+         * \param[in] startX Center X of the first sphere.
+         * \param[in] stepX Distance between the centers of neighbouring spheres.
+         * \param[in] y, z Center Y and Z of all spheres.
+         * \param[in] radius Radius of all spheres.
+         * \param[in] numberOfSpheres Number of spheres in the row.
+         * \param[out] visible Receives 1 for each sphere which intersects the frustum and 0 otherwise, numberOfSpheres bytes.
+         */
+        void cullSphereRow(float startX, float stepX, float y, float z, float radius,
+                           unsigned int numberOfSpheres, unsigned char *visible) const;
+
+        /**
+         * \brief Finds the axis-aligned boxes which intersect the frustum.
+         *
+         * A box is culled when all of its corners are outside of one of the planes.
+         * \param[in] minX, minY, minZ, maxX, maxY, maxZ Box extents, numberOfBoxes of each.
+         * \param[in] numberOfBoxes Number of boxes to test.
+         * \param[out] visible Receives the indices of visible boxes. Must have room for numberOfBoxes indices.
+         * \return The number of visible boxes.
+         */
+        unsigned int cullBoxes(const float *minX, const float *minY, const float *minZ,
+                               const float *maxX, const float *maxY, const float *maxZ,
+                               unsigned int numberOfBoxes, unsigned int *visible) const;
+        unsigned int cullBoxes(const BoundingBoxArray& boxes, unsigned int *visible) const;
+
+    private:
+        float planes[NUMBER_OF_PLANES][4];
+    };
+}
+#endif /* FRUSTUMCULLING_H */
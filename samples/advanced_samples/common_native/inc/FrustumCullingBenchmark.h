@@ -1,4 +1,4 @@
-/* Copyright (c) 2014-2017, ARM Limited and Contributors
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
  *
  * SPDX-License-Identifier: MIT
  *
@@ -18,25 +18,26 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#ifndef AABB_H__
-#define AABB_H__
+#ifndef FRUSTUMCULLINGBENCHMARK_H
+#define FRUSTUMCULLINGBENCHMARK_H
 
-#include "vector_math.h"
-
-// Axis-aligned bounding box. Used for frustum-culling.
-// Represents a box with corners base and base + offset which encapsulate an entire mesh.
-
-class AABB
+namespace MaliSDK
 {
-public:
-    AABB(const vec3& base, const vec3& offset);
-    vec3 center() const;
-
-    vec3 corner(unsigned int index) const;
-
-private:
-    vec3 base;
-    vec3 offset;
-};
-
-#endif
+    /**
+     * \brief Microbenchmark comparing FrustumCuller against testing one bounding volume at a time.
+     *
+     * Results are printed with LOGI. Intended to be called once during start-up of a sample
+     * on the device that is being profiled.
+     */
+    class FrustumCullingBenchmark
+    {
+    public:
+        /**
+         * \brief Time culling of randomly placed spheres and boxes, and log the results.
+         * \param[in] numberOfObjects Number of spheres and of boxes.
+         * \param[in] iterations Number of times each set is culled.
+         */
+        static void run(int numberOfObjects, int iterations);
+    };
+}
+#endif /* FRUSTUMCULLINGBENCHMARK_H */
@@ -103,7 +103,7 @@ namespace MaliSDK
 
             static float convertSingleComponent(unsigned char value, int exponent);
 
-            static bool decodeLine(FILE* file, int lineLength, RGBEPixel* scanLine);
+            static bool decodeLine(const unsigned char*& cursor, const unsigned char* end, int lineLength, RGBEPixel* scanLine);
 
             static void writeDecodedComponent(int componentIndicator, unsigned char value, RGBEPixel* pixel);
     };
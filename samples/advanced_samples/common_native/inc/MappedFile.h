@@ -0,0 +1,96 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+namespace MaliSDK
+{
+    /**
+     * \brief Read-only view of a whole file, mapped into memory.
+     *
+     * Reading a file with fread() copies it from the page cache into a heap buffer,
+     * which is then usually copied once more by OpenGL ES. Mapping the file lets
+     * glTexImage2D(), glShaderSource() or a parser read the page cache directly,
+     * without a temporary allocation the size of the file.
+     *
+     * The view is valid until close() is called or the object is destroyed,
+     * so pointers into it must not outlive the MappedFile.
+     */
+    class MappedFile
+    {
+    public:
+        /**
+         * \brief Creates a closed file.
+         */
+        MappedFile(void);
+
+        /**
+         * \brief Maps filename, see open(). Exits if the file cannot be mapped.
+         * \param[in] filename The file to map.
+         */
+        explicit MappedFile(const char *filename);
+
+        /**
+         * \brief Unmaps the file.
+         */
+        ~MappedFile(void);
+
+        /**
+         * \brief Maps a file, closing the one mapped before.
+         * \param[in] filename The file to map.
+         * \return false if the file could not be opened or mapped.
+         */
+        bool open(const char *filename);
+
+        /**
+         * \brief Unmaps the file. Pointers returned by getData() become invalid.
+         */
+        void close(void);
+
+        /**
+         * \brief Returns true if a file is mapped.
+         */
+        bool isOpen(void) const { return opened; }
+
+        /**
+         * \brief Returns the contents of the file. The data is not null-terminated.
+         */
+        const unsigned char *getData(void) const { return data; }
+
+        /**
+         * \brief Returns the size of the file in bytes.
+         */
+        size_t getSize(void) const { return size; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const unsigned char *data;
+        size_t size;
+        bool opened;
+        /* True if data is a heap copy rather than a mapping, on platforms without mmap(). */
+        bool copied;
+    };
+}
+#endif /* MAPPEDFILE_H */
@@ -44,7 +44,7 @@ namespace MaliSDK
          * \param[in] right Second matrix to multiply.
          * \return The result of left * right 
          */
-        static Matrix multiply(Matrix *left, Matrix *right);
+        static Matrix multiply(const Matrix *left, const Matrix *right);
     public:       
         /**
          * \brief Get the matrix elements as a column major order array.
@@ -69,7 +69,7 @@ namespace MaliSDK
          * \param[in] right The matrix to post multiply by.
          * \return The result of matrix * right.
          */
-        Matrix operator* (Matrix right);
+        Matrix operator* (const Matrix &right);
 
         /**
          * \brief Overloading assingment operater to do deep copy of the Matrix elements.
@@ -105,6 +105,43 @@ namespace MaliSDK
          */
         static Vec3f vertexTransform(Vec3f *vector, Matrix *matrix);
 
+        /**
+         * \brief Transform an array of 4D vertices by a matrix.
+         *
+         * Uses NEON, AVX or SSE kernels where the target supports them, scalar code otherwise.
+         * \note vertices and results may point to the same array to transform in-place.
+         * \param[in] vertices The 4D vectors to be transformed.
+         * \param[out] results Array receiving matrix x vertices[i]. Must hold numberOfVertices elements.
+         * \param[in] numberOfVertices Number of vectors in vertices.
+         * \param[in] matrix The transformation matrix.
+         */
+        static void vertexTransform(const Vec4f *vertices, Vec4f *results, int numberOfVertices, const Matrix *matrix);
+
+        /**
+         * \brief Transform an array of 3D positions by a matrix (w is taken to be 1).
+         *
+         * Uses NEON or SSE kernels where the target supports them, scalar code otherwise.
+         * \note vertices and results may point to the same array to transform in-place.
+         * \param[in] vertices The 3D positions to be transformed.
+         * \param[out] results Array receiving matrix x vertices[i]. Must hold numberOfVertices elements.
+         * \param[in] numberOfVertices Number of positions in vertices.
+         * \param[in] matrix The transformation matrix.
+         */
+        static void vertexTransform(const Vec3f *vertices, Vec3f *results, int numberOfVertices, const Matrix *matrix);
+
+        /**
+         * \brief Transform an array of 3D directions by the upper 3x3 part of a matrix (w is taken to be 0).
+         *
+         * The results are not normalized. To transform normals by a matrix containing non-uniform
+         * scaling, pass the inverse transpose of that matrix.
+         * \note normals and results may point to the same array to transform in-place.
+         * \param[in] normals The 3D directions to be transformed.
+         * \param[out] results Array receiving the transformed directions. Must hold numberOfNormals elements.
+         * \param[in] numberOfNormals Number of directions in normals.
+         * \param[in] matrix The transformation matrix.
+         */
+        static void normalTransform(const Vec3f *normals, Vec3f *results, int numberOfNormals, const Matrix *matrix);
+
         /**
          * \brief Transpose a matrix in-place.
          * \param[in,out] matrix The matrix to transpose.
@@ -0,0 +1,45 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MATRIXBENCHMARK_H
+#define MATRIXBENCHMARK_H
+
+namespace MaliSDK
+{
+    /**
+     * \brief Microbenchmark comparing the batched Matrix transforms against the per-vertex path.
+     *
+     * Results are printed with LOGI. Intended to be called once during start-up of a sample
+     * on the device that is being profiled. The batched results are checked against the per-vertex
+     * results, so a broken SIMD path is reported with LOGE.
+     */
+    class MatrixBenchmark
+    {
+    public:
+        /**
+         * \brief Time per-vertex and batched transforms of 3D and 4D vertex arrays and of normals, and log the results.
+         * \param[in] numberOfVertices Number of vertices in each array.
+         * \param[in] iterations Number of times each array is transformed.
+         * \return False if a batched result differs from the per-vertex result by more than rounding.
+         */
+        static bool run(int numberOfVertices, int iterations);
+    };
+}
+#endif /* MATRIXBENCHMARK_H */
@@ -0,0 +1,148 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+
+namespace MaliSDK
+{
+    /**
+     * \brief Result of running an index buffer through MeshOptimizer::simulateVertexCache().
+     */
+    struct VertexCacheStatistics
+    {
+        /** Number of non-degenerate triangles. */
+        unsigned int triangles;
+        /** Number of cache misses, i.e. vertex shader invocations. */
+        unsigned int transformedVertices;
+        /** Number of unique vertices referenced. */
+        unsigned int uniqueVertices;
+        /** Average cache miss ratio, transformed vertices per triangle. 0.5 is the best case for a large regular grid. */
+        float acmr;
+        /** Average transform to vertex ratio, transformed vertices per unique vertex. 1.0 is the best case. */
+        float atvr;
+    };
+
+    /**
+     * \brief Order of the triangles in the index buffer of a regular grid, chosen by each sample.
+     */
+    enum IndexOrder
+    {
+        /** One triangle strip per row of quads, as generated by the sample. */
+        IndexOrderRows,
+        /** Strips in vertical bands narrow enough that a row of vertices is still in the cache for the next row, see MeshOptimizer::generateGridStrips(). */
+        IndexOrderBandedStrips,
+        /** Triangle list reordered by MeshOptimizer::optimizeVertexCache(). Needs three times the indices. */
+        IndexOrderForsyth
+    };
+
+    /**
+     * \brief Reorders 16-bit index buffers for post-transform vertex cache locality, and measures the effect.
+     *
+     * GPUs keep recently shaded vertices around in a small cache indexed by vertex index.
+     * Every miss means another vertex shader invocation, so the order of the triangles
+     * decides how many times each vertex is shaded.
+     */
+    class MeshOptimizer
+    {
+    public:
+        /**
+         * \brief Index which restarts a triangle strip with GL_PRIMITIVE_RESTART_FIXED_INDEX.
+         */
+        static const unsigned short restartIndex = 0xffff;
+
+        /**
+         * \brief Size of the FIFO post-transform vertex cache to optimise for when the size of the device's cache is not known.
+         */
+        static const unsigned int defaultCacheSize = 16;
+
+        /**
+         * \brief Runs indices through a FIFO post-transform vertex cache.
+         * \param[in] indices Indices to simulate.
+         * \param[in] numberOfIndices Number of indices.
+         * \param[in] triangleStrip True for GL_TRIANGLE_STRIP (restartIndex restarts the strip), false for GL_TRIANGLES.
+         * \param[in] cacheSize Number of vertices the cache holds.
+         * \return Miss counts and ratios.
+         */
+        static VertexCacheStatistics simulateVertexCache(const unsigned short *indices, unsigned int numberOfIndices,
+                                                         bool triangleStrip, unsigned int cacheSize = defaultCacheSize);
+
+        /**
+         * \brief Converts a triangle strip to a triangle list with the same winding.
+         *
+         * Degenerate triangles are dropped, and restartIndex restarts the strip.
+         * \param[in] strip Strip indices.
+         * \param[in] numberOfIndices Number of strip indices.
+         * \param[out] triangles Triangle list indices are appended here.
+         */
+        static void convertStripToList(const unsigned short *strip, unsigned int numberOfIndices, std::vector<unsigned short>& triangles);
+
+        /**
+         * \brief Reorders the triangles of a triangle list for a vertex cache of unknown size.
+         *
+         * Uses Tom Forsyth's linear-speed vertex cache optimisation: triangles are emitted greedily,
+         * picking the triangle whose vertices score highest based on their position in a simulated LRU cache
+         * and how many triangles still use them. The winding of each triangle is kept.
+         * \param[in,out] triangles Triangle list indices, reordered in place.
+         */
+        static void optimizeVertexCache(std::vector<unsigned short>& triangles);
+
+        /**
+         * \brief Generates triangle strips for a regular grid of vertices, ordered for vertex cache locality.
+         *
+         * A strip along a full row of a wide grid pushes the shared vertices of the row out of the cache
+         * before the next row can use them. Instead, the grid is split in vertical bands of bandWidth vertices
+         * and each band is drawn as one strip per row of quads, separated by restartIndex.
+         * With bandWidth >= width, this is the plain row by row order.
+         * \param[in] width Number of vertices in a row.
+         * \param[in] height Number of rows.
+         * \param[in] stride Distance between rows in the vertex buffer.
+         * \param[in] firstVertex Index of the top-left vertex.
+         * \param[in] bandWidth Number of vertices in a row of a band, at least 2.
+         * \param[in] alternateDiagonals If true, the quads of every other row are split along the other diagonal,
+         *                               like a single strip running back and forth over the rows does.
+         *                               Costs one extra index per row.
+         * \param[out] indices Strip indices are appended here. Draw with GL_PRIMITIVE_RESTART_FIXED_INDEX enabled.
+         */
+        static void generateGridStrips(unsigned int width, unsigned int height, unsigned int stride, unsigned int firstVertex,
+                                       unsigned int bandWidth, bool alternateDiagonals, std::vector<unsigned short>& indices);
+
+        /**
+         * \brief Finds the band width for generateGridStrips() with the lowest ACMR, by simulating each of them.
+         * \param[in] width Number of vertices in a row.
+         * \param[in] height Number of rows.
+         * \param[in] alternateDiagonals As for generateGridStrips().
+         * \param[in] cacheSize Number of vertices the cache holds.
+         * \return The best band width. Wider bands win ties, as they need fewer indices.
+         */
+        static unsigned int findGridBandWidth(unsigned int width, unsigned int height, bool alternateDiagonals, unsigned int cacheSize = defaultCacheSize);
+
+        /**
+         * \brief Logs the cache statistics of an index buffer before and after optimisation.
+         * \param[in] name Name of the mesh.
+         * \param[in] before Statistics of the original index buffer.
+         * \param[in] after Statistics of the optimised index buffer.
+         */
+        static void logReport(const char *name, const VertexCacheStatistics& before, const VertexCacheStatistics& after);
+    };
+}
+#endif /* MESHOPTIMIZER_H */
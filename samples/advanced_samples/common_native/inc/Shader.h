@@ -36,13 +36,6 @@ namespace MaliSDK
      */
     class Shader
     {
-    private:
-        /**
-         * \brief Load shader source from a file into memory.
-         * \param[in] filename File name of the shader to load.
-         * \return A character array containing the contents of the shader source file. 
-         */
-        static char *loadShader(const char *filename);
     public:
         /**
          * \brief Create shader, load in source, compile, and dump debug as necessary.
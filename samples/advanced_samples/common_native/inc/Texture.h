@@ -22,6 +22,7 @@
 #define TEXTURE_H
 
 #include "ETCHeader.h"
+#include "MappedFile.h"
 
 #if GLES_VERSION == 2
 #include <GLES2/gl2.h>
@@ -101,6 +102,15 @@ namespace MaliSDK
          */
         static void loadData(const char *filename, unsigned char **textureData);
 
+        /**
+         * \brief Map texture data from a file into memory, without copying it.
+         *
+         * Prefer this to the copying version when the data is only passed on to OpenGL ES or a parser.
+         * \param[in] filename The filename of the texture to load.
+         * \param[out] file Holds the texture data until it is closed or destroyed.
+         */
+        static void loadData(const char *filename, MappedFile& file);
+
         /**
          * \brief Load header and texture data from a pkm file into memory.
          *
@@ -110,6 +120,16 @@ namespace MaliSDK
          */
         static void loadPKMData(const char *filename, ETCHeader* etcHeader, unsigned char **textureData);
 
+        /**
+         * \brief Map a pkm file into memory and extract its header, without copying the texture data.
+         *
+         * \param[in] filename The filename of the texture to load.
+         * \param[out] etcHeader Pointer to the header that has been loaded.
+         * \param[out] file Holds the texture data until it is closed or destroyed.
+         * \param[out] textureData Pointer to the texture data inside file.
+         */
+        static void loadPKMData(const char *filename, ETCHeader* etcHeader, MappedFile& file, const unsigned char **textureData);
+
         /**
          * \brief Load compressed mipmaps into memory
          *
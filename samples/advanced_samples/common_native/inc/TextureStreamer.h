@@ -0,0 +1,271 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#if GLES_VERSION == 3
+
+#include <GLES3/gl3.h>
+#include <EGL/egl.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace MaliSDK
+{
+    class MappedFile;
+    class Timer;
+
+    /**
+     * \brief Loads ETC (PKM) and ASTC textures in the background while the application keeps rendering.
+     *
+     * Files are read and their headers parsed on an I/O thread. An upload thread with its own
+     * EGL context, sharing objects with the context of the application, copies every mipmap
+     * level into a pixel unpack buffer and from there into the texture. A fence is inserted after
+     * every upload, and update() makes a level visible once its fence has signalled.
+     * Until then the texture is incomplete, and samples as black.
+     *
+     * Work is ordered by request priority, and within a texture the smallest mipmap levels
+     * come first. GL_TEXTURE_BASE_LEVEL is moved down as levels arrive, so a texture can be
+     * sampled at low resolution early and sharpens over the following frames.
+     *
+     * All public functions must be called from the thread owning the application's context.
+     * Requires OpenGL ES 3.0.
+     */
+    class TextureStreamer
+    {
+    public:
+        /**
+         * \brief Upload counters, see getStatistics().
+         */
+        struct Statistics
+        {
+            /** Number of textures requested. */
+            unsigned int texturesRequested;
+            /** Number of textures with every mipmap level visible. */
+            unsigned int texturesComplete;
+            /** Number of mipmap levels made visible by update(). */
+            unsigned int levelsUploaded;
+            /** Number of compressed bytes made visible by update(). */
+            size_t bytesUploaded;
+            /** Seconds from start() until update() last made a level visible. */
+            float streamingTime;
+        };
+
+        /**
+         * \brief Creates an idle streamer. Call start() to create the worker threads.
+         * \param[in] stagingBufferCount Number of pixel unpack buffers cycled through by the upload thread.
+         * \param[in] maximumPendingBytes Once this much file data is mapped but not uploaded, the I/O thread waits.
+         */
+        explicit TextureStreamer(unsigned int stagingBufferCount = 3, size_t maximumPendingBytes = 16 * 1024 * 1024);
+
+        /**
+         * \brief Stops the worker threads. The streamed textures are left to the application.
+         *
+         * Deletes sync objects, so the application's context must still be current.
+         */
+        ~TextureStreamer();
+
+        /**
+         * \brief Creates the upload context, sharing objects with the current context, and starts the worker threads.
+         * \return false if the upload context could not be created. Textures must then be loaded synchronously.
+         */
+        bool start(void);
+
+        /**
+         * \brief Stops the worker threads, dropping all work which has not been uploaded yet.
+         */
+        void stop(void);
+
+        /**
+         * \brief Streams a texture with a single level stored in one PKM or ASTC file.
+         *
+         * \param[in] filename Path of the PKM or ASTC file. The format is detected from the file header.
+         * \param[in] internalFormat Compressed internal format of the texture.
+         *                           GL_NONE derives it from the file header, which cannot tell sRGB ASTC textures apart.
+         * \param[in] priority Textures with a higher priority are streamed first.
+         * \return Name of the texture. It has no storage until its first level arrives.
+         */
+        GLuint streamTexture(const char *filename, GLenum internalFormat = GL_NONE, int priority = 0);
+
+        /**
+         * \brief Streams a mipmapped texture stored with one file per level, like Texture::loadCompressedMipmaps().
+         *
+         * \param[in] filenameBase Level numbers are appended to this to build the filenames, starting with 0 for the base level.
+         * \param[in] filenameSuffix Appended after the level number, usually the file extension.
+         * \param[in] internalFormat Compressed internal format of the texture, or GL_NONE to derive it from the file header.
+         * \param[in] priority Textures with a higher priority are streamed first.
+         * \return Name of the texture. It has no storage until its first level arrives.
+         */
+        GLuint streamMipmaps(const char *filenameBase, const char *filenameSuffix, GLenum internalFormat = GL_NONE, int priority = 0);
+
+        /**
+         * \brief Makes uploaded levels visible to the application's context. Call once per frame.
+         *
+         * Never blocks on the GPU. Textures which got new levels must be bound again
+         * before drawing for the new levels to be used.
+         * \return Number of levels which became visible.
+         */
+        unsigned int update(void);
+
+        /**
+         * \brief Returns true once at least one level of texture is visible.
+         */
+        bool isTextureResident(GLuint texture) const;
+
+        /**
+         * \brief Returns true once every level of texture is visible.
+         */
+        bool isTextureComplete(GLuint texture) const;
+
+        /**
+         * \brief Returns true once every requested texture is complete.
+         */
+        bool isIdle(void) const;
+
+        /**
+         * \brief Returns the upload counters.
+         */
+        Statistics getStatistics(void) const;
+
+        /**
+         * \brief Prints the upload counters with LOGI.
+         */
+        void logStatistics(void) const;
+
+    private:
+        TextureStreamer(const TextureStreamer&);
+        TextureStreamer& operator=(const TextureStreamer&);
+
+        /* Shared between the threads. Every member has a single writer, noted below. */
+        struct StreamedTexture
+        {
+            /* Set on request. */
+            GLuint id;
+            std::string filenameBase;
+            std::string filenameSuffix;
+            bool mipmapped;
+            int priority;
+
+            /* Set by the I/O thread before the first level is handed to the upload thread. */
+            GLenum internalFormat;
+            GLsizei width;
+            GLsizei height;
+            GLint levels;
+
+            /* Application thread only. */
+            std::vector<bool> resident;
+            GLint baseLevel;
+        };
+
+        /* Reads the header of a texture (level == headerLevel) or the data of one level. */
+        struct ReadJob
+        {
+            StreamedTexture *texture;
+            GLint level;
+            unsigned int sequence;
+        };
+
+        struct UploadJob
+        {
+            StreamedTexture *texture;
+            GLint level;
+            unsigned int sequence;
+            GLsizei width;
+            GLsizei height;
+            std::unique_ptr<MappedFile> file;
+            size_t dataOffset;
+            size_t dataSize;
+        };
+
+        struct Completion
+        {
+            StreamedTexture *texture;
+            GLint level;
+            GLsizei dataSize;
+            GLsync fence;
+        };
+
+        struct StagingBuffer
+        {
+            GLuint buffer;
+            GLsizeiptr capacity;
+            GLsync fence;
+        };
+
+        static const GLint headerLevel = -1;
+
+        /*
+         * GL_TEXTURE_BASE_LEVEL of a texture with no resident levels. No level is ever defined this high,
+         * so the texture stays incomplete. Immutable storage would clamp the base level to the
+         * allocated levels and be complete before the first upload has finished, so levels are
+         * defined one by one as they are uploaded instead.
+         */
+        static const GLint unsampledBaseLevel = 1000;
+
+        unsigned int stagingBufferCount;
+        size_t maximumPendingBytes;
+
+        EGLDisplay display;
+        EGLSurface uploadSurface;
+        EGLContext uploadContext;
+
+        std::thread readThread;
+        std::thread uploadThread;
+
+        /* Guards everything up to and including shutdown. */
+        mutable std::mutex lock;
+        std::condition_variable readCondition;
+        std::condition_variable uploadCondition;
+        std::vector<ReadJob> readQueue;
+        std::vector<UploadJob> uploadQueue;
+        std::vector<Completion> completions;
+        size_t pendingBytes;
+        unsigned int nextSequence;
+        bool shutdown;
+
+        /* Application thread only. */
+        std::vector<StreamedTexture *> textures;
+        std::map<GLuint, StreamedTexture *> texturesById;
+        std::vector<Completion> pendingCompletions;
+        Statistics statistics;
+        Timer *timer;
+
+        GLuint requestTexture(const char *filenameBase, const char *filenameSuffix, bool mipmapped, GLenum internalFormat, int priority);
+        void pushReadJob(StreamedTexture *texture, GLint level);
+        void readLoop(void);
+        void uploadLoop(void);
+        void readHeader(StreamedTexture *texture);
+        void readLevel(StreamedTexture *texture, GLint level, unsigned int sequence);
+        void uploadLevel(UploadJob &job, StagingBuffer &staging);
+        void makeResident(const Completion &completion);
+        std::string getFilename(const StreamedTexture *texture, GLint level) const;
+    };
+}
+
+#endif /* GLES_VERSION == 3 */
+#endif /* TEXTURESTREAMER_H */
@@ -0,0 +1,91 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MaliSDK
+{
+    /**
+     * \brief A fork-join pool of worker threads for data-parallel CPU work.
+     *
+     * Workers are created once and sleep until parallelFor() hands them work,
+     * so a pool can be reused every frame without the cost of creating threads.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * \brief Creates the worker threads.
+         * \param[in] numberOfThreads Total number of threads taking part in parallelFor(), including the caller.
+         *                            0 uses one thread per CPU core.
+         */
+        explicit ThreadPool(unsigned int numberOfThreads = 0);
+
+        /**
+         * \brief Stops and joins the worker threads.
+         */
+        ~ThreadPool();
+
+        /**
+         * \brief Calls function(begin, end) over [0, count) split into chunks, and blocks until all chunks are done.
+         *
+         * The calling thread processes chunks as well. function must not throw,
+         * and must not call parallelFor() on the same pool.
+         * \param[in] count Number of work items.
+         * \param[in] function Called with half-open ranges of work items.
+         * \param[in] minimumChunk Lower bound on the number of work items per call to function.
+         */
+        void parallelFor(unsigned int count, const std::function<void (unsigned int, unsigned int)>& function, unsigned int minimumChunk = 1);
+
+        /**
+         * \brief Returns the number of threads taking part in parallelFor(), including the caller.
+         */
+        unsigned int getNumberOfThreads() const { return (unsigned int)workers.size() + 1; }
+
+    private:
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable workCondition;
+        std::condition_variable doneCondition;
+
+        const std::function<void (unsigned int, unsigned int)>* job;
+        unsigned int jobCount;
+        unsigned int jobChunk;
+        std::atomic<unsigned int> jobNext;
+        unsigned int generation;
+        unsigned int activeWorkers;
+        bool shutdown;
+
+        void workerLoop();
+        void runChunks();
+    };
+}
+#endif /* THREADPOOL_H */
@@ -0,0 +1,250 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CounterRandom.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define COUNTER_RANDOM_USE_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COUNTER_RANDOM_USE_SSE
+#endif
+
+namespace MaliSDK
+{
+    namespace
+    {
+        /* Philox4x32 multipliers and Weyl sequence constants for the key schedule. */
+        const unsigned int philoxMultiplier0 = 0xD2511F53u;
+        const unsigned int philoxMultiplier1 = 0xCD9E8D57u;
+        const unsigned int philoxWeyl0 = 0x9E3779B9u;
+        const unsigned int philoxWeyl1 = 0xBB67AE85u;
+        const unsigned int philoxRounds = 10;
+
+        void philox(const unsigned int *key, unsigned int *counter)
+        {
+            unsigned int key0 = key[0];
+            unsigned int key1 = key[1];
+
+            for (unsigned int round = 0; round < philoxRounds; round++)
+            {
+                unsigned long long product0 = (unsigned long long)philoxMultiplier0 * counter[0];
+                unsigned long long product1 = (unsigned long long)philoxMultiplier1 * counter[2];
+
+                unsigned int result0 = (unsigned int)(product1 >> 32) ^ counter[1] ^ key0;
+                unsigned int result2 = (unsigned int)(product0 >> 32) ^ counter[3] ^ key1;
+                counter[0] = result0;
+                counter[1] = (unsigned int)product1;
+                counter[2] = result2;
+                counter[3] = (unsigned int)product0;
+
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+        }
+
+#if defined(COUNTER_RANDOM_USE_NEON)
+        /* Full 32x32 -> 64 bit products of four lanes, split into their low and high halves. */
+        inline void multiply(uint32x4_t a, uint32_t b, uint32x4_t& low, uint32x4_t& high)
+        {
+            uint64x2_t productLow = vmull_n_u32(vget_low_u32(a), b);
+            uint64x2_t productHigh = vmull_n_u32(vget_high_u32(a), b);
+            low = vcombine_u32(vmovn_u64(productLow), vmovn_u64(productHigh));
+            high = vcombine_u32(vshrn_n_u64(productLow, 32), vshrn_n_u64(productHigh, 32));
+        }
+
+        /* Runs Philox on four counters held in structure-of-arrays layout, and stores the results interleaved. */
+        inline void philox4(const unsigned int *key, uint32x4_t counter0, uint32x4_t counter1, uint32x4_t counter2, uint32x4_t counter3, unsigned int *output)
+        {
+            unsigned int key0 = key[0];
+            unsigned int key1 = key[1];
+
+            for (unsigned int round = 0; round < philoxRounds; round++)
+            {
+                uint32x4_t low0, high0, low1, high1;
+                multiply(counter0, philoxMultiplier0, low0, high0);
+                multiply(counter2, philoxMultiplier1, low1, high1);
+
+                counter0 = veorq_u32(veorq_u32(high1, counter1), vdupq_n_u32(key0));
+                counter1 = low1;
+                counter2 = veorq_u32(veorq_u32(high0, counter3), vdupq_n_u32(key1));
+                counter3 = low0;
+
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+
+            uint32x4x4_t result = { { counter0, counter1, counter2, counter3 } };
+            vst4q_u32(output, result);
+        }
+#elif defined(COUNTER_RANDOM_USE_SSE)
+        /* Full 32x32 -> 64 bit products of four lanes, split into their low and high halves. */
+        inline void multiply(__m128i a, __m128i b, __m128i& low, __m128i& high)
+        {
+            __m128i productEven = _mm_mul_epu32(a, b);
+            __m128i productOdd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+            low = _mm_unpacklo_epi32(_mm_shuffle_epi32(productEven, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(productOdd, _MM_SHUFFLE(3, 1, 2, 0)));
+            high = _mm_unpacklo_epi32(_mm_shuffle_epi32(productEven, _MM_SHUFFLE(2, 0, 3, 1)), _mm_shuffle_epi32(productOdd, _MM_SHUFFLE(2, 0, 3, 1)));
+        }
+
+        /* Runs Philox on four counters held in structure-of-arrays layout, and stores the results interleaved. */
+        inline void philox4(const unsigned int *key, __m128i counter0, __m128i counter1, __m128i counter2, __m128i counter3, unsigned int *output)
+        {
+            const __m128i multiplier0 = _mm_set1_epi32((int)philoxMultiplier0);
+            const __m128i multiplier1 = _mm_set1_epi32((int)philoxMultiplier1);
+            unsigned int key0 = key[0];
+            unsigned int key1 = key[1];
+
+            for (unsigned int round = 0; round < philoxRounds; round++)
+            {
+                __m128i low0, high0, low1, high1;
+                multiply(counter0, multiplier0, low0, high0);
+                multiply(counter2, multiplier1, low1, high1);
+
+                counter0 = _mm_xor_si128(_mm_xor_si128(high1, counter1), _mm_set1_epi32((int)key0));
+                counter1 = low1;
+                counter2 = _mm_xor_si128(_mm_xor_si128(high0, counter3), _mm_set1_epi32((int)key1));
+                counter3 = low0;
+
+                key0 += philoxWeyl0;
+                key1 += philoxWeyl1;
+            }
+
+            /* Transpose so that the four values of each counter are stored together. */
+            __m128i t0 = _mm_unpacklo_epi32(counter0, counter1);
+            __m128i t1 = _mm_unpacklo_epi32(counter2, counter3);
+            __m128i t2 = _mm_unpackhi_epi32(counter0, counter1);
+            __m128i t3 = _mm_unpackhi_epi32(counter2, counter3);
+            _mm_storeu_si128((__m128i*)(output + 0), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(output + 4), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(output + 8), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i*)(output + 12), _mm_unpackhi_epi64(t2, t3));
+        }
+#endif
+    }
+
+    CounterRandom::CounterRandom(unsigned long long seed)
+    {
+        key[0] = (unsigned int)seed;
+        key[1] = (unsigned int)(seed >> 32);
+    }
+
+    void CounterRandom::generate(unsigned long long index, unsigned int stream, unsigned int *output) const
+    {
+        output[0] = (unsigned int)index;
+        output[1] = (unsigned int)(index >> 32);
+        output[2] = stream;
+        output[3] = 0;
+        philox(key, output);
+    }
+
+    unsigned int CounterRandom::generateUint(unsigned long long index, unsigned int stream) const
+    {
+        unsigned int values[4];
+        generate(index, stream, values);
+        return values[0];
+    }
+
+    float CounterRandom::generateFloat(unsigned long long index, unsigned int stream) const
+    {
+        return toFloat(generateUint(index, stream));
+    }
+
+    void CounterRandom::generateBatch(unsigned long long firstIndex, unsigned int stream, unsigned int count, unsigned int *output) const
+    {
+        unsigned int i = 0;
+
+#if defined(COUNTER_RANDOM_USE_NEON)
+        static const uint32_t laneOffsets[4] = { 0, 1, 2, 3 };
+        const uint32x4_t offsets = vld1q_u32(laneOffsets);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned long long index = firstIndex + i;
+            /* The four indices only share their high word if the low word does not wrap around. */
+            if ((unsigned int)index > 0xFFFFFFFCu)
+            {
+                break;
+            }
+
+            uint32x4_t counter0 = vaddq_u32(vdupq_n_u32((unsigned int)index), offsets);
+            philox4(key, counter0, vdupq_n_u32((unsigned int)(index >> 32)), vdupq_n_u32(stream), vdupq_n_u32(0), output + 4 * i);
+        }
+#elif defined(COUNTER_RANDOM_USE_SSE)
+        const __m128i offsets = _mm_setr_epi32(0, 1, 2, 3);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned long long index = firstIndex + i;
+            /* The four indices only share their high word if the low word does not wrap around. */
+            if ((unsigned int)index > 0xFFFFFFFCu)
+            {
+                break;
+            }
+
+            __m128i counter0 = _mm_add_epi32(_mm_set1_epi32((int)(unsigned int)index), offsets);
+            philox4(key, counter0, _mm_set1_epi32((int)(unsigned int)(index >> 32)), _mm_set1_epi32((int)stream), _mm_setzero_si128(), output + 4 * i);
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            generate(firstIndex + i, stream, output + 4 * i);
+        }
+    }
+
+    void CounterRandom::generateFloatBatch(unsigned long long firstIndex, unsigned int stream, unsigned int count, float *output) const
+    {
+        /* Generate a block at a time into a small buffer which stays in the cache, then convert it. */
+        const unsigned int blockSize = 64;
+        unsigned int values[4 * blockSize];
+
+        for (unsigned int first = 0; first < count; first += blockSize)
+        {
+            unsigned int blockCount = count - first < blockSize ? count - first : blockSize;
+            unsigned int valueCount = 4 * blockCount;
+            float *blockOutput = output + 4 * first;
+            generateBatch(firstIndex + first, stream, blockCount, values);
+
+            unsigned int i = 0;
+#if defined(COUNTER_RANDOM_USE_NEON)
+            const float32x4_t scale = vdupq_n_f32(1.0f / 16777216.0f);
+            for (; i < valueCount; i += 4)
+            {
+                uint32x4_t value = vshrq_n_u32(vld1q_u32(values + i), 8);
+                vst1q_f32(blockOutput + i, vmulq_f32(vcvtq_f32_u32(value), scale));
+            }
+#elif defined(COUNTER_RANDOM_USE_SSE)
+            const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+            for (; i < valueCount; i += 4)
+            {
+                /* After the shift the values fit in a signed integer, so the signed conversion is exact. */
+                __m128i value = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(values + i)), 8);
+                _mm_storeu_ps(blockOutput + i, _mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+            }
+#endif
+            for (; i < valueCount; i++)
+            {
+                blockOutput[i] = toFloat(values[i]);
+            }
+        }
+    }
+}
@@ -27,7 +27,7 @@ namespace MaliSDK
     
     }
 
-    ETCHeader::ETCHeader(unsigned char *data)
+    ETCHeader::ETCHeader(const unsigned char *data)
     {
         /*
          * Load from a ETC compressed pkm image file. 
@@ -0,0 +1,451 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "FrustumCulling.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CULLING_USE_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_USE_SSE
+#endif
+
+namespace MaliSDK
+{
+    void BoundingSphereArray::clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius.clear();
+    }
+
+    void BoundingSphereArray::reserve(unsigned int count)
+    {
+        x.reserve(count);
+        y.reserve(count);
+        z.reserve(count);
+        radius.reserve(count);
+    }
+
+    void BoundingSphereArray::push(float centerX, float centerY, float centerZ, float sphereRadius)
+    {
+        x.push_back(centerX);
+        y.push_back(centerY);
+        z.push_back(centerZ);
+        radius.push_back(sphereRadius);
+    }
+
+    void BoundingBoxArray::clear()
+    {
+        minX.clear();
+        minY.clear();
+        minZ.clear();
+        maxX.clear();
+        maxY.clear();
+        maxZ.clear();
+    }
+
+    void BoundingBoxArray::reserve(unsigned int count)
+    {
+        minX.reserve(count);
+        minY.reserve(count);
+        minZ.reserve(count);
+        maxX.reserve(count);
+        maxY.reserve(count);
+        maxZ.reserve(count);
+    }
+
+    void BoundingBoxArray::push(float minimumX, float minimumY, float minimumZ, float maximumX, float maximumY, float maximumZ)
+    {
+        minX.push_back(minimumX);
+        minY.push_back(minimumY);
+        minZ.push_back(minimumZ);
+        maxX.push_back(maximumX);
+        maxY.push_back(maximumY);
+        maxZ.push_back(maximumZ);
+    }
+
+    FrustumCuller::FrustumCuller()
+    {
+        /* Planes which everything is on the inside of. */
+        memset(planes, 0, sizeof(planes));
+        for (int plane = 0; plane < NUMBER_OF_PLANES; plane++)
+        {
+            planes[plane][3] = 1.0f;
+        }
+    }
+
+    void FrustumCuller::setViewProjection(const float *viewProjection)
+    {
+        /*
+         * A clip space position c is inside the frustum when -c.w <= c.x, c.y, c.z <= c.w.
+         * With c = M * p, each of these is a plane equation built from two rows of M.
+         */
+        float rows[4][4];
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                rows[row][column] = viewProjection[column * 4 + row];
+            }
+        }
+
+        for (int plane = 0; plane < NUMBER_OF_PLANES; plane++)
+        {
+            const float *axis = rows[plane / 2];
+            const float sign = (plane & 1) ? -1.0f : 1.0f;
+
+            for (int component = 0; component < 4; component++)
+            {
+                planes[plane][component] = rows[3][component] + sign * axis[component];
+            }
+
+            float length = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1] + planes[plane][2] * planes[plane][2]);
+            if (length > 0.0f)
+            {
+                for (int component = 0; component < 4; component++)
+                {
+                    planes[plane][component] /= length;
+                }
+            }
+        }
+    }
+
+    void FrustumCuller::setPlanes(const float *newPlanes)
+    {
+        memcpy(planes, newPlanes, sizeof(planes));
+    }
+
+    unsigned int FrustumCuller::cullSpheres(const BoundingSphereArray& spheres, unsigned int *visible) const
+    {
+        if (spheres.size() == 0)
+        {
+            return 0;
+        }
+
+        return cullSpheres(&spheres.x[0], &spheres.y[0], &spheres.z[0], &spheres.radius[0], spheres.size(), visible);
+    }
+
+    unsigned int FrustumCuller::cullBoxes(const BoundingBoxArray& boxes, unsigned int *visible) const
+    {
+        if (boxes.size() == 0)
+        {
+            return 0;
+        }
+
+        return cullBoxes(&boxes.minX[0], &boxes.minY[0], &boxes.minZ[0], &boxes.maxX[0], &boxes.maxY[0], &boxes.maxZ[0], boxes.size(), visible);
+    }
+
+    /*
+     * Appends base + lane for every set bit of mask.
+     * Every lane is stored unconditionally and the count only advances for visible lanes,
+     * which avoids unpredictable branches. Stores never go past the final count.
+     */
+    static inline unsigned int appendVisible(unsigned int *visible, unsigned int count, unsigned int mask, unsigned int base)
+    {
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            visible[count] = base + lane;
+            count += (mask >> lane) & 1;
+        }
+
+        return count;
+    }
+
+#if defined(CULLING_USE_NEON)
+    static inline unsigned int moveMask(uint32x4_t mask)
+    {
+        static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+        uint32x4_t bits = vandq_u32(mask, vld1q_u32(laneBits));
+        uint32x2_t halves = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+        return vget_lane_u32(vpadd_u32(halves, halves), 0);
+    }
+
+    /* Distance of four points to a plane, with the plane given as four broadcast vectors. */
+    static inline float32x4_t planeDistance(const float32x4_t *plane, float32x4_t x, float32x4_t y, float32x4_t z)
+    {
+        float32x4_t distance = vmlaq_f32(plane[3], plane[0], x);
+        distance = vmlaq_f32(distance, plane[1], y);
+        return vmlaq_f32(distance, plane[2], z);
+    }
+#elif defined(CULLING_USE_SSE)
+    static inline __m128 planeDistance(const __m128 *plane, __m128 x, __m128 y, __m128 z)
+    {
+        __m128 distance = _mm_add_ps(plane[3], _mm_mul_ps(plane[0], x));
+        distance = _mm_add_ps(distance, _mm_mul_ps(plane[1], y));
+        return _mm_add_ps(distance, _mm_mul_ps(plane[2], z));
+    }
+#endif
+
+    unsigned int FrustumCuller::cullSpheres(const float *x, const float *y, const float *z, const float *radius,
+                                            unsigned int numberOfSpheres, unsigned int *visible) const
+    {
+        unsigned int count = 0;
+        unsigned int sphere = 0;
+
+#if defined(CULLING_USE_NEON)
+        float32x4_t plane[NUMBER_OF_PLANES][4];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                plane[p][component] = vdupq_n_f32(planes[p][component]);
+            }
+        }
+
+        for (; sphere + 8 <= numberOfSpheres; sphere += 8)
+        {
+            float32x4_t x0 = vld1q_f32(x + sphere), x1 = vld1q_f32(x + sphere + 4);
+            float32x4_t y0 = vld1q_f32(y + sphere), y1 = vld1q_f32(y + sphere + 4);
+            float32x4_t z0 = vld1q_f32(z + sphere), z1 = vld1q_f32(z + sphere + 4);
+            float32x4_t negativeRadius0 = vnegq_f32(vld1q_f32(radius + sphere));
+            float32x4_t negativeRadius1 = vnegq_f32(vld1q_f32(radius + sphere + 4));
+            uint32x4_t inside0 = vdupq_n_u32(~0u);
+            uint32x4_t inside1 = vdupq_n_u32(~0u);
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                inside0 = vandq_u32(inside0, vcgeq_f32(planeDistance(plane[p], x0, y0, z0), negativeRadius0));
+                inside1 = vandq_u32(inside1, vcgeq_f32(planeDistance(plane[p], x1, y1, z1), negativeRadius1));
+            }
+
+            count = appendVisible(visible, count, moveMask(inside0), sphere);
+            count = appendVisible(visible, count, moveMask(inside1), sphere + 4);
+        }
+#elif defined(CULLING_USE_SSE)
+        __m128 plane[NUMBER_OF_PLANES][4];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                plane[p][component] = _mm_set1_ps(planes[p][component]);
+            }
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        for (; sphere + 8 <= numberOfSpheres; sphere += 8)
+        {
+            __m128 x0 = _mm_loadu_ps(x + sphere), x1 = _mm_loadu_ps(x + sphere + 4);
+            __m128 y0 = _mm_loadu_ps(y + sphere), y1 = _mm_loadu_ps(y + sphere + 4);
+            __m128 z0 = _mm_loadu_ps(z + sphere), z1 = _mm_loadu_ps(z + sphere + 4);
+            __m128 negativeRadius0 = _mm_sub_ps(zero, _mm_loadu_ps(radius + sphere));
+            __m128 negativeRadius1 = _mm_sub_ps(zero, _mm_loadu_ps(radius + sphere + 4));
+            __m128 inside0 = _mm_cmpeq_ps(zero, zero);
+            __m128 inside1 = inside0;
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(planeDistance(plane[p], x0, y0, z0), negativeRadius0));
+                inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(planeDistance(plane[p], x1, y1, z1), negativeRadius1));
+            }
+
+            count = appendVisible(visible, count, (unsigned int)_mm_movemask_ps(inside0), sphere);
+            count = appendVisible(visible, count, (unsigned int)_mm_movemask_ps(inside1), sphere + 4);
+        }
+#endif
+
+        for (; sphere < numberOfSpheres; sphere++)
+        {
+            bool inside = true;
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                float distance = planes[p][3] + planes[p][0] * x[sphere] + planes[p][1] * y[sphere] + planes[p][2] * z[sphere];
+                inside = inside && distance >= -radius[sphere];
+            }
+
+            visible[count] = sphere;
+            count += inside ? 1 : 0;
+        }
+
+        return count;
+    }
+
+    void FrustumCuller::cullSphereRow(float startX, float stepX, float y, float z, float radius,
+                                      unsigned int numberOfSpheres, unsigned char *visible) const
+    {
+        /* Y and Z are the same for the whole row, so each plane reduces to a * x + offset >= 0. */
+        float offsets[NUMBER_OF_PLANES];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            offsets[p] = planes[p][1] * y + planes[p][2] * z + planes[p][3] + radius;
+        }
+
+        unsigned int sphere = 0;
+
+#if defined(CULLING_USE_NEON)
+        static const float laneOffsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        const float32x4_t lanes = vld1q_f32(laneOffsets);
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+
+        for (; sphere + 4 <= numberOfSpheres; sphere += 4)
+        {
+            float32x4_t x = vmlaq_n_f32(vdupq_n_f32(startX), vaddq_f32(vdupq_n_f32(float(sphere)), lanes), stepX);
+            uint32x4_t inside = vdupq_n_u32(~0u);
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(offsets[p]), x, planes[p][0]), zero));
+            }
+
+            unsigned int mask = moveMask(inside);
+            for (unsigned int lane = 0; lane < 4; lane++)
+            {
+                visible[sphere + lane] = (mask >> lane) & 1;
+            }
+        }
+#elif defined(CULLING_USE_SSE)
+        const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; sphere + 4 <= numberOfSpheres; sphere += 4)
+        {
+            __m128 x = _mm_add_ps(_mm_set1_ps(startX), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(sphere)), lanes), _mm_set1_ps(stepX)));
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p][0])), _mm_set1_ps(offsets[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+            }
+
+            unsigned int mask = (unsigned int)_mm_movemask_ps(inside);
+            for (unsigned int lane = 0; lane < 4; lane++)
+            {
+                visible[sphere + lane] = (mask >> lane) & 1;
+            }
+        }
+#endif
+
+        for (; sphere < numberOfSpheres; sphere++)
+        {
+            float x = startX + float(sphere) * stepX;
+            bool inside = true;
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                inside = inside && planes[p][0] * x + offsets[p] >= 0.0f;
+            }
+
+            visible[sphere] = inside ? 1 : 0;
+        }
+    }
+
+    unsigned int FrustumCuller::cullBoxes(const float *minX, const float *minY, const float *minZ,
+                                          const float *maxX, const float *maxY, const float *maxZ,
+                                          unsigned int numberOfBoxes, unsigned int *visible) const
+    {
+        //! [Select box corners]
+        /*
+         * A box is outside a plane if its corner furthest along the plane normal is.
+         * That corner picks max or min on each axis depending on the sign of the normal,
+         * which is the same for all boxes, so it is just a choice of input arrays per plane.
+         */
+        const float *cornerX[NUMBER_OF_PLANES];
+        const float *cornerY[NUMBER_OF_PLANES];
+        const float *cornerZ[NUMBER_OF_PLANES];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            cornerX[p] = planes[p][0] >= 0.0f ? maxX : minX;
+            cornerY[p] = planes[p][1] >= 0.0f ? maxY : minY;
+            cornerZ[p] = planes[p][2] >= 0.0f ? maxZ : minZ;
+        }
+        //! [Select box corners]
+
+        unsigned int count = 0;
+        unsigned int box = 0;
+
+#if defined(CULLING_USE_NEON)
+        float32x4_t plane[NUMBER_OF_PLANES][4];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                plane[p][component] = vdupq_n_f32(planes[p][component]);
+            }
+        }
+
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        for (; box + 8 <= numberOfBoxes; box += 8)
+        {
+            uint32x4_t inside0 = vdupq_n_u32(~0u);
+            uint32x4_t inside1 = vdupq_n_u32(~0u);
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                float32x4_t distance0 = planeDistance(plane[p], vld1q_f32(cornerX[p] + box), vld1q_f32(cornerY[p] + box), vld1q_f32(cornerZ[p] + box));
+                float32x4_t distance1 = planeDistance(plane[p], vld1q_f32(cornerX[p] + box + 4), vld1q_f32(cornerY[p] + box + 4), vld1q_f32(cornerZ[p] + box + 4));
+                inside0 = vandq_u32(inside0, vcgeq_f32(distance0, zero));
+                inside1 = vandq_u32(inside1, vcgeq_f32(distance1, zero));
+            }
+
+            count = appendVisible(visible, count, moveMask(inside0), box);
+            count = appendVisible(visible, count, moveMask(inside1), box + 4);
+        }
+#elif defined(CULLING_USE_SSE)
+        __m128 plane[NUMBER_OF_PLANES][4];
+        for (int p = 0; p < NUMBER_OF_PLANES; p++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                plane[p][component] = _mm_set1_ps(planes[p][component]);
+            }
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        for (; box + 8 <= numberOfBoxes; box += 8)
+        {
+            __m128 inside0 = _mm_cmpeq_ps(zero, zero);
+            __m128 inside1 = inside0;
+
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                __m128 distance0 = planeDistance(plane[p], _mm_loadu_ps(cornerX[p] + box), _mm_loadu_ps(cornerY[p] + box), _mm_loadu_ps(cornerZ[p] + box));
+                __m128 distance1 = planeDistance(plane[p], _mm_loadu_ps(cornerX[p] + box + 4), _mm_loadu_ps(cornerY[p] + box + 4), _mm_loadu_ps(cornerZ[p] + box + 4));
+                inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(distance0, zero));
+                inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(distance1, zero));
+            }
+
+            count = appendVisible(visible, count, (unsigned int)_mm_movemask_ps(inside0), box);
+            count = appendVisible(visible, count, (unsigned int)_mm_movemask_ps(inside1), box + 4);
+        }
+#endif
+
+        //! [Test for intersection]
+        for (; box < numberOfBoxes; box++)
+        {
+            bool inside = true;
+            for (int p = 0; p < NUMBER_OF_PLANES; p++)
+            {
+                float distance = planes[p][3] + planes[p][0] * cornerX[p][box] + planes[p][1] * cornerY[p][box] + planes[p][2] * cornerZ[p][box];
+                inside = inside && distance >= 0.0f;
+            }
+
+            visible[count] = box;
+            count += inside ? 1 : 0;
+        }
+        //! [Test for intersection]
+
+        return count;
+    }
+}
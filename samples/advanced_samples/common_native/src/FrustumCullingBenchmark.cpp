@@ -0,0 +1,165 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "FrustumCullingBenchmark.h"
+
+#include "FrustumCulling.h"
+#include "Matrix.h"
+#include "Platform.h"
+#include "Timer.h"
+#include "VectorTypes.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace MaliSDK
+{
+    static float randomRange(float minimum, float maximum)
+    {
+        return minimum + (maximum - minimum) * ((float)rand() / RAND_MAX);
+    }
+
+    /* One object at a time, the way the samples tested their bounding volumes before. */
+    static unsigned int cullSpheresScalar(const FrustumCuller& culler, const BoundingSphereArray& spheres, unsigned int *visible)
+    {
+        unsigned int count = 0;
+        for (unsigned int sphere = 0; sphere < spheres.size(); sphere++)
+        {
+            bool inside = true;
+            for (unsigned int p = 0; p < FrustumCuller::NUMBER_OF_PLANES && inside; p++)
+            {
+                const float *plane = culler.getPlane(p);
+                inside = plane[0] * spheres.x[sphere] + plane[1] * spheres.y[sphere] + plane[2] * spheres.z[sphere] + plane[3] >= -spheres.radius[sphere];
+            }
+
+            if (inside)
+            {
+                visible[count++] = sphere;
+            }
+        }
+
+        return count;
+    }
+
+    static unsigned int cullBoxesScalar(const FrustumCuller& culler, const BoundingBoxArray& boxes, unsigned int *visible)
+    {
+        unsigned int count = 0;
+        for (unsigned int box = 0; box < boxes.size(); box++)
+        {
+            bool inside = true;
+            for (unsigned int p = 0; p < FrustumCuller::NUMBER_OF_PLANES && inside; p++)
+            {
+                const float *plane = culler.getPlane(p);
+                bool anyCornerInside = false;
+                for (unsigned int corner = 0; corner < 8 && !anyCornerInside; corner++)
+                {
+                    float x = (corner & 1) ? boxes.maxX[box] : boxes.minX[box];
+                    float y = (corner & 2) ? boxes.maxY[box] : boxes.minY[box];
+                    float z = (corner & 4) ? boxes.maxZ[box] : boxes.minZ[box];
+                    anyCornerInside = plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0.0f;
+                }
+                inside = anyCornerInside;
+            }
+
+            if (inside)
+            {
+                visible[count++] = box;
+            }
+        }
+
+        return count;
+    }
+
+    void FrustumCullingBenchmark::run(int numberOfObjects, int iterations)
+    {
+        if (numberOfObjects <= 0 || iterations <= 0)
+        {
+            return;
+        }
+
+        BoundingSphereArray spheres;
+        BoundingBoxArray boxes;
+        spheres.reserve(numberOfObjects);
+        boxes.reserve(numberOfObjects);
+
+        for (int object = 0; object < numberOfObjects; object++)
+        {
+            float x = randomRange(-500.0f, 500.0f);
+            float y = randomRange(-50.0f, 50.0f);
+            float z = randomRange(-500.0f, 500.0f);
+            float size = randomRange(0.5f, 5.0f);
+
+            spheres.push(x, y, z, size);
+            boxes.push(x - size, y - size, z - size, x + size, y + size, z + size);
+        }
+
+        /* Camera in the middle of the objects looking down -Z, which keeps a good part of them. */
+        Matrix projection = Matrix::matrixPerspective(90.0f, 16.0f / 9.0f, 1.0f, 1000.0f);
+        Vec3f eye = { 0.0f, 10.0f, 0.0f };
+        Vec3f center = { 0.0f, 0.0f, -100.0f };
+        Vec3f up = { 0.0f, 1.0f, 0.0f };
+        Matrix view = Matrix::matrixCameraLookAt(eye, center, up);
+        Matrix viewProjection = projection * view;
+
+        FrustumCuller culler;
+        culler.setViewProjection(viewProjection.getAsArray());
+
+        std::vector<unsigned int> visible(numberOfObjects);
+        Timer timer;
+        unsigned int visibleScalar = 0;
+        unsigned int visibleBatched = 0;
+
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            visibleScalar = cullSpheresScalar(culler, spheres, &visible[0]);
+        }
+        const float timeScalarSpheres = timer.getTime();
+
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            visibleBatched = culler.cullSpheres(spheres, &visible[0]);
+        }
+        const float timeBatchedSpheres = timer.getTime();
+
+        LOGI("FrustumCullingBenchmark: %d objects x %d iterations, spheres visible %u / %u\n", numberOfObjects, iterations, visibleScalar, visibleBatched);
+        LOGI("FrustumCullingBenchmark: spheres per-object %.3f ms, batched %.3f ms per cull (%.2fx)\n",
+             timeScalarSpheres * 1000.0f / iterations, timeBatchedSpheres * 1000.0f / iterations, timeScalarSpheres / timeBatchedSpheres);
+
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            visibleScalar = cullBoxesScalar(culler, boxes, &visible[0]);
+        }
+        const float timeScalarBoxes = timer.getTime();
+
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            visibleBatched = culler.cullBoxes(boxes, &visible[0]);
+        }
+        const float timeBatchedBoxes = timer.getTime();
+
+        LOGI("FrustumCullingBenchmark: boxes visible %u / %u\n", visibleScalar, visibleBatched);
+        LOGI("FrustumCullingBenchmark: boxes per-object %.3f ms, batched %.3f ms per cull (%.2fx)\n",
+             timeScalarBoxes * 1000.0f / iterations, timeBatchedBoxes * 1000.0f / iterations, timeScalarBoxes / timeBatchedBoxes);
+    }
+}
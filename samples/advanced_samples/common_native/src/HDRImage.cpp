@@ -18,6 +18,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
@@ -25,6 +26,7 @@
 #include <string>
 
 #include "HDRImage.h"
+#include "MappedFile.h"
 #include "Platform.h"
 
 using std::string;
@@ -94,45 +96,56 @@ namespace MaliSDK
 
     void HDRImage::loadFromFile(const std::string& filePath)
     {
-        FILE* file;
+        /* The file is decoded straight from the mapping, without reading it into a buffer first. */
+        MappedFile file;
 
-        file = fopen(filePath.c_str(), "rb");
-
-        if (file == NULL)
+        if (!file.open(filePath.c_str()))
         {
             LOGE("Could not open file %s", filePath.c_str());
             return;
         }
 
+        const unsigned char* cursor = file.getData();
+        const unsigned char* end = cursor + file.getSize();
+
         /* Read header. */
-        char header[radianceHeaderLength];
+        if (file.getSize() < radianceHeaderLength)
+        {
+            LOGE("File header has not been recognized.\n");
+            return;
+        }
 
-        fread(header, 1, radianceHeaderLength, file);
-        header[radianceHeaderLength - 1] = 0;
-        string readHeader = header;
+        string readHeader(cursor, cursor + radianceHeaderLength - 1);
 
         if (!readHeader.compare(radianceHeader))
         {
             LOGE("File header has not been recognized.\n");
-            fclose(file);
             return;
         }
 
-        /* Search for resolution data. */
-        char currentChar  = 0;
-        char previousChar = 0;
+        /* Search for resolution data, which follows the first empty line. */
+        cursor += std::min<size_t>(radianceHeaderLength + 2, file.getSize());
+
+        while (cursor < end && (cursor[-1] != '\n' || cursor[-2] != '\n'))
+        {
+            ++cursor;
+        }
+
+        /* The resolution line is not null-terminated in the mapping, copy it out for sscanf. */
+        const unsigned char* lineEnd = cursor;
 
-        while ((previousChar != '\n' || currentChar != '\n') && currentChar != EOF)
+        while (lineEnd < end && *lineEnd != '\n')
         {
-            previousChar = currentChar;
-            currentChar = fgetc(file);
+            ++lineEnd;
         }
 
+        string resolution(cursor, lineEnd);
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+
         int imageWidth = 0;
         int imageHeight = 0;
 
-        fscanf(file, "-Y %d ", &imageHeight);
-        fscanf(file, "+X %d ", &imageWidth);
+        sscanf(resolution.c_str(), "-Y %d +X %d", &imageHeight, &imageWidth);
 
         if (imageWidth < minLineLength || imageWidth > maxLineLength)
         {
@@ -158,12 +171,11 @@ namespace MaliSDK
 
         for (int y = 0; y < imageHeight; ++y)
         {
-            if (!decodeLine(file, imageWidth, scanLine))
+            if (!decodeLine(cursor, end, imageWidth, scanLine))
             {
                 LOGE("One of the scan lines has not been encoded correctly.\n");
 
                 delete [] scanLine;
-                fclose(file);
 
                 return;
             }
@@ -176,8 +188,6 @@ namespace MaliSDK
         }
 
         delete [] scanLine;
-
-        fclose(file);
     }
 
     inline void HDRImage::convertRGBEPixel(const RGBEPixel& pixel, float* rgbData)
@@ -197,12 +207,19 @@ namespace MaliSDK
         return floatValue * multiplier;
     }
 
-    bool HDRImage::decodeLine(FILE* file, int lineLength, RGBEPixel* scanLine)
+    bool HDRImage::decodeLine(const unsigned char*& cursor, const unsigned char* end, int lineLength, RGBEPixel* scanLine)
     {
         /* Check if line beginning is correct. */
-        char startLineChar1 = fgetc(file);
-        char startLineChar2 = fgetc(file);
-        char startLineChar3 = fgetc(file);
+        if (end - cursor < 4)
+        {
+            LOGE("Error occured while encoding HDR data. Unexpected end of file.");
+
+            return false;
+        }
+
+        char startLineChar1 = cursor[0];
+        char startLineChar2 = cursor[1];
+        char startLineChar3 = cursor[2];
 
         if (startLineChar1 != startOfText || startLineChar2 != startOfText || startLineChar3 & 0x80)
         {
@@ -211,8 +228,8 @@ namespace MaliSDK
             return false;
         }
 
-        /* Move file position indicator by one character. */
-        fgetc(file);
+        /* Skip the line beginning and the character after it. */
+        cursor += 4;
 
         for (int componentIndex = 0; componentIndex < rgbeComponentsCount; ++componentIndex)
         {
@@ -220,8 +237,15 @@ namespace MaliSDK
 
             while (pixelIndex < lineLength)
             {
+                if (cursor >= end)
+                {
+                    LOGE("Error occured while encoding HDR data. Unexpected end of file.");
+
+                    return false;
+                }
+
                 /* Code for RLE compression algorithm. */
-                unsigned char rleCode = fgetc(file);
+                unsigned char rleCode = *cursor++;
 
                 if (rleCode > MAXCHAR + 1)
                 {
@@ -229,10 +253,17 @@ namespace MaliSDK
                      * Read code indicates how many pixels are written with the same value,
                      *.so it is read only once.
                      */
-                    unsigned char value = fgetc(file);
-
                     rleCode &= MAXCHAR;
 
+                    if (cursor >= end || pixelIndex + rleCode > lineLength)
+                    {
+                        LOGE("Error occured while encoding HDR data. Run exceeds the scan line.");
+
+                        return false;
+                    }
+
+                    unsigned char value = *cursor++;
+
                     while (rleCode--)
                     {
                         writeDecodedComponent(componentIndex, value, &scanLine[pixelIndex++]);
@@ -240,13 +271,20 @@ namespace MaliSDK
                 }
                 else
                 {
+                    if (end - cursor < rleCode || pixelIndex + rleCode > lineLength)
+                    {
+                        LOGE("Error occured while encoding HDR data. Run exceeds the scan line.");
+
+                        return false;
+                    }
+
                     while (rleCode--)
                     {
                         /* 
                          * Read code indicates how many pixels are written next to each other,
                          * so their value must be read each time this loop is executed.
                          */
-                        unsigned char value = fgetc(file);
+                        unsigned char value = *cursor++;
 
                         writeDecodedComponent(componentIndex, value, &scanLine[pixelIndex++]);
                     }
@@ -0,0 +1,156 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MappedFile.h"
+#include "Platform.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MaliSDK
+{
+    MappedFile::MappedFile(void)
+        : data(NULL), size(0), opened(false), copied(false)
+    {
+    }
+
+    MappedFile::MappedFile(const char *filename)
+        : data(NULL), size(0), opened(false), copied(false)
+    {
+        if (!open(filename))
+        {
+            exit(1);
+        }
+    }
+
+    MappedFile::~MappedFile(void)
+    {
+        close();
+    }
+
+#if defined(_WIN32)
+    bool MappedFile::open(const char *filename)
+    {
+        close();
+
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL)
+        {
+            LOGE("Failed to open '%s'\n", filename);
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        size_t length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        unsigned char *buffer = new (std::nothrow) unsigned char[length > 0 ? length : 1];
+        if (buffer == NULL || fread(buffer, 1, length, file) != length)
+        {
+            LOGE("Failed to read in '%s'\n", filename);
+            delete[] buffer;
+            fclose(file);
+            return false;
+        }
+        fclose(file);
+
+        data = buffer;
+        size = length;
+        opened = true;
+        copied = true;
+        return true;
+    }
+#else
+    bool MappedFile::open(const char *filename)
+    {
+        close();
+
+        int descriptor = ::open(filename, O_RDONLY);
+        if (descriptor < 0)
+        {
+            LOGE("Failed to open '%s'\n", filename);
+            return false;
+        }
+
+        struct stat status;
+        if (fstat(descriptor, &status) != 0)
+        {
+            LOGE("Failed to get the size of '%s'\n", filename);
+            ::close(descriptor);
+            return false;
+        }
+
+        /* mmap() rejects empty mappings, an empty file simply has no data. */
+        size_t length = status.st_size;
+        if (length > 0)
+        {
+            void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping == MAP_FAILED)
+            {
+                LOGE("Failed to map '%s'\n", filename);
+                ::close(descriptor);
+                return false;
+            }
+
+            /* Files are read front to back, let the kernel start reading ahead straight away. */
+            madvise(mapping, length, MADV_WILLNEED);
+            data = (const unsigned char *)mapping;
+        }
+
+        /* The mapping stays valid after the descriptor is closed. */
+        ::close(descriptor);
+
+        size = length;
+        opened = true;
+        copied = false;
+        return true;
+    }
+#endif
+
+    void MappedFile::close(void)
+    {
+        if (data != NULL)
+        {
+            if (copied)
+            {
+                delete[] data;
+            }
+#if !defined(_WIN32)
+            else
+            {
+                munmap((void *)data, size);
+            }
+#endif
+        }
+
+        data = NULL;
+        size = 0;
+        opened = false;
+        copied = false;
+    }
+}
@@ -28,8 +28,198 @@
 #include <cstdio>
 #include <cstdlib>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MATRIX_USE_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATRIX_USE_SSE
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATRIX_USE_AVX
+#endif
+#endif
+
 namespace MaliSDK
 {
+    /*
+     * Batched transform kernels.
+     *
+     * All kernels read a whole vertex before writing the corresponding result,
+     * so input and output are allowed to be the same array.
+     * The matrix is column major, so transforming a vertex is a sum of the four
+     * columns scaled by the vertex components.
+     */
+
+    /* Transform numberOfVertices tightly packed 4D vectors. */
+    static void transformVec4Array(const float *input, float *output, int numberOfVertices, const float *matrix)
+    {
+        int vertex = 0;
+
+#if defined(MATRIX_USE_NEON)
+        const float32x4_t column0 = vld1q_f32(matrix +  0);
+        const float32x4_t column1 = vld1q_f32(matrix +  4);
+        const float32x4_t column2 = vld1q_f32(matrix +  8);
+        const float32x4_t column3 = vld1q_f32(matrix + 12);
+
+        for (; vertex < numberOfVertices; vertex++)
+        {
+            const float32x4_t value = vld1q_f32(input + 4 * vertex);
+            const float32x2_t low = vget_low_f32(value);
+            const float32x2_t high = vget_high_f32(value);
+
+            float32x4_t result = vmulq_lane_f32(column0, low, 0);
+            result = vmlaq_lane_f32(result, column1, low, 1);
+            result = vmlaq_lane_f32(result, column2, high, 0);
+            result = vmlaq_lane_f32(result, column3, high, 1);
+
+            vst1q_f32(output + 4 * vertex, result);
+        }
+#elif defined(MATRIX_USE_SSE)
+        const __m128 column0 = _mm_loadu_ps(matrix +  0);
+        const __m128 column1 = _mm_loadu_ps(matrix +  4);
+        const __m128 column2 = _mm_loadu_ps(matrix +  8);
+        const __m128 column3 = _mm_loadu_ps(matrix + 12);
+
+#if defined(MATRIX_USE_AVX)
+        /* Two vertices per iteration, each 128-bit lane holds one vertex. */
+        const __m256 wideColumn0 = _mm256_insertf128_ps(_mm256_castps128_ps256(column0), column0, 1);
+        const __m256 wideColumn1 = _mm256_insertf128_ps(_mm256_castps128_ps256(column1), column1, 1);
+        const __m256 wideColumn2 = _mm256_insertf128_ps(_mm256_castps128_ps256(column2), column2, 1);
+        const __m256 wideColumn3 = _mm256_insertf128_ps(_mm256_castps128_ps256(column3), column3, 1);
+
+        for (; vertex + 2 <= numberOfVertices; vertex += 2)
+        {
+            const __m256 value = _mm256_loadu_ps(input + 4 * vertex);
+
+            __m256 result = _mm256_mul_ps(wideColumn0, _mm256_permute_ps(value, 0x00));
+            result = _mm256_add_ps(result, _mm256_mul_ps(wideColumn1, _mm256_permute_ps(value, 0x55)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(wideColumn2, _mm256_permute_ps(value, 0xaa)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(wideColumn3, _mm256_permute_ps(value, 0xff)));
+
+            _mm256_storeu_ps(output + 4 * vertex, result);
+        }
+#endif
+
+        for (; vertex < numberOfVertices; vertex++)
+        {
+            const __m128 value = _mm_loadu_ps(input + 4 * vertex);
+
+            __m128 result = _mm_mul_ps(column0, _mm_shuffle_ps(value, value, 0x00));
+            result = _mm_add_ps(result, _mm_mul_ps(column1, _mm_shuffle_ps(value, value, 0x55)));
+            result = _mm_add_ps(result, _mm_mul_ps(column2, _mm_shuffle_ps(value, value, 0xaa)));
+            result = _mm_add_ps(result, _mm_mul_ps(column3, _mm_shuffle_ps(value, value, 0xff)));
+
+            _mm_storeu_ps(output + 4 * vertex, result);
+        }
+#endif
+
+        for (; vertex < numberOfVertices; vertex++)
+        {
+            const float x = input[4 * vertex + 0];
+            const float y = input[4 * vertex + 1];
+            const float z = input[4 * vertex + 2];
+            const float w = input[4 * vertex + 3];
+
+            output[4 * vertex + 0] = x * matrix[0] + y * matrix[4] + z * matrix[ 8] + w * matrix[12];
+            output[4 * vertex + 1] = x * matrix[1] + y * matrix[5] + z * matrix[ 9] + w * matrix[13];
+            output[4 * vertex + 2] = x * matrix[2] + y * matrix[6] + z * matrix[10] + w * matrix[14];
+            output[4 * vertex + 3] = x * matrix[3] + y * matrix[7] + z * matrix[11] + w * matrix[15];
+        }
+    }
+
+    /*
+     * Transform numberOfVertices tightly packed 3D vectors with an implicit w component.
+     * w is 1.0f for positions and 0.0f for directions.
+     * The SIMD paths work on blocks of four vectors (12 floats) which are transposed
+     * to structure-of-arrays form, so no lane is wasted on the missing w component.
+     */
+    static void transformVec3Array(const float *input, float *output, int numberOfVertices, const float *matrix, float w)
+    {
+        int vertex = 0;
+
+#if defined(MATRIX_USE_NEON)
+        const float32x4_t translationX = vdupq_n_f32(matrix[12] * w);
+        const float32x4_t translationY = vdupq_n_f32(matrix[13] * w);
+        const float32x4_t translationZ = vdupq_n_f32(matrix[14] * w);
+
+        for (; vertex + 4 <= numberOfVertices; vertex += 4)
+        {
+            /* vld3q/vst3q (de)interleave the xyz triplets for us. */
+            const float32x4x3_t value = vld3q_f32(input + 3 * vertex);
+            float32x4x3_t result;
+
+            result.val[0] = vmlaq_n_f32(translationX, value.val[0], matrix[0]);
+            result.val[0] = vmlaq_n_f32(result.val[0], value.val[1], matrix[4]);
+            result.val[0] = vmlaq_n_f32(result.val[0], value.val[2], matrix[8]);
+
+            result.val[1] = vmlaq_n_f32(translationY, value.val[0], matrix[1]);
+            result.val[1] = vmlaq_n_f32(result.val[1], value.val[1], matrix[5]);
+            result.val[1] = vmlaq_n_f32(result.val[1], value.val[2], matrix[9]);
+
+            result.val[2] = vmlaq_n_f32(translationZ, value.val[0], matrix[2]);
+            result.val[2] = vmlaq_n_f32(result.val[2], value.val[1], matrix[6]);
+            result.val[2] = vmlaq_n_f32(result.val[2], value.val[2], matrix[10]);
+
+            vst3q_f32(output + 3 * vertex, result);
+        }
+#elif defined(MATRIX_USE_SSE)
+        const __m128 m0  = _mm_set1_ps(matrix[ 0]);
+        const __m128 m1  = _mm_set1_ps(matrix[ 1]);
+        const __m128 m2  = _mm_set1_ps(matrix[ 2]);
+        const __m128 m4  = _mm_set1_ps(matrix[ 4]);
+        const __m128 m5  = _mm_set1_ps(matrix[ 5]);
+        const __m128 m6  = _mm_set1_ps(matrix[ 6]);
+        const __m128 m8  = _mm_set1_ps(matrix[ 8]);
+        const __m128 m9  = _mm_set1_ps(matrix[ 9]);
+        const __m128 m10 = _mm_set1_ps(matrix[10]);
+        const __m128 translationX = _mm_set1_ps(matrix[12] * w);
+        const __m128 translationY = _mm_set1_ps(matrix[13] * w);
+        const __m128 translationZ = _mm_set1_ps(matrix[14] * w);
+
+        for (; vertex + 4 <= numberOfVertices; vertex += 4)
+        {
+            /* a = (x0 y0 z0 x1), b = (y1 z1 x2 y2), c = (z2 x3 y3 z3) */
+            const __m128 a = _mm_loadu_ps(input + 3 * vertex + 0);
+            const __m128 b = _mm_loadu_ps(input + 3 * vertex + 4);
+            const __m128 c = _mm_loadu_ps(input + 3 * vertex + 8);
+
+            const __m128 xy23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+            const __m128 yz01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+            const __m128 x = _mm_shuffle_ps(a, xy23, _MM_SHUFFLE(2, 0, 3, 0));
+            const __m128 y = _mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(3, 1, 2, 0));
+            const __m128 z = _mm_shuffle_ps(yz01, c, _MM_SHUFFLE(3, 0, 3, 1));
+
+            const __m128 resultX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m0), _mm_mul_ps(y, m4)), _mm_add_ps(_mm_mul_ps(z, m8), translationX));
+            const __m128 resultY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m1), _mm_mul_ps(y, m5)), _mm_add_ps(_mm_mul_ps(z, m9), translationY));
+            const __m128 resultZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m2), _mm_mul_ps(y, m6)), _mm_add_ps(_mm_mul_ps(z, m10), translationZ));
+
+            /* Interleave back to (x0 y0 z0 x1), (y1 z1 x2 y2), (z2 x3 y3 z3). */
+            const __m128 xy01 = _mm_shuffle_ps(resultX, resultY, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m128 xy23Result = _mm_shuffle_ps(resultX, resultY, _MM_SHUFFLE(3, 2, 3, 2));
+            const __m128 zx01 = _mm_shuffle_ps(resultZ, resultX, _MM_SHUFFLE(1, 1, 0, 0));
+            const __m128 yz11 = _mm_shuffle_ps(resultY, resultZ, _MM_SHUFFLE(1, 1, 1, 1));
+            const __m128 zx23 = _mm_shuffle_ps(resultZ, resultX, _MM_SHUFFLE(3, 3, 2, 2));
+            const __m128 yz33 = _mm_shuffle_ps(resultY, resultZ, _MM_SHUFFLE(3, 3, 3, 3));
+
+            _mm_storeu_ps(output + 3 * vertex + 0, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(output + 3 * vertex + 4, _mm_shuffle_ps(yz11, xy23Result, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(output + 3 * vertex + 8, _mm_shuffle_ps(zx23, yz33, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+#endif
+
+        for (; vertex < numberOfVertices; vertex++)
+        {
+            const float x = input[3 * vertex + 0];
+            const float y = input[3 * vertex + 1];
+            const float z = input[3 * vertex + 2];
+
+            output[3 * vertex + 0] = x * matrix[0] + y * matrix[4] + z * matrix[ 8] + w * matrix[12];
+            output[3 * vertex + 1] = x * matrix[1] + y * matrix[5] + z * matrix[ 9] + w * matrix[13];
+            output[3 * vertex + 2] = x * matrix[2] + y * matrix[6] + z * matrix[10] + w * matrix[14];
+        }
+    }
+
     /* Identity matrix. */
     const float identityArray[16] =
     {
@@ -60,7 +250,7 @@ namespace MaliSDK
         return elements[element]; 
     }
 
-    Matrix Matrix::operator* (Matrix right)
+    Matrix Matrix::operator* (const Matrix &right)
     {
         return multiply(this, &right);
     }
@@ -532,26 +722,12 @@ namespace MaliSDK
         return result;
     }
 
-    Matrix Matrix::multiply(Matrix *left, Matrix *right)
+    Matrix Matrix::multiply(const Matrix *left, const Matrix *right)
     {
         Matrix result;
 
-        for(int row = 0; row < 4; row ++)
-        {
-            for(int column = 0; column < 4; column ++)
-            {
-                /*result.elements[row * 4 + column]  = left->elements[0 + row * 4] * right->elements[column + 0 * 4];
-                result.elements[row * 4 + column] += left->elements[1 + row * 4] * right->elements[column + 1 * 4];
-                result.elements[row * 4 + column] += left->elements[2 + row * 4] * right->elements[column + 2 * 4];
-                result.elements[row * 4 + column] += left->elements[3 + row * 4] * right->elements[column + 3 * 4];*/
-                float accumulator = 0.0f;
-                for(int allElements = 0; allElements < 4; allElements ++)
-                {
-                    accumulator += left->elements[allElements * 4 + row] * right->elements[column * 4 + allElements];
-                }
-                result.elements[column * 4 + row] = accumulator;
-            }
-        }
+        /* Each column of the result is left multiplied by the matching column of right. */
+        transformVec4Array(right->elements, result.elements, 4, left->elements);
 
         return result;
     }
@@ -611,6 +787,21 @@ namespace MaliSDK
         return result;
     }
 
+    void Matrix::vertexTransform(const Vec4f *vertices, Vec4f *results, int numberOfVertices, const Matrix *matrix)
+    {
+        transformVec4Array(reinterpret_cast<const float*>(vertices), reinterpret_cast<float*>(results), numberOfVertices, matrix->elements);
+    }
+
+    void Matrix::vertexTransform(const Vec3f *vertices, Vec3f *results, int numberOfVertices, const Matrix *matrix)
+    {
+        transformVec3Array(reinterpret_cast<const float*>(vertices), reinterpret_cast<float*>(results), numberOfVertices, matrix->elements, 1.0f);
+    }
+
+    void Matrix::normalTransform(const Vec3f *normals, Vec3f *results, int numberOfNormals, const Matrix *matrix)
+    {
+        transformVec3Array(reinterpret_cast<const float*>(normals), reinterpret_cast<float*>(results), numberOfNormals, matrix->elements, 0.0f);
+    }
+
     void Matrix::print(void)
     {
         LOGI("\n");
@@ -0,0 +1,168 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MatrixBenchmark.h"
+
+#include "Matrix.h"
+#include "Platform.h"
+#include "Timer.h"
+#include "VectorTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace MaliSDK
+{
+    /*
+     * Largest difference allowed between the batched and the per-vertex path.
+     * The SIMD paths may fuse or reorder the multiply-adds, which changes the last bits of the result.
+     */
+    static const float tolerance = 1e-5f;
+
+    /* Compares the first count floats of each element, relative to the magnitude of the per-vertex result. */
+    template <typename T>
+    static bool compare(const char *name, const std::vector<T>& reference, const std::vector<T>& batched, int count)
+    {
+        for (size_t vertex = 0; vertex < reference.size(); vertex++)
+        {
+            const float* expected = reinterpret_cast<const float*>(&reference[vertex]);
+            const float* actual = reinterpret_cast<const float*>(&batched[vertex]);
+
+            for (int component = 0; component < count; component++)
+            {
+                if (fabsf(actual[component] - expected[component]) > tolerance * std::max(1.0f, fabsf(expected[component])))
+                {
+                    LOGE("MatrixBenchmark: %s batched result differs at vertex %d component %d: %f, expected %f\n",
+                         name, (int)vertex, component, actual[component], expected[component]);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool MatrixBenchmark::run(int numberOfVertices, int iterations)
+    {
+        if (numberOfVertices <= 0 || iterations <= 0)
+        {
+            return true;
+        }
+
+        std::vector<Vec4f> input4(numberOfVertices);
+        std::vector<Vec4f> reference4(numberOfVertices);
+        std::vector<Vec4f> output4(numberOfVertices);
+        std::vector<Vec3f> input3(numberOfVertices);
+        std::vector<Vec3f> reference3(numberOfVertices);
+        std::vector<Vec3f> output3(numberOfVertices);
+        std::vector<Vec3f> referenceNormals(numberOfVertices);
+        std::vector<Vec3f> outputNormals(numberOfVertices);
+
+        for (int vertex = 0; vertex < numberOfVertices; vertex++)
+        {
+            Vec4f value4 = { (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, 1.0f };
+            Vec3f value3 = { value4.x, value4.y, value4.z };
+
+            input4[vertex] = value4;
+            input3[vertex] = value3;
+        }
+
+        Matrix transform = Matrix::createRotationY(30.0f) * Matrix::createTranslation(1.0f, 2.0f, 3.0f) * Matrix::createScaling(2.0f, 2.0f, 2.0f);
+        Timer timer;
+
+        /* Vec4f: per-vertex path. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            for (int vertex = 0; vertex < numberOfVertices; vertex++)
+            {
+                reference4[vertex] = Matrix::vertexTransform(&input4[vertex], &transform);
+            }
+        }
+        const float timeScalar4 = timer.getTime();
+
+        /* Vec4f: batched path. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            Matrix::vertexTransform(&input4[0], &output4[0], numberOfVertices, &transform);
+        }
+        const float timeBatched4 = timer.getTime();
+
+        /* Vec3f: per-vertex path. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            for (int vertex = 0; vertex < numberOfVertices; vertex++)
+            {
+                reference3[vertex] = Matrix::vertexTransform(&input3[vertex], &transform);
+            }
+        }
+        const float timeScalar3 = timer.getTime();
+
+        /* Vec3f: batched path. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            Matrix::vertexTransform(&input3[0], &output3[0], numberOfVertices, &transform);
+        }
+        const float timeBatched3 = timer.getTime();
+
+        /* Normals: per-vertex path, a 4D transform with w = 0. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            for (int vertex = 0; vertex < numberOfVertices; vertex++)
+            {
+                Vec4f normal = { input3[vertex].x, input3[vertex].y, input3[vertex].z, 0.0f };
+                Vec4f result = Matrix::vertexTransform(&normal, &transform);
+                Vec3f result3 = { result.x, result.y, result.z };
+                referenceNormals[vertex] = result3;
+            }
+        }
+        const float timeScalarNormals = timer.getTime();
+
+        /* Normals: batched path. */
+        timer.reset();
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            Matrix::normalTransform(&input3[0], &outputNormals[0], numberOfVertices, &transform);
+        }
+        const float timeBatchedNormals = timer.getTime();
+
+        const float vertexCount = (float)numberOfVertices * iterations;
+
+        LOGI("MatrixBenchmark: %d vertices x %d iterations\n", numberOfVertices, iterations);
+        LOGI("MatrixBenchmark: Vec4f per-vertex %.3f ms, batched %.3f ms (%.1f Mverts/s, %.2fx)\n",
+             timeScalar4 * 1000.0f, timeBatched4 * 1000.0f, vertexCount / (timeBatched4 * 1e6f), timeScalar4 / timeBatched4);
+        LOGI("MatrixBenchmark: Vec3f per-vertex %.3f ms, batched %.3f ms (%.1f Mverts/s, %.2fx)\n",
+             timeScalar3 * 1000.0f, timeBatched3 * 1000.0f, vertexCount / (timeBatched3 * 1e6f), timeScalar3 / timeBatched3);
+        LOGI("MatrixBenchmark: normals per-vertex %.3f ms, batched %.3f ms (%.1f Mverts/s, %.2fx)\n",
+             timeScalarNormals * 1000.0f, timeBatchedNormals * 1000.0f, vertexCount / (timeBatchedNormals * 1e6f), timeScalarNormals / timeBatchedNormals);
+
+        /* Comparing the results also keeps the compiler from discarding the transforms. */
+        bool matches = compare("Vec4f", reference4, output4, 4);
+        matches = compare("Vec3f", reference3, output3, 3) && matches;
+        matches = compare("Normal", referenceNormals, outputNormals, 3) && matches;
+        return matches;
+    }
+}
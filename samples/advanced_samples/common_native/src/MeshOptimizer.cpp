@@ -0,0 +1,384 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MeshOptimizer.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace MaliSDK
+{
+    const unsigned short MeshOptimizer::restartIndex;
+
+    VertexCacheStatistics MeshOptimizer::simulateVertexCache(const unsigned short *indices, unsigned int numberOfIndices,
+                                                             bool triangleStrip, unsigned int cacheSize)
+    {
+        VertexCacheStatistics statistics;
+        statistics.triangles = 0;
+        statistics.transformedVertices = 0;
+        statistics.uniqueVertices = 0;
+
+        /* Ring buffer of the cached indices, oldest entry at cacheHead. */
+        std::vector<int> cache(cacheSize, -1);
+        unsigned int cacheHead = 0;
+        std::vector<bool> seen;
+
+        unsigned int stripLength = 0;
+        for (unsigned int i = 0; i < numberOfIndices; i++)
+        {
+            unsigned short index = indices[i];
+            if (triangleStrip && index == restartIndex)
+            {
+                stripLength = 0;
+                continue;
+            }
+
+            if (std::find(cache.begin(), cache.end(), int(index)) == cache.end())
+            {
+                cache[cacheHead] = index;
+                cacheHead = (cacheHead + 1) % cacheSize;
+                statistics.transformedVertices++;
+            }
+
+            if (index >= seen.size())
+            {
+                seen.resize(index + 1, false);
+            }
+            if (!seen[index])
+            {
+                seen[index] = true;
+                statistics.uniqueVertices++;
+            }
+
+            if (triangleStrip)
+            {
+                if (++stripLength >= 3)
+                {
+                    unsigned short a = indices[i - 2];
+                    unsigned short b = indices[i - 1];
+                    if (a != b && b != index && a != index)
+                    {
+                        statistics.triangles++;
+                    }
+                }
+            }
+            else if (i % 3 == 2)
+            {
+                statistics.triangles++;
+            }
+        }
+
+        statistics.acmr = statistics.triangles ? float(statistics.transformedVertices) / statistics.triangles : 0.0f;
+        statistics.atvr = statistics.uniqueVertices ? float(statistics.transformedVertices) / statistics.uniqueVertices : 0.0f;
+        return statistics;
+    }
+
+    void MeshOptimizer::convertStripToList(const unsigned short *strip, unsigned int numberOfIndices, std::vector<unsigned short>& triangles)
+    {
+        unsigned int stripLength = 0;
+        for (unsigned int i = 0; i < numberOfIndices; i++)
+        {
+            if (strip[i] == restartIndex)
+            {
+                stripLength = 0;
+                continue;
+            }
+
+            if (++stripLength < 3)
+            {
+                continue;
+            }
+
+            unsigned short a = strip[i - 2];
+            unsigned short b = strip[i - 1];
+            unsigned short c = strip[i];
+            if (a == b || b == c || a == c)
+            {
+                continue;
+            }
+
+            /* Every other triangle in a strip has reversed winding. */
+            if (stripLength & 1)
+            {
+                triangles.push_back(a);
+                triangles.push_back(b);
+            }
+            else
+            {
+                triangles.push_back(b);
+                triangles.push_back(a);
+            }
+            triangles.push_back(c);
+        }
+    }
+
+    /* Scoring as described in "Linear-Speed Vertex Cache Optimisation" by Tom Forsyth. */
+    static const int forsythCacheSize = 32;
+    static const float forsythCacheDecayPower = 1.5f;
+    static const float forsythLastTriangleScore = 0.75f;
+    static const float forsythValenceBoostScale = 2.0f;
+    static const float forsythValenceBoostPower = 0.5f;
+
+    static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+        {
+            /* Not used by any more triangles, so it does not matter. */
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                /*
+                 * Used by the last triangle. Give it a fixed score so a triangle
+                 * which shares an edge with it is not always preferred over one which shares a vertex.
+                 */
+                score = forsythLastTriangleScore;
+            }
+            else
+            {
+                float scale = 1.0f / (forsythCacheSize - 3);
+                score = powf(1.0f - (cachePosition - 3) * scale, forsythCacheDecayPower);
+            }
+        }
+
+        /* Boost vertices with few triangles left, so lone triangles do not get left behind. */
+        score += forsythValenceBoostScale * powf(float(remainingTriangles), -forsythValenceBoostPower);
+        return score;
+    }
+
+    void MeshOptimizer::optimizeVertexCache(std::vector<unsigned short>& triangles)
+    {
+        unsigned int numberOfTriangles = (unsigned int)triangles.size() / 3;
+        if (numberOfTriangles == 0)
+        {
+            return;
+        }
+
+        unsigned int numberOfVertices = *std::max_element(triangles.begin(), triangles.end()) + 1;
+
+        /* Triangles using each vertex, in compressed row layout. */
+        std::vector<unsigned int> vertexTriangleStart(numberOfVertices + 1, 0);
+        for (unsigned int i = 0; i < numberOfTriangles * 3; i++)
+        {
+            vertexTriangleStart[triangles[i] + 1]++;
+        }
+        for (unsigned int v = 0; v < numberOfVertices; v++)
+        {
+            vertexTriangleStart[v + 1] += vertexTriangleStart[v];
+        }
+
+        std::vector<unsigned int> vertexTriangles(numberOfTriangles * 3);
+        std::vector<unsigned int> remainingTriangles(numberOfVertices, 0);
+        for (unsigned int t = 0; t < numberOfTriangles; t++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = triangles[t * 3 + corner];
+                vertexTriangles[vertexTriangleStart[v] + remainingTriangles[v]++] = t;
+            }
+        }
+
+        std::vector<int> cachePosition(numberOfVertices, -1);
+        std::vector<float> vertexScore(numberOfVertices);
+        for (unsigned int v = 0; v < numberOfVertices; v++)
+        {
+            vertexScore[v] = forsythVertexScore(-1, remainingTriangles[v]);
+        }
+
+        std::vector<float> triangleScore(numberOfTriangles);
+        std::vector<bool> triangleAdded(numberOfTriangles, false);
+        for (unsigned int t = 0; t < numberOfTriangles; t++)
+        {
+            triangleScore[t] = vertexScore[triangles[t * 3]] + vertexScore[triangles[t * 3 + 1]] + vertexScore[triangles[t * 3 + 2]];
+        }
+
+        std::vector<unsigned short> output;
+        output.reserve(triangles.size());
+
+        /* Simulated LRU cache, with room for the three vertices of the new triangle on top. */
+        std::vector<unsigned int> cache;
+        std::vector<unsigned int> newCache;
+        cache.reserve(forsythCacheSize + 3);
+        newCache.reserve(forsythCacheSize + 3);
+
+        unsigned int scanPosition = 0;
+        int bestTriangle = -1;
+
+        for (unsigned int emitted = 0; emitted < numberOfTriangles; emitted++)
+        {
+            if (bestTriangle < 0)
+            {
+                /* Nothing in the cache is useful, start over with the best remaining triangle. */
+                float bestScore = -1.0f;
+                while (triangleAdded[scanPosition])
+                {
+                    scanPosition++;
+                }
+                for (unsigned int t = scanPosition; t < numberOfTriangles; t++)
+                {
+                    if (!triangleAdded[t] && triangleScore[t] > bestScore)
+                    {
+                        bestScore = triangleScore[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+
+            const unsigned short *triangle = &triangles[bestTriangle * 3];
+            output.insert(output.end(), triangle, triangle + 3);
+            triangleAdded[bestTriangle] = true;
+
+            /* Remove the triangle from the triangle lists of its vertices. */
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = triangle[corner];
+                unsigned int *begin = &vertexTriangles[vertexTriangleStart[v]];
+                unsigned int *end = begin + remainingTriangles[v];
+                *std::find(begin, end, (unsigned int)bestTriangle) = end[-1];
+                remainingTriangles[v]--;
+            }
+
+            /* Move the vertices of the triangle to the front of the cache. */
+            newCache.assign(triangle, triangle + 3);
+            for (unsigned int i = 0; i < cache.size(); i++)
+            {
+                unsigned int v = cache[i];
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                {
+                    newCache.push_back(v);
+                }
+            }
+            cache.swap(newCache);
+
+            for (unsigned int i = 0; i < cache.size(); i++)
+            {
+                unsigned int v = cache[i];
+                cachePosition[v] = i < (unsigned int)forsythCacheSize ? int(i) : -1;
+                vertexScore[v] = forsythVertexScore(cachePosition[v], remainingTriangles[v]);
+            }
+
+            /* Rescore the triangles touching the cache and pick the best for the next step. */
+            bestTriangle = -1;
+            float bestScore = -1.0f;
+            for (unsigned int i = 0; i < cache.size(); i++)
+            {
+                unsigned int v = cache[i];
+                for (unsigned int j = 0; j < remainingTriangles[v]; j++)
+                {
+                    unsigned int t = vertexTriangles[vertexTriangleStart[v] + j];
+                    float score = vertexScore[triangles[t * 3]] + vertexScore[triangles[t * 3 + 1]] + vertexScore[triangles[t * 3 + 2]];
+                    triangleScore[t] = score;
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        bestTriangle = t;
+                    }
+                }
+            }
+
+            /* Vertices which fell out of the cache stay in the list for one step so their score is updated above. */
+            if (cache.size() > (unsigned int)forsythCacheSize)
+            {
+                cache.resize(forsythCacheSize);
+            }
+        }
+
+        triangles.swap(output);
+    }
+
+    void MeshOptimizer::generateGridStrips(unsigned int width, unsigned int height, unsigned int stride, unsigned int firstVertex,
+                                           unsigned int bandWidth, bool alternateDiagonals, std::vector<unsigned short>& indices)
+    {
+        bool first = true;
+
+        /* Neighbouring bands share a column of vertices. */
+        for (unsigned int bandStart = 0; bandStart + 1 < width; bandStart += bandWidth - 1)
+        {
+            unsigned int columns = std::min(bandWidth, width - bandStart);
+
+            for (unsigned int z = 0; z + 1 < height; z++)
+            {
+                if (!first)
+                {
+                    indices.push_back(restartIndex);
+                }
+                first = false;
+
+                unsigned int position = firstVertex + z * stride + bandStart;
+                if (alternateDiagonals && (z & 1))
+                {
+                    /*
+                     * Zig-zag starting with the lower row to get the other diagonal.
+                     * The repeated first index keeps the winding the same as for the other rows.
+                     */
+                    indices.push_back(position + stride);
+                    for (unsigned int x = 0; x < columns; x++)
+                    {
+                        indices.push_back(position + x + stride);
+                        indices.push_back(position + x);
+                    }
+                }
+                else
+                {
+                    /* Zig-zag between the two rows: down, then up and one to the right. */
+                    for (unsigned int x = 0; x < columns; x++)
+                    {
+                        indices.push_back(position + x);
+                        indices.push_back(position + x + stride);
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned int MeshOptimizer::findGridBandWidth(unsigned int width, unsigned int height, bool alternateDiagonals, unsigned int cacheSize)
+    {
+        unsigned int bestBandWidth = width;
+        float bestAcmr = 0.0f;
+        std::vector<unsigned short> indices;
+
+        for (unsigned int bandWidth = width; bandWidth >= 2; bandWidth--)
+        {
+            indices.clear();
+            generateGridStrips(width, height, width, 0, bandWidth, alternateDiagonals, indices);
+
+            float acmr = simulateVertexCache(&indices[0], (unsigned int)indices.size(), true, cacheSize).acmr;
+            if (bandWidth == width || acmr < bestAcmr)
+            {
+                bestAcmr = acmr;
+                bestBandWidth = bandWidth;
+            }
+        }
+
+        return bestBandWidth;
+    }
+
+    void MeshOptimizer::logReport(const char *name, const VertexCacheStatistics& before, const VertexCacheStatistics& after)
+    {
+        LOGI("%s: %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertex shader invocations %u -> %u\n",
+             name, before.triangles, before.acmr, after.acmr, before.atvr, after.atvr,
+             before.transformedVertices, after.transformedVertices);
+    }
+}
@@ -19,6 +19,7 @@
  */
 
 #include "Shader.h"
+#include "MappedFile.h"
 #include "Platform.h"
 
 #include <cstdio>
@@ -29,14 +30,19 @@ namespace MaliSDK
     void Shader::processShader(GLuint *shader, const char *filename, GLint shaderType)
     {  
         const char *strings[1] = { NULL };
+        GLint lengths[1] = { 0 };
 
         /* Create shader and load into GL. */
         *shader = GL_CHECK(glCreateShader(shaderType));
-        strings[0] = loadShader(filename);
-        GL_CHECK(glShaderSource(*shader, 1, strings, NULL));
 
-        /* Clean up shader source. */
-        free((void *)(strings[0]));
+        /* The mapped source is not null-terminated, so pass its length explicitly. */
+        MappedFile file(filename);
+        strings[0] = file.getSize() > 0 ? (const char *)file.getData() : "";
+        lengths[0] = (GLint)file.getSize();
+        GL_CHECK(glShaderSource(*shader, 1, strings, lengths));
+
+        /* OpenGL ES has its own copy of the source now. */
+        file.close();
         strings[0] = NULL;
 
         /* Try compiling the shader. */
@@ -69,37 +75,4 @@ namespace MaliSDK
             exit(1);
         }
     }
-
-    char* Shader::loadShader(const char *filename)
-    {
-        FILE *file = fopen(filename, "rb");
-        if(file == NULL)
-        {
-            LOGE("Cannot read file '%s'\n", filename);
-            exit(1);
-        }
-        /* Seek end of file. */
-        fseek(file, 0, SEEK_END);
-        /* Record the size of the file for memory allocation. */
-        long length = ftell(file);
-        /* Seek start of file again. */
-        fseek(file, 0, SEEK_SET); 
-        char *shader = (char *)calloc(length + 1, sizeof(char));
-        if(shader == NULL)
-        {
-            LOGE("Out of memory at %s:%i\n", __FILE__, __LINE__);
-            exit(1);
-        }
-        /* Read in the file */
-        size_t numberOfBytesRead = fread(shader, sizeof(char), length, file);
-        if (numberOfBytesRead != length) 
-        {
-            LOGE("Error reading %s (read %d of %ld)", filename, numberOfBytesRead, length);
-            exit(1);
-        }
-        shader[length] = '\0';
-        fclose(file);
-
-        return shader;
-    }
 }
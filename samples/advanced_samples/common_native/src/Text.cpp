@@ -129,12 +129,11 @@ namespace MaliSDK
         GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 
         string texture = resourceDirectory + textureFilename;
-        unsigned char *textureData = NULL;
-        Texture::loadData(texture.c_str(), &textureData);
+        MappedFile textureFile;
+        Texture::loadData(texture.c_str(), textureFile);
 
-        GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 48, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData));
-        free(textureData);
-        textureData = NULL;
+        GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 48, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureFile.getData()));
+        textureFile.close();
 
         LOGD("Text initialization done.\n");
     }
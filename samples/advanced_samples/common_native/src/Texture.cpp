@@ -19,6 +19,7 @@
  */
 
 #include "Texture.h"
+#include "CounterRandom.h"
 #include "ETCHeader.h"
 #include "Platform.h"
 
@@ -109,17 +110,28 @@ namespace MaliSDK
             exit(1);
         }
 
-        /* Initialize texture with random shades. */
-        for(unsigned int allTexels = 0; allTexels < width * height; allTexels ++)
+        /*
+         * Initialize texture with random shades. Every texel gets the four values of its own index
+         * from a counter-based generator, generated a block of texels at a time.
+         */
+        const CounterRandom random;
+        const unsigned int blockSize = 256;
+        unsigned int randomValues[4 * blockSize];
+        for(unsigned int firstTexel = 0; firstTexel < width * height; firstTexel += blockSize)
         {
-            /* Use 255 (fully opaque) for the alpha value */
-            randomTexture[allTexels * 4 + 3] = 255;
-            /* Set each colour component (Red, Green, Blue) of the texel to a different random number. */
-            for (int allChannels = 0; allChannels < 3; allChannels++)
+            unsigned int blockTexels = width * height - firstTexel < blockSize ? width * height - firstTexel : blockSize;
+            random.generateBatch(firstTexel, 0, blockTexels, randomValues);
+
+            for (unsigned int texel = 0; texel < blockTexels; texel++)
             {
-                /* Generate a random number between 0 and 255 */
-                int randomNumber = (int)(255 * (rand() / (float)RAND_MAX));
-                randomTexture[allTexels * 4 + allChannels] = randomNumber;
+                unsigned char *texelData = randomTexture + (firstTexel + texel) * 4;
+                /* Set each colour component (Red, Green, Blue) of the texel to a different random number between 0 and 255. */
+                for (int allChannels = 0; allChannels < 3; allChannels++)
+                {
+                    texelData[allChannels] = (unsigned char)(randomValues[texel * 4 + allChannels] >> 24);
+                }
+                /* Use 255 (fully opaque) for the alpha value */
+                texelData[3] = 255;
             }
         }
 
@@ -168,34 +180,36 @@ namespace MaliSDK
     {
         LOGD("Texture loadData started for %s...\n", filename);
 
-        FILE *file = fopen(filename, "rb");
-        if(file == NULL)
-        {
-            LOGE("Failed to open '%s'\n", filename);
-            exit(1);
-        }
-        fseek(file, 0, SEEK_END);
-        unsigned int length = ftell(file);
-        unsigned char *loadedTexture = (unsigned char *)calloc(length, sizeof(unsigned char));
+        /* Copy out of a mapping rather than reading into a zeroed buffer, the caller owns the copy. */
+        MappedFile file(filename);
+        unsigned char *loadedTexture = (unsigned char *)malloc(file.getSize() > 0 ? file.getSize() : 1);
         if(loadedTexture == NULL)
         {
             LOGE("Out of memory at %s:%i\n", __FILE__, __LINE__);
             exit(1);
         }
-        fseek(file, 0, SEEK_SET);
-        size_t read = fread(loadedTexture, sizeof(unsigned char), length, file);
-        if(read != length)
+        if (file.getSize() > 0)
         {
-            LOGE("Failed to read in '%s'\n", filename);
-            exit(1);
+            memcpy(loadedTexture, file.getData(), file.getSize());
         }
-        fclose(file);
 
         *textureData = loadedTexture;
 
         LOGD("Texture loadData for %s done.\n", filename);
     }
 
+    void Texture::loadData(const char *filename, MappedFile& file)
+    {
+        LOGD("Texture loadData started for %s...\n", filename);
+
+        if (!file.open(filename))
+        {
+            exit(1);
+        }
+
+        LOGD("Texture loadData for %s done.\n", filename);
+    }
+
     void Texture::loadPKMData(const char *filename, ETCHeader* etcHeader, unsigned char **textureData)
     {
         /* PKM file consists of a header with information about image (stored in 16 first bits) and image data. */
@@ -229,6 +243,32 @@ namespace MaliSDK
         }
     }
 
+    void Texture::loadPKMData(const char *filename, ETCHeader* etcHeader, MappedFile& file, const unsigned char **textureData)
+    {
+        const size_t sizeOfETCHeader = 16;
+
+        if (textureData == NULL)
+        {
+            LOGE("textureData is a NULL pointer.");
+            exit(1);
+        }
+        if (etcHeader == NULL)
+        {
+            LOGE("etcHeader is a NULL pointer.");
+            exit(1);
+        }
+
+        loadData(filename, file);
+        if (file.getSize() < sizeOfETCHeader)
+        {
+            LOGE("Could not load data from file %s.", filename);
+            exit(1);
+        }
+
+        *etcHeader   = ETCHeader(file.getData());
+        *textureData = file.getData() + sizeOfETCHeader;
+    }
+
     void Texture::loadCompressedMipmaps(const char *filenameBase, const char *filenameSuffix, GLuint *textureID)
     {
         /* Allocate texture name. */
@@ -238,9 +278,10 @@ namespace MaliSDK
         /* Load base level Mipmap. */
         /* Construct filename, load and tidy up. */
         string filename = filenameBase + string("0") + filenameSuffix;
-        unsigned char *data = NULL;
-        loadData(filename.c_str(), &data);
-        ETCHeader loadedETCHeader = ETCHeader(data);
+        MappedFile file;
+        const unsigned char *data = NULL;
+        ETCHeader loadedETCHeader;
+        loadPKMData(filename.c_str(), &loadedETCHeader, file, &data);
 
         /* Calculate number of Mipmap levels. */
         LOGD("Base level Mipmap loaded: (%i, %i) padded to 4x4 blocks, (%i, %i) actual\n", loadedETCHeader.getPaddedWidth(), loadedETCHeader.getPaddedHeight(), loadedETCHeader.getWidth(), loadedETCHeader.getHeight());
@@ -256,18 +297,16 @@ namespace MaliSDK
         LOGD("Requires %i Mipmap levels in total\n", numberOfMipmaps);
 
         /* Load base Mipmap level into level 0 of texture.
-         * Skip the 16 byte header of the PKM file before passing the data to OpenGL ES.
+         * The data is passed to OpenGL ES straight from the mapped file, past the 16 byte header.
          * Data size (taken in number of bytes) of the texture is:
          *      Number of pixels = padded width * padded height.
          *      The number of pixels is divided by two as there are 4 bits per pixel in ETC (half a byte)
          */
 #if GLES_VERSION == 2
-        GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_ETC1_RGB8_OES, loadedETCHeader.getWidth(), loadedETCHeader.getHeight(), 0, (loadedETCHeader.getPaddedWidth() * loadedETCHeader.getPaddedHeight()) >> 1, data + 16));
+        GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_ETC1_RGB8_OES, loadedETCHeader.getWidth(), loadedETCHeader.getHeight(), 0, (loadedETCHeader.getPaddedWidth() * loadedETCHeader.getPaddedHeight()) >> 1, data));
 #elif GLES_VERSION == 3
         /* TODO */
 #endif
-        free(data);
-        data = NULL;
 
         /* Load other levels. */
         for(int allMipmaps = 1; allMipmaps < numberOfMipmaps; allMipmaps++)
@@ -294,24 +333,21 @@ namespace MaliSDK
             sprintf(level, "%i", allMipmaps);
 
             filename = filenameBase + string(level) + filenameSuffix;
-            loadData(filename.c_str(), &data);
+            loadPKMData(filename.c_str(), &loadedETCHeader, file, &data);
             free(level);
             level = NULL;
-            loadedETCHeader = ETCHeader(data);
 
             /* Load Mipmap level into texture.
-             * Skip the 16 byte header of the PKM file before passing the data to OpenGL ES.
+             * The data is passed to OpenGL ES straight from the mapped file, past the 16 byte header.
              * Data size (taken in number of bytes) of the texture is:
              *      Number of pixels = padded width * padded height.
              *      The number of pixels is divided by two as there are 4 bits per pixel in ETC (half a byte)
              */
 #if GLES_VERSION == 2
-            GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, allMipmaps, GL_ETC1_RGB8_OES, loadedETCHeader.getWidth(), loadedETCHeader.getHeight(), 0, (loadedETCHeader.getPaddedWidth() * loadedETCHeader.getPaddedHeight()) >> 1, data + 16));
+            GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, allMipmaps, GL_ETC1_RGB8_OES, loadedETCHeader.getWidth(), loadedETCHeader.getHeight(), 0, (loadedETCHeader.getPaddedWidth() * loadedETCHeader.getPaddedHeight()) >> 1, data));
 #elif GLES_VERSION == 3
         /* TODO */
 #endif
-            free(data);
-            data = NULL;
         }
     }
 
@@ -0,0 +1,670 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TextureStreamer.h"
+
+#if GLES_VERSION == 3
+
+#include "ETCHeader.h"
+#include "MappedFile.h"
+#include "Platform.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x00000040
+#endif
+
+/* From KHR_texture_compression_astc_ldr. The formats for the 2D block sizes are numbered consecutively. */
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+
+namespace MaliSDK
+{
+    namespace
+    {
+        const size_t pkmHeaderSize = 16;
+        const size_t astcHeaderSize = 16;
+        const size_t astcBlockSize = 16;
+
+        const unsigned char astcMagic[4] = { 0x13, 0xAB, 0xA1, 0x5C };
+
+        /* Block sizes of the ASTC formats, in the order of their enums. */
+        const unsigned char astcBlockDimensions[][2] =
+        {
+            { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+            { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+        };
+
+        /* Compressed formats indexed by the data type stored in a version 2.0 PKM header. */
+        const GLenum pkmFormats[] =
+        {
+            GL_COMPRESSED_RGB8_ETC2,                    /* ETC1, which is a subset of ETC2. */
+            GL_COMPRESSED_RGB8_ETC2,
+            GL_NONE,                                    /* Obsolete RGBA format. */
+            GL_COMPRESSED_RGBA8_ETC2_EAC,
+            GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+            GL_COMPRESSED_R11_EAC,
+            GL_COMPRESSED_RG11_EAC,
+            GL_COMPRESSED_SIGNED_R11_EAC,
+            GL_COMPRESSED_SIGNED_RG11_EAC,
+        };
+
+        /**
+         * \brief Describes the texture data stored in a PKM or ASTC file.
+         */
+        struct CompressedImage
+        {
+            GLenum internalFormat;
+            GLsizei width;
+            GLsizei height;
+            size_t dataOffset;
+            size_t dataSize;
+        };
+
+        /**
+         * \brief Parses the 16 byte header of a PKM or ASTC file. Exits on unknown formats.
+         */
+        CompressedImage parseHeader(const unsigned char *header, const std::string &filename)
+        {
+            CompressedImage image;
+
+            if (memcmp(header, "PKM ", 4) == 0)
+            {
+                /* Bytes 4 and 5 hold the version, "10" or "20", and bytes 6 and 7 the data type, big endian. */
+                unsigned int dataType = (header[6] << 8) | header[7];
+                if (header[4] == '1')
+                {
+                    dataType = 0;
+                }
+                if (dataType >= sizeof(pkmFormats) / sizeof(pkmFormats[0]) || pkmFormats[dataType] == GL_NONE)
+                {
+                    LOGE("Unsupported PKM data type %u in '%s'\n", dataType, filename.c_str());
+                    exit(1);
+                }
+
+                ETCHeader etcHeader(header);
+                image.internalFormat = pkmFormats[dataType];
+                image.width = etcHeader.getWidth();
+                image.height = etcHeader.getHeight();
+                image.dataOffset = pkmHeaderSize;
+                image.dataSize = etcHeader.getSize(image.internalFormat);
+            }
+            else if (memcmp(header, astcMagic, 4) == 0)
+            {
+                /* Block dimensions in bytes 4 to 6, followed by 24-bit little endian sizes in texels. */
+                unsigned int blockWidth = header[4];
+                unsigned int blockHeight = header[5];
+                unsigned int blockDepth = header[6];
+                unsigned int width = header[7] | (header[8] << 8) | (header[9] << 16);
+                unsigned int height = header[10] | (header[11] << 8) | (header[12] << 16);
+                unsigned int depth = header[13] | (header[14] << 8) | (header[15] << 16);
+
+                image.internalFormat = GL_NONE;
+                for (unsigned int i = 0; i < sizeof(astcBlockDimensions) / sizeof(astcBlockDimensions[0]); i++)
+                {
+                    if (astcBlockDimensions[i][0] == blockWidth && astcBlockDimensions[i][1] == blockHeight)
+                    {
+                        image.internalFormat = GL_COMPRESSED_RGBA_ASTC_4x4_KHR + i;
+                    }
+                }
+                if (image.internalFormat == GL_NONE || blockDepth != 1 || depth != 1)
+                {
+                    LOGE("Unsupported ASTC block size %ux%ux%u or depth %u in '%s'\n", blockWidth, blockHeight, blockDepth, depth, filename.c_str());
+                    exit(1);
+                }
+
+                image.width = width;
+                image.height = height;
+                image.dataOffset = astcHeaderSize;
+                image.dataSize = ((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * astcBlockSize;
+            }
+            else
+            {
+                LOGE("'%s' is neither a PKM nor an ASTC file\n", filename.c_str());
+                exit(1);
+            }
+
+            return image;
+        }
+
+        /* Heap orderings: the job which compares greatest is taken first. */
+        template <typename Job>
+        GLint getOrderLevel(const Job &job)
+        {
+            /* Headers come before any level, and small levels come before large ones. */
+            return job.level < 0 ? 0x7fffffff : job.level;
+        }
+
+        template <typename Job>
+        bool isTakenLater(const Job &a, const Job &b)
+        {
+            if (a.texture->priority != b.texture->priority)
+            {
+                return a.texture->priority < b.texture->priority;
+            }
+            if (getOrderLevel(a) != getOrderLevel(b))
+            {
+                return getOrderLevel(a) < getOrderLevel(b);
+            }
+            return a.sequence > b.sequence;
+        }
+    }
+
+    TextureStreamer::TextureStreamer(unsigned int stagingBufferCount, size_t maximumPendingBytes)
+        : stagingBufferCount(std::max(stagingBufferCount, 1u)), maximumPendingBytes(maximumPendingBytes),
+          display(EGL_NO_DISPLAY), uploadSurface(EGL_NO_SURFACE), uploadContext(EGL_NO_CONTEXT),
+          pendingBytes(0), nextSequence(0), shutdown(false), timer(new Timer())
+    {
+        memset(&statistics, 0, sizeof(statistics));
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        stop();
+
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            delete textures[i];
+        }
+        delete timer;
+    }
+
+    bool TextureStreamer::start(void)
+    {
+        if (uploadContext != EGL_NO_CONTEXT)
+        {
+            return true;
+        }
+
+        display = eglGetCurrentDisplay();
+        EGLContext applicationContext = eglGetCurrentContext();
+        if (display == EGL_NO_DISPLAY || applicationContext == EGL_NO_CONTEXT)
+        {
+            LOGE("TextureStreamer::start() needs a current EGL context\n");
+            return false;
+        }
+
+        /* The upload thread never draws, a tiny pbuffer is enough to make its context current. */
+        const EGLint configAttributes[] =
+        {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+            EGL_NONE
+        };
+        const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        const EGLint contextAttributes[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+
+        EGLConfig config;
+        EGLint numberOfConfigs = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &numberOfConfigs) || numberOfConfigs == 0)
+        {
+            LOGE("No pbuffer EGLConfig for the texture upload context\n");
+            return false;
+        }
+
+        uploadSurface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        if (uploadSurface == EGL_NO_SURFACE)
+        {
+            LOGE("Failed to create the texture upload pbuffer, eglGetError() = 0x%.4x\n", eglGetError());
+            return false;
+        }
+
+        uploadContext = eglCreateContext(display, config, applicationContext, contextAttributes);
+        if (uploadContext == EGL_NO_CONTEXT)
+        {
+            LOGE("Failed to create the texture upload context, eglGetError() = 0x%.4x\n", eglGetError());
+            eglDestroySurface(display, uploadSurface);
+            uploadSurface = EGL_NO_SURFACE;
+            return false;
+        }
+
+        shutdown = false;
+        statistics.streamingTime = 0.0f;
+        timer->reset();
+        readThread = std::thread(&TextureStreamer::readLoop, this);
+        uploadThread = std::thread(&TextureStreamer::uploadLoop, this);
+
+        return true;
+    }
+
+    void TextureStreamer::stop(void)
+    {
+        if (uploadContext == EGL_NO_CONTEXT)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            shutdown = true;
+        }
+        readCondition.notify_all();
+        uploadCondition.notify_all();
+
+        readThread.join();
+        uploadThread.join();
+
+        /* Levels uploaded but not made visible yet are simply dropped. */
+        pendingCompletions.insert(pendingCompletions.end(), completions.begin(), completions.end());
+        for (size_t i = 0; i < pendingCompletions.size(); i++)
+        {
+            GL_CHECK(glDeleteSync(pendingCompletions[i].fence));
+        }
+        pendingCompletions.clear();
+        completions.clear();
+        readQueue.clear();
+        uploadQueue.clear();
+        pendingBytes = 0;
+
+        eglDestroyContext(display, uploadContext);
+        eglDestroySurface(display, uploadSurface);
+        uploadContext = EGL_NO_CONTEXT;
+        uploadSurface = EGL_NO_SURFACE;
+    }
+
+    GLuint TextureStreamer::streamTexture(const char *filename, GLenum internalFormat, int priority)
+    {
+        return requestTexture(filename, "", false, internalFormat, priority);
+    }
+
+    GLuint TextureStreamer::streamMipmaps(const char *filenameBase, const char *filenameSuffix, GLenum internalFormat, int priority)
+    {
+        return requestTexture(filenameBase, filenameSuffix, true, internalFormat, priority);
+    }
+
+    GLuint TextureStreamer::requestTexture(const char *filenameBase, const char *filenameSuffix, bool mipmapped, GLenum internalFormat, int priority)
+    {
+        StreamedTexture *texture = new StreamedTexture();
+        texture->filenameBase = filenameBase;
+        texture->filenameSuffix = filenameSuffix;
+        texture->mipmapped = mipmapped;
+        texture->priority = priority;
+        texture->internalFormat = internalFormat;
+        texture->width = 0;
+        texture->height = 0;
+        texture->levels = 0;
+        texture->baseLevel = 0;
+
+        /*
+         * Create the texture object here rather than leaving it to the first bind,
+         * so the two contexts never race to create it. The levels are defined by
+         * the upload thread, and the base level keeps the texture incomplete until
+         * makeResident() lowers it.
+         */
+        GLint previousTexture = 0;
+        GL_CHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+        GL_CHECK(glGenTextures(1, &texture->id));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture->id));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, unsampledBaseLevel));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+
+        textures.push_back(texture);
+        texturesById[texture->id] = texture;
+        statistics.texturesRequested++;
+
+        pushReadJob(texture, headerLevel);
+        return texture->id;
+    }
+
+    void TextureStreamer::pushReadJob(StreamedTexture *texture, GLint level)
+    {
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            ReadJob job = { texture, level, nextSequence++ };
+            readQueue.push_back(job);
+            std::push_heap(readQueue.begin(), readQueue.end(), isTakenLater<ReadJob>);
+        }
+        readCondition.notify_one();
+    }
+
+    std::string TextureStreamer::getFilename(const StreamedTexture *texture, GLint level) const
+    {
+        if (!texture->mipmapped)
+        {
+            return texture->filenameBase;
+        }
+
+        char levelString[16];
+        snprintf(levelString, sizeof(levelString), "%d", level);
+        return texture->filenameBase + levelString + texture->filenameSuffix;
+    }
+
+    void TextureStreamer::readLoop(void)
+    {
+        for (;;)
+        {
+            std::unique_lock<std::mutex> holder(lock);
+            /* Stop reading ahead once enough data is waiting for the upload thread, to bound memory use. */
+            readCondition.wait(holder, [this] { return shutdown || (!readQueue.empty() && pendingBytes < maximumPendingBytes); });
+            if (shutdown)
+            {
+                return;
+            }
+
+            std::pop_heap(readQueue.begin(), readQueue.end(), isTakenLater<ReadJob>);
+            ReadJob job = readQueue.back();
+            readQueue.pop_back();
+            holder.unlock();
+
+            if (job.level == headerLevel && job.texture->mipmapped)
+            {
+                readHeader(job.texture);
+            }
+            else
+            {
+                readLevel(job.texture, job.level == headerLevel ? 0 : job.level, job.sequence);
+            }
+        }
+    }
+
+    void TextureStreamer::readHeader(StreamedTexture *texture)
+    {
+        std::string filename = getFilename(texture, 0);
+        MappedFile file(filename.c_str());
+        if (file.getSize() < pkmHeaderSize)
+        {
+            LOGE("'%s' is too small for a texture header\n", filename.c_str());
+            exit(1);
+        }
+        CompressedImage image = parseHeader(file.getData(), filename);
+
+        if (texture->internalFormat == GL_NONE)
+        {
+            texture->internalFormat = image.internalFormat;
+        }
+        texture->width = image.width;
+        texture->height = image.height;
+
+        /* Same level count as Texture::loadCompressedMipmaps(). */
+        GLsizei width = image.width;
+        GLsizei height = image.height;
+        texture->levels = 1;
+        while (width > 1 || height > 1)
+        {
+            texture->levels++;
+            width = std::max(width >> 1, 1);
+            height = std::max(height >> 1, 1);
+        }
+
+        for (GLint level = 0; level < texture->levels; level++)
+        {
+            pushReadJob(texture, level);
+        }
+    }
+
+    void TextureStreamer::readLevel(StreamedTexture *texture, GLint level, unsigned int sequence)
+    {
+        std::string filename = getFilename(texture, level);
+
+        UploadJob job;
+        job.texture = texture;
+        job.level = level;
+        job.sequence = sequence;
+        /* Mapping the file leaves the actual reading to the page cache, the upload thread copies straight from it. */
+        job.file.reset(new MappedFile(filename.c_str()));
+        if (job.file->getSize() < pkmHeaderSize)
+        {
+            LOGE("'%s' is too small for a texture header\n", filename.c_str());
+            exit(1);
+        }
+
+        CompressedImage image = parseHeader(job.file->getData(), filename);
+        if (image.dataOffset + image.dataSize > job.file->getSize())
+        {
+            LOGE("'%s' is truncated, expected %u bytes of texture data\n", filename.c_str(), (unsigned int)image.dataSize);
+            exit(1);
+        }
+        job.width = image.width;
+        job.height = image.height;
+        job.dataOffset = image.dataOffset;
+        job.dataSize = image.dataSize;
+
+        if (!texture->mipmapped)
+        {
+            if (texture->internalFormat == GL_NONE)
+            {
+                texture->internalFormat = image.internalFormat;
+            }
+            texture->width = image.width;
+            texture->height = image.height;
+            texture->levels = 1;
+        }
+
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            pendingBytes += job.file->getSize();
+            uploadQueue.push_back(std::move(job));
+            std::push_heap(uploadQueue.begin(), uploadQueue.end(), isTakenLater<UploadJob>);
+        }
+        uploadCondition.notify_one();
+    }
+
+    void TextureStreamer::uploadLoop(void)
+    {
+        if (!eglMakeCurrent(display, uploadSurface, uploadSurface, uploadContext))
+        {
+            LOGE("Failed to make the texture upload context current, eglGetError() = 0x%.4x\n", eglGetError());
+            exit(1);
+        }
+
+        std::vector<StagingBuffer> staging(stagingBufferCount);
+        for (unsigned int i = 0; i < stagingBufferCount; i++)
+        {
+            GL_CHECK(glGenBuffers(1, &staging[i].buffer));
+            staging[i].capacity = 0;
+            staging[i].fence = NULL;
+        }
+        unsigned int nextStaging = 0;
+
+        for (;;)
+        {
+            UploadJob job;
+            {
+                std::unique_lock<std::mutex> holder(lock);
+                uploadCondition.wait(holder, [this] { return shutdown || !uploadQueue.empty(); });
+                if (shutdown)
+                {
+                    break;
+                }
+
+                std::pop_heap(uploadQueue.begin(), uploadQueue.end(), isTakenLater<UploadJob>);
+                job = std::move(uploadQueue.back());
+                uploadQueue.pop_back();
+            }
+
+            uploadLevel(job, staging[nextStaging]);
+            nextStaging = (nextStaging + 1) % stagingBufferCount;
+
+            {
+                std::lock_guard<std::mutex> holder(lock);
+                pendingBytes -= job.file->getSize();
+            }
+            readCondition.notify_one();
+        }
+
+        for (unsigned int i = 0; i < stagingBufferCount; i++)
+        {
+            if (staging[i].fence != NULL)
+            {
+                GL_CHECK(glDeleteSync(staging[i].fence));
+            }
+            GL_CHECK(glDeleteBuffers(1, &staging[i].buffer));
+        }
+        GL_CHECK(glFinish());
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+
+    void TextureStreamer::uploadLevel(UploadJob &job, StagingBuffer &staging)
+    {
+        StreamedTexture *texture = job.texture;
+
+        /* The staging buffer is reused round-robin. Wait until the GPU has consumed its previous contents. */
+        if (staging.fence != NULL)
+        {
+            while (glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+            GL_CHECK(glDeleteSync(staging.fence));
+            staging.fence = NULL;
+        }
+
+        GL_CHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer));
+        if ((GLsizeiptr)job.dataSize > staging.capacity)
+        {
+            staging.capacity = job.dataSize;
+            GL_CHECK(glBufferData(GL_PIXEL_UNPACK_BUFFER, staging.capacity, NULL, GL_STREAM_DRAW));
+        }
+
+        void *mapped = GL_CHECK(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, job.dataSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (mapped == NULL)
+        {
+            LOGE("Failed to map a texture staging buffer\n");
+            exit(1);
+        }
+        memcpy(mapped, job.file->getData() + job.dataOffset, job.dataSize);
+        GL_CHECK(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture->id));
+        GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, job.level, texture->internalFormat, job.width, job.height, 0, job.dataSize, NULL));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+        GL_CHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+        /* One fence guards the staging buffer, the other tells the application thread when the level is safe to use. */
+        staging.fence = GL_CHECK(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        Completion completion = { texture, job.level, (GLsizei)job.dataSize, NULL };
+        completion.fence = GL_CHECK(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+        /* Fences only signal once submitted, and the application thread cannot flush this context. */
+        GL_CHECK(glFlush());
+
+        std::lock_guard<std::mutex> holder(lock);
+        completions.push_back(completion);
+    }
+
+    unsigned int TextureStreamer::update(void)
+    {
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            pendingCompletions.insert(pendingCompletions.end(), completions.begin(), completions.end());
+            completions.clear();
+        }
+
+        unsigned int levelsMadeResident = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < pendingCompletions.size(); i++)
+        {
+            /* A zero timeout polls the fence, so the frame never stalls on an upload. */
+            GLenum status = GL_CHECK(glClientWaitSync(pendingCompletions[i].fence, 0, 0));
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            {
+                GL_CHECK(glDeleteSync(pendingCompletions[i].fence));
+                makeResident(pendingCompletions[i]);
+                levelsMadeResident++;
+            }
+            else
+            {
+                pendingCompletions[kept++] = pendingCompletions[i];
+            }
+        }
+        pendingCompletions.resize(kept);
+
+        if (levelsMadeResident > 0)
+        {
+            statistics.streamingTime = timer->getTime();
+        }
+        return levelsMadeResident;
+    }
+
+    void TextureStreamer::makeResident(const Completion &completion)
+    {
+        StreamedTexture *texture = completion.texture;
+
+        if (texture->resident.empty())
+        {
+            texture->resident.resize(texture->levels, false);
+            texture->baseLevel = texture->levels;
+        }
+        texture->resident[completion.level] = true;
+
+        statistics.levelsUploaded++;
+        statistics.bytesUploaded += completion.dataSize;
+
+        /* Only an unbroken chain of levels down to the smallest one can be sampled. */
+        GLint baseLevel = texture->baseLevel;
+        while (baseLevel > 0 && texture->resident[baseLevel - 1])
+        {
+            baseLevel--;
+        }
+        if (baseLevel == texture->baseLevel || baseLevel == texture->levels)
+        {
+            return;
+        }
+        texture->baseLevel = baseLevel;
+
+        GLint previousTexture = 0;
+        GL_CHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture->id));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+
+        if (baseLevel == 0)
+        {
+            statistics.texturesComplete++;
+        }
+    }
+
+    bool TextureStreamer::isTextureResident(GLuint texture) const
+    {
+        std::map<GLuint, StreamedTexture *>::const_iterator found = texturesById.find(texture);
+        return found != texturesById.end() && found->second->baseLevel < (GLint)found->second->resident.size();
+    }
+
+    bool TextureStreamer::isTextureComplete(GLuint texture) const
+    {
+        std::map<GLuint, StreamedTexture *>::const_iterator found = texturesById.find(texture);
+        return found != texturesById.end() && !found->second->resident.empty() && found->second->baseLevel == 0;
+    }
+
+    bool TextureStreamer::isIdle(void) const
+    {
+        return statistics.texturesComplete == statistics.texturesRequested;
+    }
+
+    TextureStreamer::Statistics TextureStreamer::getStatistics(void) const
+    {
+        return statistics;
+    }
+
+    void TextureStreamer::logStatistics(void) const
+    {
+        LOGI("Texture streaming: %u of %u textures complete, %u levels, %.2f MB uploaded in %.2f s\n",
+             statistics.texturesComplete, statistics.texturesRequested, statistics.levelsUploaded,
+             statistics.bytesUploaded / (1024.0f * 1024.0f), statistics.streamingTime);
+    }
+}
+
+#endif /* GLES_VERSION == 3 */
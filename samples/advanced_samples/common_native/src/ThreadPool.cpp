@@ -0,0 +1,139 @@
+/* Copyright (c) 2012-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace MaliSDK
+{
+    ThreadPool::ThreadPool(unsigned int numberOfThreads)
+        : job(NULL), jobCount(0), jobChunk(1), jobNext(0), generation(0), activeWorkers(0), shutdown(false)
+    {
+        if (numberOfThreads == 0)
+        {
+            numberOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        /* The thread calling parallelFor() is one of the threads. */
+        workers.reserve(numberOfThreads - 1);
+        for (unsigned int i = 1; i < numberOfThreads; i++)
+        {
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            shutdown = true;
+        }
+        workCondition.notify_all();
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+    }
+
+    void ThreadPool::runChunks()
+    {
+        for (;;)
+        {
+            unsigned int begin = jobNext.fetch_add(jobChunk);
+            if (begin >= jobCount)
+            {
+                break;
+            }
+
+            unsigned int end = std::min(begin + jobChunk, jobCount);
+            (*job)(begin, end);
+        }
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        unsigned int seenGeneration = 0;
+
+        for (;;)
+        {
+            std::unique_lock<std::mutex> holder(lock);
+            while (!shutdown && generation == seenGeneration)
+            {
+                workCondition.wait(holder);
+            }
+
+            if (shutdown)
+            {
+                return;
+            }
+
+            seenGeneration = generation;
+            holder.unlock();
+
+            runChunks();
+
+            holder.lock();
+            if (--activeWorkers == 0)
+            {
+                doneCondition.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::parallelFor(unsigned int count, const std::function<void (unsigned int, unsigned int)>& function, unsigned int minimumChunk)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        /* Aim for a few chunks per thread so uneven work still balances out. */
+        const unsigned int threads = getNumberOfThreads();
+        const unsigned int chunk = std::max(std::max(minimumChunk, 1u), (count + threads * 4 - 1) / (threads * 4));
+
+        if (workers.empty() || chunk >= count)
+        {
+            function(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> holder(lock);
+            job = &function;
+            jobCount = count;
+            jobChunk = chunk;
+            jobNext = 0;
+            activeWorkers = (unsigned int)workers.size();
+            generation++;
+        }
+        workCondition.notify_all();
+
+        runChunks();
+
+        std::unique_lock<std::mutex> holder(lock);
+        while (activeWorkers != 0)
+        {
+            doneCondition.wait(holder);
+        }
+        job = NULL;
+    }
+}
@@ -280,17 +280,9 @@ namespace MaliSDK
 
     void PlaneModel::transform(Matrix transform, int numberOfCoordinates, float** squareCoordinates)
     {
-        /* Loop through all the coordinates and transform them using the rotation matrix. */
-        for (int allCoordinates = 0; allCoordinates < numberOfCoordinates; allCoordinates +=4)
-        {
-            Vec4f currentVertex = {(*squareCoordinates)[allCoordinates], (*squareCoordinates)[allCoordinates + 1], (*squareCoordinates)[allCoordinates + 2], (*squareCoordinates)[allCoordinates + 3]};
-
-            Vec4f rotatedVertex = Matrix::vertexTransform(&currentVertex, &transform);
+        /* Transform all the coordinates in one batch, in-place. */
+        Vec4f* vertices = reinterpret_cast<Vec4f*>(*squareCoordinates);
 
-            (*squareCoordinates)[allCoordinates] = rotatedVertex.x;
-            (*squareCoordinates)[allCoordinates + 1] = rotatedVertex.y;
-            (*squareCoordinates)[allCoordinates + 2] = rotatedVertex.z;
-            (*squareCoordinates)[allCoordinates + 3] = rotatedVertex.w;
-        }
+        Matrix::vertexTransform(vertices, vertices, numberOfCoordinates / 4, &transform);
     }
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "BoidsSimulation.h"
+#include "Common.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace MaliSDK
+{
+    const float BoidsSimulation::minimumDistance = 4.0f;
+
+    BoidsSimulation::BoidsSimulation(int numberOfBoids, ThreadPool* threadPool)
+        : numberOfBoids(numberOfBoids)
+        , threadPool(threadPool)
+    {
+        ASSERT(numberOfBoids >= 2, "There has to be a leader and at least one follower.");
+
+        for (int component = 0; component < 4; component++)
+        {
+            position[component].assign(numberOfBoids, 0.0f);
+            velocity[component].assign(numberOfBoids, 0.0f);
+            nextPosition[component].resize(numberOfBoids);
+            nextVelocity[component].resize(numberOfBoids);
+            sortedPosition[component].resize(numberOfBoids);
+        }
+
+        /* Twice as many buckets as boids keeps collisions between occupied cells rare. */
+        unsigned int numberOfBuckets = 1;
+        while (numberOfBuckets < 2u * numberOfBoids)
+        {
+            numberOfBuckets <<= 1;
+        }
+        bucketMask = numberOfBuckets - 1;
+
+        boidBucket.resize(numberOfBoids);
+        bucketStart.resize(numberOfBuckets + 1);
+        sortedBoids.resize(numberOfBoids);
+    }
+
+    void BoidsSimulation::setState(const float* positionsAndVelocities)
+    {
+        const float* velocities = positionsAndVelocities + 4 * numberOfBoids;
+
+        for (int boid = 0; boid < numberOfBoids; boid++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                position[component][boid] = positionsAndVelocities[4 * boid + component];
+                velocity[component][boid] = velocities[4 * boid + component];
+            }
+        }
+    }
+
+    void BoidsSimulation::getState(float* positionsAndVelocities) const
+    {
+        float* velocities = positionsAndVelocities + 4 * numberOfBoids;
+
+        for (int boid = 0; boid < numberOfBoids; boid++)
+        {
+            for (int component = 0; component < 4; component++)
+            {
+                positionsAndVelocities[4 * boid + component] = position[component][boid];
+                velocities[4 * boid + component]             = velocity[component][boid];
+            }
+        }
+    }
+
+    unsigned int BoidsSimulation::hashCell(int x, int y, int z)
+    {
+        return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+    }
+
+    int BoidsSimulation::getCell(float coordinate) const
+    {
+        return (int)floorf(coordinate * (1.0f / minimumDistance));
+    }
+
+    void BoidsSimulation::buildGrid()
+    {
+        const float* x = &position[0][0];
+        const float* y = &position[1][0];
+        const float* z = &position[2][0];
+
+        /* Find the bucket of every boid. */
+        std::function<void (unsigned int, unsigned int)> findBuckets = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int boid = begin; boid < end; boid++)
+            {
+                boidBucket[boid] = hashCell(getCell(x[boid]), getCell(y[boid]), getCell(z[boid])) & bucketMask;
+            }
+        };
+
+        if (threadPool != NULL)
+        {
+            threadPool->parallelFor(numberOfBoids, findBuckets, 1024);
+        }
+        else
+        {
+            findBuckets(0, numberOfBoids);
+        }
+
+        /* Counting sort of the boids by bucket. bucketStart[b + 1] first counts the boids in bucket b. */
+        memset(&bucketStart[0], 0, bucketStart.size() * sizeof(unsigned int));
+        for (int boid = 0; boid < numberOfBoids; boid++)
+        {
+            bucketStart[boidBucket[boid] + 1]++;
+        }
+        for (size_t bucket = 1; bucket < bucketStart.size(); bucket++)
+        {
+            bucketStart[bucket] += bucketStart[bucket - 1];
+        }
+
+        /* Scatter, using boidBucket to count up each bucket's next free slot. The counts are restored afterwards. */
+        for (int boid = 0; boid < numberOfBoids; boid++)
+        {
+            unsigned int slot = bucketStart[boidBucket[boid]]++;
+
+            sortedBoids[slot] = boid;
+            for (int component = 0; component < 4; component++)
+            {
+                sortedPosition[component][slot] = position[component][boid];
+            }
+        }
+        for (size_t bucket = bucketStart.size() - 1; bucket > 0; bucket--)
+        {
+            bucketStart[bucket] = bucketStart[bucket - 1];
+        }
+        bucketStart[0] = 0;
+    }
+
+    void BoidsSimulation::updateFollowers(unsigned int begin, unsigned int end, const double* totalPosition, const double* totalVelocity)
+    {
+        const float otherBoids = float(numberOfBoids - 1);
+        const float minimumDistanceSquared = minimumDistance * minimumDistance;
+
+        /* Walk the boids in bucket order, so neighbouring boids are handled by the same thread. */
+        for (unsigned int slot = begin; slot < end; slot++)
+        {
+            const int boid = sortedBoids[slot];
+
+            if (boid == 0)
+            {
+                continue;
+            }
+
+            float location[4];
+            float result[4];
+
+            for (int component = 0; component < 4; component++)
+            {
+                location[component] = position[component][boid];
+
+                /* Fly toward the center of mass of all other boids, and match their average velocity. */
+                float center  = float((totalPosition[component] - location[component]) / otherBoids);
+                float average = float((totalVelocity[component] - velocity[component][boid]) / otherBoids);
+
+                result[component] = velocity[component][boid]
+                                  + (center - location[component]) / 100.0f
+                                  + (average - velocity[component][boid]) / 2.0f;
+            }
+
+            /* Keep the distance from boids in the 27 cells around this boid's cell. */
+            const int cellX = getCell(location[0]);
+            const int cellY = getCell(location[1]);
+            const int cellZ = getCell(location[2]);
+
+            unsigned int visitedBuckets[27];
+            int numberOfVisitedBuckets = 0;
+
+            for (int offsetZ = -1; offsetZ <= 1; offsetZ++)
+            for (int offsetY = -1; offsetY <= 1; offsetY++)
+            for (int offsetX = -1; offsetX <= 1; offsetX++)
+            {
+                const unsigned int bucket = hashCell(cellX + offsetX, cellY + offsetY, cellZ + offsetZ) & bucketMask;
+
+                /* Different cells can share a bucket; each bucket must only be visited once. */
+                bool visited = false;
+                for (int visitedBucket = 0; visitedBucket < numberOfVisitedBuckets; visitedBucket++)
+                {
+                    visited = visited || visitedBuckets[visitedBucket] == bucket;
+                }
+                if (visited)
+                {
+                    continue;
+                }
+                visitedBuckets[numberOfVisitedBuckets++] = bucket;
+
+                for (unsigned int other = bucketStart[bucket]; other < bucketStart[bucket + 1]; other++)
+                {
+                    const float xDistance = sortedPosition[0][other] - location[0];
+                    const float yDistance = sortedPosition[1][other] - location[1];
+                    const float zDistance = sortedPosition[2][other] - location[2];
+                    const float distanceSquared = xDistance * xDistance + yDistance * yDistance + zDistance * zDistance;
+
+                    /* The bucket can also hold boids from distant cells, so the distance is always checked. */
+                    if (other == slot || distanceSquared >= minimumDistanceSquared)
+                    {
+                        continue;
+                    }
+
+                    /* 1.1 - smoothstep(0.0, minimumDistance, distance). */
+                    const float t = sqrtf(distanceSquared) / minimumDistance;
+                    const float push = 1.1f - t * t * (3.0f - 2.0f * t);
+
+                    for (int component = 0; component < 4; component++)
+                    {
+                        result[component] -= push * (sortedPosition[component][other] - location[component]);
+                    }
+                }
+            }
+
+            for (int component = 0; component < 4; component++)
+            {
+                nextVelocity[component][boid] = result[component];
+                nextPosition[component][boid] = location[component] + result[component];
+            }
+        }
+    }
+
+    void BoidsSimulation::step(float time)
+    {
+        /* Totals over all boids; each follower subtracts itself to get the average over the others. */
+        double totalPosition[4] = {0.0, 0.0, 0.0, 0.0};
+        double totalVelocity[4] = {0.0, 0.0, 0.0, 0.0};
+
+        for (int component = 0; component < 4; component++)
+        {
+            for (int boid = 0; boid < numberOfBoids; boid++)
+            {
+                totalPosition[component] += position[component][boid];
+                totalVelocity[component] += velocity[component][boid];
+            }
+        }
+
+        buildGrid();
+
+        std::function<void (unsigned int, unsigned int)> update = [&](unsigned int begin, unsigned int end)
+        {
+            updateFollowers(begin, end, totalPosition, totalVelocity);
+        };
+
+        if (threadPool != NULL)
+        {
+            threadPool->parallelFor(numberOfBoids, update, 256);
+        }
+        else
+        {
+            update(0, numberOfBoids);
+        }
+
+        /* The leader follows a closed curve. */
+        nextPosition[0][0] = 15.0f * cosf(time);
+        nextPosition[1][0] = 15.0f * sinf(time);
+        nextPosition[2][0] = 2.0f * 15.0f * sinf(time / 2.0f);
+        nextPosition[3][0] = 1.0f;
+        for (int component = 0; component < 4; component++)
+        {
+            nextVelocity[component][0] = 0.0f;
+        }
+
+        for (int component = 0; component < 4; component++)
+        {
+            position[component].swap(nextPosition[component]);
+            velocity[component].swap(nextVelocity[component]);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2014-2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BOIDS_SIMULATION_H
+#define BOIDS_SIMULATION_H
+
+#include "ThreadPool.h"
+
+#include <vector>
+
+namespace MaliSDK
+{
+    /**
+     * \brief CPU implementation of the flocking rules in movement.vert.
+     *
+     * Boid 0 is the leader and follows a looping path; all other boids are followers.
+     * The averages over all other boids are computed from running totals, and the
+     * separation rule only looks at boids closer than minimumDistance, which are found
+     * through a uniform grid hashed into a table. One step is therefore O(N) rather
+     * than the O(N^2) of the shader, so the simulation scales to tens of thousands of boids.
+     *
+     * State is kept as separate x, y, z and w arrays (structure of arrays) for positions
+     * and velocities, and is double buffered in the same way as the ping and pong buffer
+     * objects used for transform feedback.
+     */
+    class BoidsSimulation
+    {
+    public:
+        /** Boids closer than this push each other away. Also the size of a grid cell. */
+        static const float minimumDistance;
+
+        /**
+         * \brief Allocates storage for the boids. All positions and velocities start at zero.
+         * \param[in] numberOfBoids Number of boids, including the leader. Has to be at least 2.
+         * \param[in] threadPool    Pool used to update the boids in parallel. NULL updates them on the calling thread.
+         */
+        BoidsSimulation(int numberOfBoids, ThreadPool* threadPool = NULL);
+
+        /**
+         * \brief Loads positions and velocities.
+         * \param[in] positionsAndVelocities numberOfBoids vec4 positions followed by numberOfBoids vec4 velocities,
+         *                                   which is the layout of startPositionAndVelocity and of the ping and pong buffer objects.
+         */
+        void setState(const float* positionsAndVelocities);
+
+        /**
+         * \brief Stores positions and velocities in the layout taken by setState().
+         * \param[out] positionsAndVelocities Has to hold 8 * numberOfBoids floats.
+         */
+        void getState(float* positionsAndVelocities) const;
+
+        /**
+         * \brief Moves all boids by one step, as one transform feedback pass of movement.vert would.
+         * \param[in] time Time value that determines the leader's position.
+         */
+        void step(float time);
+
+        /**
+         * \brief Returns the number of boids, including the leader.
+         */
+        int getNumberOfBoids() const { return numberOfBoids; }
+
+    private:
+        int numberOfBoids;
+        ThreadPool* threadPool;
+
+        /* Current and next positions and velocities, one array per component. */
+        std::vector<float> position[4];
+        std::vector<float> velocity[4];
+        std::vector<float> nextPosition[4];
+        std::vector<float> nextVelocity[4];
+
+        /* Spatial hash. Boids are sorted by hash bucket; the boids of bucket b are sortedBoids[bucketStart[b]] to sortedBoids[bucketStart[b + 1] - 1]. */
+        unsigned int bucketMask;
+        std::vector<unsigned int> boidBucket;
+        std::vector<unsigned int> bucketStart;
+        std::vector<int> sortedBoids;
+        /* Positions copied in bucket order, so the boids of one bucket are read from consecutive memory. */
+        std::vector<float> sortedPosition[4];
+
+        static unsigned int hashCell(int x, int y, int z);
+        int getCell(float coordinate) const;
+
+        void buildGrid();
+        void updateFollowers(unsigned int begin, unsigned int end, const double* totalPosition, const double* totalVelocity);
+    };
+}
+#endif /* BOIDS_SIMULATION_H */
@@ -33,17 +33,24 @@
  * transferred back to the CPU. Transform feedback buffers are used to store the output of the
  * movement vertex shader, this data is then used as the input data on the next pass.
  * The same data is used when rendering the scene.
+ *
+ * BoidsSimulation implements the same flocking rules on the CPU. It can replace transform
+ * feedback, check its output, or be benchmarked with many more boids than the shader supports.
  */
 #include <jni.h>
 #include <android/log.h>
 
 #include <GLES3/gl3.h>
 #include "Boids.h"
+#include "BoidsSimulation.h"
 #include "Common.h"
+#include "CounterRandom.h"
 #include "Shader.h"
 #include "SphereModel.h"
 #include "Timer.h"
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 using namespace MaliSDK;
 
 
@@ -126,18 +133,39 @@ GLuint spherePongPositionAndVelocityBufferObjectId = 0;
 /* Array holding positions and velocities of spheres in 3D space which are used to draw spheres for the first time. */
 float startPositionAndVelocity[spherePositionsAndVelocitiesLength] = {0};
 
+/* CPU simulation. */
+/* If true, positions and velocities are computed on the CPU and uploaded to the ping or pong buffer object instead of using transform feedback. */
+const bool useCpuSimulation = false;
+/* If true, the output of every transform feedback pass is compared with a CPU simulation step from the same input. */
+const bool validateTransformFeedback = false;
+/* Number of boids simulated on the CPU when the application starts, to measure the time per step. 0 disables the benchmark. */
+const int cpuBenchmarkNumberOfBoids = 0;
+/* Number of steps the benchmark runs. */
+const int cpuBenchmarkNumberOfSteps = 100;
+/* Worker threads used by the CPU simulation. */
+ThreadPool* threadPool = NULL;
+/* CPU simulation of the spheres. */
+BoidsSimulation* cpuSimulation = NULL;
+/* Array receiving positions and velocities computed on the CPU. */
+float cpuPositionAndVelocity[spherePositionsAndVelocitiesLength] = {0};
+
 /**
 * \brief Generate random positions and velocities of spheres which are used during first draw call.
 */
 void generateStartPositionAndVelocity()
 {
-    /* Fill the array with position data (starting at index 0). */
+    /*
+     * Fill the array with position data (starting at index 0).
+     * Sphere i gets the four values of index i from a counter-based generator, so the spheres start at the same positions on every run.
+     */
+    const CounterRandom random;
+    random.generateFloatBatch(0, 0, numberOfSpheresToGenerate, startPositionAndVelocity);
     for (int allComponents = 0;
              allComponents < 4 * numberOfSpheresToGenerate;
              allComponents++)
     {
         /* Random data with range -20 to -10. */
-        startPositionAndVelocity[allComponents] = 10.0f * (float(rand()) / float(RAND_MAX)) - 20.0f;
+        startPositionAndVelocity[allComponents] = 10.0f * startPositionAndVelocity[allComponents] - 20.0f;
     }
 
     /* Fill array with velocity data (which follows position data). */
@@ -165,10 +193,9 @@ void fillVertexColorsArray()
 
     ASSERT(vertexColors != NULL, "Could not allocate memory for vertexColors array.");
 
-    for (int i = 0; i < colorArraySize; i++)
-    {
-        vertexColors[i] = float(rand()%RAND_MAX)/float(RAND_MAX);
-    }
+    /* Each vertex gets the four color components of its own index, from a different stream than the start positions. */
+    const CounterRandom random;
+    random.generateFloatBatch(0, 1, colorArraySize / 4, vertexColors);
 }
 
 /**
@@ -374,6 +401,85 @@ void setupPrograms()
     /* [Fill position and velocity buffer with data] */
 }
 
+/**
+ * \brief Step the simulation with a large number of boids on the CPU and log the average time per step.
+ */
+void benchmarkCpuSimulation()
+{
+    BoidsSimulation simulation(cpuBenchmarkNumberOfBoids, threadPool);
+
+    /* Spread the boids over a cube, so that they keep roughly the same density as the 30 spheres of the sample. */
+    const float extent = 10.0f * cbrtf(cpuBenchmarkNumberOfBoids / float(numberOfSpheresToGenerate));
+    float* state = (float*) malloc(8 * cpuBenchmarkNumberOfBoids * sizeof(float));
+
+    ASSERT(state != NULL, "Could not allocate memory for benchmark state.");
+
+    const CounterRandom random;
+    random.generateFloatBatch(0, 0, cpuBenchmarkNumberOfBoids, state);
+    for (int allComponents = 0; allComponents < 4 * cpuBenchmarkNumberOfBoids; allComponents++)
+    {
+        state[allComponents] = extent * (state[allComponents] - 0.5f);
+    }
+    memset(state + 4 * cpuBenchmarkNumberOfBoids, 0, 4 * cpuBenchmarkNumberOfBoids * sizeof(float));
+
+    simulation.setState(state);
+    free(state);
+
+    Timer benchmarkTimer;
+    benchmarkTimer.reset();
+    for (int stepIndex = 0; stepIndex < cpuBenchmarkNumberOfSteps; stepIndex++)
+    {
+        simulation.step(stepIndex * 0.01f);
+    }
+
+    LOGI("CPU simulation of %d boids on %u threads: %.3f ms per step.\n",
+         cpuBenchmarkNumberOfBoids,
+         threadPool->getNumberOfThreads(),
+         1000.0f * benchmarkTimer.getTime() / cpuBenchmarkNumberOfSteps);
+}
+
+/**
+ * \brief Compare the output of a transform feedback pass with a CPU simulation step from the same input.
+ *
+ * \param[in] inputBufferObjectId  Buffer object read by the movement shader.
+ * \param[in] outputBufferObjectId Buffer object written by the movement shader.
+ * \param[in] time                 Time value passed to the movement shader.
+ */
+void validateTransformFeedbackOutput(GLuint inputBufferObjectId, GLuint outputBufferObjectId, float time)
+{
+    const GLsizeiptr size = spherePositionsAndVelocitiesLength * sizeof(float);
+
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, inputBufferObjectId));
+    const float* input = (const float*) GL_CHECK(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_READ_BIT));
+    ASSERT(input != NULL, "Could not map the transform feedback input buffer.");
+    cpuSimulation->setState(input);
+    GL_CHECK(glUnmapBuffer(GL_ARRAY_BUFFER));
+
+    cpuSimulation->step(time);
+    cpuSimulation->getState(cpuPositionAndVelocity);
+
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, outputBufferObjectId));
+    const float* output = (const float*) GL_CHECK(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_READ_BIT));
+    ASSERT(output != NULL, "Could not map the transform feedback output buffer.");
+
+    for (int allComponents = 0; allComponents < spherePositionsAndVelocitiesLength; allComponents++)
+    {
+        /* The shader sums in a different order, so only differences well above rounding are reported. */
+        const float difference = fabsf(output[allComponents] - cpuPositionAndVelocity[allComponents]);
+
+        if (difference > 1e-3f * (1.0f + fabsf(cpuPositionAndVelocity[allComponents])))
+        {
+            LOGE("Transform feedback differs from CPU simulation for sphere %d: %f (GPU) vs %f (CPU).\n",
+                 (allComponents / 4) % numberOfSpheresToGenerate,
+                 output[allComponents],
+                 cpuPositionAndVelocity[allComponents]);
+            break;
+        }
+    }
+
+    GL_CHECK(glUnmapBuffer(GL_ARRAY_BUFFER));
+}
+
 /**
  * \brief Render new frame's contents into back buffer.
  */
@@ -385,91 +491,120 @@ void renderFrame()
     /* Value of time returned by timer used for determining leader's position and to keep the leader's velocity constant across different GPUs. */
     float timerTime = timer.getTime();
 
-    /*
-     * Transform feedback is used for setting position and velocity for each of the spheres.
-     * You cannot read from and write to the same buffer object at a time, so we use a ping-pong approach.
-     * During first call, ping buffer is used for reading and pong buffer for writing.
-     * During second call, pong buffer is used for reading and ping buffer for writing.
-     */
-
-    /* [Set output buffer] */
-    /*
-     * Configure transform feedback.
-     * Bind buffer object to first varying (location) of GL_TRANSFORM_FEEDBACK_BUFFER - binding point index equal to 0.
-     * Use the first half of the data array, 0 -> sizeof(float) * 4 * numberOfSpheresToGenerate (4 floating point position coordinates per sphere).
-     * Bind buffer object to first varying (velocity) of GL_TRANSFORM_FEEDBACK_BUFFER - binding point index equal to 1.
-     * Use the second half of the data array, from the end of the position data until the end of the velocity data.
-     * The size of the velocity data is sizeof(float) * 4 * numberOfSpheresToGenerate values (4 floating point velocity coordinates per sphere).
-     *
-     * The buffer bound here is used as an output from the movement vertex shader. The output variables in the shader that are bound to this buffer are
-     * given by the call to glTransformFeedbackVaryings earlier.
-     */
-    if (usePingBufferForTransformFeedbackOutput)
+    if (useCpuSimulation)
     {
-        GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
-                                   0,
-                                   spherePingPositionAndVelocityBufferObjectId,
-                                   0,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate));
-        GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
-                                   1,
-                                   spherePingPositionAndVelocityBufferObjectId,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate));
+        /* Write the result to the buffer object that transform feedback would have written to, so rendering is unchanged. */
+        cpuSimulation->step(timerTime);
+        cpuSimulation->getState(cpuPositionAndVelocity);
+
+        GL_CHECK(glBindBuffer   (GL_ARRAY_BUFFER,
+                                 usePingBufferForTransformFeedbackOutput ? spherePingPositionAndVelocityBufferObjectId
+                                                                         : spherePongPositionAndVelocityBufferObjectId));
+        GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER,
+                                 0,
+                                 sizeof(cpuPositionAndVelocity),
+                                 cpuPositionAndVelocity));
     }
     else
     {
-        GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
-                                   0,
-                                   spherePongPositionAndVelocityBufferObjectId,
-                                   0,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate));
-        GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
-                                   1,
-                                   spherePongPositionAndVelocityBufferObjectId,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate,
-                                   sizeof(float) * 4 * numberOfSpheresToGenerate));
-    }
-    /* [Set output buffer] */
+        /*
+         * Transform feedback is used for setting position and velocity for each of the spheres.
+         * You cannot read from and write to the same buffer object at a time, so we use a ping-pong approach.
+         * During first call, ping buffer is used for reading and pong buffer for writing.
+         * During second call, pong buffer is used for reading and ping buffer for writing.
+         */
+
+        /* [Set output buffer] */
+        /*
+         * Configure transform feedback.
+         * Bind buffer object to first varying (location) of GL_TRANSFORM_FEEDBACK_BUFFER - binding point index equal to 0.
+         * Use the first half of the data array, 0 -> sizeof(float) * 4 * numberOfSpheresToGenerate (4 floating point position coordinates per sphere).
+         * Bind buffer object to first varying (velocity) of GL_TRANSFORM_FEEDBACK_BUFFER - binding point index equal to 1.
+         * Use the second half of the data array, from the end of the position data until the end of the velocity data.
+         * The size of the velocity data is sizeof(float) * 4 * numberOfSpheresToGenerate values (4 floating point velocity coordinates per sphere).
+         *
+         * The buffer bound here is used as an output from the movement vertex shader. The output variables in the shader that are bound to this buffer are
+         * given by the call to glTransformFeedbackVaryings earlier.
+         */
+        if (usePingBufferForTransformFeedbackOutput)
+        {
+            GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                                       0,
+                                       spherePingPositionAndVelocityBufferObjectId,
+                                       0,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate));
+            GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                                       1,
+                                       spherePingPositionAndVelocityBufferObjectId,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate));
+        }
+        else
+        {
+            GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                                       0,
+                                       spherePongPositionAndVelocityBufferObjectId,
+                                       0,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate));
+            GL_CHECK(glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                                       1,
+                                       spherePongPositionAndVelocityBufferObjectId,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate,
+                                       sizeof(float) * 4 * numberOfSpheresToGenerate));
+        }
+        /* [Set output buffer] */
+
+        /* [Set input buffer] */
+        /*
+         * The buffer bound here is used as the input to the movement vertex shader. The data is mapped to the uniform block, and as the size of the
+         * arrays inside the uniform block is known, the data is mapped to the correct variables.
+         */
+        if (usePingBufferForTransformFeedbackOutput)
+        {
+            GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER, 0, spherePongPositionAndVelocityBufferObjectId));
+        }
+        else
+        {
+            GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER, 0, spherePingPositionAndVelocityBufferObjectId));
+        }
+        /* [Set input buffer] */
+
+        /* [Use the transform feedback] */
+        /*
+         * Perform the boids transformation.
+         * This takes the current boid data in the buffers and passes it through the movement vertex shader.
+         * This fills the output buffer with the updated location and velocity information for each boid.
+         */
+        GL_CHECK(glEnable(GL_RASTERIZER_DISCARD));
+        {
+            GL_CHECK(glUseProgram(movementProgramId));
+            GL_CHECK(glBeginTransformFeedback(GL_POINTS));
+            {
+                GL_CHECK(glUniform1f(timeLocation, timerTime));
+                GL_CHECK(glDrawArraysInstanced(GL_POINTS, 0, 1, numberOfSpheresToGenerate));
+            }
+            GL_CHECK(glEndTransformFeedback());
+        }
+        GL_CHECK(glDisable(GL_RASTERIZER_DISCARD));
+        /* [Use the transform feedback] */
 
-    /* [Set input buffer] */
-    /*
-     * The buffer bound here is used as the input to the movement vertex shader. The data is mapped to the uniform block, and as the size of the
-     * arrays inside the uniform block is known, the data is mapped to the correct variables.
-     */
-    if (usePingBufferForTransformFeedbackOutput)
-    {
-        GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER, 0, spherePongPositionAndVelocityBufferObjectId));
-    }
-    else
-    {
-        GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER, 0, spherePingPositionAndVelocityBufferObjectId));
-    }
-    /* [Set input buffer] */
+        /* Clean up. */
+        GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+        GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0));
+        GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER,            0, 0));
 
-    /* [Use the transform feedback] */
-    /*
-     * Perform the boids transformation.
-     * This takes the current boid data in the buffers and passes it through the movement vertex shader.
-     * This fills the output buffer with the updated location and velocity information for each boid.
-     */
-    GL_CHECK(glEnable(GL_RASTERIZER_DISCARD));
-    {
-        GL_CHECK(glUseProgram(movementProgramId));
-        GL_CHECK(glBeginTransformFeedback(GL_POINTS));
+        if (validateTransformFeedback)
         {
-            GL_CHECK(glUniform1f(timeLocation, timerTime));
-            GL_CHECK(glDrawArraysInstanced(GL_POINTS, 0, 1, numberOfSpheresToGenerate));
+            if (usePingBufferForTransformFeedbackOutput)
+            {
+                validateTransformFeedbackOutput(spherePongPositionAndVelocityBufferObjectId, spherePingPositionAndVelocityBufferObjectId, timerTime);
+            }
+            else
+            {
+                validateTransformFeedbackOutput(spherePingPositionAndVelocityBufferObjectId, spherePongPositionAndVelocityBufferObjectId, timerTime);
+            }
         }
-        GL_CHECK(glEndTransformFeedback());
     }
-    GL_CHECK(glDisable(GL_RASTERIZER_DISCARD));
-    /* [Use the transform feedback] */
-
-    /* Clean up. */
-    GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
-    GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0));
-    GL_CHECK(glBindBufferBase(GL_UNIFORM_BUFFER,            0, 0));
     /*
      * Rasterizer pass.
      * Render the scene using the calculated locations of the boids.
@@ -512,6 +647,21 @@ void setupGraphics(int width, int height)
     initializeData();
     /* Create programs. */
     setupPrograms();
+
+    if (useCpuSimulation || validateTransformFeedback || cpuBenchmarkNumberOfBoids > 0)
+    {
+        threadPool = new ThreadPool();
+    }
+    if (cpuBenchmarkNumberOfBoids > 0)
+    {
+        benchmarkCpuSimulation();
+    }
+    if (useCpuSimulation || validateTransformFeedback)
+    {
+        /* Start from the data that setupPrograms() put in the pong buffer object, which is read first. */
+        cpuSimulation = new BoidsSimulation(numberOfSpheresToGenerate, threadPool);
+        cpuSimulation->setState(startPositionAndVelocity);
+    }
     /* Start counting time. */
     timer.reset();
 
@@ -569,6 +719,11 @@ void uninit()
     GL_CHECK(glDeleteShader (vertexShaderId));
     GL_CHECK(glDeleteProgram(renderingProgramId));
     GL_CHECK(glDeleteProgram(movementProgramId));
+
+    delete cpuSimulation;
+    cpuSimulation = NULL;
+    delete threadPool;
+    threadPool = NULL;
 }
 
 extern "C"